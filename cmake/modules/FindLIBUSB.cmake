@@ -13,7 +13,7 @@
 #
 
 # FreeBSD has built-in libusb since 800069
-IF(CMAKE_SYSTEM_NAME MATCHES FreeBSD)
+IF(CMAKE_SYSTEM_NAME MATCHES FreeBSD AND NOT LIBNFC_USE_LIBUSB1)
   EXEC_PROGRAM(sysctl ARGS -n kern.osreldate OUTPUT_VARIABLE FREEBSD_VERSION)
   SET(MIN_FREEBSD_VERSION 800068)
   IF(FREEBSD_VERSION GREATER ${MIN_FREEBSD_VERSION})
@@ -22,7 +22,7 @@ IF(CMAKE_SYSTEM_NAME MATCHES FreeBSD)
     SET(LIBUSB_LIBRARIES "usb")
     SET(LIBUSB_LIBRARY_DIRS "/usr/lib/")
   ENDIF(FREEBSD_VERSION GREATER ${MIN_FREEBSD_VERSION})
-ENDIF(CMAKE_SYSTEM_NAME MATCHES FreeBSD)
+ENDIF(CMAKE_SYSTEM_NAME MATCHES FreeBSD AND NOT LIBNFC_USE_LIBUSB1)
 
 IF(NOT LIBUSB_FOUND)
   IF(WIN32)
@@ -41,7 +41,11 @@ IF(NOT LIBUSB_FOUND)
     # If not under Windows we use PkgConfig
     FIND_PACKAGE (PkgConfig)
     IF(PKG_CONFIG_FOUND)
-      PKG_CHECK_MODULES(LIBUSB REQUIRED libusb)
+      IF(LIBNFC_USE_LIBUSB1)
+        PKG_CHECK_MODULES(LIBUSB REQUIRED libusb-1.0)
+      ELSE(LIBNFC_USE_LIBUSB1)
+        PKG_CHECK_MODULES(LIBUSB REQUIRED libusb)
+      ENDIF(LIBNFC_USE_LIBUSB1)
     ELSE(PKG_CONFIG_FOUND)
       MESSAGE(FATAL_ERROR "Could not find PkgConfig")
     ENDIF(PKG_CONFIG_FOUND)
@@ -57,6 +57,11 @@ typedef struct nfc_device nfc_device;
  */
 typedef struct nfc_driver nfc_driver;
 
+/**
+ * Group of devices polled concurrently
+ */
+typedef struct nfc_poll_group nfc_poll_group;
+
 /**
  * Connection string
  */
@@ -353,6 +358,112 @@ typedef struct {
   nfc_modulation nm;
 } nfc_target;
 
+/**
+ * Amount of buckets of latency histograms
+ */
+#define NFC_STATS_HISTOGRAM_LEN 24
+
+/**
+ * Amount of distinct chip commands tracked in device statistics
+ */
+#define NFC_STATS_COMMANDS_LEN 32
+
+/**
+ * @struct nfc_latency_stats
+ * @brief Latency statistics, durations are in microseconds
+ *
+ * histogram[0] counts durations under 1 us, histogram[i] those from 2^(i-1)
+ * (included) to 2^i us (excluded) and the last bucket all longer durations.
+ */
+typedef struct {
+  uint64_t count;
+  uint64_t total_us;
+  uint64_t max_us;
+  uint64_t histogram[NFC_STATS_HISTOGRAM_LEN];
+} nfc_latency_stats;
+
+/**
+ * @struct nfc_command_stats
+ * @brief Statistics of a chip command, e.g. PN53x InDataExchange
+ */
+typedef struct {
+  /** Command code */
+  uint8_t code;
+  /** Failed commands, including the timed out and aborted ones */
+  uint64_t errors;
+  uint64_t timeouts;
+  uint64_t aborts;
+  /** Command and response payload bytes */
+  uint64_t bytes_sent;
+  uint64_t bytes_received;
+  /** Time from sending the command to receiving its response */
+  nfc_latency_stats latency;
+} nfc_command_stats;
+
+/**
+ * @struct nfc_device_stats
+ * @brief Input/output statistics of a device
+ */
+typedef struct {
+  /** Frames exchanged with the device and their payload bytes, as counted by its driver */
+  uint64_t frames_sent;
+  uint64_t bytes_sent;
+  uint64_t frames_received;
+  uint64_t bytes_received;
+  /** Frames sent again after a transmission failure */
+  uint64_t retries;
+  /** NACK frames sent or received */
+  uint64_t nacks;
+  /** Failed commands, including the timed out and aborted ones */
+  uint64_t errors;
+  uint64_t timeouts;
+  uint64_t aborts;
+  /** Commands answered by the device which involved RF communication with targets */
+  uint64_t rf_exchanges;
+  /** Time spent writing frames to the device */
+  nfc_latency_stats send;
+  /** Time from a frame written to its acknowledgement */
+  nfc_latency_stats ack_wait;
+  /** Time spent waiting for and reading responses */
+  nfc_latency_stats receive;
+  /** Amount of valid entries in commands */
+  size_t command_count;
+  /** Per command statistics, in order of first use */
+  nfc_command_stats commands[NFC_STATS_COMMANDS_LEN];
+} nfc_device_stats;
+
+/**
+ * @struct nfc_poll_event
+ * @brief Target found, or error met, by a device of a poll group
+ */
+typedef struct {
+  /** Device which polled */
+  nfc_device *device;
+  /** Index, in the poll group modulations, of the modulation polled */
+  size_t modulation;
+  /** NFC_SUCCESS when \a target was found, otherwise the error met by \a device */
+  int error;
+  /** Target found */
+  nfc_target target;
+} nfc_poll_event;
+
+/**
+ * @brief Target arrival and departure callback
+ *
+ * Called by nfc_device_watch_targets() from its own thread, with \a present
+ * true when \a pnt was selected and false once it left the field.
+ */
+typedef void (*nfc_target_callback)(nfc_device *pnd, const nfc_target *pnt, const bool present, void *user_data);
+
+/**
+ * @brief Log sink callback
+ *
+ * Receives each logged message along with its monotonic timestamp in
+ * microseconds and its priority (1: error, 2: info, 3: debug). When logging
+ * is asynchronous, it is called from the libnfc log thread.
+ */
+typedef void (*nfc_log_callback)(const uint64_t timestamp_us, const int priority, const char *category, const char *message, void *user_data);
+
 // Reset struct alignment to default
 #  pragma pack()
 
@@ -84,6 +84,14 @@ extern  "C" {
 NFC_EXPORT void nfc_init(nfc_context **context) ATTRIBUTE_NONNULL(1);
 NFC_EXPORT void nfc_exit(nfc_context *context) ATTRIBUTE_NONNULL(1);
 NFC_EXPORT int nfc_register_driver(const nfc_driver *driver);
+NFC_EXPORT void nfc_set_log_level(nfc_context *context, const uint32_t log_level) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT uint32_t nfc_get_log_level(const nfc_context *context) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT int nfc_log_set_stderr_sink(nfc_context *context) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT int nfc_log_set_file_sink(nfc_context *context, const char *path) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT int nfc_log_set_callback_sink(nfc_context *context, nfc_log_callback callback, void *user_data) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT int nfc_log_start_async(nfc_context *context, const size_t records) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT int nfc_log_stop_async(nfc_context *context) ATTRIBUTE_NONNULL(1);
+NFC_EXPORT uint64_t nfc_log_get_dropped(const nfc_context *context) ATTRIBUTE_NONNULL(1);
 
 /* NFC Device/Hardware manipulation */
 NFC_EXPORT nfc_device *nfc_open(nfc_context *context, const nfc_connstring connstring) ATTRIBUTE_NONNULL(1);
@@ -102,11 +110,23 @@ NFC_EXPORT int nfc_initiator_select_dep_target(nfc_device *pnd, const nfc_dep_mo
 NFC_EXPORT int nfc_initiator_poll_dep_target(nfc_device *pnd, const nfc_dep_mode ndm, const nfc_baud_rate nbr, const nfc_dep_info *pndiInitiator, nfc_target *pnt, const int timeout);
 NFC_EXPORT int nfc_initiator_deselect_target(nfc_device *pnd);
 NFC_EXPORT int nfc_initiator_transceive_bytes(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, int timeout);
+NFC_EXPORT int nfc_initiator_transceive_bytes_async(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+NFC_EXPORT int nfc_initiator_transceive_bytes_complete(nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int timeout);
 NFC_EXPORT int nfc_initiator_transceive_bits(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtRx, const size_t szRx, uint8_t *pbtRxPar);
 NFC_EXPORT int nfc_initiator_transceive_bytes_timed(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, uint32_t *cycles);
 NFC_EXPORT int nfc_initiator_transceive_bits_timed(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtRx, const size_t szRx, uint8_t *pbtRxPar, uint32_t *cycles);
 NFC_EXPORT int nfc_initiator_target_is_present(nfc_device *pnd, const nfc_target *pnt);
 
+/* NFC initiator: poll several devices concurrently */
+NFC_EXPORT nfc_poll_group *nfc_poll_group_new(const nfc_modulation *pnmModulations, const size_t szModulations, const size_t szEvents);
+NFC_EXPORT int nfc_poll_group_add(nfc_poll_group *group, nfc_device *pnd);
+NFC_EXPORT int nfc_poll_group_start(nfc_poll_group *group, const size_t szWorkers);
+NFC_EXPORT int nfc_poll_group_next(nfc_poll_group *group, nfc_poll_event *pevent, const int timeout);
+NFC_EXPORT int nfc_poll_group_stop(nfc_poll_group *group);
+NFC_EXPORT void nfc_poll_group_free(nfc_poll_group *group);
+NFC_EXPORT int nfc_device_watch_targets(nfc_device *pnd, const nfc_modulation *pnmModulations, const size_t szModulations, const int period, nfc_target_callback callback, void *user_data);
+NFC_EXPORT int nfc_device_unwatch_targets(nfc_device *pnd);
+
 /* NFC target: act as tag (i.e. MIFARE Classic) or NFC target device. */
 NFC_EXPORT int nfc_target_init(nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRx, int timeout);
 NFC_EXPORT int nfc_target_send_bytes(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
@@ -123,6 +143,9 @@ NFC_EXPORT int nfc_device_get_last_error(const nfc_device *pnd);
 /* Special data accessors */
 NFC_EXPORT const char *nfc_device_get_name(nfc_device *pnd);
 NFC_EXPORT const char *nfc_device_get_connstring(nfc_device *pnd);
+NFC_EXPORT int nfc_device_get_pollfd(nfc_device *pnd);
+NFC_EXPORT int nfc_device_get_stats(const nfc_device *pnd, nfc_device_stats *pstats);
+NFC_EXPORT int nfc_device_reset_stats(nfc_device *pnd);
 NFC_EXPORT int nfc_device_get_supported_modulation(nfc_device *pnd, const nfc_mode mode,  const nfc_modulation_type **const supported_mt);
 NFC_EXPORT int nfc_device_get_supported_baud_rate(nfc_device *pnd, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
 NFC_EXPORT int nfc_device_get_supported_baud_rate_target_mode(nfc_device *pnd, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
@@ -134,8 +157,12 @@ NFC_EXPORT int nfc_device_set_property_bool(nfc_device *pnd, const nfc_property
 /* Misc. functions */
 NFC_EXPORT void iso14443a_crc(uint8_t *pbtData, size_t szLen, uint8_t *pbtCrc);
 NFC_EXPORT void iso14443a_crc_append(uint8_t *pbtData, size_t szLen);
+NFC_EXPORT bool iso14443a_crc_check(const uint8_t *pbtData, size_t szLen);
+NFC_EXPORT void iso14443a_crc_batch(const uint8_t *const *ppbtData, const size_t *pszLen, size_t szCount, uint8_t *pbtCrc);
 NFC_EXPORT void iso14443b_crc(uint8_t *pbtData, size_t szLen, uint8_t *pbtCrc);
 NFC_EXPORT void iso14443b_crc_append(uint8_t *pbtData, size_t szLen);
+NFC_EXPORT bool iso14443b_crc_check(const uint8_t *pbtData, size_t szLen);
+NFC_EXPORT void iso14443b_crc_batch(const uint8_t *const *ppbtData, const size_t *pszLen, size_t szCount, uint8_t *pbtCrc);
 NFC_EXPORT uint8_t *iso14443a_locate_historical_bytes(uint8_t *pbtAts, size_t szAts, size_t *pszTk);
 
 NFC_EXPORT void nfc_free(void *p);
@@ -0,0 +1,214 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/**
+ * @file gpio.c
+ * @brief GPIO interrupt line, using the Linux GPIO character device
+ *
+ * A line is named "<gpiochip device>@<line offset>", e.g. "/dev/gpiochip0@25".
+ * It is requested for falling edge events, as used by the PN532 P70_IRQ pin
+ * which goes low when a response is ready.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "gpio.h"
+
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/gpio.h>
+
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_COM
+#define LOG_CATEGORY "libnfc.bus.gpio"
+
+struct gpio_irq_unix {
+  int fd;         // Line event file descriptor
+  int epfd;       // epoll set: line events and abort fd
+  int abort_fd;   // Abort fd currently in epfd, -1 if none
+};
+
+#define GPIO_DATA( X ) ((struct gpio_irq_unix *) X)
+
+/**
+ * @brief Use an already opened file descriptor as interrupt line
+ *
+ * Any fd becoming readable on edges will do: the line is considered triggered
+ * whenever it is readable, and pending data is drained after each wait. This
+ * is used for the GPIO character device line events, and allows to use an
+ * eventfd in place of a real line.
+ *
+ * @return the interrupt line (owning \a fd) or INVALID_GPIO_IRQ
+ */
+gpio_irq
+gpio_irq_open_fd(int fd)
+{
+  struct gpio_irq_unix *irq = malloc(sizeof(struct gpio_irq_unix));
+
+  if (irq == NULL)
+    return INVALID_GPIO_IRQ;
+
+  irq->fd = fd;
+  irq->abort_fd = -1;
+
+  // Reads drain pending events, never block
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+  if (((irq->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) ||
+      (epoll_ctl(irq->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)) {
+    if (irq->epfd >= 0)
+      close(irq->epfd);
+    free(irq);
+    return INVALID_GPIO_IRQ;
+  }
+  return irq;
+}
+
+/**
+ * @brief Request falling edge events of a GPIO line
+ *
+ * @param pcLineName "<gpiochip device>@<line offset>"
+ * @return the interrupt line or INVALID_GPIO_IRQ
+ */
+gpio_irq
+gpio_irq_open(const char *pcLineName)
+{
+#ifdef GPIO_GET_LINEEVENT_IOCTL
+  char acChip[64];
+  uint32_t uiLine;
+
+  if ((sscanf(pcLineName, "%63[^@]@%10"SCNu32, acChip, &uiLine) != 2)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid GPIO line: %s (expected <gpiochip>@<line>)", pcLineName);
+    return INVALID_GPIO_IRQ;
+  }
+
+  int chip_fd = open(acChip, O_RDONLY);
+  if (chip_fd < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to open %s: %s", acChip, strerror(errno));
+    return INVALID_GPIO_IRQ;
+  }
+
+  struct gpioevent_request req;
+  memset(&req, 0, sizeof(req));
+  req.lineoffset = uiLine;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+  req.eventflags = GPIOEVENT_REQUEST_FALLING_EDGE;
+  strncpy(req.consumer_label, "libnfc", sizeof(req.consumer_label) - 1);
+
+  int res = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+  close(chip_fd);
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to request events of %s line %" PRIu32 ": %s", acChip, uiLine, strerror(errno));
+    return INVALID_GPIO_IRQ;
+  }
+
+  gpio_irq irq = gpio_irq_open_fd(req.fd);
+  if (irq == INVALID_GPIO_IRQ)
+    close(req.fd);
+  return irq;
+#else
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "GPIO line events are not supported, unable to use %s", pcLineName);
+  return INVALID_GPIO_IRQ;
+#endif
+}
+
+void
+gpio_irq_close(gpio_irq irq)
+{
+  close(GPIO_DATA(irq)->epfd);
+  close(GPIO_DATA(irq)->fd);
+  free(irq);
+}
+
+static void
+gpio_irq_drain(struct gpio_irq_unix *irq)
+{
+  // Line events are 16 bytes records, an eventfd gives its 8 bytes counter
+  uint8_t abtEvents[16 * 16];
+  while (read(irq->fd, abtEvents, sizeof(abtEvents)) > 0)
+    ;
+}
+
+/**
+ * @brief Wait for an edge on the interrupt line, or an abort request
+ *
+ * Edges seen before the call are reported at once: callers check the device
+ * state first and only then wait, so no edge is lost in between.
+ *
+ * @param iAbortFd fd becoming readable on abort requests, -1 if none
+ * @param timeout timeout in ms, 0 or less to wait forever
+ * @return NFC_SUCCESS on edge, NFC_ETIMEOUT, NFC_EOPABORTED or NFC_EIO
+ */
+int
+gpio_irq_wait(gpio_irq irq, int iAbortFd, int timeout)
+{
+  struct gpio_irq_unix *gi = GPIO_DATA(irq);
+  struct epoll_event ev = { .events = EPOLLIN };
+
+  // The abort fd may change between calls, keep only the current one in the set
+  if (gi->abort_fd != iAbortFd) {
+    if (gi->abort_fd >= 0)
+      epoll_ctl(gi->epfd, EPOLL_CTL_DEL, gi->abort_fd, NULL);
+    gi->abort_fd = -1;
+    if (iAbortFd >= 0) {
+      ev.data.fd = iAbortFd;
+      if (epoll_ctl(gi->epfd, EPOLL_CTL_ADD, iAbortFd, &ev) < 0)
+        return NFC_EIO;
+      gi->abort_fd = iAbortFd;
+    }
+  }
+
+  int res;
+  do {
+    res = epoll_wait(gi->epfd, &ev, 1, (timeout > 0) ? timeout : -1);
+  } while ((res < 0) && (EINTR == errno));
+
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Error waiting for GPIO line: %s", strerror(errno));
+    return NFC_EIO;
+  }
+  if (res == 0)
+    return NFC_ETIMEOUT;
+  if (ev.data.fd != gi->fd)
+    return NFC_EOPABORTED;
+
+  gpio_irq_drain(gi);
+  return NFC_SUCCESS;
+}
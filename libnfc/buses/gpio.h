@@ -0,0 +1,50 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ *
+ */
+
+/**
+ * @file gpio.h
+ * @brief GPIO interrupt line header
+ */
+
+#ifndef __NFC_BUS_GPIO_H__
+#  define __NFC_BUS_GPIO_H__
+
+#  include <stdint.h>
+
+#  include <nfc/nfc-types.h>
+
+// Define shortcut to types to make code more readable
+typedef void *gpio_irq;
+#  define INVALID_GPIO_IRQ (void*)(~1)
+
+gpio_irq gpio_irq_open(const char *pcLineName);
+gpio_irq gpio_irq_open_fd(int fd);
+void    gpio_irq_close(gpio_irq irq);
+
+int     gpio_irq_wait(gpio_irq irq, int iAbortFd, int timeout);
+
+#endif // __NFC_BUS_GPIO_H__
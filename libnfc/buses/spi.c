@@ -54,6 +54,7 @@
 
 #include <nfc/nfc.h>
 #include "nfc-internal.h"
+#include "mirror-subr.h"
 
 #define LOG_GROUP    NFC_LOG_GROUP_COM
 #define LOG_CATEGORY "libnfc.bus.spi"
@@ -69,8 +70,15 @@ const char *spi_ports_device_radix[] = { "spidev", NULL };
 #  endif
 
 
+// Initial size of the LSB-first transmit buffer, enough for any PN532 frame
+#define SPI_SCRATCH_LEN 512
+#define SPI_SCRATCH_ALIGN 16
+
 struct spi_port_unix {
   int 			fd; 			// Serial port file descriptor
+  struct spi_ioc_transfer tr[2];  // Transfers of a transaction, set up once
+  uint8_t *pbtScratch;            // Bit-reversed copy of LSB-first transmits
+  size_t szScratch;
   //~ struct termios 	termios_backup; 	// Terminal info before using the port
   //~ struct termios 	termios_new; 		// Terminal info during the transaction
 };
@@ -86,6 +94,14 @@ spi_open(const char *pcPortName)
   if (sp == 0)
     return INVALID_SPI_PORT;
 
+  memset(sp->tr, 0, sizeof(sp->tr));
+  sp->szScratch = 0;
+  if (posix_memalign((void **) &sp->pbtScratch, SPI_SCRATCH_ALIGN, SPI_SCRATCH_LEN) != 0) {
+    free(sp);
+    return INVALID_SPI_PORT;
+  }
+  sp->szScratch = SPI_SCRATCH_LEN;
+
   sp->fd = open(pcPortName, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (sp->fd == -1) {
     spi_close(sp);
@@ -139,30 +155,31 @@ void
 spi_close(const spi_port sp)
 {
   close(SPI_DATA(sp)->fd);
+  free(SPI_DATA(sp)->pbtScratch);
   free(sp);
 }
 
 
 /**
- * @brief Perform bit reversal on one byte \a x
+ * @brief Make sure the port scratch buffer holds at least \a szLen bytes
  *
- * @return reversed byte
+ * @return 0 on success, otherwise NFC_ESOFT
  */
-
-static uint8_t
-bit_reversal(const uint8_t x)
+static int
+spi_reserve_scratch(struct spi_port_unix *sp, const size_t szLen)
 {
-  uint8_t ret = x;
-  ret = (((ret & 0xaa) >> 1) | ((ret & 0x55) << 1));
-  ret = (((ret & 0xcc) >> 2) | ((ret & 0x33) << 2));
-  ret = (((ret & 0xf0) >> 4) | ((ret & 0x0f) << 4));
-  return ret;
+  uint8_t *pbtScratch;
+
+  if (szLen <= sp->szScratch)
+    return NFC_SUCCESS;
+  if (posix_memalign((void **) &pbtScratch, SPI_SCRATCH_ALIGN, szLen) != 0)
+    return NFC_ESOFT;
+  free(sp->pbtScratch);
+  sp->pbtScratch = pbtScratch;
+  sp->szScratch = szLen;
+  return NFC_SUCCESS;
 }
 
-
-
-
-
 /**
  * @brief Send \a pbtTx content to SPI then receive data from SPI and copy data to \a pbtRx. CS line stays active	 between transfers as well as during transfers.
  *
@@ -171,61 +188,34 @@ bit_reversal(const uint8_t x)
 int
 spi_send_receive(spi_port sp, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, bool lsb_first)
 {
+  struct spi_ioc_transfer *tr = SPI_DATA(sp)->tr;
   size_t transfers = 0;
-  struct spi_ioc_transfer tr[2];
-
-
-  uint8_t *pbtTxLSB = 0;
 
   if (szTx) {
     LOG_HEX(LOG_GROUP, "TX", pbtTx, szTx);
     if (lsb_first) {
-      pbtTxLSB = malloc(szTx * sizeof(uint8_t));
-      if (!pbtTxLSB) {
-        return NFC_ESOFT;
-      }
-
-      size_t i;
-      for (i = 0; i < szTx; ++i) {
-        pbtTxLSB[i] = bit_reversal(pbtTx[i]);
-      }
-
-      pbtTx = pbtTxLSB;
+      int res;
+      if ((res = spi_reserve_scratch(SPI_DATA(sp), szTx)) < 0)
+        return res;
+      mirror_buffer(SPI_DATA(sp)->pbtScratch, pbtTx, szTx);
+      pbtTx = SPI_DATA(sp)->pbtScratch;
     }
 
-    struct spi_ioc_transfer tr_send = {
-      .tx_buf = (unsigned long) pbtTx,
-      .rx_buf = 0,
-      .len = szTx,
-      .delay_usecs = 0,
-      .speed_hz = 0,
-      .bits_per_word = 0,
-    };
-    tr[transfers] = tr_send;
-
+    tr[transfers].tx_buf = (unsigned long) pbtTx;
+    tr[transfers].rx_buf = 0;
+    tr[transfers].len = szTx;
     ++transfers;
   }
 
   if (szRx) {
-    struct spi_ioc_transfer tr_receive = {
-      .tx_buf = 0,
-      .rx_buf = (unsigned long) pbtRx,
-      .len = szRx,
-      .delay_usecs = 0,
-      .speed_hz = 0,
-      .bits_per_word = 0,
-    };
-    tr[transfers] = tr_receive;
+    tr[transfers].tx_buf = 0;
+    tr[transfers].rx_buf = (unsigned long) pbtRx;
+    tr[transfers].len = szRx;
     ++transfers;
   }
 
-
-
   if (transfers) {
     int ret = ioctl(SPI_DATA(sp)->fd, SPI_IOC_MESSAGE(transfers), tr);
-    if (szTx && lsb_first) {
-      free(pbtTxLSB);
-    }
 
     if (ret != (int)(szRx + szTx)) {
       return NFC_EIO;
@@ -234,17 +224,13 @@ spi_send_receive(spi_port sp, const uint8_t *pbtTx, const size_t szTx, uint8_t *
     // Reverse received bytes if needed
     if (szRx) {
       if (lsb_first) {
-        size_t i;
-        for (i = 0; i < szRx; ++i) {
-          pbtRx[i] = bit_reversal(pbtRx[i]);
-        }
+        mirror_buffer(pbtRx, pbtRx, szRx);
       }
 
       LOG_HEX(LOG_GROUP, "RX", pbtRx, szRx);
     }
   }
 
-
   return NFC_SUCCESS;
 }
 
@@ -41,6 +41,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
@@ -57,21 +58,7 @@
 #define LOG_GROUP    NFC_LOG_GROUP_COM
 #define LOG_CATEGORY "libnfc.bus.uart"
 
-#ifndef _WIN32
-// Needed by sleep() under Unix
-#  include <unistd.h>
-#  include <time.h>
-#  define msleep(x) do { \
-    struct timespec xsleep; \
-    xsleep.tv_sec = x / 1000; \
-    xsleep.tv_nsec = (x - xsleep.tv_sec * 1000) * 1000 * 1000; \
-    nanosleep(&xsleep, NULL); \
-  } while (0)
-#else
-// Needed by Sleep() under Windows
-#  include <winbase.h>
-#  define msleep Sleep
-#endif
+#include <time.h>
 
 #  if defined(__APPLE__)
 const char *serial_ports_device_radix[] = { "tty.SLAB_USBtoUART", "tty.usbserial", "tty.usbmodem", NULL };
@@ -92,13 +79,40 @@ const char *serial_ports_device_radix[] = { "ttyUSB", "ttyS", "ttyACM", "ttyAMA"
 #  define FIONREAD TIOCINQ
 #endif
 
+// Under Linux, wait for incoming bytes with epoll(7) instead of select(2)
+#if defined(__linux__)
+#  define UART_USE_EPOLL
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#endif
+
 // Work-around to claim uart interface using the c_iflag (software input processing) from the termios struct
 #  define CCLAIMED 0x80000000
 
+// Size of the receive ring buffer, must be a power of 2
+#define UART_RX_BUFFER_LEN 4096
+
+// When flushing with "wait", bytes are drained until none came for
+// UART_QUIET_TIME ms, but no longer than UART_DRAIN_MAX_TIME ms
+#define UART_QUIET_TIME 5
+#define UART_DRAIN_MAX_TIME 50
+
 struct serial_port_unix {
   int 			fd; 			// Serial port file descriptor
   struct termios 	termios_backup; 	// Terminal info before using the port
   struct termios 	termios_new; 		// Terminal info during the transaction
+  // Incoming bytes are read by large chunks into this ring buffer, frame
+  // parsing then consumes them without issuing a syscall per segment
+  uint8_t		rx_buf[UART_RX_BUFFER_LEN];
+  size_t		rx_head;		// Index of the next byte to consume
+  size_t		rx_count;		// Count of buffered bytes
+#ifdef UART_USE_EPOLL
+  int			epfd;			// epoll set: serial port and abort fd
+  int			abort_fd;		// Abort fd currently in epfd, 0 if none
+  int			poll_epfd;		// epoll set returned by uart_get_fd()
+  int			pending_fd;		// eventfd readable while rx_buf holds data
+  bool			pending_signaled;
+#endif
 };
 
 #define UART_DATA( X ) ((struct serial_port_unix *) X)
@@ -113,6 +127,15 @@ uart_open(const char *pcPortName)
   if (sp == 0)
     return INVALID_SERIAL_PORT;
 
+  sp->rx_head = 0;
+  sp->rx_count = 0;
+#ifdef UART_USE_EPOLL
+  sp->epfd = -1;
+  sp->abort_fd = 0;
+  sp->poll_epfd = -1;
+  sp->pending_fd = -1;
+  sp->pending_signaled = false;
+#endif
   sp->fd = open(pcPortName, O_RDWR | O_NOCTTY | O_NONBLOCK);
   if (sp->fd == -1) {
     uart_close_ext(sp, false);
@@ -143,49 +166,241 @@ uart_open(const char *pcPortName)
     uart_close_ext(sp, true);
     return INVALID_SERIAL_PORT;
   }
+#ifdef UART_USE_EPOLL
+  struct epoll_event ev = { .events = EPOLLIN, .data.fd = sp->fd };
+  if (((sp->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) ||
+      (epoll_ctl(sp->epfd, EPOLL_CTL_ADD, sp->fd, &ev) < 0)) {
+    uart_close_ext(sp, true);
+    return INVALID_SERIAL_PORT;
+  }
+#endif
   return sp;
 }
 
-void
-uart_flush_input(serial_port sp, bool wait)
+#ifdef UART_USE_EPOLL
+// Keep the fd returned by uart_get_fd() readable while bytes wait in rx_buf
+static void
+uart_update_pending(struct serial_port_unix *sp)
 {
-  // flush commands may seem to be without effect
-  // if asked too quickly after previous event, cf comments below
-  // therefore a "wait" argument allows now to wait before flushing
-  // I believe that now the byte-eater part is not required anymore --Phil
-  if (wait) {
-    msleep(50); // 50 ms
+  if (sp->pending_fd < 0)
+    return;
+  if (sp->rx_count && !sp->pending_signaled) {
+    eventfd_write(sp->pending_fd, 1);
+    sp->pending_signaled = true;
+  } else if (!sp->rx_count && sp->pending_signaled) {
+    eventfd_t value;
+    eventfd_read(sp->pending_fd, &value);
+    sp->pending_signaled = false;
   }
+}
+#else
+#  define uart_update_pending(sp) do {} while (0)
+#endif
 
-  // This line seems to produce absolutely no effect on my system (GNU/Linux 2.6.35)
-  tcflush(UART_DATA(sp)->fd, TCIFLUSH);
-  // So, I wrote this byte-eater
-  // Retrieve the count of the incoming bytes
-  int available_bytes_count = 0;
+// Copy up to szRx buffered bytes to pbtRx, return the count of copied bytes
+static size_t
+uart_rx_consume(struct serial_port_unix *sp, uint8_t *pbtRx, size_t szRx)
+{
+  size_t len = MIN(szRx, sp->rx_count);
+  size_t first = MIN(len, UART_RX_BUFFER_LEN - sp->rx_head);
+  memcpy(pbtRx, sp->rx_buf + sp->rx_head, first);
+  memcpy(pbtRx + first, sp->rx_buf, len - first);
+  sp->rx_head = (sp->rx_head + len) & (UART_RX_BUFFER_LEN - 1);
+  sp->rx_count -= len;
+  return len;
+}
+
+// Read as much as possible from the serial port into rx_buf
+static int
+uart_rx_fill(struct serial_port_unix *sp)
+{
+  size_t tail = (sp->rx_head + sp->rx_count) & (UART_RX_BUFFER_LEN - 1);
+  size_t space = UART_RX_BUFFER_LEN - sp->rx_count;
+  struct iovec iov[2];
+  int iovcnt = 1;
+
+  iov[0].iov_base = sp->rx_buf + tail;
+  iov[0].iov_len = MIN(space, UART_RX_BUFFER_LEN - tail);
+  if (iov[0].iov_len < space) {
+    iov[1].iov_base = sp->rx_buf;
+    iov[1].iov_len = space - iov[0].iov_len;
+    iovcnt = 2;
+  }
+
+  ssize_t res = readv(sp->fd, iov, iovcnt);
+  if (res < 0) {
+    if ((EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno))
+      return 0;
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
+    return NFC_EIO;
+  }
+  // Stop if the OS has some troubles reading the data
+  if (res == 0) {
+    return NFC_EIO;
+  }
+  sp->rx_count += res;
+  return res;
+}
+
+#ifdef UART_USE_EPOLL
+/*
+ * Wait for incoming bytes or an abort request.
+ * The abort fd is (re)registered at each wait as drivers recreate their abort
+ * pipe after each abort, the fd number may then be the same for a new file.
+ */
+static int
+uart_wait(struct serial_port_unix *sp, int iAbortFd, int timeout)
+{
+  struct epoll_event ev;
+  if (iAbortFd) {
+    if (sp->abort_fd && (sp->abort_fd != iAbortFd)) {
+      epoll_ctl(sp->epfd, EPOLL_CTL_DEL, sp->abort_fd, NULL);
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = iAbortFd;
+    if ((epoll_ctl(sp->epfd, EPOLL_CTL_ADD, iAbortFd, &ev) < 0) && (EEXIST != errno)) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
+      return NFC_EIO;
+    }
+    sp->abort_fd = iAbortFd;
+  }
+
+  for (;;) {
+    int res = epoll_wait(sp->epfd, &ev, 1, (timeout > 0) ? timeout : -1);
+
+    if ((res < 0) && (EINTR == errno)) {
+      // The system call was interupted by a signal and a signal handler was
+      // run.  Restart the interupted system call.
+      continue;
+    }
+
+    // Read error
+    if (res < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
+      return NFC_EIO;
+    }
+    // Read time-out
+    if (res == 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
+      return NFC_ETIMEOUT;
+    }
+
+    if (ev.data.fd == sp->fd)
+      return 0;
+
+    if (iAbortFd && (ev.data.fd == iAbortFd)) {
+      // Abort requested
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Abort!");
+      close(iAbortFd);
+      sp->abort_fd = 0;
+      return NFC_EOPABORTED;
+    }
+
+    // Abort fd left over from a previous call, this receive can't be aborted
+    epoll_ctl(sp->epfd, EPOLL_CTL_DEL, ev.data.fd, NULL);
+    sp->abort_fd = 0;
+  }
+}
+#else
+/*
+ * Wait for incoming bytes or an abort request.
+ */
+static int
+uart_wait(struct serial_port_unix *sp, int iAbortFd, int timeout)
+{
   int res;
-  res = ioctl(UART_DATA(sp)->fd, FIONREAD, &available_bytes_count);
-  if (res != 0) {
-    return;
+  fd_set rfds;
+select:
+  // Reset file descriptor
+  FD_ZERO(&rfds);
+  FD_SET(sp->fd, &rfds);
+
+  if (iAbortFd) {
+    FD_SET(iAbortFd, &rfds);
   }
-  if (available_bytes_count == 0) {
-    return;
+
+  struct timeval timeout_tv;
+  if (timeout > 0) {
+    timeout_tv.tv_sec = (timeout / 1000);
+    timeout_tv.tv_usec = ((timeout % 1000) * 1000);
   }
-  char *rx = malloc(available_bytes_count);
-  if (!rx) {
-    perror("malloc");
-    return;
+
+  res = select(MAX(sp->fd, iAbortFd) + 1, &rfds, NULL, NULL, timeout ? &timeout_tv : NULL);
+
+  if ((res < 0) && (EINTR == errno)) {
+    // The system call was interupted by a signal and a signal handler was
+    // run.  Restart the interupted system call.
+    goto select;
   }
-  // There is something available, read the data
-  if (read(UART_DATA(sp)->fd, rx, available_bytes_count) < 0) {
-    perror("uart read");
-    free(rx);
-    return;
+
+  // Read error
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
+    return NFC_EIO;
+  }
+  // Read time-out
+  if (res == 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
+    return NFC_ETIMEOUT;
   }
-  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%d bytes have eaten.", available_bytes_count);
-  free(rx);
+
+  if (FD_ISSET(iAbortFd, &rfds)) {
+    // Abort requested
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Abort!");
+    close(iAbortFd);
+    return NFC_EOPABORTED;
+  }
+  return 0;
 }
+#endif
 
+/**
+ * @brief Drop incoming bytes
+ *
+ * @param wait if true, bytes still in flight are dropped as well: the input is
+ * drained until the line stays quiet for a short while
+ */
 void
+uart_flush_input(serial_port sp, bool wait)
+{
+  size_t szEaten = UART_DATA(sp)->rx_count;
+
+  // Drop what was already buffered
+  UART_DATA(sp)->rx_head = 0;
+  UART_DATA(sp)->rx_count = 0;
+
+  // This line seems to produce absolutely no effect on my system (GNU/Linux 2.6.35)
+  tcflush(UART_DATA(sp)->fd, TCIFLUSH);
+
+  if (wait) {
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (uart_wait(UART_DATA(sp), 0, UART_QUIET_TIME) == 0) {
+      if (uart_rx_fill(UART_DATA(sp)) < 0)
+        break;
+      szEaten += UART_DATA(sp)->rx_count;
+      UART_DATA(sp)->rx_head = 0;
+      UART_DATA(sp)->rx_count = 0;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if ((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000 >= UART_DRAIN_MAX_TIME)
+        break;
+    }
+  } else {
+    // So, I wrote this byte-eater
+    // There is something available, read the data
+    if (uart_rx_fill(UART_DATA(sp)) > 0) {
+      szEaten += UART_DATA(sp)->rx_count;
+      UART_DATA(sp)->rx_head = 0;
+      UART_DATA(sp)->rx_count = 0;
+    }
+  }
+  uart_update_pending(UART_DATA(sp));
+
+  if (szEaten)
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%zu bytes have eaten.", szEaten);
+}
+
+int
 uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
 {
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Serial port speed requested to be set to %d baud.", uiPortSpeed);
@@ -222,19 +437,28 @@ uart_set_speed(serial_port sp, const uint32_t uiPortSpeed)
     case 460800:
       stPortSpeed = B460800;
       break;
+#  endif
+#  ifdef B921600
+    case 921600:
+      stPortSpeed = B921600;
+      break;
 #  endif
     default:
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set serial port speed to %d baud. Speed value must be one of those defined in termios(3).",
               uiPortSpeed);
-      return;
+      return NFC_EINVARG;
   };
 
   // Set port speed (Input and Output)
+  struct termios termios_previous = UART_DATA(sp)->termios_new;
   cfsetispeed(&(UART_DATA(sp)->termios_new), stPortSpeed);
   cfsetospeed(&(UART_DATA(sp)->termios_new), stPortSpeed);
   if (tcsetattr(UART_DATA(sp)->fd, TCSADRAIN, &(UART_DATA(sp)->termios_new)) == -1) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to apply new speed settings.");
+    UART_DATA(sp)->termios_new = termios_previous;
+    return NFC_EIO;
   }
+  return NFC_SUCCESS;
 }
 
 uint32_t
@@ -270,6 +494,11 @@ uart_get_speed(serial_port sp)
     case B460800:
       uiPortSpeed = 460800;
       break;
+#  endif
+#  ifdef B921600
+    case B921600:
+      uiPortSpeed = 921600;
+      break;
 #  endif
   }
 
@@ -279,6 +508,14 @@ uart_get_speed(serial_port sp)
 void
 uart_close_ext(const serial_port sp, const bool restore_termios)
 {
+#ifdef UART_USE_EPOLL
+  if (UART_DATA(sp)->epfd >= 0)
+    close(UART_DATA(sp)->epfd);
+  if (UART_DATA(sp)->poll_epfd >= 0)
+    close(UART_DATA(sp)->poll_epfd);
+  if (UART_DATA(sp)->pending_fd >= 0)
+    close(UART_DATA(sp)->pending_fd);
+#endif
   if (UART_DATA(sp)->fd >= 0) {
     if (restore_termios)
       tcsetattr(UART_DATA(sp)->fd, TCSANOW, &UART_DATA(sp)->termios_backup);
@@ -302,67 +539,22 @@ int
 uart_receive(serial_port sp, uint8_t *pbtRx, const size_t szRx, void *abort_p, int timeout)
 {
   int iAbortFd = abort_p ? *((int *)abort_p) : 0;
-  int received_bytes_count = 0;
-  int available_bytes_count = 0;
-  const int expected_bytes_count = (int)szRx;
+  size_t received_bytes_count = uart_rx_consume(UART_DATA(sp), pbtRx, szRx);
   int res;
-  fd_set rfds;
-  do {
-select:
-    // Reset file descriptor
-    FD_ZERO(&rfds);
-    FD_SET(UART_DATA(sp)->fd, &rfds);
-
-    if (iAbortFd) {
-      FD_SET(iAbortFd, &rfds);
-    }
-
-    struct timeval timeout_tv;
-    if (timeout > 0) {
-      timeout_tv.tv_sec = (timeout / 1000);
-      timeout_tv.tv_usec = ((timeout % 1000) * 1000);
-    }
 
-    res = select(MAX(UART_DATA(sp)->fd, iAbortFd) + 1, &rfds, NULL, NULL, timeout ? &timeout_tv : NULL);
-
-    if ((res < 0) && (EINTR == errno)) {
-      // The system call was interupted by a signal and a signal handler was
-      // run.  Restart the interupted system call.
-      goto select;
-    }
-
-    // Read error
-    if (res < 0) {
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Error: %s", strerror(errno));
-      return NFC_EIO;
-    }
-    // Read time-out
-    if (res == 0) {
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Timeout!");
-      return NFC_ETIMEOUT;
-    }
-
-    if (FD_ISSET(iAbortFd, &rfds)) {
-      // Abort requested
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Abort!");
-      close(iAbortFd);
-      return NFC_EOPABORTED;
+  while (szRx > received_bytes_count) {
+    if ((res = uart_wait(UART_DATA(sp), iAbortFd, timeout)) < 0) {
+      uart_update_pending(UART_DATA(sp));
+      return res;
     }
-
-    // Retrieve the count of the incoming bytes
-    res = ioctl(UART_DATA(sp)->fd, FIONREAD, &available_bytes_count);
-    if (res != 0) {
-      return NFC_EIO;
-    }
-    // There is something available, read the data
-    res = read(UART_DATA(sp)->fd, pbtRx + received_bytes_count, MIN(available_bytes_count, (expected_bytes_count - received_bytes_count)));
-    // Stop if the OS has some troubles reading the data
-    if (res <= 0) {
-      return NFC_EIO;
+    // There is something available, read all the data we can hold
+    if ((res = uart_rx_fill(UART_DATA(sp))) < 0) {
+      uart_update_pending(UART_DATA(sp));
+      return res;
     }
-    received_bytes_count += res;
-
-  } while (expected_bytes_count > received_bytes_count);
+    received_bytes_count += uart_rx_consume(UART_DATA(sp), pbtRx + received_bytes_count, szRx - received_bytes_count);
+  }
+  uart_update_pending(UART_DATA(sp));
   LOG_HEX(LOG_GROUP, "RX", pbtRx, szRx);
   return NFC_SUCCESS;
 }
@@ -383,6 +575,42 @@ uart_send(serial_port sp, const uint8_t *pbtTx, const size_t szTx, int timeout)
     return NFC_EIO;
 }
 
+/**
+ * @brief Get a file descriptor to wait for incoming data
+ *
+ * Bytes may already wait in the receive buffer while the serial port is not
+ * readable anymore, so under Linux the returned fd is an epoll set which is
+ * also readable while the receive buffer is not empty.
+ *
+ * @return file descriptor
+ */
+int
+uart_get_fd(const serial_port sp)
+{
+#ifdef UART_USE_EPOLL
+  struct serial_port_unix *usp = UART_DATA(sp);
+  if (usp->poll_epfd < 0) {
+    struct epoll_event ev = { .events = EPOLLIN };
+    if ((usp->pending_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+      return usp->fd;
+    if ((usp->poll_epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+      close(usp->pending_fd);
+      usp->pending_fd = -1;
+      return usp->fd;
+    }
+    ev.data.fd = usp->fd;
+    epoll_ctl(usp->poll_epfd, EPOLL_CTL_ADD, usp->fd, &ev);
+    ev.data.fd = usp->pending_fd;
+    epoll_ctl(usp->poll_epfd, EPOLL_CTL_ADD, usp->pending_fd, &ev);
+    usp->pending_signaled = false;
+    uart_update_pending(usp);
+  }
+  return usp->poll_epfd;
+#else
+  return UART_DATA(sp)->fd;
+#endif
+}
+
 char **
 uart_list_ports(void)
 {
@@ -27,30 +27,537 @@
 
 /**
  * @file usbbus.c
- * @brief libusb 0.1 driver wrapper
+ * @brief USB bus wrapper (libusb 0.1 or libusb 1.0)
  */
 
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
 #endif // HAVE_CONFIG_H
 
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#if defined(LIBUSB1_ENABLED) && defined(__linux__)
+#  include <sys/eventfd.h>
+#  include <unistd.h>
+#  define USBBUS_POLLFD
+#endif
 
 #include "usbbus.h"
+#include "nfc-internal.h"
 #include "log.h"
 #define LOG_CATEGORY "libnfc.buses.usbbus"
 #define LOG_GROUP    NFC_LOG_GROUP_DRIVER
 
+#ifndef MIN
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
+// Flags shared with the thread aborting a read, or handling libusb events
+#if defined(__GNUC__)
+#  define usbbus_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#  define usbbus_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+#  define usbbus_load(p) (*(volatile int *)(p))
+#  define usbbus_store(p, v) ((void)(*(volatile int *)(p) = (v)))
+#endif
+
+#if defined(LIBUSB1_ENABLED)
+
+/*
+ * libusb 1.0 backend
+ *
+ * Bulk-IN reads go through an asynchronous transfer owned by the handle. It
+ * can be submitted ahead of time with usbbus_bulk_read_submit() (i.e. before
+ * sending the command whose answer is expected) and is cancelled by
+ * usbbus_bulk_read_abort(), so aborting a blocking command is immediate.
+ *
+ * Under Linux, usbbus_get_pollfd() gives an eventfd which the transfer
+ * callback makes readable. Callbacks only run while some thread handles
+ * libusb events, so once a pollfd is in use a thread does it until the last
+ * handle using one is closed.
+ */
+
+#define USBBUS_TRANSFER_LEN 512
+
+typedef enum {
+  TRANSFER_IDLE,
+  TRANSFER_PENDING,
+  TRANSFER_DONE,
+} usbbus_transfer_state;
+
+struct usbbus_handle {
+  libusb_device_handle *pudh;
+  int interface;
+  struct libusb_transfer *transfer;
+  uint8_t buffer[USBBUS_TRANSFER_LEN];
+  /** usbbus_transfer_state, see usbbus_load() */
+  int state;
+  /** Set by the transfer callback, checked by libusb under its event waiters lock */
+  int completed;
+  int abort_flag;
+  /** Readable once the transfer completed, -1 until usbbus_get_pollfd() */
+  int pollfd;
+};
+
+static libusb_context *usbbus_context = NULL;
+
+#ifdef USBBUS_POLLFD
+// Thread handling libusb events for the handles using a pollfd, with nfc_global_lock() held
+static struct {
+  nfc_thread thread;
+  unsigned int users;
+  int stop;
+} usbbus_events;
+
+static void *
+usbbus_events_thread(void *arg)
+{
+  (void) arg;
+  // libusb checks stop under its events lock, which libusb_close() takes after it is set
+  while (!usbbus_load(&usbbus_events.stop))
+    libusb_handle_events_completed(usbbus_context, &usbbus_events.stop);
+  return NULL;
+}
+
+static void
+usbbus_pollfd_signal(usbbus_handle *h)
+{
+  const int fd = usbbus_load(&h->pollfd);
+  if (fd >= 0) {
+    const uint64_t ui64One = 1;
+    if (write(fd, &ui64One, sizeof(ui64One)) < 0)
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to signal USB transfer completion (%s)", strerror(errno));
+  }
+}
+
+static void
+usbbus_pollfd_clear(usbbus_handle *h)
+{
+  const int fd = usbbus_load(&h->pollfd);
+  if (fd >= 0) {
+    uint64_t ui64Count;
+    // Non-blocking, fails when nothing was signaled
+    if (read(fd, &ui64Count, sizeof(ui64Count)) < 0) {
+      // Nothing to clear
+    }
+  }
+}
+#else
+#  define usbbus_pollfd_signal(h) ((void)(h))
+#  define usbbus_pollfd_clear(h) ((void)(h))
+#endif
+
+static int
+usbbus_errno(int libusb_error)
+{
+  switch (libusb_error) {
+    case LIBUSB_SUCCESS:
+      return 0;
+    case LIBUSB_ERROR_INVALID_PARAM:
+      return -EINVAL;
+    case LIBUSB_ERROR_ACCESS:
+      return -EPERM;
+    case LIBUSB_ERROR_NO_DEVICE:
+      return -ENODEV;
+    case LIBUSB_ERROR_NOT_FOUND:
+      return -ENOENT;
+    case LIBUSB_ERROR_BUSY:
+      return -EBUSY;
+    case LIBUSB_ERROR_TIMEOUT:
+      return -ETIMEDOUT;
+    case LIBUSB_ERROR_OVERFLOW:
+      return -EOVERFLOW;
+    case LIBUSB_ERROR_PIPE:
+      return -EPIPE;
+    case LIBUSB_ERROR_INTERRUPTED:
+      return -EINTR;
+    case LIBUSB_ERROR_NO_MEM:
+      return -ENOMEM;
+    case LIBUSB_ERROR_NOT_SUPPORTED:
+      return -ENOSYS;
+    default:
+      return -EIO;
+  }
+}
+
+int usb_prepare(void)
+{
+  // Drivers scan from several threads, the shared context is created once
+  nfc_global_lock();
+  if (!usbbus_context) {
+#ifdef ENVVARS
+    // Set libusb debug only if asked explicitely:
+    // LIBUSB_LOG_LEVEL=12288 (= NFC_LOG_PRIORITY_DEBUG * 2 ^ NFC_LOG_GROUP_LIBUSB)
+    if (((log_get_level() >> (NFC_LOG_GROUP_LIBUSB * 2)) & 0x00000003) >= NFC_LOG_PRIORITY_DEBUG) {
+      setenv("LIBUSB_DEBUG", "4", 1);
+    }
+#endif
+
+    int res;
+    if ((res = libusb_init(&usbbus_context)) < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to initialize libusb (%s)", libusb_error_name(res));
+      usbbus_context = NULL;
+      nfc_global_unlock();
+      return -1;
+    }
+  }
+  nfc_global_unlock();
+  return 0;
+}
+
+size_t
+usbbus_get_devices(struct usbbus_device **pdevices)
+{
+  libusb_device **list;
+  *pdevices = NULL;
+  if (!usbbus_context)
+    return 0;
+
+  ssize_t count = libusb_get_device_list(usbbus_context, &list);
+  if (count < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to find USB devices (%s)", libusb_error_name((int)count));
+    return 0;
+  }
+  // One more zeroed entry ends the list
+  if ((count == 0) || !(*pdevices = calloc(count + 1, sizeof(struct usbbus_device)))) {
+    libusb_free_device_list(list, 1);
+    return 0;
+  }
+
+  size_t n = 0;
+  for (ssize_t i = 0; i < count; i++) {
+    struct libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(list[i], &desc) < 0)
+      continue;
+
+    struct usbbus_device *dev = &(*pdevices)[n++];
+    snprintf(dev->dirname, sizeof(dev->dirname), "%03u", libusb_get_bus_number(list[i]));
+    snprintf(dev->filename, sizeof(dev->filename), "%03u", libusb_get_device_address(list[i]));
+    dev->idVendor = desc.idVendor;
+    dev->idProduct = desc.idProduct;
+    dev->iManufacturer = desc.iManufacturer;
+    dev->iProduct = desc.iProduct;
+
+    struct libusb_config_descriptor *config;
+    if (libusb_get_config_descriptor(list[i], 0, &config) == 0) {
+      if ((config->bNumInterfaces > 0) && (config->interface[0].num_altsetting > 0)) {
+        const struct libusb_interface_descriptor *puid = &config->interface[0].altsetting[0];
+        dev->has_config = true;
+        dev->bAlternateSetting = puid->bAlternateSetting;
+        dev->bNumEndpoints = MIN(puid->bNumEndpoints, USBBUS_MAX_ENDPOINTS);
+        for (uint8_t e = 0; e < dev->bNumEndpoints; e++) {
+          dev->endpoint[e].bEndpointAddress = puid->endpoint[e].bEndpointAddress;
+          dev->endpoint[e].bmAttributes = puid->endpoint[e].bmAttributes;
+          dev->endpoint[e].wMaxPacketSize = puid->endpoint[e].wMaxPacketSize;
+        }
+      }
+      libusb_free_config_descriptor(config);
+    }
+    // Keep a reference on the device until usbbus_free_devices()
+    dev->priv = libusb_ref_device(list[i]);
+  }
+  libusb_free_device_list(list, 1);
+  if (n == 0) {
+    free(*pdevices);
+    *pdevices = NULL;
+  }
+  return n;
+}
+
+void
+usbbus_free_devices(struct usbbus_device *devices)
+{
+  if (!devices)
+    return;
+  for (struct usbbus_device *dev = devices; dev->priv; dev++) {
+    libusb_unref_device(dev->priv);
+  }
+  free(devices);
+}
+
+usbbus_handle *
+usbbus_open(const struct usbbus_device *dev)
+{
+  usbbus_handle *h = malloc(sizeof(usbbus_handle));
+  if (!h)
+    return NULL;
+  if (libusb_open(dev->priv, &h->pudh) < 0) {
+    free(h);
+    return NULL;
+  }
+  if (!(h->transfer = libusb_alloc_transfer(0))) {
+    libusb_close(h->pudh);
+    free(h);
+    return NULL;
+  }
+  h->interface = 0;
+  usbbus_store(&h->state, TRANSFER_IDLE);
+  usbbus_store(&h->completed, 1);
+  usbbus_store(&h->abort_flag, 0);
+  usbbus_store(&h->pollfd, -1);
+  return h;
+}
+
+static void LIBUSB_CALL
+usbbus_transfer_cb(struct libusb_transfer *transfer)
+{
+  usbbus_handle *h = transfer->user_data;
+  usbbus_store(&h->state, TRANSFER_DONE);
+  // Wakes this handle's waiter even when another thread handled the event
+  usbbus_store(&h->completed, 1);
+  usbbus_pollfd_signal(h);
+}
+
+// Run libusb events until the pending transfer completes or the deadline is reached
+static void
+usbbus_wait_transfer(usbbus_handle *h, int timeout)
+{
+  struct timeval deadline, now, tv;
+  gettimeofday(&now, NULL);
+  deadline = now;
+  deadline.tv_sec += timeout / 1000;
+  deadline.tv_usec += (timeout % 1000) * 1000;
+  if (deadline.tv_usec >= 1000000) {
+    deadline.tv_sec++;
+    deadline.tv_usec -= 1000000;
+  }
+
+  bool cancelled = false;
+  while (usbbus_load(&h->state) == TRANSFER_PENDING) {
+    if ((usbbus_load(&h->abort_flag) || (timeout && timercmp(&now, &deadline, >=))) && !cancelled) {
+      libusb_cancel_transfer(h->transfer);
+      cancelled = true;
+    }
+    if (timeout && !cancelled) {
+      timersub(&deadline, &now, &tv);
+    } else {
+      // Cancellation or completion will end the wait, an upper bound is only a safety net
+      tv.tv_sec = 1;
+      tv.tv_usec = 0;
+    }
+    libusb_handle_events_timeout_completed(usbbus_context, &tv, &h->completed);
+    gettimeofday(&now, NULL);
+  }
+}
+
+int
+usbbus_bulk_read_submit(usbbus_handle *h, int ep, size_t size)
+{
+  const int state = usbbus_load(&h->state);
+  if (state == TRANSFER_PENDING)
+    return 0;
+  if (state == TRANSFER_DONE)
+    return 0; // An answer is already waiting to be consumed
+
+  libusb_fill_bulk_transfer(h->transfer, h->pudh, ep, h->buffer, MIN(size, sizeof(h->buffer)), usbbus_transfer_cb, h, 0);
+  usbbus_pollfd_clear(h);
+  usbbus_store(&h->completed, 0);
+  usbbus_store(&h->state, TRANSFER_PENDING);
+  int res = libusb_submit_transfer(h->transfer);
+  if (res < 0) {
+    usbbus_store(&h->state, TRANSFER_IDLE);
+    usbbus_store(&h->completed, 1);
+    return usbbus_errno(res);
+  }
+  return 0;
+}
+
+int
+usbbus_bulk_read(usbbus_handle *h, int ep, uint8_t *bytes, size_t size, int timeout)
+{
+  int res;
+  if ((res = usbbus_bulk_read_submit(h, ep, size)) < 0)
+    return res;
+
+  if (usbbus_load(&h->state) == TRANSFER_PENDING)
+    usbbus_wait_transfer(h, timeout);
+  usbbus_store(&h->state, TRANSFER_IDLE);
+  usbbus_pollfd_clear(h);
+
+  switch (h->transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+      break;
+    case LIBUSB_TRANSFER_CANCELLED:
+      if (usbbus_load(&h->abort_flag)) {
+        usbbus_store(&h->abort_flag, 0);
+        return -USB_CANCELED;
+      }
+      return -USB_TIMEDOUT;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+      return -USB_TIMEDOUT;
+    case LIBUSB_TRANSFER_STALL:
+      return -EPIPE;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+      return -ENODEV;
+    case LIBUSB_TRANSFER_OVERFLOW:
+      return -EOVERFLOW;
+    default:
+      return -EIO;
+  }
+  if ((size_t)h->transfer->actual_length > size)
+    return -EOVERFLOW;
+  memcpy(bytes, h->buffer, h->transfer->actual_length);
+  return h->transfer->actual_length;
+}
+
+int
+usbbus_bulk_read_abort(usbbus_handle *h)
+{
+  usbbus_store(&h->abort_flag, 1);
+  if (usbbus_load(&h->state) == TRANSFER_PENDING) {
+    libusb_cancel_transfer(h->transfer);
+  }
+  return 0;
+}
+
+int
+usbbus_get_pollfd(usbbus_handle *h)
+{
+#ifdef USBBUS_POLLFD
+  if (usbbus_load(&h->pollfd) >= 0)
+    return h->pollfd;
+  const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd < 0)
+    return -errno;
+  nfc_global_lock();
+  if (!usbbus_events.users) {
+    usbbus_store(&usbbus_events.stop, 0);
+    if (nfc_thread_create(&usbbus_events.thread, usbbus_events_thread, NULL) < 0) {
+      nfc_global_unlock();
+      close(fd);
+      return -ENOMEM;
+    }
+  }
+  usbbus_events.users++;
+  nfc_global_unlock();
+  usbbus_store(&h->pollfd, fd);
+  // The answer may already be there
+  if (usbbus_load(&h->state) == TRANSFER_DONE)
+    usbbus_pollfd_signal(h);
+  return fd;
+#else
+  (void) h;
+  return -ENOSYS;
+#endif
+}
+
+int
+usbbus_bulk_write(usbbus_handle *h, int ep, const uint8_t *bytes, size_t size, int timeout)
+{
+  int transferred = 0;
+  int res = libusb_bulk_transfer(h->pudh, ep, (unsigned char *)bytes, size, &transferred, timeout);
+  if (res < 0)
+    return usbbus_errno(res);
+  return transferred;
+}
+
+int
+usbbus_close(usbbus_handle *h)
+{
+  if (usbbus_load(&h->state) == TRANSFER_PENDING) {
+    libusb_cancel_transfer(h->transfer);
+    while (usbbus_load(&h->state) == TRANSFER_PENDING) {
+      libusb_handle_events_completed(usbbus_context, &h->completed);
+    }
+  }
+  libusb_free_transfer(h->transfer);
+#ifdef USBBUS_POLLFD
+  bool bLast = false;
+  if (h->pollfd >= 0) {
+    nfc_global_lock();
+    // libusb_close() interrupts event handling, so the thread sees stop
+    if ((bLast = (--usbbus_events.users == 0)))
+      usbbus_store(&usbbus_events.stop, 1);
+  }
+#endif
+  libusb_close(h->pudh);
+#ifdef USBBUS_POLLFD
+  if (h->pollfd >= 0) {
+    if (bLast)
+      nfc_thread_join(usbbus_events.thread);
+    nfc_global_unlock();
+    close(h->pollfd);
+  }
+#endif
+  free(h);
+  return 0;
+}
+
+int
+usbbus_set_configuration(usbbus_handle *h, int configuration)
+{
+  return usbbus_errno(libusb_set_configuration(h->pudh, configuration));
+}
+
+int
+usbbus_claim_interface(usbbus_handle *h, int interface)
+{
+  int res = libusb_claim_interface(h->pudh, interface);
+  if (res == 0)
+    h->interface = interface;
+  return usbbus_errno(res);
+}
+
+int
+usbbus_release_interface(usbbus_handle *h, int interface)
+{
+  return usbbus_errno(libusb_release_interface(h->pudh, interface));
+}
+
+int
+usbbus_set_altinterface(usbbus_handle *h, int alternate)
+{
+  return usbbus_errno(libusb_set_interface_alt_setting(h->pudh, h->interface, alternate));
+}
+
+int
+usbbus_reset(usbbus_handle *h)
+{
+  return usbbus_errno(libusb_reset_device(h->pudh));
+}
+
+int
+usbbus_get_string_simple(usbbus_handle *h, int index, char *buf, size_t buflen)
+{
+  int res = libusb_get_string_descriptor_ascii(h->pudh, index, (unsigned char *)buf, buflen);
+  if (res < 0) {
+    *buf = '\0';
+    return usbbus_errno(res);
+  }
+  return res;
+}
+
+#else // !LIBUSB1_ENABLED
+
+/*
+ * libusb 0.1 backend
+ *
+ * Reads are synchronous: a blocking read is cut in USB_TIMEOUT_PER_PASS chunks
+ * to be able to honor usbbus_bulk_read_abort().
+ */
+
+#define USB_TIMEOUT_PER_PASS 200
+
+struct usbbus_handle {
+  usb_dev_handle *pudh;
+  /** Set by usbbus_bulk_read_abort(), see usbbus_load() */
+  int abort_flag;
+};
+
 int usb_prepare(void)
 {
   static bool usb_initialized = false;
+  // libusb 0.1 keeps a single bus list, rescanned here and walked by usbbus_get_devices()
+  nfc_global_lock();
   if (!usb_initialized) {
 
 #ifdef ENVVARS
-    char *env_log_level = getenv("LIBNFC_LOG_LEVEL");
     // Set libusb debug only if asked explicitely:
     // LIBUSB_LOG_LEVEL=12288 (= NFC_LOG_PRIORITY_DEBUG * 2 ^ NFC_LOG_GROUP_LIBUSB)
-    if (env_log_level && (((atoi(env_log_level) >> (NFC_LOG_GROUP_LIBUSB * 2)) & 0x00000003) >= NFC_LOG_PRIORITY_DEBUG)) {
+    if (((log_get_level() >> (NFC_LOG_GROUP_LIBUSB * 2)) & 0x00000003) >= NFC_LOG_PRIORITY_DEBUG) {
       setenv("USB_DEBUG", "255", 1);
     }
 #endif
@@ -65,6 +572,7 @@ int usb_prepare(void)
   // busses and busses removed).
   if ((res = usb_find_busses()) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to find USB busses (%s)", _usb_strerror(res));
+    nfc_global_unlock();
     return -1;
   }
   // usb_find_devices will find all of the devices on each bus. This should be
@@ -72,8 +580,176 @@ int usb_prepare(void)
   // previous call to this function (total of new device and devices removed).
   if ((res = usb_find_devices()) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to find USB devices (%s)", _usb_strerror(res));
+    nfc_global_unlock();
     return -1;
   }
+  nfc_global_unlock();
+  return 0;
+}
+
+size_t
+usbbus_get_devices(struct usbbus_device **pdevices)
+{
+  struct usb_bus *bus;
+  struct usb_device *udev;
+  size_t count = 0;
+
+  *pdevices = NULL;
+  nfc_global_lock();
+  for (bus = usb_get_busses(); bus; bus = bus->next) {
+    for (udev = bus->devices; udev; udev = udev->next) {
+      count++;
+    }
+  }
+  // One more zeroed entry ends the list
+  if ((count == 0) || !(*pdevices = calloc(count + 1, sizeof(struct usbbus_device)))) {
+    nfc_global_unlock();
+    return 0;
+  }
+
+  size_t n = 0;
+  for (bus = usb_get_busses(); bus && (n < count); bus = bus->next) {
+    for (udev = bus->devices; udev && (n < count); udev = udev->next) {
+      struct usbbus_device *dev = &(*pdevices)[n++];
+      snprintf(dev->dirname, sizeof(dev->dirname), "%s", bus->dirname);
+      snprintf(dev->filename, sizeof(dev->filename), "%s", udev->filename);
+      dev->idVendor = udev->descriptor.idVendor;
+      dev->idProduct = udev->descriptor.idProduct;
+      dev->iManufacturer = udev->descriptor.iManufacturer;
+      dev->iProduct = udev->descriptor.iProduct;
+      // libusb-win32 may return a NULL udev->config, be robust before looking at endpoints
+      if (udev->config && udev->config->interface && udev->config->interface->altsetting) {
+        struct usb_interface_descriptor *puid = udev->config->interface->altsetting;
+        dev->has_config = true;
+        dev->bAlternateSetting = puid->bAlternateSetting;
+        dev->bNumEndpoints = MIN(puid->bNumEndpoints, USBBUS_MAX_ENDPOINTS);
+        for (uint8_t e = 0; e < dev->bNumEndpoints; e++) {
+          dev->endpoint[e].bEndpointAddress = puid->endpoint[e].bEndpointAddress;
+          dev->endpoint[e].bmAttributes = puid->endpoint[e].bmAttributes;
+          dev->endpoint[e].wMaxPacketSize = puid->endpoint[e].wMaxPacketSize;
+        }
+      }
+      dev->priv = udev;
+    }
+  }
+  nfc_global_unlock();
+  return n;
+}
+
+void
+usbbus_free_devices(struct usbbus_device *devices)
+{
+  free(devices);
+}
+
+usbbus_handle *
+usbbus_open(const struct usbbus_device *dev)
+{
+  usbbus_handle *h = malloc(sizeof(usbbus_handle));
+  if (!h)
+    return NULL;
+  if ((h->pudh = usb_open(dev->priv)) == NULL) {
+    free(h);
+    return NULL;
+  }
+  usbbus_store(&h->abort_flag, 0);
+  return h;
+}
+
+int
+usbbus_close(usbbus_handle *h)
+{
+  int res = usb_close(h->pudh);
+  free(h);
+  return res;
+}
+
+int
+usbbus_bulk_read_submit(usbbus_handle *h, int ep, size_t size)
+{
+  // Nothing to prepare with synchronous transfers
+  (void) h;
+  (void) ep;
+  (void) size;
+  return 0;
+}
+
+int
+usbbus_bulk_read(usbbus_handle *h, int ep, uint8_t *bytes, size_t size, int timeout)
+{
+  int remaining_time = timeout;
+  for (;;) {
+    int usb_timeout = (timeout == 0) ? USB_TIMEOUT_PER_PASS : MIN(remaining_time, USB_TIMEOUT_PER_PASS);
+    int res = usb_bulk_read(h->pudh, ep, (char *) bytes, size, usb_timeout);
+    if (res != -USB_TIMEDOUT)
+      return res;
+    if (usbbus_load(&h->abort_flag)) {
+      usbbus_store(&h->abort_flag, 0);
+      return -USB_CANCELED;
+    }
+    if (timeout != 0) {
+      remaining_time -= usb_timeout;
+      if (remaining_time <= 0)
+        return res;
+    }
+  }
+}
+
+int
+usbbus_bulk_read_abort(usbbus_handle *h)
+{
+  usbbus_store(&h->abort_flag, 1);
   return 0;
 }
 
+int
+usbbus_get_pollfd(usbbus_handle *h)
+{
+  // Reads are synchronous, nothing signals their completion
+  (void) h;
+  return -ENOSYS;
+}
+
+int
+usbbus_bulk_write(usbbus_handle *h, int ep, const uint8_t *bytes, size_t size, int timeout)
+{
+  return usb_bulk_write(h->pudh, ep, (const char *) bytes, size, timeout);
+}
+
+int
+usbbus_set_configuration(usbbus_handle *h, int configuration)
+{
+  return usb_set_configuration(h->pudh, configuration);
+}
+
+int
+usbbus_claim_interface(usbbus_handle *h, int interface)
+{
+  return usb_claim_interface(h->pudh, interface);
+}
+
+int
+usbbus_release_interface(usbbus_handle *h, int interface)
+{
+  return usb_release_interface(h->pudh, interface);
+}
+
+int
+usbbus_set_altinterface(usbbus_handle *h, int alternate)
+{
+  return usb_set_altinterface(h->pudh, alternate);
+}
+
+int
+usbbus_reset(usbbus_handle *h)
+{
+  return usb_reset(h->pudh);
+}
+
+int
+usbbus_get_string_simple(usbbus_handle *h, int index, char *buf, size_t buflen)
+{
+  return usb_get_string_simple(h->pudh, index, buf, buflen);
+}
+
+#endif // LIBUSB1_ENABLED
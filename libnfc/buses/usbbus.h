@@ -27,15 +27,22 @@
 
 /**
  * @file usbbus.h
- * @brief libusb 0.1 driver header
+ * @brief USB bus wrapper header (libusb 0.1 or libusb 1.0)
  */
 
 #ifndef __NFC_BUS_USB_H__
 #  define __NFC_BUS_USB_H__
 
-#ifndef _WIN32
-// Under POSIX system, we use libusb (>= 0.1.12)
 #include <stdint.h>
+#include <errno.h>
+
+#if defined(LIBUSB1_ENABLED)
+// libusb 1.0 errors are translated to negative errno values, as libusb 0.1 does
+#include <libusb.h>
+#define USB_TIMEDOUT ETIMEDOUT
+#define _usb_strerror( X ) strerror(-X)
+#elif !defined(_WIN32)
+// Under POSIX system, we use libusb (>= 0.1.12)
 #include <usb.h>
 #define USB_TIMEDOUT ETIMEDOUT
 #define _usb_strerror( X ) strerror(-X)
@@ -46,9 +53,74 @@
 #define _usb_strerror( X ) usb_strerror()
 #endif
 
+#ifndef ECANCELED
+#  define ECANCELED 125
+#endif
+// Returned (negated) by usbbus_bulk_read() when interrupted by usbbus_bulk_read_abort()
+#define USB_CANCELED ECANCELED
+
 #include <stdbool.h>
 #include <string.h>
 
+#define USBBUS_NAME_LEN 16
+#define USBBUS_MAX_ENDPOINTS 8
+
+#ifndef USB_ENDPOINT_IN
+#  define USB_ENDPOINT_IN        0x80
+#  define USB_ENDPOINT_OUT       0x00
+#  define USB_ENDPOINT_DIR_MASK  0x80
+#  define USB_ENDPOINT_TYPE_BULK 0x02
+#endif
+
+struct usbbus_endpoint {
+  uint8_t bEndpointAddress;
+  uint8_t bmAttributes;
+  uint16_t wMaxPacketSize;
+};
+
+/**
+ * @struct usbbus_device
+ * @brief Snapshot of an enumerated USB device
+ *
+ * Interface information describes the first alternate setting of the first
+ * interface of the active configuration; \a has_config is false when it
+ * could not be retrieved.
+ */
+struct usbbus_device {
+  char dirname[USBBUS_NAME_LEN];
+  char filename[USBBUS_NAME_LEN];
+  uint16_t idVendor;
+  uint16_t idProduct;
+  uint8_t iManufacturer;
+  uint8_t iProduct;
+  bool has_config;
+  uint8_t bAlternateSetting;
+  uint8_t bNumEndpoints;
+  struct usbbus_endpoint endpoint[USBBUS_MAX_ENDPOINTS];
+  void *priv;
+};
+
+typedef struct usbbus_handle usbbus_handle;
+
 int usb_prepare(void);
 
+size_t  usbbus_get_devices(struct usbbus_device **pdevices);
+void    usbbus_free_devices(struct usbbus_device *devices);
+
+usbbus_handle *usbbus_open(const struct usbbus_device *dev);
+int     usbbus_close(usbbus_handle *h);
+int     usbbus_set_configuration(usbbus_handle *h, int configuration);
+int     usbbus_claim_interface(usbbus_handle *h, int interface);
+int     usbbus_release_interface(usbbus_handle *h, int interface);
+int     usbbus_set_altinterface(usbbus_handle *h, int alternate);
+int     usbbus_reset(usbbus_handle *h);
+int     usbbus_get_string_simple(usbbus_handle *h, int index, char *buf, size_t buflen);
+
+int     usbbus_bulk_write(usbbus_handle *h, int ep, const uint8_t *bytes, size_t size, int timeout);
+int     usbbus_bulk_read(usbbus_handle *h, int ep, uint8_t *bytes, size_t size, int timeout);
+int     usbbus_bulk_read_submit(usbbus_handle *h, int ep, size_t size);
+int     usbbus_bulk_read_abort(usbbus_handle *h);
+// File descriptor readable once a submitted read completed, -ENOSYS when not supported
+int     usbbus_get_pollfd(usbbus_handle *h);
+
 #endif // __NFC_BUS_USB_H__
@@ -147,6 +147,8 @@ typedef enum {
 #else
 #  define PNCMD( X, Y ) { X , Y, #X }
 #  define PNCMD_TRACE( X ) do { \
+    if (!log_enabled(LOG_GROUP, NFC_LOG_PRIORITY_DEBUG)) \
+      break; \
     for (size_t i=0; i<(sizeof(pn53x_commands)/sizeof(pn53x_command)); i++) { \
       if ( X == pn53x_commands[i].ui8Code ) { \
         log_put( LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", pn53x_commands[i].abtCommandText ); \
@@ -231,6 +233,8 @@ typedef struct {
   } while(0)
 #else
 #  define PNREG_TRACE( X ) do { \
+    if (!log_enabled(LOG_GROUP, NFC_LOG_PRIORITY_DEBUG)) \
+      break; \
     for (size_t i=0; i<(sizeof(pn53x_registers)/sizeof(pn53x_register)); i++) { \
       if ( X == pn53x_registers[i].ui16Address ) { \
         log_put( LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s (%s)", pn53x_registers[i].abtRegisterText, pn53x_registers[i].abtRegisterDescription ); \
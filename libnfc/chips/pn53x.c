@@ -42,14 +42,17 @@
 
 #include "nfc/nfc.h"
 #include "nfc-internal.h"
+#include "nfc-capture.h"
 #include "pn53x.h"
 #include "pn53x-internal.h"
 
-#include "mirror-subr.h"
 
 #define LOG_CATEGORY "libnfc.chip.pn53x"
 #define LOG_GROUP NFC_LOG_GROUP_CHIP
 
+#define SAK_ISO14443_4_COMPLIANT 0x20
+#define SAK_ISO18092_COMPLIANT   0x40
+
 const uint8_t pn53x_ack_frame[] = { 0x00, 0x00, 0xff, 0x00, 0xff, 0x00 };
 const uint8_t pn53x_nack_frame[] = { 0x00, 0x00, 0xff, 0xff, 0x00, 0x00 };
 static const uint8_t pn53x_error_frame[] = { 0x00, 0x00, 0xff, 0x01, 0xff, 0x7f, 0x81, 0x00 };
@@ -66,6 +69,8 @@ const nfc_modulation_type pn53x_supported_modulation_as_target[] = {NMT_ISO14443
 /* prototypes */
 int pn53x_reset_settings(struct nfc_device *pnd);
 int pn53x_writeback_register(struct nfc_device *pnd);
+static int pn53x_transceive_submit_frame(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+static void pn53x_shadow_command(struct nfc_device *pnd, const uint8_t btCommand);
 
 nfc_modulation pn53x_ptt_to_nm(const pn53x_target_type ptt);
 pn53x_modulation pn53x_nm_to_pm(const nfc_modulation nm);
@@ -144,6 +149,8 @@ int
 pn53x_reset_settings(struct nfc_device *pnd)
 {
   int res = 0;
+  // Registers values are unknown until read or written again
+  pn53x_shadow_invalidate(pnd);
   // Reset the ending transmission bits register, it is unknown what the last tranmission used there
   CHIP_DATA(pnd)->ui8TxBits = 0;
   if ((res = pn53x_write_register(pnd, PN53X_REG_CIU_BitFraming, SYMBOL_TX_LAST_BITS, 0x00)) < 0) {
@@ -167,14 +174,157 @@ pn53x_reset_settings(struct nfc_device *pnd)
 int
 pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRxLen, int timeout)
 {
-  bool mi = false;
   int res = 0;
+  if ((res = pn53x_transceive_submit(pnd, pbtTx, szTx, timeout)) < 0) {
+    return res;
+  }
+  return pn53x_transceive_complete(pnd, pbtRx, szRxLen, timeout);
+}
+
+/**
+ * @brief Account the outcome of a command in the device statistics
+ *
+ * Latency and RF exchanges are only recorded when the chip answered, errors are recorded whenever res is negative.
+ */
+static void
+pn53x_stats_command(struct nfc_device *pnd, const uint8_t btCommand, const int res, const bool bAnswered)
+{
+  nfc_command_stats *pcs = nfc_stats_command(pnd, btCommand);
+
+  if (res < 0) {
+    pnd->stats.errors++;
+    if (NFC_ETIMEOUT == res) {
+      pnd->stats.timeouts++;
+    } else if (NFC_EOPABORTED == res) {
+      pnd->stats.aborts++;
+    }
+  }
+  if (bAnswered) {
+    switch (btCommand) {
+      case InListPassiveTarget:
+      case InDeselect:
+      case InRelease:
+      case InSelect:
+      case InDataExchange:
+      case InCommunicateThru:
+      case InJumpForDEP:
+      case InJumpForPSL:
+      case InATR:
+      case InPSL:
+      case InAutoPoll:
+        pnd->stats.rf_exchanges++;
+        break;
+      default:
+        break;
+    }
+  }
+  if (!pcs) {
+    return;
+  }
+  if (res < 0) {
+    pcs->errors++;
+    if (NFC_ETIMEOUT == res) {
+      pcs->timeouts++;
+    } else if (NFC_EOPABORTED == res) {
+      pcs->aborts++;
+    }
+  } else {
+    pcs->bytes_received += res;
+  }
+  if (bAnswered) {
+    nfc_stats_add_latency(&pcs->latency, CHIP_DATA(pnd)->command_start);
+  }
+}
+
+// Driver I/O, with the frames recorded when the device is captured
+static int
+pn53x_io_send(struct nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  if (pnd->capture)
+    nfc_capture_frame(pnd->capture, NFC_CAPTURE_TX, pbtData, szData);
+  const int res = CHIP_DATA(pnd)->io->send(pnd, pbtData, szData, timeout);
+  if ((res < 0) && pnd->capture)
+    nfc_capture_error(pnd->capture, NFC_CAPTURE_TX_ERROR, res);
+  return res;
+}
+
+static void
+pn53x_io_capture_reply(struct nfc_device *pnd, const uint8_t *pbtData, const int res)
+{
+  if (res < 0)
+    nfc_capture_error(pnd->capture, NFC_CAPTURE_RX_ERROR, res);
+  else
+    nfc_capture_frame(pnd->capture, NFC_CAPTURE_RX, pbtData, (size_t) res);
+}
+
+static int
+pn53x_io_receive(struct nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  const int res = CHIP_DATA(pnd)->io->receive(pnd, pbtData, szDataLen, timeout);
+  if (pnd->capture)
+    pn53x_io_capture_reply(pnd, pbtData, res);
+  return res;
+}
+
+static int
+pn53x_io_receive_frame(struct nfc_device *pnd, struct pn53x_frame *frame, int timeout)
+{
+  const int res = CHIP_DATA(pnd)->io->receive_frame(pnd, frame, timeout);
+  if (pnd->capture)
+    pn53x_io_capture_reply(pnd, frame->data, res);
+  return res;
+}
+
+/**
+ * @brief Send a command to the PN53x and return as soon as the chip acknowledged it
+ *
+ * The reply has to be collected later using pn53x_transceive_complete().
+ * When pbtTx was built in pn53x_tx_buffer(), the frame is built around it without copying.
+ * @return 0 on success, otherwise an error code
+ */
+int
+pn53x_transceive_submit(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
+{
+  int res = 0;
+  if (CHIP_DATA(pnd)->command_pending) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Command 0x%02x submitted while reply of 0x%02x is still pending", pbtTx[0], CHIP_DATA(pnd)->last_command);
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
+
+  if (szTx > PN53x_EXTENDED_FRAME__DATA_MAX_LEN) {
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
+
+  // Commands sent while this one is being submitted (register write-back,
+  // PN532 wake up from the driver) must not reuse the command frame
+  CHIP_DATA(pnd)->tx_depth++;
+  res = pn53x_transceive_submit_frame(pnd, pbtTx, szTx, timeout);
+  CHIP_DATA(pnd)->tx_depth--;
+  return res;
+}
+
+static int
+pn53x_transceive_submit_frame(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
+{
+  int res = 0;
+  uint8_t abtFrame[PN53x_FRAME__BUFFER_LEN];
+
   if (CHIP_DATA(pnd)->wb_trigged) {
     if ((res = pn53x_writeback_register(pnd)) < 0) {
       return res;
     }
   }
 
+  // Drivers build the frame around the command, so it needs some headroom:
+  // commands built with pn53x_tx_buffer() are sent as is, others are copied
+  if (pbtTx != CHIP_DATA(pnd)->tx_frame.data) {
+    uint8_t *pbtData = (CHIP_DATA(pnd)->tx_depth > 1) ? abtFrame + PN53x_FRAME__HEADROOM : CHIP_DATA(pnd)->tx_frame.data;
+    memcpy(pbtData, pbtTx, szTx);
+    pbtTx = pbtData;
+  }
+
   PNCMD_TRACE(pbtTx[0]);
   if (timeout > 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Timeout value: %d", timeout);
@@ -186,38 +336,89 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Invalid timeout value: %d", timeout);
   }
 
-  uint8_t  abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  size_t  szRx = sizeof(abtRx);
-
-  // Check if receiving buffers are available, if not, replace them
-  if (szRxLen == 0 || !pbtRx) {
-    pbtRx = abtRx;
-  } else {
-    szRx = szRxLen;
-  }
+  pn53x_shadow_command(pnd, pbtTx[0]);
 
-  // Call the send/receice callback functions of the current driver
-  if ((res = CHIP_DATA(pnd)->io->send(pnd, pbtTx, szTx, timeout)) < 0) {
+  // Call the send callback function of the current driver
+  const uint64_t ui64Start = nfc_stats_now();
+  pnd->stats_io_start = ui64Start;
+  if ((res = pn53x_io_send(pnd, pbtTx, szTx, timeout)) < 0) {
+    // Command may or may not have been run
+    pn53x_shadow_invalidate(pnd);
+    CHIP_DATA(pnd)->command_start = ui64Start;
+    pn53x_stats_command(pnd, pbtTx[0], res, false);
     return res;
   }
+  CHIP_DATA(pnd)->command_start = ui64Start;
+  nfc_command_stats *pcs = nfc_stats_command(pnd, pbtTx[0]);
+  if (pcs) {
+    pcs->bytes_sent += szTx;
+  }
 
   // Command is sent, we store the command
   CHIP_DATA(pnd)->last_command = pbtTx[0];
+  CHIP_DATA(pnd)->last_command_param = (szTx > 1) ? pbtTx[1] : 0x00;
+  CHIP_DATA(pnd)->command_pending = true;
 
   // Handle power mode for PN532
   if ((CHIP_DATA(pnd)->type == PN532) && (TgInitAsTarget == pbtTx[0])) {  // PN532 automatically goes into PowerDown mode when TgInitAsTarget command will be sent
     CHIP_DATA(pnd)->power_mode = POWERDOWN;
   }
+  return NFC_SUCCESS;
+}
 
-  if ((res = CHIP_DATA(pnd)->io->receive(pnd, pbtRx, szRx, timeout)) < 0) {
+/**
+ * @brief Wait for and decode the reply of the command sent by pn53x_transceive_submit()
+ * @return received bytes count on success, otherwise an error code
+ */
+int
+pn53x_transceive_complete(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRxLen, int timeout)
+{
+  bool mi = false;
+  int res = 0;
+  const uint8_t btCommand = CHIP_DATA(pnd)->last_command;
+
+  if (!CHIP_DATA(pnd)->command_pending) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "No command is pending");
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
+  if (timeout == -1) {
+    timeout = CHIP_DATA(pnd)->timeout_command;
+  }
+
+  struct pn53x_frame *frame = &CHIP_DATA(pnd)->rx_frame;
+  size_t  szRx = PN53x_EXTENDED_FRAME__DATA_MAX_LEN;
+
+  const uint64_t ui64Start = nfc_stats_now();
+  // Check if receiving buffers are available, if not, the reply is left in
+  // CHIP_DATA(pnd)->rx_frame, parsed in place when the driver is able to
+  if (szRxLen == 0 || !pbtRx) {
+    if (CHIP_DATA(pnd)->io->receive_frame) {
+      res = pn53x_io_receive_frame(pnd, frame, timeout);
+    } else {
+      frame->data = frame->buffer + PN53x_FRAME__HEADROOM;
+      res = pn53x_io_receive(pnd, frame->data, szRx, timeout);
+    }
+    pbtRx = frame->data;
+  } else {
+    szRx = szRxLen;
+    // Call the receive callback function of the current driver
+    res = pn53x_io_receive(pnd, pbtRx, szRx, timeout);
+  }
+  CHIP_DATA(pnd)->command_pending = false;
+  if (res < 0) {
+    // Command may have been interrupted in any state
+    pn53x_shadow_invalidate(pnd);
+    pn53x_stats_command(pnd, btCommand, res, false);
     return res;
   }
+  nfc_stats_add_latency(&pnd->stats.receive, ui64Start);
 
-  if ((CHIP_DATA(pnd)->type == PN532) && (TgInitAsTarget == pbtTx[0])) { // PN532 automatically wakeup on external RF field
+  if ((CHIP_DATA(pnd)->type == PN532) && (TgInitAsTarget == btCommand)) { // PN532 automatically wakeup on external RF field
     CHIP_DATA(pnd)->power_mode = NORMAL; // When TgInitAsTarget reply that means an external RF have waken up the chip
   }
 
-  switch (pbtTx[0]) {
+  switch (btCommand) {
     case PowerDown:
     case InDataExchange:
     case InCommunicateThru:
@@ -238,7 +439,7 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
       CHIP_DATA(pnd)->last_status_byte = pbtRx[0] & 0x3f;
       break;
     case Diagnose:
-      if (pbtTx[1] == 0x06) { // Diagnose: Card presence detection
+      if (CHIP_DATA(pnd)->last_command_param == 0x06) { // Diagnose: Card presence detection
         CHIP_DATA(pnd)->last_status_byte = pbtRx[0] & 0x3f;
       } else {
         CHIP_DATA(pnd)->last_status_byte = 0;
@@ -269,24 +470,46 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
 
   while (mi) {
     int res2;
-    uint8_t  abtRx2[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-    // Send empty command to card
-    if ((res2 = CHIP_DATA(pnd)->io->send(pnd, pbtTx, 2, timeout)) < 0) {
+    uint8_t abtCmd[PN53x_FRAME__HEADROOM + 2 + PN53x_FRAME__TAILROOM] = { 0 };
+    abtCmd[PN53x_FRAME__HEADROOM] = btCommand;
+    abtCmd[PN53x_FRAME__HEADROOM + 1] = CHIP_DATA(pnd)->last_command_param;
+    // Send empty command to card, its send time starts now
+    pnd->stats_io_start = nfc_stats_now();
+    if ((res2 = pn53x_io_send(pnd, abtCmd + PN53x_FRAME__HEADROOM, 2, timeout)) < 0) {
+      pn53x_stats_command(pnd, btCommand, res2, false);
       return res2;
     }
-    if ((res2 = CHIP_DATA(pnd)->io->receive(pnd, abtRx2, sizeof(abtRx2), timeout)) < 0) {
-      return res2;
-    }
-    mi = abtRx2[0] & 0x40;
-    if ((size_t)(res + res2 - 1) > szRx) {
-      CHIP_DATA(pnd)->last_status_byte = ESMALLBUF;
-      break;
+    if (szRx - res + 1 >= PN53x_EXTENDED_FRAME__DATA_MAX_LEN) {
+      // Receive the next chunk right after the previous one: its status byte
+      // lands on our last byte, which is saved and restored
+      const uint8_t btLast = pbtRx[res - 1];
+      if ((res2 = pn53x_io_receive(pnd, pbtRx + res - 1, szRx - res + 1, timeout)) < 0) {
+        pn53x_stats_command(pnd, btCommand, res2, false);
+        return res2;
+      }
+      mi = pbtRx[res - 1] & 0x40;
+      // Copy last status byte
+      pbtRx[0] = pbtRx[res - 1];
+      pbtRx[res - 1] = btLast;
+    } else {
+      // Chunk may not fit, receive it whole to keep in sync with the chip
+      uint8_t  abtRx2[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+      if ((res2 = pn53x_io_receive(pnd, abtRx2, sizeof(abtRx2), timeout)) < 0) {
+        pn53x_stats_command(pnd, btCommand, res2, false);
+        return res2;
+      }
+      mi = abtRx2[0] & 0x40;
+      if ((size_t)(res + res2 - 1) > szRx) {
+        CHIP_DATA(pnd)->last_status_byte = ESMALLBUF;
+        break;
+      }
+      memcpy(pbtRx + res, abtRx2 + 1, res2 - 1);
+      // Copy last status byte
+      pbtRx[0] = abtRx2[0];
     }
-    memcpy(pbtRx + res, abtRx2 + 1, res2 - 1);
-    // Copy last status byte
-    pbtRx[0] = abtRx2[0];
     res += res2 - 1;
   }
+  frame->len = (pbtRx == frame->data) ? (size_t)res : 0;
 
   szRx = (size_t) res;
 
@@ -338,6 +561,7 @@ pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx
       break;
   };
 
+  pn53x_stats_command(pnd, btCommand, res, true);
   if (res < 0) {
     pnd->last_error = res;
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Chip error: \"%s\" (%02x), returned error: \"%s\" (%d))", pn53x_strerror(pnd), CHIP_DATA(pnd)->last_status_byte, nfc_strerror(pnd), res);
@@ -373,107 +597,120 @@ pn53x_set_tx_bits(struct nfc_device *pnd, const uint8_t ui8Bits)
   return NFC_SUCCESS;
 }
 
+/*
+ * On air, every byte is sent LSB first and followed by its parity bit, the
+ * PN53x packs that bit stream LSB first into frame bytes.  Eight data bytes
+ * and their parities thus fill exactly nine frame bytes: data byte j of the
+ * group lands at bit 9 * j and its parity at bit 9 * j + 8, so a whole group
+ * is handled with 64-bit shifts (bits 0..63) plus a ninth byte (bits 64..71).
+ */
+static void
+pn53x_pack_group(const uint8_t *pbtData, const uint8_t *pbtPar, const size_t szData, uint8_t *pbtGroup)
+{
+  uint64_t ui64Low = 0;
+  uint8_t btHigh = 0;
+  size_t n;
+
+  for (n = 0; (n < szData) && (n < 7); n++) {
+    ui64Low |= ((uint64_t)pbtData[n] | ((uint64_t)(pbtPar[n] & 0x01) << 8)) << (9 * n);
+  }
+  if (szData == 8) {
+    ui64Low |= (uint64_t)pbtData[7] << 63;
+    btHigh = (pbtData[7] >> 1) | ((pbtPar[7] & 0x01) << 7);
+  }
+  for (n = 0; n < 8; n++) {
+    pbtGroup[n] = (uint8_t)(ui64Low >> (8 * n));
+  }
+  pbtGroup[8] = btHigh;
+}
+
+static void
+pn53x_unpack_group(const uint8_t *pbtGroup, const size_t szData, uint8_t *pbtData, uint8_t *pbtPar)
+{
+  uint64_t ui64Low = 0;
+  size_t n;
+
+  for (n = 0; n < 8; n++) {
+    ui64Low |= (uint64_t)pbtGroup[n] << (8 * n);
+  }
+  for (n = 0; (n < szData) && (n < 7); n++) {
+    pbtData[n] = (uint8_t)(ui64Low >> (9 * n));
+    if (pbtPar != NULL)
+      pbtPar[n] = (uint8_t)(ui64Low >> (9 * n + 8)) & 0x01;
+  }
+  if (szData == 8) {
+    pbtData[7] = (uint8_t)(ui64Low >> 63) | (uint8_t)(pbtGroup[8] << 1);
+    if (pbtPar != NULL)
+      pbtPar[7] = pbtGroup[8] >> 7;
+  }
+}
+
 int
 pn53x_wrap_frame(const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar,
                  uint8_t *pbtFrame)
 {
-  uint8_t  btData;
-  uint32_t uiBitPos;
-  uint32_t uiDataPos = 0;
-  size_t  szBitsLeft = szTxBits;
-  size_t szFrameBits = 0;
+  uint8_t abtGroup[9];
+  size_t szTxBytes, szDataPos;
 
   // Make sure we should frame at least something
-  if (szBitsLeft == 0)
+  if (szTxBits == 0)
     return NFC_ECHIP;
 
   // Handle a short response (1byte) as a special case
-  if (szBitsLeft < 9) {
+  if (szTxBits < 9) {
     *pbtFrame = *pbtTx;
-    szFrameBits = szTxBits;
-    return szFrameBits;
+    return szTxBits;
   }
-  // We start by calculating the frame length in bits
-  szFrameBits = szTxBits + (szTxBits / 8);
-
-  // Parse the data bytes and add the parity bits
-  // This is really a sensitive process, mirror the frame bytes and append parity bits
-  // buffer = mirror(frame-byte) + parity + mirror(frame-byte) + parity + ...
-  // split "buffer" up in segments of 8 bits again and mirror them
-  // air-bytes = mirror(buffer-byte) + mirror(buffer-byte) + mirror(buffer-byte) + ..
-  while (true) {
-    // Reset the temporary frame byte;
-    uint8_t  btFrame = 0;
-
-    for (uiBitPos = 0; uiBitPos < 8; uiBitPos++) {
-      // Copy as much data that fits in the frame byte
-      btData = mirror(pbtTx[uiDataPos]);
-      btFrame |= (btData >> uiBitPos);
-      // Save this frame byte
-      *pbtFrame = mirror(btFrame);
-      // Set the remaining bits of the date in the new frame byte and append the parity bit
-      btFrame = (btData << (8 - uiBitPos));
-      btFrame |= ((pbtTxPar[uiDataPos] & 0x01) << (7 - uiBitPos));
-      // Backup the frame bits we have so far
-      pbtFrame++;
-      *pbtFrame = mirror(btFrame);
-      // Increase the data (without parity bit) position
-      uiDataPos++;
-      // Test if we are done
-      if (szBitsLeft < 9)
-        return szFrameBits;
-      szBitsLeft -= 8;
-    }
-    // Every 8 data bytes we lose one frame byte to the parities
-    pbtFrame++;
+
+  // Interleave the parity bits, a group of 8 data bytes at a time
+  szTxBytes = (szTxBits + 7) / 8;
+  for (szDataPos = 0; szDataPos + 8 <= szTxBytes; szDataPos += 8) {
+    pn53x_pack_group(pbtTx + szDataPos, pbtTxPar + szDataPos, 8, pbtFrame);
+    pbtFrame += 9;
   }
+  if (szDataPos < szTxBytes) {
+    const size_t szTail = szTxBytes - szDataPos;
+    pn53x_pack_group(pbtTx + szDataPos, pbtTxPar + szDataPos, szTail, abtGroup);
+    memcpy(pbtFrame, abtGroup, (9 * szTail + 7) / 8);
+  }
+
+  // The frame length in bits includes a parity bit for every whole data byte
+  return szTxBits + (szTxBits / 8);
 }
 
 int
 pn53x_unwrap_frame(const uint8_t *pbtFrame, const size_t szFrameBits, uint8_t *pbtRx, uint8_t *pbtRxPar)
 {
-  uint8_t  btFrame;
-  uint8_t  btData;
-  uint8_t uiBitPos;
-  uint32_t uiDataPos = 0;
-  uint8_t *pbtFramePos = (uint8_t *) pbtFrame;
-  size_t  szBitsLeft = szFrameBits;
-  size_t szRxBits = 0;
+  uint8_t abtGroup[9];
+  size_t szRxBits, szRxBytes, szFrameBytes, szDataPos, szFramePos;
 
   // Make sure we should frame at least something
-  if (szBitsLeft == 0)
+  if (szFrameBits == 0)
     return NFC_ECHIP;
 
   // Handle a short response (1byte) as a special case
-  if (szBitsLeft < 9) {
+  if (szFrameBits < 9) {
     *pbtRx = *pbtFrame;
-    szRxBits = szFrameBits;
-    return szRxBits;
+    return szFrameBits;
   }
+
   // Calculate the data length in bits
   szRxBits = szFrameBits - (szFrameBits / 9);
+  szRxBytes = (szRxBits + 7) / 8;
+  szFrameBytes = (szFrameBits + 7) / 8;
 
-  // Parse the frame bytes, remove the parity bits and store them in the parity array
-  // This process is the reverse of WrapFrame(), look there for more info
-  while (true) {
-    for (uiBitPos = 0; uiBitPos < 8; uiBitPos++) {
-      btFrame = mirror(pbtFramePos[uiDataPos]);
-      btData = (btFrame << uiBitPos);
-      btFrame = mirror(pbtFramePos[uiDataPos + 1]);
-      btData |= (btFrame >> (8 - uiBitPos));
-      pbtRx[uiDataPos] = mirror(btData);
-      if (pbtRxPar != NULL)
-        pbtRxPar[uiDataPos] = ((btFrame >> (7 - uiBitPos)) & 0x01);
-      // Increase the data (without parity bit) position
-      uiDataPos++;
-      // Test if we are done
-      if (szBitsLeft < 9)
-        return szRxBits;
-      szBitsLeft -= 9;
-    }
-    // Every 8 data bytes we lose one frame byte to the parities
-    pbtFramePos++;
+  // Remove the parity bits and store them in the parity array, this is the
+  // reverse of pn53x_wrap_frame()
+  for (szDataPos = 0, szFramePos = 0; (szDataPos + 8 <= szRxBytes) && (szFramePos + 9 <= szFrameBytes); szDataPos += 8, szFramePos += 9) {
+    pn53x_unpack_group(pbtFrame + szFramePos, 8, pbtRx + szDataPos, (pbtRxPar != NULL) ? pbtRxPar + szDataPos : NULL);
   }
+  if (szDataPos < szRxBytes) {
+    // Never read past the received frame, missing bits are zero
+    memset(abtGroup, 0x00, sizeof(abtGroup));
+    memcpy(abtGroup, pbtFrame + szFramePos, MIN(sizeof(abtGroup), szFrameBytes - szFramePos));
+    pn53x_unpack_group(abtGroup, szRxBytes - szDataPos, pbtRx + szDataPos, (pbtRxPar != NULL) ? pbtRxPar + szDataPos : NULL);
+  }
+  return szRxBits;
 }
 
 int
@@ -633,6 +870,143 @@ pn53x_decode_target_data(const uint8_t *pbtRawData, size_t szRawData, pn53x_type
   return NFC_SUCCESS;
 }
 
+/* Registers whose value only changes when the host writes them, when a
+ * command sets up a new communication, or for some of them when the firmware
+ * runs a data exchange (see pn53x_shadow_command()).
+ * GPIO ports (P3, P7) follow their input pins, only their configuration is
+ * shadowed. */
+static const struct {
+  uint16_t address;
+  // Also changed by the firmware during a data exchange
+  bool exchange;
+} pn53x_shadow_registers[] = {
+  { PN53X_REG_Control_switch_rng, false },
+  { PN53X_REG_CIU_Mode, false },
+  // Framing, CRC and speed are set by the firmware for the exchanged frames
+  { PN53X_REG_CIU_TxMode, true },
+  { PN53X_REG_CIU_RxMode, true },
+  { PN53X_REG_CIU_TxControl, false },
+  { PN53X_REG_CIU_TxAuto, false },
+  { PN53X_REG_CIU_TxSel, false },
+  { PN53X_REG_CIU_RxSel, false },
+  { PN53X_REG_CIU_RxThreshold, false },
+  { PN53X_REG_CIU_Demod, false },
+  { PN53X_REG_CIU_FelNFC1, false },
+  { PN53X_REG_CIU_FelNFC2, false },
+  { PN53X_REG_CIU_MifNFC, false },
+  { PN53X_REG_CIU_ManualRCV, false },
+  { PN53X_REG_CIU_TypeB, false },
+  { PN53X_REG_CIU_GsNOFF, false },
+  { PN53X_REG_CIU_ModWidth, false },
+  { PN53X_REG_CIU_TxBitPhase, false },
+  { PN53X_REG_CIU_RFCfg, false },
+  { PN53X_REG_CIU_GsNOn, false },
+  { PN53X_REG_CIU_CWGsP, false },
+  { PN53X_REG_CIU_ModGsP, false },
+  { PN53X_SFR_P3CFGA, false },
+  { PN53X_SFR_P3CFGB, false },
+  { PN53X_SFR_P7CFGA, false },
+  { PN53X_SFR_P7CFGB, false },
+  // Timer may also be used by the firmware to time out a data exchange
+  { PN53X_REG_CIU_TMode, true },
+  { PN53X_REG_CIU_TPrescaler, true },
+  { PN53X_REG_CIU_TReloadVal_hi, true },
+  { PN53X_REG_CIU_TReloadVal_lo, true },
+};
+#define PN53X_SHADOW_REGISTER_COUNT ((int)(sizeof(pn53x_shadow_registers) / sizeof(pn53x_shadow_registers[0])))
+// Compilation fails if struct pn53x_data cannot hold every shadowed register
+typedef char pn53x_shadow_register_size_check[(PN53X_SHADOW_REGISTER_COUNT <= PN53X_SHADOW_REGISTER_SIZE) ? 1 : -1];
+
+static int
+pn53x_shadow_index(const uint16_t ui16RegisterAddress)
+{
+  for (int n = 0; n < PN53X_SHADOW_REGISTER_COUNT; n++) {
+    if (pn53x_shadow_registers[n].address == ui16RegisterAddress)
+      return n;
+  }
+  return -1;
+}
+
+static void
+pn53x_shadow_set(struct nfc_device *pnd, const uint16_t ui16RegisterAddress, const uint8_t ui8Value)
+{
+  const int n = pn53x_shadow_index(ui16RegisterAddress);
+  if (n >= 0) {
+    CHIP_DATA(pnd)->shadow_data[n] = ui8Value;
+    CHIP_DATA(pnd)->shadow_known[n] = true;
+  }
+}
+
+/**
+ * @brief Lookup a register in the shadow copy
+ * @return true and its value in ui8Value when it is known
+ */
+static bool
+pn53x_shadow_get(struct nfc_device *pnd, const uint16_t ui16RegisterAddress, uint8_t *ui8Value)
+{
+  const int n = pn53x_shadow_index(ui16RegisterAddress);
+  if ((n < 0) || !CHIP_DATA(pnd)->shadow_known[n])
+    return false;
+  *ui8Value = CHIP_DATA(pnd)->shadow_data[n];
+  return true;
+}
+
+/**
+ * @brief Update the shadow copy with the registers written by a successful WriteRegister command
+ */
+static void
+pn53x_shadow_write_command(struct nfc_device *pnd, const uint8_t *pbtWriteRegisterCmd, const size_t szWriteRegisterCmd)
+{
+  for (size_t i = 1; i + 2 < szWriteRegisterCmd; i += 3) {
+    pn53x_shadow_set(pnd, (pbtWriteRegisterCmd[i] << 8) | pbtWriteRegisterCmd[i + 1], pbtWriteRegisterCmd[i + 2]);
+  }
+}
+
+void
+pn53x_shadow_invalidate(struct nfc_device *pnd)
+{
+  memset(CHIP_DATA(pnd)->shadow_known, false, sizeof(CHIP_DATA(pnd)->shadow_known));
+}
+
+void
+pn53x_shadow_get_stats(struct nfc_device *pnd, uint32_t *pui32Hits, uint32_t *pui32Misses)
+{
+  *pui32Hits = CHIP_DATA(pnd)->shadow_hits;
+  *pui32Misses = CHIP_DATA(pnd)->shadow_misses;
+}
+
+/**
+ * @brief Forget the shadowed registers a command is about to change
+ */
+static void
+pn53x_shadow_command(struct nfc_device *pnd, const uint8_t btCommand)
+{
+  switch (btCommand) {
+    case ReadRegister:
+    case WriteRegister:   // Shadow is updated by pn53x_WriteRegister() and pn53x_writeback_register()
+    case GetFirmwareVersion:
+    case GetGeneralStatus:
+    case ReadGPIO:
+    case SetParameters:
+    case SetSerialBaudRate:
+      break;
+    case InDataExchange:
+    case InCommunicateThru:
+    case TgGetData:
+    case TgSetData:
+    case TgGetInitiatorCommand:
+    case TgResponseToInitiator:
+      for (int n = 0; n < PN53X_SHADOW_REGISTER_COUNT; n++) {
+        if (pn53x_shadow_registers[n].exchange)
+          CHIP_DATA(pnd)->shadow_known[n] = false;
+      }
+      break;
+    default:
+      // Command (re)configures the CIU: InListPassiveTarget, TgInitAsTarget, PowerDown, RFConfiguration, etc.
+      pn53x_shadow_invalidate(pnd);
+  }
+}
+
 static int
 pn53x_ReadRegister(struct nfc_device *pnd, uint16_t ui16RegisterAddress, uint8_t *ui8Value)
 {
@@ -651,11 +1025,22 @@ pn53x_ReadRegister(struct nfc_device *pnd, uint16_t ui16RegisterAddress, uint8_t
   } else {
     *ui8Value = abtRegValue[0];
   }
+  pn53x_shadow_set(pnd, ui16RegisterAddress, *ui8Value);
   return NFC_SUCCESS;
 }
 
 int pn53x_read_register(struct nfc_device *pnd, uint16_t ui16RegisterAddress, uint8_t *ui8Value)
 {
+  if (pn53x_shadow_get(pnd, ui16RegisterAddress, ui8Value)) {
+    if ((ui16RegisterAddress >= PN53X_CACHE_REGISTER_MIN_ADDRESS) && (ui16RegisterAddress <= PN53X_CACHE_REGISTER_MAX_ADDRESS)) {
+      // Apply bits waiting in the write-back cache
+      const int internal_address = ui16RegisterAddress - PN53X_CACHE_REGISTER_MIN_ADDRESS;
+      *ui8Value = (*ui8Value & ~CHIP_DATA(pnd)->wb_mask[internal_address]) | (CHIP_DATA(pnd)->wb_data[internal_address] & CHIP_DATA(pnd)->wb_mask[internal_address]);
+    }
+    CHIP_DATA(pnd)->shadow_hits++;
+    return NFC_SUCCESS;
+  }
+  CHIP_DATA(pnd)->shadow_misses++;
   return pn53x_ReadRegister(pnd, ui16RegisterAddress, ui8Value);
 }
 
@@ -663,8 +1048,13 @@ static int
 pn53x_WriteRegister(struct nfc_device *pnd, const uint16_t ui16RegisterAddress, const uint8_t ui8Value)
 {
   uint8_t  abtCmd[] = { WriteRegister, ui16RegisterAddress >> 8, ui16RegisterAddress & 0xff, ui8Value };
+  int res = 0;
   PNREG_TRACE(ui16RegisterAddress);
-  return pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), NULL, 0, -1);
+  if ((res = pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), NULL, 0, -1)) < 0) {
+    return res;
+  }
+  pn53x_shadow_set(pnd, ui16RegisterAddress, ui8Value);
+  return res;
 }
 
 int
@@ -682,6 +1072,12 @@ pn53x_write_register(struct nfc_device *pnd, const uint16_t ui16RegisterAddress,
         return pn53x_WriteRegister(pnd, ui16RegisterAddress, ui8NewValue);
       }
     } else {
+      uint8_t ui8CurrentValue;
+      if (pn53x_shadow_get(pnd, ui16RegisterAddress, &ui8CurrentValue) && (ui8CurrentValue == ui8Value)) {
+        // Register already holds this value
+        CHIP_DATA(pnd)->shadow_hits++;
+        return NFC_SUCCESS;
+      }
       return pn53x_WriteRegister(pnd, ui16RegisterAddress, ui8Value);
     }
   } else {
@@ -705,11 +1101,20 @@ pn53x_writeback_register(struct nfc_device *pnd)
   // First step, it looks for registers to be read before applying the requested mask
   CHIP_DATA(pnd)->wb_trigged = false;
   for (size_t n = 0; n < PN53X_CACHE_REGISTER_SIZE; n++) {
-    if ((CHIP_DATA(pnd)->wb_mask[n]) && (CHIP_DATA(pnd)->wb_mask[n] != 0xff)) {
-      // This register needs to be read: mask is present but does not cover full data width (ie. mask != 0xff)
+    if (CHIP_DATA(pnd)->wb_mask[n]) {
       const uint16_t pn53x_register_address = PN53X_CACHE_REGISTER_MIN_ADDRESS + n;
-      BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address  >> 8);
-      BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address & 0xff);
+      uint8_t ui8CurrentValue;
+      if (pn53x_shadow_get(pnd, pn53x_register_address, &ui8CurrentValue)) {
+        // Current value is known, merge it right now
+        CHIP_DATA(pnd)->wb_data[n] = ((CHIP_DATA(pnd)->wb_data[n] & CHIP_DATA(pnd)->wb_mask[n]) | (ui8CurrentValue & (~CHIP_DATA(pnd)->wb_mask[n])));
+        CHIP_DATA(pnd)->wb_mask[n] = (CHIP_DATA(pnd)->wb_data[n] != ui8CurrentValue) ? 0xff : 0x00;
+        CHIP_DATA(pnd)->shadow_hits++;
+      } else if (CHIP_DATA(pnd)->wb_mask[n] != 0xff) {
+        // This register needs to be read: mask is present but does not cover full data width (ie. mask != 0xff)
+        BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address  >> 8);
+        BUFFER_APPEND(abtReadRegisterCmd, pn53x_register_address & 0xff);
+        CHIP_DATA(pnd)->shadow_misses++;
+      }
     }
   }
 
@@ -728,6 +1133,7 @@ pn53x_writeback_register(struct nfc_device *pnd)
     }
     for (size_t n = 0; n < PN53X_CACHE_REGISTER_SIZE; n++) {
       if ((CHIP_DATA(pnd)->wb_mask[n]) && (CHIP_DATA(pnd)->wb_mask[n] != 0xff)) {
+        pn53x_shadow_set(pnd, PN53X_CACHE_REGISTER_MIN_ADDRESS + n, abtRes[i]);
         CHIP_DATA(pnd)->wb_data[n] = ((CHIP_DATA(pnd)->wb_data[n] & CHIP_DATA(pnd)->wb_mask[n]) | (abtRes[i] & (~CHIP_DATA(pnd)->wb_mask[n])));
         if (CHIP_DATA(pnd)->wb_data[n] != abtRes[i]) {
           // Requested value is different from read one
@@ -759,6 +1165,7 @@ pn53x_writeback_register(struct nfc_device *pnd)
     if ((res = pn53x_transceive(pnd, abtWriteRegisterCmd, BUFFER_SIZE(abtWriteRegisterCmd), NULL, 0, -1)) < 0) {
       return res;
     }
+    pn53x_shadow_write_command(pnd, abtWriteRegisterCmd, BUFFER_SIZE(abtWriteRegisterCmd));
   }
   return NFC_SUCCESS;
 }
@@ -1401,6 +1808,99 @@ pn53x_initiator_select_passive_target(struct nfc_device *pnd,
   return pn53x_initiator_select_passive_target_ext(pnd, nm, pbtInitData, szInitData, pnt, 300);
 }
 
+// Length of one TargetData[n] of an InListPassiveTarget answer, Tg included, or 0 if it is truncated
+static size_t
+pn53x_target_data_len(const struct nfc_device *pnd, const nfc_modulation_type nmt, const uint8_t *pbtData, const size_t szData, const bool bLast)
+{
+  size_t szLen = 0;
+
+  switch (nmt) {
+    case NMT_ISO14443A:
+      // Tg, SENS_RES, SEL_RES, NFCIDLength, NFCID1 then ATS if the target was activated as ISO/IEC 14443-4
+      if (szData < 5)
+        return 0;
+      szLen = 5 + pbtData[4];
+      if (bLast) {
+        szLen = MAX(szLen, szData);
+      } else if ((pbtData[3] & SAK_ISO14443_4_COMPLIANT) && pnd->bAutoIso14443_4 && (szLen < szData)) {
+        szLen += pbtData[szLen];
+      }
+      break;
+    case NMT_ISO14443B:
+      // Tg, ATQB, ATTRIB_RES length, ATTRIB_RES
+      if (szData < 14)
+        return 0;
+      szLen = 14 + pbtData[13];
+      break;
+    case NMT_FELICA:
+      // Tg, POL_RES length (counting itself), POL_RES
+      if (szData < 2)
+        return 0;
+      szLen = 1 + pbtData[1];
+      break;
+    default:
+      return 0;
+  }
+  return (szLen <= szData) ? szLen : 0;
+}
+
+/**
+ * @brief Select up to \a szTargets passive targets
+ * @return Returns selected targets count, otherwise returns libnfc's error code (negative value)
+ *
+ * InListPassiveTarget activates up to two targets at once (MaxTg = 2) for
+ * ISO/IEC 14443 A at 106 kbps, ISO/IEC 14443 B and FeliCa, so a single RF
+ * exchange lists two targets. The first one becomes the current target.
+ * Other modulations are selected one at a time.
+ */
+int
+pn53x_initiator_select_passive_targets(struct nfc_device *pnd,
+                                       const nfc_modulation nm,
+                                       const uint8_t *pbtInitData, const size_t szInitData,
+                                       nfc_target ant[], const size_t szTargets)
+{
+  if ((szTargets < 2) ||
+      !(((nm.nmt == NMT_ISO14443A) && (nm.nbr == NBR_106)) || (nm.nmt == NMT_ISO14443B) || (nm.nmt == NMT_FELICA))) {
+    return pn53x_initiator_select_passive_target(pnd, nm, pbtInitData, szInitData, ant);
+  }
+  const pn53x_modulation pm = pn53x_nm_to_pm(nm);
+  if ((PM_UNDEFINED == pm) || (NBR_UNDEFINED == nm.nbr)) {
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
+
+  uint8_t  abtTargetsData[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  size_t  szTargetsData = sizeof(abtTargetsData);
+  int res;
+  if ((res = pn53x_InListPassiveTarget(pnd, pm, 2, pbtInitData, szInitData, abtTargetsData, &szTargetsData, 300)) <= 0)
+    return res;
+  if (szTargetsData <= 1)
+    return 0;
+
+  const int iCount = MIN(res, 2);
+  const uint8_t *pbtData = abtTargetsData + 1;
+  size_t szData = szTargetsData - 1;
+  for (int i = 0; i < iCount; i++) {
+    const size_t szLen = pn53x_target_data_len(pnd, nm.nmt, pbtData, szData, i == iCount - 1);
+    if (!szLen) {
+      pnd->last_error = NFC_ECHIP;
+      return pnd->last_error;
+    }
+    memset(&ant[i], 0x00, sizeof(nfc_target));
+    ant[i].nm = nm;
+    if ((res = pn53x_decode_target_data(pbtData, szLen, CHIP_DATA(pnd)->type, nm.nmt, &(ant[i].nti))) < 0) {
+      return res;
+    }
+    pbtData += szLen;
+    szData -= szLen;
+  }
+  if (pn53x_current_target_new(pnd, &ant[0]) == NULL) {
+    pnd->last_error = NFC_ESOFT;
+    return pnd->last_error;
+  }
+  return iCount;
+}
+
 int
 pn53x_initiator_poll_target(struct nfc_device *pnd,
                             const nfc_modulation *pnmModulations, const size_t szModulations,
@@ -1601,9 +2101,19 @@ pn53x_initiator_transceive_bits(struct nfc_device *pnd, const uint8_t *pbtTx, co
 int
 pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx,
                                  const size_t szRx, int timeout)
+{
+  int res = 0;
+  if ((res = pn53x_initiator_transceive_bytes_async(pnd, pbtTx, szTx, timeout)) < 0) {
+    return res;
+  }
+  return pn53x_initiator_transceive_bytes_complete(pnd, pbtRx, szRx, timeout);
+}
+
+int
+pn53x_initiator_transceive_bytes_async(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
 {
   size_t  szExtraTxLen;
-  uint8_t  abtCmd[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  uint8_t *abtCmd;
   int res = 0;
 
   // We can not just send bytes without parity if while the PN53X expects we handled them
@@ -1612,28 +2122,48 @@ pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, c
     return pnd->last_error;
   }
 
-  // Copy the data into the command frame
+  // To transfer command frames bytes we can not have any leading bits, reset this to zero
+  if ((res = pn53x_set_tx_bits(pnd, 0)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+
+  // Copy the data into the command frame, directly where the driver builds its frame
+  abtCmd = pn53x_tx_buffer(pnd);
+  szExtraTxLen = (pnd->bEasyFraming) ? 2 : 1;
+  if (szTx + szExtraTxLen > PN53x_EXTENDED_FRAME__DATA_MAX_LEN) {
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
   if (pnd->bEasyFraming) {
     abtCmd[0] = InDataExchange;
     abtCmd[1] = 1;              /* target number */
-    memcpy(abtCmd + 2, pbtTx, szTx);
-    szExtraTxLen = 2;
   } else {
     abtCmd[0] = InCommunicateThru;
-    memcpy(abtCmd + 1, pbtTx, szTx);
-    szExtraTxLen = 1;
   }
+  memcpy(abtCmd + szExtraTxLen, pbtTx, szTx);
 
-  // To transfer command frames bytes we can not have any leading bits, reset this to zero
-  if ((res = pn53x_set_tx_bits(pnd, 0)) < 0) {
+  // Send the frame to the PN53X chip, the answer will be fetched by pn53x_initiator_transceive_bytes_complete()
+  // We have to give the amount of bytes + (the two command bytes 0xD4, 0x42)
+  if ((res = pn53x_transceive_submit(pnd, abtCmd, szTx + szExtraTxLen, timeout)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
+  return NFC_SUCCESS;
+}
 
-  // Send the frame to the PN53X chip and get the answer
-  // We have to give the amount of bytes + (the two command bytes 0xD4, 0x42)
-  uint8_t  abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  if ((res = pn53x_transceive(pnd, abtCmd, szTx + szExtraTxLen, abtRx, sizeof(abtRx), timeout)) < 0) {
+int
+pn53x_initiator_transceive_bytes_complete(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int timeout)
+{
+  int res = 0;
+
+  if ((CHIP_DATA(pnd)->last_command != InDataExchange) && (CHIP_DATA(pnd)->last_command != InCommunicateThru)) {
+    pnd->last_error = NFC_EINVARG;
+    return pnd->last_error;
+  }
+
+  // The reply is left in the chip frame buffer
+  if ((res = pn53x_transceive_complete(pnd, NULL, 0, timeout)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
@@ -1644,13 +2174,16 @@ pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, c
       return NFC_EOVFLOW;
     }
     // Copy the received bytes
-    memcpy(pbtRx, abtRx + 1, szRxLen);
+    memcpy(pbtRx, CHIP_DATA(pnd)->rx_frame.data + 1, szRxLen);
   }
   // Everything went successful, we return received bytes count
   return szRxLen;
 }
 
-static void __pn53x_init_timer(struct nfc_device *pnd, const uint32_t max_cycles)
+/**
+ * @brief Append to a WriteRegister command the timer setup which is not already in place
+ */
+static void __pn53x_init_timer(struct nfc_device *pnd, const uint32_t max_cycles, uint8_t *pbtWriteRegisterCmd, size_t *pszWriteRegisterCmd)
 {
 // The prescaler will dictate what will be the precision and
 // the largest delay to measure before saturation. Some examples:
@@ -1664,40 +2197,33 @@ static void __pn53x_init_timer(struct nfc_device *pnd, const uint32_t max_cycles
     CHIP_DATA(pnd)->timer_prescaler = 0;
   }
   uint16_t reloadval = 0xFFFF;
-  // Initialize timer
-  pn53x_write_register(pnd, PN53X_REG_CIU_TMode, 0xFF, SYMBOL_TAUTO | ((CHIP_DATA(pnd)->timer_prescaler >> 8) & SYMBOL_TPRESCALERHI));
-  pn53x_write_register(pnd, PN53X_REG_CIU_TPrescaler, 0xFF, (CHIP_DATA(pnd)->timer_prescaler & SYMBOL_TPRESCALERLO));
-  pn53x_write_register(pnd, PN53X_REG_CIU_TReloadVal_hi, 0xFF, (reloadval >> 8) & 0xFF);
-  pn53x_write_register(pnd, PN53X_REG_CIU_TReloadVal_lo, 0xFF, reloadval & 0xFF);
+  const uint16_t timer_registers[] = { PN53X_REG_CIU_TMode, PN53X_REG_CIU_TPrescaler, PN53X_REG_CIU_TReloadVal_hi, PN53X_REG_CIU_TReloadVal_lo };
+  const uint8_t timer_values[] = {
+    SYMBOL_TAUTO | ((CHIP_DATA(pnd)->timer_prescaler >> 8) & SYMBOL_TPRESCALERHI),
+    (CHIP_DATA(pnd)->timer_prescaler & SYMBOL_TPRESCALERLO),
+    (reloadval >> 8) & 0xFF,
+    reloadval & 0xFF
+  };
+  // Initialize timer, unless it is still set up from a previous timed exchange
+  for (size_t n = 0; n < sizeof(timer_registers) / sizeof(timer_registers[0]); n++) {
+    uint8_t ui8CurrentValue;
+    if (pn53x_shadow_get(pnd, timer_registers[n], &ui8CurrentValue) && (ui8CurrentValue == timer_values[n])) {
+      CHIP_DATA(pnd)->shadow_hits++;
+      continue;
+    }
+    PNREG_TRACE(timer_registers[n]);
+    pbtWriteRegisterCmd[(*pszWriteRegisterCmd)++] = timer_registers[n] >> 8;
+    pbtWriteRegisterCmd[(*pszWriteRegisterCmd)++] = timer_registers[n] & 0xff;
+    pbtWriteRegisterCmd[(*pszWriteRegisterCmd)++] = timer_values[n];
+  }
 }
 
-static uint32_t __pn53x_get_timer(struct nfc_device *pnd, const uint8_t last_cmd_byte)
+/**
+ * @brief Convert the timer counter value read after a timed exchange into cycles
+ */
+static uint32_t __pn53x_get_timer(struct nfc_device *pnd, const uint16_t counter, const uint8_t last_cmd_byte)
 {
-  uint8_t counter_hi, counter_lo;
-  uint16_t counter;
   uint32_t u32cycles;
-  size_t off = 0;
-  if (CHIP_DATA(pnd)->type == PN533) {
-    // PN533 prepends its answer by a status byte
-    off = 1;
-  }
-  // Read timer
-  BUFFER_INIT(abtReadRegisterCmd, PN53x_EXTENDED_FRAME__DATA_MAX_LEN);
-  BUFFER_APPEND(abtReadRegisterCmd, ReadRegister);
-  BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_hi  >> 8);
-  BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_hi & 0xff);
-  BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_lo  >> 8);
-  BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_lo & 0xff);
-  uint8_t abtRes[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  size_t szRes = sizeof(abtRes);
-  // Let's send the previously constructed ReadRegister command
-  if (pn53x_transceive(pnd, abtReadRegisterCmd, BUFFER_SIZE(abtReadRegisterCmd), abtRes, szRes, -1) < 0) {
-    return false;
-  }
-  counter_hi = abtRes[off];
-  counter_lo = abtRes[off + 1];
-  counter = counter_hi;
-  counter = (counter << 8) + counter_lo;
   if (counter == 0) {
     // counter saturated
     u32cycles = 0xFFFFFFFF;
@@ -1741,6 +2267,7 @@ pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbt
   (void) pbtRxPar;
   uint16_t i;
   uint8_t sz = 0;
+  uint16_t counter = 0;
   int res = 0;
   size_t szRxBits = 0;
 
@@ -1760,14 +2287,13 @@ pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbt
     return pnd->last_error;
   }
 
-  __pn53x_init_timer(pnd, *cycles);
-
   // Once timer is started, we cannot use Tama commands anymore.
   // E.g. on SCL3711 timer settings are reset by 0x42 InCommunicateThru command to:
   //  631a=82 631b=a5 631c=02 631d=00
-  // Prepare FIFO
+  // Setup timer and prepare FIFO in a single WriteRegister command
   BUFFER_INIT(abtWriteRegisterCmd, PN53x_EXTENDED_FRAME__DATA_MAX_LEN);
   BUFFER_APPEND(abtWriteRegisterCmd, WriteRegister);
+  __pn53x_init_timer(pnd, *cycles, abtWriteRegisterCmd, &BUFFER_SIZE(abtWriteRegisterCmd));
 
   BUFFER_APPEND(abtWriteRegisterCmd, PN53X_REG_CIU_Command  >> 8);
   BUFFER_APPEND(abtWriteRegisterCmd, PN53X_REG_CIU_Command & 0xff);
@@ -1788,6 +2314,7 @@ pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbt
   if ((res = pn53x_transceive(pnd, abtWriteRegisterCmd, BUFFER_SIZE(abtWriteRegisterCmd), NULL, 0, -1)) < 0) {
     return res;
   }
+  pn53x_shadow_write_command(pnd, abtWriteRegisterCmd, BUFFER_SIZE(abtWriteRegisterCmd));
 
   // Recv data
   // we've to watch for coming data until we decide to timeout.
@@ -1813,6 +2340,11 @@ pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbt
     }
     BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_FIFOLevel  >> 8);
     BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_FIFOLevel & 0xff);
+    // Timer is stopped since bits were received, read it along in case it is the last read
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_hi  >> 8);
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_hi & 0xff);
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_lo  >> 8);
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_lo & 0xff);
     uint8_t abtRes[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
     size_t szRes = sizeof(abtRes);
     // Let's send the previously constructed ReadRegister command
@@ -1823,6 +2355,7 @@ pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbt
       pbtRx[i + szRxBits] = abtRes[i + off];
     }
     szRxBits += (size_t)(sz & SYMBOL_FIFO_LEVEL);
+    counter = (abtRes[sz + off + 1] << 8) | abtRes[sz + off + 2];
     sz = abtRes[sz + off];
     if (sz == 0)
       break;
@@ -1830,7 +2363,7 @@ pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbt
   szRxBits *= 8; // in bits, not bytes
 
   // Recv corrected timer value
-  *cycles = __pn53x_get_timer(pnd, pbtTx[szTxBits / 8]);
+  *cycles = __pn53x_get_timer(pnd, counter, pbtTx[szTxBits / 8]);
 
   return szRxBits;
 }
@@ -1840,6 +2373,7 @@ pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pb
 {
   uint16_t i;
   uint8_t sz = 0;
+  uint16_t counter = 0;
   int res = 0;
 
   // We can not just send bytes without parity while the PN53X expects we handled them
@@ -1861,14 +2395,13 @@ pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pb
     }
   }
 
-  __pn53x_init_timer(pnd, *cycles);
-
   // Once timer is started, we cannot use Tama commands anymore.
   // E.g. on SCL3711 timer settings are reset by 0x42 InCommunicateThru command to:
   //  631a=82 631b=a5 631c=02 631d=00
-  // Prepare FIFO
+  // Setup timer and prepare FIFO in a single WriteRegister command
   BUFFER_INIT(abtWriteRegisterCmd, PN53x_EXTENDED_FRAME__DATA_MAX_LEN);
   BUFFER_APPEND(abtWriteRegisterCmd, WriteRegister);
+  __pn53x_init_timer(pnd, *cycles, abtWriteRegisterCmd, &BUFFER_SIZE(abtWriteRegisterCmd));
 
   BUFFER_APPEND(abtWriteRegisterCmd, PN53X_REG_CIU_Command  >> 8);
   BUFFER_APPEND(abtWriteRegisterCmd, PN53X_REG_CIU_Command & 0xff);
@@ -1889,6 +2422,7 @@ pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pb
   if ((res = pn53x_transceive(pnd, abtWriteRegisterCmd, BUFFER_SIZE(abtWriteRegisterCmd), NULL, 0, -1)) < 0) {
     return res;
   }
+  pn53x_shadow_write_command(pnd, abtWriteRegisterCmd, BUFFER_SIZE(abtWriteRegisterCmd));
 
   // Recv data
   size_t szRxLen = 0;
@@ -1915,6 +2449,11 @@ pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pb
     }
     BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_FIFOLevel  >> 8);
     BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_FIFOLevel & 0xff);
+    // Timer is stopped since bits were received, read it along in case it is the last read
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_hi  >> 8);
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_hi & 0xff);
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_lo  >> 8);
+    BUFFER_APPEND(abtReadRegisterCmd, PN53X_REG_CIU_TCounterVal_lo & 0xff);
     uint8_t abtRes[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
     size_t szRes = sizeof(abtRes);
     // Let's send the previously constructed ReadRegister command
@@ -1932,6 +2471,7 @@ pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pb
       }
     }
     szRxLen += (size_t)(sz & SYMBOL_FIFO_LEVEL);
+    counter = (abtRes[sz + off + 1] << 8) | abtRes[sz + off + 2];
     sz = abtRes[sz + off];
     if (sz == 0)
       break;
@@ -1951,10 +2491,10 @@ pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pb
       iso14443b_crc_append(pbtTxRaw, szTx);
     else
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unsupported framing type %02X, cannot adjust CRC cycles", txmode & SYMBOL_TX_FRAMING);
-    *cycles = __pn53x_get_timer(pnd, pbtTxRaw[szTx + 1]);
+    *cycles = __pn53x_get_timer(pnd, counter, pbtTxRaw[szTx + 1]);
     free(pbtTxRaw);
   } else {
-    *cycles = __pn53x_get_timer(pnd, pbtTx[szTx - 1]);
+    *cycles = __pn53x_get_timer(pnd, counter, pbtTx[szTx - 1]);
   }
   return szRxLen;
 }
@@ -2370,8 +2910,6 @@ pn53x_initiator_target_is_present(struct nfc_device *pnd, const nfc_target *pnt)
   return pnd->last_error = ret;
 }
 
-#define SAK_ISO14443_4_COMPLIANT 0x20
-#define SAK_ISO18092_COMPLIANT   0x40
 int
 pn53x_target_init(struct nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRxLen, int timeout)
 {
@@ -2683,11 +3221,10 @@ pn53x_target_receive_bytes(struct nfc_device *pnd, uint8_t *pbtRx, const size_t
     abtCmd[0] = TgGetInitiatorCommand;
   }
 
-  // Try to gather a received frame from the reader
-  uint8_t abtRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
-  size_t szRx = sizeof(abtRx);
+  // Try to gather a received frame from the reader, it is left in the chip frame buffer
+  size_t szRx;
   int res = 0;
-  if ((res = pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), abtRx, szRx, timeout)) < 0)
+  if ((res = pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), NULL, 0, timeout)) < 0)
     return pnd->last_error;
   szRx = (size_t) res;
   // Save the received bytes count
@@ -2697,7 +3234,7 @@ pn53x_target_receive_bytes(struct nfc_device *pnd, uint8_t *pbtRx, const size_t
     return NFC_EOVFLOW;
 
   // Copy the received bytes
-  memcpy(pbtRx, abtRx + 1, szRx);
+  memcpy(pbtRx, CHIP_DATA(pnd)->rx_frame.data + 1, szRx);
 
   // Everyting seems ok, return received bytes count
   return szRx;
@@ -2747,13 +3284,17 @@ pn53x_target_send_bits(struct nfc_device *pnd, const uint8_t *pbtTx, const size_
 int
 pn53x_target_send_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
 {
-  uint8_t  abtCmd[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  // Command is built directly where the driver builds its frame
+  uint8_t *abtCmd = pn53x_tx_buffer(pnd);
   int res = 0;
 
   // We can not just send bytes without parity if while the PN53X expects we handled them
   if (!pnd->bPar)
     return NFC_ECHIP;
 
+  if (szTx + 1 > PN53x_EXTENDED_FRAME__DATA_MAX_LEN)
+    return NFC_EINVARG;
+
   // XXX I think this is not a clean way to provide some kind of "EasyFraming"
   // but at the moment I have no more better than this
   if (pnd->bEasyFraming) {
@@ -2956,6 +3497,56 @@ pn53x_PowerDown(struct nfc_device *pnd)
   return res;
 }
 
+/**
+ * @brief C wrapper to SetSerialBaudRate command
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param pnd struct nfc_device struct pointer that represent currently used device
+ * @param uiBaudRate new baud rate of the serial link, in bauds
+ *
+ * @note The chip only switches to the new baud rate once the host has sent an ACK
+ * frame (at the current baud rate) after the command response: that is up to the driver.
+ */
+int
+pn53x_SetSerialBaudRate(struct nfc_device *pnd, const uint32_t uiBaudRate)
+{
+  uint8_t abtCmd[] = { SetSerialBaudRate, 0x00 };
+
+  switch (uiBaudRate) {
+    case 9600:
+      abtCmd[1] = 0x00;
+      break;
+    case 19200:
+      abtCmd[1] = 0x01;
+      break;
+    case 38400:
+      abtCmd[1] = 0x02;
+      break;
+    case 57600:
+      abtCmd[1] = 0x03;
+      break;
+    case 115200:
+      abtCmd[1] = 0x04;
+      break;
+    case 230400:
+      abtCmd[1] = 0x05;
+      break;
+    case 460800:
+      abtCmd[1] = 0x06;
+      break;
+    case 921600:
+      abtCmd[1] = 0x07;
+      break;
+    case 1288000:
+      abtCmd[1] = 0x08;
+      break;
+    default:
+      pnd->last_error = NFC_EINVARG;
+      return pnd->last_error;
+  }
+  return pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), NULL, 0, 1000);
+}
+
 /**
  * @brief C wrapper to InListPassiveTarget command
  * @return Returns selected targets count on success, otherwise returns libnfc's error code (negative value)
@@ -3314,6 +3905,7 @@ pn53x_check_ack_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const s
   if (szRxFrameLen >= sizeof(pn53x_ack_frame)) {
     if (0 == memcmp(pbtRxFrame, pn53x_ack_frame, sizeof(pn53x_ack_frame))) {
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "PN53x ACKed");
+      nfc_stats_add_latency(&pnd->stats.ack_wait, pnd->stats_io_start);
       return NFC_SUCCESS;
     }
   }
@@ -3335,6 +3927,80 @@ pn53x_check_error_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const
   return NFC_SUCCESS;
 }
 
+/**
+ * @brief Return the buffer in which a command can be built to be sent without copying
+ *
+ * The command has to be given to pn53x_transceive() (or pn53x_transceive_submit())
+ * right after being built: any other command sent in between reuses this buffer.
+ * It can hold up to PN53x_EXTENDED_FRAME__DATA_MAX_LEN bytes.
+ */
+uint8_t *
+pn53x_tx_buffer(struct nfc_device *pnd)
+{
+  return CHIP_DATA(pnd)->tx_frame.data;
+}
+
+/**
+ * @brief Build a PN53x frame around its payload
+ *
+ * Header is written in the PN53x_FRAME__HEADROOM bytes before pbtData and
+ * trailer in the PN53x_FRAME__TAILROOM bytes after it, as guaranteed by
+ * pn53x_transceive_submit() to the send() function of drivers.
+ *
+ * @param pbtData payload (bytes array) of the frame, will become PD0, ..., PDn in PN53x frame
+ * @param ppbtFrame where to store the start of the frame, at least one more byte before it is free
+ * @note The first byte of pbtData is the Command Code (CC)
+ */
+int
+pn53x_build_frame_in_place(const uint8_t *pbtData, const size_t szData, uint8_t **ppbtFrame, size_t *pszFrame)
+{
+  // Memory around the payload is owned by the caller, only the payload is const
+  uint8_t *pbtPayload = (uint8_t *) pbtData;
+  uint8_t *pbtFrame;
+
+  if (szData <= PN53x_NORMAL_FRAME__DATA_MAX_LEN) {
+    pbtFrame = pbtPayload - 6;
+    // LEN - Packet length = data length (len) + TFI (1)
+    pbtFrame[3] = szData + 1;
+    // LCS - Packet length checksum
+    pbtFrame[4] = 256 - (szData + 1);
+  } else if (szData <= PN53x_EXTENDED_FRAME__DATA_MAX_LEN) {
+    pbtFrame = pbtPayload - 9;
+    // Extended frame marker
+    pbtFrame[3] = 0xff;
+    pbtFrame[4] = 0xff;
+    // LENm
+    pbtFrame[5] = (szData + 1) >> 8;
+    // LENl
+    pbtFrame[6] = (szData + 1) & 0xff;
+    // LCS
+    pbtFrame[7] = 256 - ((pbtFrame[5] + pbtFrame[6]) & 0xff);
+  } else {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "We can't send more than %d bytes in a raw (requested: %" PRIdPTR ")", PN53x_EXTENDED_FRAME__DATA_MAX_LEN, szData);
+    return NFC_ECHIP;
+  }
+  // Preamble and start of packet
+  pbtFrame[0] = 0x00;
+  pbtFrame[1] = 0x00;
+  pbtFrame[2] = 0xff;
+  // TFI
+  pbtPayload[-1] = 0xD4;
+
+  // DCS - Calculate data payload checksum
+  uint8_t btDCS = (256 - 0xD4);
+  for (size_t szPos = 0; szPos < szData; szPos++) {
+    btDCS -= pbtPayload[szPos];
+  }
+  pbtPayload[szData] = btDCS;
+
+  // 0x00 - End of stream marker
+  pbtPayload[szData + 1] = 0x00;
+
+  *ppbtFrame = pbtFrame;
+  *pszFrame = (size_t)(pbtPayload + szData + 2 - pbtFrame);
+  return NFC_SUCCESS;
+}
+
 /**
  * @brief Build a PN53x frame
  *
@@ -3806,6 +4472,16 @@ pn53x_current_target_is(const struct nfc_device *pnd, const nfc_target *pnt)
   return true;
 }
 
+int
+pn53x_get_pollfd(struct nfc_device *pnd)
+{
+  if (!CHIP_DATA(pnd)->io->get_pollfd) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return CHIP_DATA(pnd)->io->get_pollfd(pnd);
+}
+
 void *
 pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io)
 {
@@ -3835,6 +4511,21 @@ pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io)
   // Set current sam_mode to normal mode
   CHIP_DATA(pnd)->sam_mode = PSM_NORMAL;
 
+  // No command sent yet
+  CHIP_DATA(pnd)->command_pending = false;
+
+  // Frame buffers keep room for the frame header before their payload
+  CHIP_DATA(pnd)->tx_frame.data = CHIP_DATA(pnd)->tx_frame.buffer + PN53x_FRAME__HEADROOM;
+  CHIP_DATA(pnd)->tx_frame.len = 0;
+  CHIP_DATA(pnd)->rx_frame.data = CHIP_DATA(pnd)->rx_frame.buffer + PN53x_FRAME__HEADROOM;
+  CHIP_DATA(pnd)->rx_frame.len = 0;
+  CHIP_DATA(pnd)->tx_depth = 0;
+
+  // Nothing is known about registers yet
+  pn53x_shadow_invalidate(pnd);
+  CHIP_DATA(pnd)->shadow_hits = 0;
+  CHIP_DATA(pnd)->shadow_misses = 0;
+
   // WriteBack cache is clean
   CHIP_DATA(pnd)->wb_trigged = false;
   memset(CHIP_DATA(pnd)->wb_mask, 0x00, PN53X_CACHE_REGISTER_SIZE);
@@ -151,20 +151,50 @@ typedef enum {
   PSM_DUAL_CARD = 0x04
 } pn532_sam_mode;
 
+/* Room around a PN53x command so its frame can be built in place: one bus
+ * prefix byte (e.g. SPI DATAWRITE), 00 00 FF FF FF LENm LENl LCS TFI before
+ * it and DCS 00 after it */
+#define PN53x_FRAME__HEADROOM   10
+#define PN53x_FRAME__TAILROOM   2
+#define PN53x_FRAME__BUFFER_LEN (PN53x_FRAME__HEADROOM + PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_FRAME__TAILROOM)
+
+/**
+ * @internal
+ * @struct pn53x_frame
+ * @brief PN53x frame buffer, payload is framed and parsed in place
+ */
+struct pn53x_frame {
+  uint8_t buffer[PN53x_FRAME__BUFFER_LEN];
+  /** Payload, i.e. command (from CC) or reply (from status byte) */
+  uint8_t *data;
+  /** Payload length */
+  size_t len;
+};
+
 /**
  * @internal
  * @struct pn53x_io
  * @brief PN53x I/O structure
+ *
+ * pbtData given to send() always has PN53x_FRAME__HEADROOM bytes before it
+ * and PN53x_FRAME__TAILROOM bytes after it which the driver may overwrite,
+ * see pn53x_build_frame_in_place().
  */
 struct pn53x_io {
   int (*send)(struct nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout);
   int (*receive)(struct nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout);
+  /** Optional: receive a whole reply in frame->buffer and point frame->data/len to its payload, returns payload length */
+  int (*receive_frame)(struct nfc_device *pnd, struct pn53x_frame *frame, int timeout);
+  /** Optional: file descriptor which becomes readable when a reply is pending */
+  int (*get_pollfd)(struct nfc_device *pnd);
 };
 
 /* defines */
 #define PN53X_CACHE_REGISTER_MIN_ADDRESS 	PN53X_REG_CIU_Mode
 #define PN53X_CACHE_REGISTER_MAX_ADDRESS 	PN53X_REG_CIU_Coll
 #define PN53X_CACHE_REGISTER_SIZE 		((PN53X_CACHE_REGISTER_MAX_ADDRESS - PN53X_CACHE_REGISTER_MIN_ADDRESS) + 1)
+// Room for the registers listed in pn53x_shadow_registers[]
+#define PN53X_SHADOW_REGISTER_SIZE 		32
 
 /**
  * @internal
@@ -194,6 +224,18 @@ struct pn53x_data {
   uint8_t ui8Parameters;
   /** Last sent command */
   uint8_t last_command;
+  /** First parameter of last sent command (needed to chain MI frames) */
+  uint8_t last_command_param;
+  /** Is a command submitted and its reply not yet collected */
+  bool command_pending;
+  /** Time the pending command was submitted, see nfc_stats_now() */
+  uint64_t command_start;
+  /** Command frame, see pn53x_tx_buffer() */
+  struct pn53x_frame tx_frame;
+  /** Reply frame, filled by pn53x_transceive_complete() when no receiving buffer is given */
+  struct pn53x_frame rx_frame;
+  /** Nesting level of pn53x_transceive_submit() */
+  unsigned int tx_depth;
   /** Interframe timer correction */
   int16_t timer_correction;
   /** Timer prescaler */
@@ -202,6 +244,12 @@ struct pn53x_data {
   uint8_t wb_data[PN53X_CACHE_REGISTER_SIZE];
   uint8_t wb_mask[PN53X_CACHE_REGISTER_SIZE];
   bool wb_trigged;
+  /** Shadow copy of the registers only the host changes, see pn53x_shadow_registers[] */
+  uint8_t shadow_data[PN53X_SHADOW_REGISTER_SIZE];
+  bool shadow_known[PN53X_SHADOW_REGISTER_SIZE];
+  /** Register accesses served by the shadow copy / needing a ReadRegister */
+  uint32_t shadow_hits;
+  uint32_t shadow_misses;
   /** Command timeout */
   int timeout_command;
   /** ATR timeout */
@@ -304,6 +352,8 @@ extern const uint8_t pn53x_nack_frame[PN53x_ACK_FRAME__LEN];
 
 int    pn53x_init(struct nfc_device *pnd);
 int    pn53x_transceive(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRxLen, int timeout);
+int    pn53x_transceive_submit(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+int    pn53x_transceive_complete(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRxLen, int timeout);
 
 int    pn53x_set_parameters(struct nfc_device *pnd, const uint8_t ui8Value, const bool bEnable);
 int    pn53x_set_tx_bits(struct nfc_device *pnd, const uint8_t ui8Bits);
@@ -314,6 +364,8 @@ int    pn53x_decode_target_data(const uint8_t *pbtRawData, size_t szRawData,
                                 nfc_target_info *pnti);
 int    pn53x_read_register(struct nfc_device *pnd, uint16_t ui16Reg, uint8_t *ui8Value);
 int    pn53x_write_register(struct nfc_device *pnd, uint16_t ui16Reg, uint8_t ui8SymbolMask, uint8_t ui8Value);
+void   pn53x_shadow_invalidate(struct nfc_device *pnd);
+void   pn53x_shadow_get_stats(struct nfc_device *pnd, uint32_t *pui32Hits, uint32_t *pui32Misses);
 int    pn53x_decode_firmware_version(struct nfc_device *pnd);
 int    pn53x_set_property_int(struct nfc_device *pnd, const nfc_property property, const int value);
 int    pn53x_set_property_bool(struct nfc_device *pnd, const nfc_property property, const bool bEnable);
@@ -329,6 +381,10 @@ int    pn53x_initiator_select_passive_target(struct nfc_device *pnd,
                                              const nfc_modulation nm,
                                              const uint8_t *pbtInitData, const size_t szInitData,
                                              nfc_target *pnt);
+int    pn53x_initiator_select_passive_targets(struct nfc_device *pnd,
+                                              const nfc_modulation nm,
+                                              const uint8_t *pbtInitData, const size_t szInitData,
+                                              nfc_target ant[], const size_t szTargets);
 int    pn53x_initiator_poll_target(struct nfc_device *pnd,
                                    const nfc_modulation *pnmModulations, const size_t szModulations,
                                    const uint8_t uiPollNr, const uint8_t uiPeriod,
@@ -342,6 +398,8 @@ int    pn53x_initiator_transceive_bits(struct nfc_device *pnd, const uint8_t *pb
                                        const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar);
 int    pn53x_initiator_transceive_bytes(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx,
                                         uint8_t *pbtRx, const size_t szRx, int timeout);
+int    pn53x_initiator_transceive_bytes_async(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+int    pn53x_initiator_transceive_bytes_complete(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int timeout);
 int    pn53x_initiator_transceive_bits_timed(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits,
                                              const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar, uint32_t *cycles);
 int    pn53x_initiator_transceive_bytes_timed(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx,
@@ -363,6 +421,7 @@ const char *pn53x_strerror(const struct nfc_device *pnd);
 int    pn53x_SetParameters(struct nfc_device *pnd, const uint8_t ui8Value);
 int    pn532_SAMConfiguration(struct nfc_device *pnd, const pn532_sam_mode mode, int timeout);
 int    pn53x_PowerDown(struct nfc_device *pnd);
+int    pn53x_SetSerialBaudRate(struct nfc_device *pnd, const uint32_t uiBaudRate);
 int    pn53x_InListPassiveTarget(struct nfc_device *pnd, const pn53x_modulation pmInitModulation,
                                  const uint8_t szMaxTargets, const uint8_t *pbtInitiatorData,
                                  const size_t szInitiatorDataLen, uint8_t *pbtTargetsData, size_t *pszTargetsData,
@@ -396,9 +455,12 @@ int    pn53x_RFConfiguration__MaxRetries(struct nfc_device *pnd, const uint8_t M
 int    pn53x_check_ack_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const size_t szRxFrameLen);
 int    pn53x_check_error_frame(struct nfc_device *pnd, const uint8_t *pbtRxFrame, const size_t szRxFrameLen);
 int    pn53x_build_frame(uint8_t *pbtFrame, size_t *pszFrame, const uint8_t *pbtData, const size_t szData);
+int    pn53x_build_frame_in_place(const uint8_t *pbtData, const size_t szData, uint8_t **ppbtFrame, size_t *pszFrame);
+uint8_t *pn53x_tx_buffer(struct nfc_device *pnd);
 int    pn53x_get_supported_modulation(nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type **const supported_mt);
 int    pn53x_get_supported_baud_rate(nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
 int    pn53x_get_information_about(nfc_device *pnd, char **pbuf);
+int    pn53x_get_pollfd(nfc_device *pnd);
 
 void   *pn53x_data_new(struct nfc_device *pnd, const struct pn53x_io *io);
 void    pn53x_data_free(struct nfc_device *pnd);
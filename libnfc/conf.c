@@ -168,7 +168,7 @@ parse_line(const char line[BUFSIZ], char **key, char **value)
   return -1;
 }
 
-static void
+void
 conf_parse_file(const char *filename,
                 void (*conf_keyvalue)(void *data, const char *key, const char *value),
                 void *data)
@@ -217,6 +217,13 @@ conf_keyvalue_context(void *data, const char *key, const char *value)
     string_as_boolean(value, &(context->allow_intrusive_scan));
   } else if (strcmp(key, "log_level") == 0) {
     context->log_level = atoi(value);
+  } else if (strcmp(key, "capture") == 0) {
+    strncpy(context->capture_path, value, sizeof(context->capture_path) - 1);
+    context->capture_path[sizeof(context->capture_path) - 1] = '\0';
+  } else if (strcmp(key, "scan_timeout") == 0) {
+    context->scan_timeout = atoi(value);
+  } else if (strcmp(key, "scan_cache_ttl") == 0) {
+    context->scan_cache_ttl = atoi(value);
   } else if (strcmp(key, "device.name") == 0) {
     if ((context->user_defined_device_count == 0) || strcmp(context->user_defined_devices[context->user_defined_device_count - 1].name, "") != 0) {
       if (context->user_defined_device_count >= MAX_USER_DEFINED_DEVICES) {
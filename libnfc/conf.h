@@ -29,6 +29,7 @@
 #include <nfc/nfc-types.h>
 
 void conf_load(nfc_context *context);
+void conf_parse_file(const char *filename, void (*conf_keyvalue)(void *data, const char *key, const char *value), void *data);
 
 #endif // __NFC_CONF_H__
 
@@ -117,11 +117,15 @@ static int _iSCardContextRefCount = 0;
 static SCARDCONTEXT *
 acr122_pcsc_get_scardcontext(void)
 {
+  nfc_global_lock();
   if (_iSCardContextRefCount == 0) {
-    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS)
+    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS) {
+      nfc_global_unlock();
       return NULL;
+    }
   }
   _iSCardContextRefCount++;
+  nfc_global_unlock();
 
   return &_SCardContext;
 }
@@ -129,12 +133,14 @@ acr122_pcsc_get_scardcontext(void)
 static void
 acr122_pcsc_free_scardcontext(void)
 {
+  nfc_global_lock();
   if (_iSCardContextRefCount) {
     _iSCardContextRefCount--;
     if (!_iSCardContextRefCount) {
       SCardReleaseContext(_SCardContext);
     }
   }
+  nfc_global_unlock();
 }
 
 #define PCSC_MAX_DEVICES 16
@@ -392,6 +398,7 @@ acr122_pcsc_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, i
     DRIVER_DATA(pnd)->szRx = dwRxLen;
   }
 
+  nfc_stats_frame_sent(pnd, szData);
   return NFC_SUCCESS;
 }
 
@@ -430,6 +437,7 @@ acr122_pcsc_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szData, int
   len = DRIVER_DATA(pnd)->szRx - 4;
   memcpy(pbtData, DRIVER_DATA(pnd)->abtRx + 2, len);
 
+  nfc_stats_frame_received(pnd, len);
   return len;
 }
 
@@ -479,6 +487,7 @@ const struct pn53x_io acr122_pcsc_io = {
 const struct nfc_driver acr122_pcsc_driver = {
   .name                             = ACR122_PCSC_DRIVER_NAME,
   .scan                             = acr122_pcsc_scan,
+  .scan_bus                         = "pcsc",
   .open                             = acr122_pcsc_open,
   .close                            = acr122_pcsc_close,
   .strerror                         = pn53x_strerror,
@@ -486,10 +495,13 @@ const struct nfc_driver acr122_pcsc_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = NULL, // No secure-element support
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -506,6 +518,7 @@ const struct nfc_driver acr122_pcsc_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = NULL,  // Abort is not supported in this driver
   .idle           = pn53x_idle,
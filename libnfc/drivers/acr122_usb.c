@@ -76,8 +76,6 @@ Thanks to d18c7db and Okko for example code
 #define LOG_GROUP     NFC_LOG_GROUP_DRIVER
 #define LOG_CATEGORY "libnfc.driver.acr122_usb"
 
-#define USB_INFINITE_TIMEOUT   0
-
 #define DRIVER_DATA(pnd) ((struct acr122_usb_data*)(pnd->driver_data))
 
 /*
@@ -174,11 +172,10 @@ struct acr122_usb_apdu_frame {
 
 // Internal data struct
 struct acr122_usb_data {
-  usb_dev_handle *pudh;
+  usbbus_handle *pudh;
   uint32_t uiEndPointIn;
   uint32_t uiEndPointOut;
   uint32_t uiMaxPacketSize;
-  volatile bool abort_flag;
   // Keep some buffers to reduce memcpy() usage
   struct acr122_usb_tama_frame tama_frame;
   struct acr122_usb_apdu_frame apdu_frame;
@@ -220,15 +217,17 @@ static int acr122_usb_send_apdu(nfc_device *pnd,
 static int
 acr122_usb_bulk_read(struct acr122_usb_data *data, uint8_t abtRx[], const size_t szRx, const int timeout)
 {
-  int res = usb_bulk_read(data->pudh, data->uiEndPointIn, (char *) abtRx, szRx, timeout);
+  int res = usbbus_bulk_read(data->pudh, data->uiEndPointIn, abtRx, szRx, timeout);
   if (res > 0) {
     LOG_HEX(NFC_LOG_GROUP_COM, "RX", abtRx, res);
   } else if (res < 0) {
-    if (res != -USB_TIMEDOUT) {
-      res = NFC_EIO;
-      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to read from USB (%s)", _usb_strerror(res));
-    } else {
+    if (res == -USB_TIMEDOUT) {
       res = NFC_ETIMEOUT;
+    } else if (res == -USB_CANCELED) {
+      res = NFC_EOPABORTED;
+    } else {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to read from USB (%s)", _usb_strerror(res));
+      res = NFC_EIO;
     }
   }
   return res;
@@ -238,11 +237,11 @@ static int
 acr122_usb_bulk_write(struct acr122_usb_data *data, uint8_t abtTx[], const size_t szTx, const int timeout)
 {
   LOG_HEX(NFC_LOG_GROUP_COM, "TX", abtTx, szTx);
-  int res = usb_bulk_write(data->pudh, data->uiEndPointOut, (char *) abtTx, szTx, timeout);
+  int res = usbbus_bulk_write(data->pudh, data->uiEndPointOut, abtTx, szTx, timeout);
   if (res > 0) {
     // HACK This little hack is a well know problem of USB, see http://www.libusb.org/ticket/6 for more details
     if ((res % data->uiMaxPacketSize) == 0) {
-      usb_bulk_write(data->pudh, data->uiEndPointOut, "\0", 0, timeout);
+      usbbus_bulk_write(data->pudh, data->uiEndPointOut, (const uint8_t *) "\0", 0, timeout);
     }
   } else if (res < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to write to USB (%s)", _usb_strerror(res));
@@ -269,30 +268,29 @@ const struct acr122_usb_supported_device acr122_usb_supported_devices[] = {
 
 // Find transfer endpoints for bulk transfers
 static void
-acr122_usb_get_end_points(struct usb_device *dev, struct acr122_usb_data *data)
+acr122_usb_get_end_points(const struct usbbus_device *dev, struct acr122_usb_data *data)
 {
   uint32_t uiIndex;
   uint32_t uiEndPoint;
-  struct usb_interface_descriptor *puid = dev->config->interface->altsetting;
 
   // 3 Endpoints maximum: Interrupt In, Bulk In, Bulk Out
-  for (uiIndex = 0; uiIndex < puid->bNumEndpoints; uiIndex++) {
+  for (uiIndex = 0; uiIndex < dev->bNumEndpoints; uiIndex++) {
     // Only accept bulk transfer endpoints (ignore interrupt endpoints)
-    if (puid->endpoint[uiIndex].bmAttributes != USB_ENDPOINT_TYPE_BULK)
+    if (dev->endpoint[uiIndex].bmAttributes != USB_ENDPOINT_TYPE_BULK)
       continue;
 
     // Copy the endpoint to a local var, makes it more readable code
-    uiEndPoint = puid->endpoint[uiIndex].bEndpointAddress;
+    uiEndPoint = dev->endpoint[uiIndex].bEndpointAddress;
 
     // Test if we dealing with a bulk IN endpoint
     if ((uiEndPoint & USB_ENDPOINT_DIR_MASK) == USB_ENDPOINT_IN) {
       data->uiEndPointIn = uiEndPoint;
-      data->uiMaxPacketSize = puid->endpoint[uiIndex].wMaxPacketSize;
+      data->uiMaxPacketSize = dev->endpoint[uiIndex].wMaxPacketSize;
     }
     // Test if we dealing with a bulk OUT endpoint
     if ((uiEndPoint & USB_ENDPOINT_DIR_MASK) == USB_ENDPOINT_OUT) {
       data->uiEndPointOut = uiEndPoint;
-      data->uiMaxPacketSize = puid->endpoint[uiIndex].wMaxPacketSize;
+      data->uiMaxPacketSize = dev->endpoint[uiIndex].wMaxPacketSize;
     }
   }
 }
@@ -305,47 +303,47 @@ acr122_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const
   usb_prepare();
 
   size_t device_found = 0;
-  uint32_t uiBusIndex = 0;
-  struct usb_bus *bus;
-  for (bus = usb_get_busses(); bus; bus = bus->next) {
-    struct usb_device *dev;
-
-    for (dev = bus->devices; dev; dev = dev->next, uiBusIndex++) {
-      for (size_t n = 0; n < sizeof(acr122_usb_supported_devices) / sizeof(struct acr122_usb_supported_device); n++) {
-        if ((acr122_usb_supported_devices[n].vendor_id == dev->descriptor.idVendor) &&
-            (acr122_usb_supported_devices[n].product_id == dev->descriptor.idProduct)) {
-          // Make sure there are 2 endpoints available
-          // with libusb-win32 we got some null pointers so be robust before looking at endpoints:
-          if (dev->config == NULL || dev->config->interface == NULL || dev->config->interface->altsetting == NULL) {
-            // Nope, we maybe want the next one, let's try to find another
-            continue;
-          }
-          if (dev->config->interface->altsetting->bNumEndpoints < 2) {
-            // Nope, we maybe want the next one, let's try to find another
-            continue;
-          }
-
-          usb_dev_handle *udev = usb_open(dev);
-          if (udev == NULL)
-            continue;
-
-          // Set configuration
-          // acr122_usb_get_usb_device_name (dev, udev, pnddDevices[device_found].acDevice, sizeof (pnddDevices[device_found].acDevice));
-          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "device found: Bus %s Device %s Name %s", bus->dirname, dev->filename, acr122_usb_supported_devices[n].name);
-          usb_close(udev);
-          if (snprintf(connstrings[device_found], sizeof(nfc_connstring), "%s:%s:%s", ACR122_USB_DRIVER_NAME, bus->dirname, dev->filename) >= (int)sizeof(nfc_connstring)) {
-            // truncation occurred, skipping that one
-            continue;
-          }
-          device_found++;
-          // Test if we reach the maximum "wanted" devices
-          if (device_found == connstrings_len) {
-            return device_found;
-          }
+  struct usbbus_device *devices;
+  size_t devices_count = usbbus_get_devices(&devices);
+  for (size_t i = 0; i < devices_count; i++) {
+    const struct usbbus_device *dev = &devices[i];
+
+    for (size_t n = 0; n < sizeof(acr122_usb_supported_devices) / sizeof(struct acr122_usb_supported_device); n++) {
+      if ((acr122_usb_supported_devices[n].vendor_id == dev->idVendor) &&
+          (acr122_usb_supported_devices[n].product_id == dev->idProduct)) {
+        // Make sure there are 2 endpoints available
+        // with libusb-win32 we got some null pointers so be robust before looking at endpoints:
+        if (!dev->has_config) {
+          // Nope, we maybe want the next one, let's try to find another
+          continue;
+        }
+        if (dev->bNumEndpoints < 2) {
+          // Nope, we maybe want the next one, let's try to find another
+          continue;
+        }
+
+        usbbus_handle *udev = usbbus_open(dev);
+        if (udev == NULL)
+          continue;
+
+        // Set configuration
+        // acr122_usb_get_usb_device_name (dev, udev, pnddDevices[device_found].acDevice, sizeof (pnddDevices[device_found].acDevice));
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "device found: Bus %s Device %s Name %s", dev->dirname, dev->filename, acr122_usb_supported_devices[n].name);
+        usbbus_close(udev);
+        if (snprintf(connstrings[device_found], sizeof(nfc_connstring), "%s:%s:%s", ACR122_USB_DRIVER_NAME, dev->dirname, dev->filename) >= (int)sizeof(nfc_connstring)) {
+          // truncation occurred, skipping that one
+          continue;
+        }
+        device_found++;
+        // Test if we reach the maximum "wanted" devices
+        if (device_found == connstrings_len) {
+          usbbus_free_devices(devices);
+          return device_found;
         }
       }
     }
   }
+  usbbus_free_devices(devices);
 
   return device_found;
 }
@@ -356,23 +354,23 @@ struct acr122_usb_descriptor {
 };
 
 static bool
-acr122_usb_get_usb_device_name(struct usb_device *dev, usb_dev_handle *udev, char *buffer, size_t len)
+acr122_usb_get_usb_device_name(const struct usbbus_device *dev, usbbus_handle *udev, char *buffer, size_t len)
 {
   *buffer = '\0';
 
-  if (dev->descriptor.iManufacturer || dev->descriptor.iProduct) {
+  if (dev->iManufacturer || dev->iProduct) {
     if (udev) {
-      usb_get_string_simple(udev, dev->descriptor.iManufacturer, buffer, len);
+      usbbus_get_string_simple(udev, dev->iManufacturer, buffer, len);
       if (strlen(buffer) > 0)
         strcpy(buffer + strlen(buffer), " / ");
-      usb_get_string_simple(udev, dev->descriptor.iProduct, buffer + strlen(buffer), len - strlen(buffer));
+      usbbus_get_string_simple(udev, dev->iProduct, buffer + strlen(buffer), len - strlen(buffer));
     }
   }
 
   if (!*buffer) {
     for (size_t n = 0; n < sizeof(acr122_usb_supported_devices) / sizeof(struct acr122_usb_supported_device); n++) {
-      if ((acr122_usb_supported_devices[n].vendor_id == dev->descriptor.idVendor) &&
-          (acr122_usb_supported_devices[n].product_id == dev->descriptor.idProduct)) {
+      if ((acr122_usb_supported_devices[n].vendor_id == dev->idVendor) &&
+          (acr122_usb_supported_devices[n].product_id == dev->idProduct)) {
         strncpy(buffer, acr122_usb_supported_devices[n].name, len);
         buffer[len - 1] = '\0';
         return true;
@@ -399,91 +397,92 @@ acr122_usb_open(const nfc_context *context, const nfc_connstring connstring)
     .uiEndPointIn = 0,
     .uiEndPointOut = 0,
   };
-  struct usb_bus *bus;
-  struct usb_device *dev;
+  struct usbbus_device *devices;
 
   usb_prepare();
 
-  for (bus = usb_get_busses(); bus; bus = bus->next) {
+  size_t devices_count = usbbus_get_devices(&devices);
+  for (size_t i = 0; i < devices_count; i++) {
+    const struct usbbus_device *dev = &devices[i];
+
     if (connstring_decode_level > 1)  {
       // A specific bus have been specified
-      if (0 != strcmp(bus->dirname, desc.dirname))
+      if (0 != strcmp(dev->dirname, desc.dirname))
         continue;
     }
-    for (dev = bus->devices; dev; dev = dev->next) {
-      if (connstring_decode_level > 2)  {
-        // A specific dev have been specified
-        if (0 != strcmp(dev->filename, desc.filename))
-          continue;
-      }
-      // Open the USB device
-      if ((data.pudh = usb_open(dev)) == NULL)
+    if (connstring_decode_level > 2)  {
+      // A specific dev have been specified
+      if (0 != strcmp(dev->filename, desc.filename))
         continue;
-      // Reset device
-      usb_reset(data.pudh);
-      // Retrieve end points
-      acr122_usb_get_end_points(dev, &data);
-      // Claim interface
-      int res = usb_claim_interface(data.pudh, 0);
+    }
+    // Open the USB device
+    if ((data.pudh = usbbus_open(dev)) == NULL)
+      continue;
+    // Reset device
+    usbbus_reset(data.pudh);
+    // Retrieve end points
+    acr122_usb_get_end_points(dev, &data);
+    // Claim interface
+    int res = usbbus_claim_interface(data.pudh, 0);
+    if (res < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to claim USB interface (%s)", _usb_strerror(res));
+      usbbus_close(data.pudh);
+      // we failed to use the specified device
+      goto free_devices;
+    }
+
+    // Check if there are more than 0 alternative interfaces and claim the first one
+    if (dev->has_config && (dev->bAlternateSetting > 0)) {
+      res = usbbus_set_altinterface(data.pudh, 0);
       if (res < 0) {
-        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to claim USB interface (%s)", _usb_strerror(res));
-        usb_close(data.pudh);
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set alternate setting on USB interface (%s)", _usb_strerror(res));
+        usbbus_close(data.pudh);
         // we failed to use the specified device
-        goto free_mem;
-      }
-
-      // Check if there are more than 0 alternative interfaces and claim the first one
-      if (dev->config->interface->altsetting->bAlternateSetting > 0) {
-        res = usb_set_altinterface(data.pudh, 0);
-        if (res < 0) {
-          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set alternate setting on USB interface (%s)", _usb_strerror(res));
-          usb_close(data.pudh);
-          // we failed to use the specified device
-          goto free_mem;
-        }
+        goto free_devices;
       }
+    }
 
-      // Allocate memory for the device info and specification, fill it and return the info
-      pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        goto error;
-      }
-      acr122_usb_get_usb_device_name(dev, data.pudh, pnd->name, sizeof(pnd->name));
+    // Allocate memory for the device info and specification, fill it and return the info
+    pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      goto error;
+    }
+    acr122_usb_get_usb_device_name(dev, data.pudh, pnd->name, sizeof(pnd->name));
 
-      pnd->driver_data = malloc(sizeof(struct acr122_usb_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        goto error;
-      }
-      *DRIVER_DATA(pnd) = data;
+    pnd->driver_data = malloc(sizeof(struct acr122_usb_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      goto error;
+    }
+    *DRIVER_DATA(pnd) = data;
 
-      // Alloc and init chip's data
-      if (pn53x_data_new(pnd, &acr122_usb_io) == NULL) {
-        perror("malloc");
-        goto error;
-      }
+    // Alloc and init chip's data
+    if (pn53x_data_new(pnd, &acr122_usb_io) == NULL) {
+      perror("malloc");
+      goto error;
+    }
 
-      memcpy(&(DRIVER_DATA(pnd)->tama_frame), acr122_usb_frame_template, sizeof(acr122_usb_frame_template));
-      memcpy(&(DRIVER_DATA(pnd)->apdu_frame), acr122_usb_frame_template, sizeof(acr122_usb_frame_template));
-      CHIP_DATA(pnd)->timer_correction = 46; // empirical tuning
-      pnd->driver = &acr122_usb_driver;
+    memcpy(&(DRIVER_DATA(pnd)->tama_frame), acr122_usb_frame_template, sizeof(acr122_usb_frame_template));
+    memcpy(&(DRIVER_DATA(pnd)->apdu_frame), acr122_usb_frame_template, sizeof(acr122_usb_frame_template));
+    CHIP_DATA(pnd)->timer_correction = 46; // empirical tuning
+    pnd->driver = &acr122_usb_driver;
 
-      if (acr122_usb_init(pnd) < 0) {
-        usb_close(data.pudh);
-        goto error;
-      }
-      DRIVER_DATA(pnd)->abort_flag = false;
-      goto free_mem;
+    if (acr122_usb_init(pnd) < 0) {
+      usbbus_close(data.pudh);
+      goto error;
     }
+    goto free_devices;
   }
   // We ran out of devices before the index required
-  goto free_mem;
+  goto free_devices;
 
 error:
   // Free allocated structure on error.
   nfc_device_free(pnd);
   pnd = NULL;
+free_devices:
+  usbbus_free_devices(devices);
 free_mem:
   free(desc.dirname);
   free(desc.filename);
@@ -497,11 +496,11 @@ acr122_usb_close(nfc_device *pnd)
   pn53x_idle(pnd);
 
   int res;
-  if ((res = usb_release_interface(DRIVER_DATA(pnd)->pudh, 0)) < 0) {
+  if ((res = usbbus_release_interface(DRIVER_DATA(pnd)->pudh, 0)) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to release USB interface (%s)", _usb_strerror(res));
   }
 
-  if ((res = usb_close(DRIVER_DATA(pnd)->pudh)) < 0) {
+  if ((res = usbbus_close(DRIVER_DATA(pnd)->pudh)) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to close USB connection (%s)", _usb_strerror(res));
   }
   pn53x_data_free(pnd);
@@ -572,14 +571,16 @@ acr122_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, co
     return pnd->last_error;
   }
 
+  // Queue the read of the reply before the command goes out
+  usbbus_bulk_read_submit(DRIVER_DATA(pnd)->pudh, DRIVER_DATA(pnd)->uiEndPointIn, 255 + sizeof(struct ccid_header));
   if ((res = acr122_usb_bulk_write(DRIVER_DATA(pnd), (unsigned char *) & (DRIVER_DATA(pnd)->tama_frame), res, timeout)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, szData);
   return NFC_SUCCESS;
 }
 
-#define USB_TIMEOUT_PER_PASS 200
 static int
 acr122_usb_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, const int timeout)
 {
@@ -588,41 +589,22 @@ acr122_usb_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, co
   uint8_t  abtRxBuf[255 + sizeof(struct ccid_header)];
   int res;
 
-  /*
-   * If no timeout is specified but the command is blocking, force a 200ms (USB_TIMEOUT_PER_PASS)
-   * timeout to allow breaking the loop if the user wants to stop it.
-   */
-  int usb_timeout;
-  int remaining_time = timeout;
+  // The USB bus layer keeps blocking reads interruptible by nfc_abort_command()
 read:
-  if (timeout == USB_INFINITE_TIMEOUT) {
-    usb_timeout = USB_TIMEOUT_PER_PASS;
-  } else {
-    // A user-provided timeout is set, we have to cut it in multiple chunk to be able to keep an nfc_abort_command() mechanism
-    remaining_time -= USB_TIMEOUT_PER_PASS;
-    if (remaining_time <= 0) {
-      pnd->last_error = NFC_ETIMEOUT;
-      return pnd->last_error;
-    } else {
-      usb_timeout = MIN(remaining_time, USB_TIMEOUT_PER_PASS);
-    }
-  }
-
-  res = acr122_usb_bulk_read(DRIVER_DATA(pnd), abtRxBuf, sizeof(abtRxBuf), usb_timeout);
+  res = acr122_usb_bulk_read(DRIVER_DATA(pnd), abtRxBuf, sizeof(abtRxBuf), timeout);
 
   uint8_t attempted_response = RDR_to_PC_DataBlock;
   size_t len;
   int error, status;
 
+  if (res == NFC_EOPABORTED) {
+    acr122_usb_ack(pnd);
+    pnd->last_error = NFC_EOPABORTED;
+    return pnd->last_error;
+  }
   if (res == NFC_ETIMEOUT) {
-    if (DRIVER_DATA(pnd)->abort_flag) {
-      DRIVER_DATA(pnd)->abort_flag = false;
-      acr122_usb_ack(pnd);
-      pnd->last_error = NFC_EOPABORTED;
-      return pnd->last_error;
-    } else {
-      goto read;
-    }
+    pnd->last_error = NFC_ETIMEOUT;
+    return pnd->last_error;
   }
   if (res < 10) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Invalid RDR_to_PC_DataBlock frame");
@@ -668,15 +650,13 @@ read:
       return pnd->last_error;
     }
     res = acr122_usb_send_apdu(pnd, APDU_GetAdditionnalData, 0x00, 0x00, NULL, 0, abtRxBuf[11], abtRxBuf, sizeof(abtRxBuf));
+    if (res == NFC_EOPABORTED) {
+      acr122_usb_ack(pnd);
+      pnd->last_error = NFC_EOPABORTED;
+      return pnd->last_error;
+    }
     if (res == NFC_ETIMEOUT) {
-      if (DRIVER_DATA(pnd)->abort_flag) {
-        DRIVER_DATA(pnd)->abort_flag = false;
-        acr122_usb_ack(pnd);
-        pnd->last_error = NFC_EOPABORTED;
-        return pnd->last_error;
-      } else {
-        goto read; // FIXME May cause some trouble on Touchatag, right ?
-      }
+      goto read; // FIXME May cause some trouble on Touchatag, right ?
     }
     if (res < 10) {
       // try to interrupt current device state
@@ -737,6 +717,7 @@ read:
 
   memcpy(pbtData, abtRxBuf + offset, len);
 
+  nfc_stats_frame_received(pnd, len);
   return len;
 }
 
@@ -833,19 +814,32 @@ acr122_usb_init(nfc_device *pnd)
 static int
 acr122_usb_abort_command(nfc_device *pnd)
 {
-  DRIVER_DATA(pnd)->abort_flag = true;
+  usbbus_bulk_read_abort(DRIVER_DATA(pnd)->pudh);
   return NFC_SUCCESS;
 }
 
+static int
+acr122_usb_get_pollfd(nfc_device *pnd)
+{
+  const int res = usbbus_get_pollfd(DRIVER_DATA(pnd)->pudh);
+  if (res < 0) {
+    pnd->last_error = (res == -ENOSYS) ? NFC_EDEVNOTSUPP : NFC_EIO;
+    return pnd->last_error;
+  }
+  return res;
+}
+
 const struct pn53x_io acr122_usb_io = {
   .send       = acr122_usb_send,
   .receive    = acr122_usb_receive,
+  .get_pollfd = acr122_usb_get_pollfd,
 };
 
 const struct nfc_driver acr122_usb_driver = {
   .name                             = ACR122_USB_DRIVER_NAME,
   .scan_type                        = NOT_INTRUSIVE,
   .scan                             = acr122_usb_scan,
+  .scan_bus                         = "usb",
   .open                             = acr122_usb_open,
   .close                            = acr122_usb_close,
   .strerror                         = pn53x_strerror,
@@ -853,10 +847,13 @@ const struct nfc_driver acr122_usb_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = NULL, // No secure-element support
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -873,6 +870,7 @@ const struct nfc_driver acr122_usb_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = acr122_usb_abort_command,
   .idle           = pn53x_idle,
@@ -672,6 +672,7 @@ acr122s_send(nfc_device *pnd, const uint8_t *buf, const size_t buf_len, int time
     pnd->last_error = ret;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, buf_len);
 
   return NFC_SUCCESS;
 }
@@ -708,6 +709,7 @@ acr122s_receive(nfc_device *pnd, uint8_t *buf, size_t buf_len, int timeout)
   }
 
   memcpy(buf, tmp + 13, data_len);
+  nfc_stats_frame_received(pnd, data_len);
   return data_len;
 }
 
@@ -728,15 +730,27 @@ acr122s_abort_command(nfc_device *pnd)
   return NFC_SUCCESS;
 }
 
+#ifndef WIN32
+static int
+acr122s_get_pollfd(nfc_device *pnd)
+{
+  return uart_get_fd(DRIVER_DATA(pnd)->port);
+}
+#endif
+
 const struct pn53x_io acr122s_io = {
   .send    = acr122s_send,
   .receive = acr122s_receive,
+#ifndef WIN32
+  .get_pollfd = acr122s_get_pollfd,
+#endif
 };
 
 const struct nfc_driver acr122s_driver = {
   .name       = ACR122S_DRIVER_NAME,
   .scan_type  = INTRUSIVE,
   .scan       = acr122s_scan,
+  .scan_bus   = "uart",
   .open       = acr122s_open,
   .close      = acr122s_close,
   .strerror   = pn53x_strerror,
@@ -744,10 +758,13 @@ const struct nfc_driver acr122s_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = NULL, // No secure-element support
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -764,6 +781,7 @@ const struct nfc_driver acr122s_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = acr122s_abort_command,
   .idle           = pn53x_idle,
@@ -332,7 +332,6 @@ arygon_open(const nfc_context *context, const nfc_connstring connstring)
   return pnd;
 }
 
-#define ARYGON_TX_BUFFER_LEN (PN53x_NORMAL_FRAME__DATA_MAX_LEN + PN53x_NORMAL_FRAME__OVERHEAD + 1)
 #define ARYGON_RX_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 static int
 arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
@@ -341,8 +340,7 @@ arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, i
   // Before sending anything, we need to discard from any junk bytes
   uart_flush_input(DRIVER_DATA(pnd)->port, false);
 
-  uint8_t abtFrame[ARYGON_TX_BUFFER_LEN] = { DEV_ARYGON_PROTOCOL_TAMA, 0x00, 0x00, 0xff };     // Every packet must start with "0x32 0x00 0x00 0xff"
-
+  uint8_t *abtFrame;
   size_t szFrame = 0;
   if (szData > PN53x_NORMAL_FRAME__DATA_MAX_LEN) {
     // ARYGON Reader with PN532 equipped does not support extended frame (bug in ARYGON firmware?)
@@ -351,16 +349,19 @@ arygon_tama_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, i
     return pnd->last_error;
   }
 
-  if ((res = pn53x_build_frame(abtFrame + 1, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_in_place(pbtData, szData, &abtFrame, &szFrame)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
+  // Every packet must start with "0x32 0x00 0x00 0xff", there is room for the protocol byte before the frame
+  *(--abtFrame) = DEV_ARYGON_PROTOCOL_TAMA;
 
   if ((res = uart_send(DRIVER_DATA(pnd)->port, abtFrame, szFrame + 1, timeout)) != 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to transmit data. (TX)");
     pnd->last_error = res;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, szData);
 
   uint8_t abtRxBuf[PN53x_ACK_FRAME__LEN];
   if ((res = uart_receive(DRIVER_DATA(pnd)->port, abtRxBuf, sizeof(abtRxBuf), 0, timeout)) != 0) {
@@ -510,6 +511,7 @@ arygon_tama_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, i
     return pnd->last_error;
   }
   // The PN53x command is done and we successfully received the reply
+  nfc_stats_frame_received(pnd, len);
   return len;
 }
 
@@ -587,15 +589,27 @@ arygon_abort_command(nfc_device *pnd)
 }
 
 
+#ifndef WIN32
+static int
+arygon_tama_get_pollfd(nfc_device *pnd)
+{
+  return uart_get_fd(DRIVER_DATA(pnd)->port);
+}
+#endif
+
 const struct pn53x_io arygon_tama_io = {
   .send       = arygon_tama_send,
   .receive    = arygon_tama_receive,
+#ifndef WIN32
+  .get_pollfd = arygon_tama_get_pollfd,
+#endif
 };
 
 const struct nfc_driver arygon_driver = {
   .name                             = ARYGON_DRIVER_NAME,
   .scan_type                        = INTRUSIVE,
   .scan                             = arygon_scan,
+  .scan_bus                         = "uart",
   .open                             = arygon_open,
   .close                            = arygon_close,
   .strerror                         = pn53x_strerror,
@@ -603,10 +617,13 @@ const struct nfc_driver arygon_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = NULL, // No secure-element support
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -623,6 +640,7 @@ const struct nfc_driver arygon_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = arygon_abort_command,
   .idle           = pn53x_idle,
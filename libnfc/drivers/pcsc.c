@@ -99,6 +99,9 @@ struct pcsc_data {
   SCARD_IO_REQUEST ioCard;
   DWORD dwShareMode;
   DWORD last_error;
+  // Context of the target watch thread, which blocks in SCardGetStatusChange()
+  SCARDCONTEXT hWatchContext;
+  bool bWatchContext;
 };
 
 #define DRIVER_DATA(pnd) ((struct pcsc_data*)(pnd->driver_data))
@@ -112,11 +115,15 @@ const nfc_modulation_type pcsc_supported_mts[] = {NMT_ISO14443A, NMT_ISO14443B,
 static SCARDCONTEXT *
 pcsc_get_scardcontext(void)
 {
+  nfc_global_lock();
   if (_iSCardContextRefCount == 0) {
-    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS)
+    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &_SCardContext) != SCARD_S_SUCCESS) {
+      nfc_global_unlock();
       return NULL;
+    }
   }
   _iSCardContextRefCount++;
+  nfc_global_unlock();
 
   return &_SCardContext;
 }
@@ -124,12 +131,14 @@ pcsc_get_scardcontext(void)
 static void
 pcsc_free_scardcontext(void)
 {
+  nfc_global_lock();
   if (_iSCardContextRefCount) {
     _iSCardContextRefCount--;
     if (!_iSCardContextRefCount) {
       SCardReleaseContext(_SCardContext);
     }
   }
+  nfc_global_unlock();
 }
 
 #define ICC_TYPE_UNKNOWN 0
@@ -547,6 +556,7 @@ pcsc_open(const nfc_context *context, const nfc_connstring connstring)
   // Configure I/O settings for card communication
   DRIVER_DATA(pnd)->ioCard.cbPciLength = sizeof(SCARD_IO_REQUEST);
   DRIVER_DATA(pnd)->dwShareMode = SCARD_SHARE_DIRECT;
+  DRIVER_DATA(pnd)->bWatchContext = false;
 
   // Done, we found the reader we are looking for
   snprintf(pnd->name, sizeof(pnd->name), "%s", ndd.pcsc_device_name);
@@ -566,6 +576,8 @@ static void
 pcsc_close(nfc_device *pnd)
 {
   SCardDisconnect(DRIVER_DATA(pnd)->hCard, SCARD_LEAVE_CARD);
+  if (DRIVER_DATA(pnd)->bWatchContext)
+    SCardReleaseContext(DRIVER_DATA(pnd)->hWatchContext);
   pcsc_free_scardcontext();
 
   nfc_device_free(pnd);
@@ -908,6 +920,32 @@ static int pcsc_initiator_target_is_present(struct nfc_device *pnd, const nfc_ta
   return NFC_SUCCESS;
 }
 
+static int pcsc_initiator_target_wait_presence(struct nfc_device *pnd, const bool present, const int timeout)
+{
+  struct pcsc_data *data = pnd->driver_data;
+  SCARD_READERSTATE rs;
+  LONG err;
+
+  // Only the watch thread gets here, with the device unlocked
+  if (!data->bWatchContext) {
+    if (SCardEstablishContext(SCARD_SCOPE_USER, NULL, NULL, &data->hWatchContext) != SCARD_S_SUCCESS)
+      return NFC_EIO;
+    data->bWatchContext = true;
+  }
+
+  memset(&rs, 0, sizeof(rs));
+  rs.szReader = pnd->name;
+  rs.dwCurrentState = present ? SCARD_STATE_PRESENT : SCARD_STATE_EMPTY;
+  err = SCardGetStatusChange(data->hWatchContext, timeout, &rs, 1);
+  if (err == SCARD_E_TIMEOUT)
+    return 0;
+  if (err != SCARD_S_SUCCESS) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Get status change failed (%s)", stringify_error(err));
+    return NFC_EIO;
+  }
+  return (((rs.dwEventState & SCARD_STATE_PRESENT) != 0) != present) ? 1 : 0;
+}
+
 static int pcsc_device_set_property_bool(struct nfc_device *pnd, const nfc_property property, const bool bEnable)
 {
   (void) pnd;
@@ -1046,6 +1084,7 @@ error:
 const struct nfc_driver pcsc_driver = {
   .name                             = PCSC_DRIVER_NAME,
   .scan                             = pcsc_scan,
+  .scan_bus                         = "pcsc",
   .open                             = pcsc_open,
   .close                            = pcsc_close,
   .strerror                         = pcsc_strerror,
@@ -1061,6 +1100,7 @@ const struct nfc_driver pcsc_driver = {
   .initiator_transceive_bytes_timed = NULL,
   .initiator_transceive_bits_timed  = NULL,
   .initiator_target_is_present      = pcsc_initiator_target_is_present,
+  .initiator_target_wait_presence   = pcsc_initiator_target_wait_presence,
 
   .target_init           = NULL,
   .target_send_bytes     = NULL,
@@ -72,6 +72,7 @@ const struct pn53x_io pn532_i2c_io;
 struct pn532_i2c_data {
   i2c_device dev;
   volatile bool abort_flag;
+  struct timespec transaction_stop;  // End of the last transaction on this bus
 };
 
 /* preamble and start bytes, see pn532-internal.h for details */
@@ -105,33 +106,62 @@ static size_t pn532_i2c_scan(const nfc_context *context, nfc_connstring connstri
  * table 320. I2C timing specification, page 211, rev. 3.2 - 2007-12-07.
  */
 #define PN532_BUS_FREE_TIME 5
-static struct timespec __transaction_stop;
+
+/*
+ * While waiting for the RDY bit, delay (in ms) between two status reads: it
+ * starts at the bus free time for the fast commands and doubles up to the max
+ * delay for the slow card operations.
+ */
+#define PN532_RDY_POLL_MIN_DELAY PN532_BUS_FREE_TIME
+#define PN532_RDY_POLL_MAX_DELAY 20
+
+static long
+pn532_i2c_elapsed_ms(const struct timespec *since)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+/**
+ * @brief Wait for the minimal free bus time since the last transaction of
+ * 	  this device, i.e. between a STOP condition and a START condition.
+ *
+ * @param pnd pointer on the NFC device.
+ */
+static void
+pn532_i2c_wait_bus_free(nfc_device *pnd)
+{
+  struct timespec now, bus_free_time = { 0, 0 };
+  long long elapsed;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  elapsed = (now.tv_sec - DRIVER_DATA(pnd)->transaction_stop.tv_sec) * 1000000000LL +
+            (now.tv_nsec - DRIVER_DATA(pnd)->transaction_stop.tv_nsec);
+  if (elapsed < PN532_BUS_FREE_TIME * 1000 * 1000) {
+    bus_free_time.tv_nsec = (PN532_BUS_FREE_TIME * 1000 * 1000) - elapsed;
+    nanosleep(&bus_free_time, NULL);
+  }
+}
 
 /**
  * @brief Wrapper around i2c_read to ensure proper timing by respecting the
  * 	  minimal free bus time between a STOP condition and a START condition.
  *
- * @note This is not thread safe, but since libnfc is single threaded
- * 	 this should be okay.
- *
- * @param id I2C device
+ * @param pnd pointer on the NFC device.
  * @param buf pointer on buffer used to store data
  * @param len length of the buffer
  * @return length (in bytes) of read data, or driver error code (negative value)
  */
-static ssize_t pn532_i2c_read(const i2c_device id,
+static ssize_t pn532_i2c_read(nfc_device *pnd,
                               uint8_t *buf, const size_t len)
 {
-  struct timespec transaction_start, bus_free_time = { 0, 0 };
   ssize_t ret;
 
-  clock_gettime(CLOCK_MONOTONIC, &transaction_start);
-  bus_free_time.tv_nsec = (PN532_BUS_FREE_TIME * 1000 * 1000) -
-                          (transaction_start.tv_nsec - __transaction_stop.tv_nsec);
-  nanosleep(&bus_free_time, NULL);
-
-  ret = i2c_read(id, buf, len);
-  clock_gettime(CLOCK_MONOTONIC, &__transaction_stop);
+  pn532_i2c_wait_bus_free(pnd);
+  ret = i2c_read(DRIVER_DATA(pnd)->dev, buf, len);
+  clock_gettime(CLOCK_MONOTONIC, &DRIVER_DATA(pnd)->transaction_stop);
   return ret;
 }
 
@@ -139,27 +169,19 @@ static ssize_t pn532_i2c_read(const i2c_device id,
  * @brief Wrapper around i2c_write to ensure proper timing by respecting the
  * 	  minimal free bus time between a STOP condition and a START condition.
  *
- * @note This is not thread safe, but since libnfc is single threaded
- * 	 this should be okay.
- *
- * @param id I2C device
+ * @param pnd pointer on the NFC device.
  * @param buf pointer on buffer containing data
  * @param len length of the buffer
  * @return NFC_SUCCESS on success, otherwise driver error code
  */
-static ssize_t pn532_i2c_write(const i2c_device id,
+static ssize_t pn532_i2c_write(nfc_device *pnd,
                                const uint8_t *buf, const size_t len)
 {
-  struct timespec transaction_start, bus_free_time = { 0, 0 };
   ssize_t ret;
 
-  clock_gettime(CLOCK_MONOTONIC, &transaction_start);
-  bus_free_time.tv_nsec = (PN532_BUS_FREE_TIME * 1000 * 1000) -
-                          (transaction_start.tv_nsec - __transaction_stop.tv_nsec);
-  nanosleep(&bus_free_time, NULL);
-
-  ret = i2c_write(id, buf, len);
-  clock_gettime(CLOCK_MONOTONIC, &__transaction_stop);
+  pn532_i2c_wait_bus_free(pnd);
+  ret = i2c_write(DRIVER_DATA(pnd)->dev, buf, len);
+  clock_gettime(CLOCK_MONOTONIC, &DRIVER_DATA(pnd)->transaction_stop);
   return ret;
 }
 
@@ -213,6 +235,8 @@ pn532_i2c_scan(const nfc_context *context, nfc_connstring connstrings[], const s
         return 0;
       }
       DRIVER_DATA(pnd)->dev = id;
+      DRIVER_DATA(pnd)->transaction_stop.tv_sec = 0;
+      DRIVER_DATA(pnd)->transaction_stop.tv_nsec = 0;
 
       // Alloc and init chip's data
       if (pn53x_data_new(pnd, &pn532_i2c_io) == NULL) {
@@ -321,6 +345,8 @@ pn532_i2c_open(const nfc_context *context, const nfc_connstring connstring)
     return NULL;
   }
   DRIVER_DATA(pnd)->dev = i2c_dev;
+  DRIVER_DATA(pnd)->transaction_stop.tv_sec = 0;
+  DRIVER_DATA(pnd)->transaction_stop.tv_nsec = 0;
 
   // Alloc and init chip's data
   if (pn53x_data_new(pnd, &pn532_i2c_io) == NULL) {
@@ -360,7 +386,6 @@ pn532_i2c_wakeup(nfc_device *pnd)
   return NFC_SUCCESS;
 }
 
-#define PN532_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 
 /**
  * @brief Send data to the PN532 device.
@@ -402,21 +427,22 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
       break;
   };
 
-  uint8_t abtFrame[PN532_BUFFER_LEN];
+  uint8_t *abtFrame;
   size_t szFrame = 0;
 
-  memcpy(abtFrame, pn53x_preamble_and_start, PN53X_PREAMBLE_AND_START_LEN);	// Every packet must start with the preamble and start bytes.
-  if ((res = pn53x_build_frame(abtFrame, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_in_place(pbtData, szData, &abtFrame, &szFrame)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
 
   for (retries = PN532_SEND_RETRIES; retries > 0; retries--) {
-    res = pn532_i2c_write(DRIVER_DATA(pnd)->dev, abtFrame, szFrame);
+    res = pn532_i2c_write(pnd, abtFrame, szFrame);
     if (res >= 0)
       break;
 
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Failed to transmit data. Retries left: %d.", retries - 1);
+    if (retries > 1)
+      pnd->stats.retries++;
   }
 
   if (res < 0) {
@@ -424,8 +450,9 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
     pnd->last_error = res;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, szData);
 
-  uint8_t abtRxBuf[PN53x_ACK_FRAME__LEN];
+  uint8_t abtRxBuf[1 + PN53x_ACK_FRAME__LEN];
 
   // Wait for the ACK frame
   res = pn532_i2c_wait_rdyframe(pnd, abtRxBuf, sizeof(abtRxBuf), timeout);
@@ -438,7 +465,7 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
     return pnd->last_error;
   }
 
-  if (pn53x_check_ack_frame(pnd, abtRxBuf, res) == 0) {
+  if (pn53x_check_ack_frame(pnd, abtRxBuf + 1, res) == 0) {
     // The PN53x is running the sent command
   } else {
     return pnd->last_error;
@@ -450,8 +477,8 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
  * @brief Read data from the PN532 device until getting a frame with RDY bit set
  *
  * @param pnd pointer on the NFC device.
- * @param pbtData buffer used to store the received frame data.
- * @param szDataLen allocated size of buffer.
+ * @param pbtData buffer used to store the I2C status byte followed by the received frame data.
+ * @param szDataLen allocated size of buffer, status byte included.
  * @param timeout timeout delay before aborting the operation (in ms). Use 0 for no timeout.
  * @return length (in bytes) of the received frame, or NFC_ETIMEOUT if timeout delay has expired,
  *         NFC_EOPABORTED if operation has been aborted, NFC_EIO in case of IO failure
@@ -459,23 +486,17 @@ pn532_i2c_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
 static int
 pn532_i2c_wait_rdyframe(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
 {
-  bool done = false;
-  int res;
+  struct timespec start;
+  long delay = PN532_RDY_POLL_MIN_DELAY;
+  uint8_t rdy;
+  int recCount;
 
-  struct timeval start_tv, cur_tv;
-  long long duration;
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
-  // Actual I2C response frame includes an additional status byte,
-  // so we use a temporary buffer to read the I2C frame
-  uint8_t i2cRx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN + 1];
-
-  if (timeout > 0) {
-    // If a timeout is specified, get current timestamp
-    gettimeofday(&start_tv, NULL);
-  }
-
-  do {
-    int recCount = pn532_i2c_read(DRIVER_DATA(pnd)->dev, i2cRx, szDataLen + 1);
+  // Poll the status byte alone: the frame only follows it once RDY is set,
+  // and is sent again from its start by the next read
+  while (true) {
+    recCount = pn532_i2c_read(pnd, &rdy, 1);
 
     if (DRIVER_DATA(pnd)->abort_flag) {
       // Reset abort flag
@@ -487,59 +508,56 @@ pn532_i2c_wait_rdyframe(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLe
     }
 
     if (recCount <= 0) {
-      done = true;
-      res = NFC_EIO;
-    } else {
-      const uint8_t rdy = i2cRx[0];
-      if (rdy & 1) {
-        int copyLength;
-
-        done = true;
-        res = recCount - 1;
-        copyLength = MIN(res, (int)szDataLen);
-        memcpy(pbtData, &(i2cRx[1]), copyLength);
-      } else {
-        /* Not ready yet. Check for elapsed timeout. */
-
-        if (timeout > 0) {
-          gettimeofday(&cur_tv, NULL);
-          duration = (cur_tv.tv_sec - start_tv.tv_sec) * 1000000L
-                     + (cur_tv.tv_usec - start_tv.tv_usec);
-
-          if (duration / 1000 > timeout) {
-            res = NFC_ETIMEOUT;
-            done = true;
-
-            log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
-                    "timeout reached with no READY frame.");
-          }
-        }
-      }
+      return NFC_EIO;
     }
-  } while (!done);
 
-  return res;
+    if (rdy & 1) {
+      break;
+    }
+
+    /* Not ready yet. Check for elapsed timeout. */
+    if ((timeout > 0) && (pn532_i2c_elapsed_ms(&start) > timeout)) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG,
+              "timeout reached with no READY frame.");
+      return NFC_ETIMEOUT;
+    }
+
+    // Back off, the bus free time is included in the delay
+    if (delay > PN532_BUS_FREE_TIME) {
+      struct timespec xsleep = { .tv_sec = 0, .tv_nsec = (delay - PN532_BUS_FREE_TIME) * 1000 * 1000 };
+      nanosleep(&xsleep, NULL);
+    }
+    delay = MIN(delay * 2, PN532_RDY_POLL_MAX_DELAY);
+  }
+
+  // Actual I2C response frame includes an additional status byte,
+  // which is read along with the frame
+  recCount = pn532_i2c_read(pnd, pbtData, szDataLen);
+  if ((recCount <= 0) || !(pbtData[0] & 1)) {
+    return NFC_EIO;
+  }
+  return recCount - 1;
 }
 
 /**
  * @brief Read a response frame from the PN532 device.
  *
  * @param pnd pointer on the NFC device.
- * @param pbtData buffer used to store the response frame data.
- * @param szDataLen allocated size of buffer.
+ * @param frame frame buffer, the response is parsed in place and frame->data points to its data.
  * @param timeout timeout delay before aborting the operation (in ms). Use 0 for no timeout.
  * @return length (in bytes) of the response, or NFC_ETIMEOUT if timeout delay has expired,
  *         NFC_EOPABORTED if operation has been aborted, NFC_EIO in case of IO failure
  */
 static int
-pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+pn532_i2c_receive_frame(nfc_device *pnd, struct pn53x_frame *frame, int timeout)
 {
-  uint8_t frameBuf[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  // Frame follows the I2C status byte
+  uint8_t *frameBuf = frame->buffer + 1;
   int frameLength;
   int TFI_idx;
   size_t len;
 
-  frameLength = pn532_i2c_wait_rdyframe(pnd, frameBuf, sizeof(frameBuf), timeout);
+  frameLength = pn532_i2c_wait_rdyframe(pnd, frame->buffer, 1 + PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD, timeout);
 
   if (NFC_EOPABORTED == pnd->last_error) {
     return pn532_i2c_ack(pnd);
@@ -585,8 +603,8 @@ pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int
     TFI_idx = 5;
   }
 
-  if ((len - 2) > szDataLen) {
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", szDataLen, len);
+  if ((len < 2) || ((size_t)(TFI_idx + len + 2) > (size_t)frameLength)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: frame truncated. (received: %d, len: %" PRIuPTR ")", frameLength, len);
     pnd->last_error = NFC_EIO;
     goto error;
   }
@@ -625,14 +643,45 @@ pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int
     goto error;
   }
 
-  memcpy(pbtData, &frameBuf[TFI_idx + 2], len - 2);
+  // The data is left where it was received
+  frame->data = &frameBuf[TFI_idx + 2];
+  frame->len = len - 2;
 
   /* The PN53x command is done and we successfully received the reply */
+  nfc_stats_frame_received(pnd, frame->len);
   return len - 2;
 error:
   return pnd->last_error;
 }
 
+/**
+ * @brief Read a response frame from the PN532 device.
+ *
+ * @param pnd pointer on the NFC device.
+ * @param pbtData buffer used to store the response frame data.
+ * @param szDataLen allocated size of buffer.
+ * @param timeout timeout delay before aborting the operation (in ms). Use 0 for no timeout.
+ * @return length (in bytes) of the response, or NFC_ETIMEOUT if timeout delay has expired,
+ *         NFC_EOPABORTED if operation has been aborted, NFC_EIO in case of IO failure
+ */
+static int
+pn532_i2c_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  struct pn53x_frame frame;
+  int res;
+
+  if ((res = pn532_i2c_receive_frame(pnd, &frame, timeout)) < 0) {
+    return res;
+  }
+  if (frame.len > szDataLen) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", szDataLen, frame.len);
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  memcpy(pbtData, frame.data, frame.len);
+  return res;
+}
+
 /**
  * @brief Send an ACK frame to the PN532 device.
  *
@@ -642,7 +691,7 @@ error:
 int
 pn532_i2c_ack(nfc_device *pnd)
 {
-  return pn532_i2c_write(DRIVER_DATA(pnd)->dev, pn53x_ack_frame, sizeof(pn53x_ack_frame));
+  return pn532_i2c_write(pnd, pn53x_ack_frame, sizeof(pn53x_ack_frame));
 }
 
 /**
@@ -661,14 +710,16 @@ pn532_i2c_abort_command(nfc_device *pnd)
 }
 
 const struct pn53x_io pn532_i2c_io = {
-  .send       = pn532_i2c_send,
-  .receive    = pn532_i2c_receive,
+  .send          = pn532_i2c_send,
+  .receive       = pn532_i2c_receive,
+  .receive_frame = pn532_i2c_receive_frame,
 };
 
 const struct nfc_driver pn532_i2c_driver = {
   .name                             = PN532_I2C_DRIVER_NAME,
   .scan_type                        = INTRUSIVE,
   .scan                             = pn532_i2c_scan,
+  .scan_bus                         = "i2c",
   .open                             = pn532_i2c_open,
   .close                            = pn532_i2c_close,
   .strerror                         = pn53x_strerror,
@@ -676,10 +727,13 @@ const struct nfc_driver pn532_i2c_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = pn532_initiator_init_secure_element,
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -696,6 +750,7 @@ const struct nfc_driver pn532_i2c_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = pn532_i2c_abort_command,
   .idle           = pn53x_idle,
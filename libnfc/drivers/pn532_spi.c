@@ -46,6 +46,9 @@
 #include "chips/pn53x.h"
 #include "chips/pn53x-internal.h"
 #include "spi.h"
+#include "gpio.h"
+
+#include <sys/eventfd.h>
 
 #define PN532_SPI_DEFAULT_SPEED 1000000 // 1 MHz
 #define PN532_SPI_DRIVER_NAME "pn532_spi"
@@ -75,6 +78,8 @@ const struct pn53x_io pn532_spi_io;
 struct pn532_spi_data {
   spi_port port;
   volatile bool abort_flag;
+  gpio_irq irq;     // PN532 IRQ line, INVALID_GPIO_IRQ to poll the SPI status
+  int abort_fd;     // eventfd waking up IRQ line waits on abort, -1 if unused
 };
 
 static const uint8_t pn532_spi_cmd_dataread = 0x03;
@@ -132,6 +137,8 @@ pn532_spi_scan(const nfc_context *context, nfc_connstring connstrings[], const s
         return 0;
       }
       DRIVER_DATA(pnd)->port = sp;
+      DRIVER_DATA(pnd)->irq = INVALID_GPIO_IRQ;
+      DRIVER_DATA(pnd)->abort_fd = -1;
 
       // Alloc and init chip's data
       if (pn53x_data_new(pnd, &pn532_spi_io) == NULL) {
@@ -180,6 +187,7 @@ pn532_spi_scan(const nfc_context *context, nfc_connstring connstrings[], const s
 struct pn532_spi_descriptor {
   char *port;
   uint32_t speed;
+  char *irq;
 };
 
 static void
@@ -190,10 +198,30 @@ pn532_spi_close(nfc_device *pnd)
   // Release SPI port
   spi_close(DRIVER_DATA(pnd)->port);
 
+  // Release IRQ line
+  if (DRIVER_DATA(pnd)->irq != INVALID_GPIO_IRQ)
+    gpio_irq_close(DRIVER_DATA(pnd)->irq);
+  if (DRIVER_DATA(pnd)->abort_fd >= 0)
+    close(DRIVER_DATA(pnd)->abort_fd);
+
   pn53x_data_free(pnd);
   nfc_device_free(pnd);
 }
 
+// Optional IRQ line follows the speed: pn532_spi:<port>:<speed>:<gpiochip>@<line>
+static char *
+pn532_spi_connstring_irq(const nfc_connstring connstring)
+{
+  const char *pcField = connstring;
+
+  for (int i = 0; i < 3; i++) {
+    if ((pcField = strchr(pcField, ':')) == NULL)
+      return NULL;
+    pcField++;
+  }
+  return (*pcField) ? strdup(pcField) : NULL;
+}
+
 static nfc_device *
 pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
 {
@@ -216,6 +244,7 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   if (connstring_decode_level < 3) {
     ndd.speed = PN532_SPI_DEFAULT_SPEED;
   }
+  ndd.irq = pn532_spi_connstring_irq(connstring);
   spi_port sp;
   nfc_device *pnd = NULL;
 
@@ -228,6 +257,7 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "SPI port already claimed: %s", ndd.port);
   if ((sp == CLAIMED_SPI_PORT) || (sp == INVALID_SPI_PORT)) {
     free(ndd.port);
+    free(ndd.irq);
     return NULL;
   }
   spi_set_speed(sp, ndd.speed);
@@ -238,6 +268,7 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   if (!pnd) {
     perror("malloc");
     free(ndd.port);
+    free(ndd.irq);
     spi_close(sp);
     return NULL;
   }
@@ -247,16 +278,37 @@ pn532_spi_open(const nfc_context *context, const nfc_connstring connstring)
   pnd->driver_data = malloc(sizeof(struct pn532_spi_data));
   if (!pnd->driver_data) {
     perror("malloc");
+    free(ndd.irq);
     spi_close(sp);
     nfc_device_free(pnd);
     return NULL;
   }
   DRIVER_DATA(pnd)->port = sp;
+  DRIVER_DATA(pnd)->irq = INVALID_GPIO_IRQ;
+  DRIVER_DATA(pnd)->abort_fd = -1;
+
+  if (ndd.irq) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Using IRQ line: %s", ndd.irq);
+    DRIVER_DATA(pnd)->irq = gpio_irq_open(ndd.irq);
+    free(ndd.irq);
+    if ((DRIVER_DATA(pnd)->irq == INVALID_GPIO_IRQ) ||
+        ((DRIVER_DATA(pnd)->abort_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)) {
+      if (DRIVER_DATA(pnd)->irq != INVALID_GPIO_IRQ)
+        gpio_irq_close(DRIVER_DATA(pnd)->irq);
+      spi_close(sp);
+      nfc_device_free(pnd);
+      return NULL;
+    }
+  }
 
   // Alloc and init chip's data
   if (pn53x_data_new(pnd, &pn532_spi_io) == NULL) {
     perror("malloc");
     spi_close(DRIVER_DATA(pnd)->port);
+    if (DRIVER_DATA(pnd)->irq != INVALID_GPIO_IRQ) {
+      gpio_irq_close(DRIVER_DATA(pnd)->irq);
+      close(DRIVER_DATA(pnd)->abort_fd);
+    }
     nfc_device_free(pnd);
     return NULL;
   }
@@ -336,17 +388,32 @@ pn532_spi_wakeup(nfc_device *pnd)
   return res;
 }
 
-#define PN532_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 
 
+static void
+pn532_spi_clear_abort(nfc_device *pnd)
+{
+  DRIVER_DATA(pnd)->abort_flag = false;
+  if (DRIVER_DATA(pnd)->abort_fd >= 0) {
+    eventfd_t value;
+    eventfd_read(DRIVER_DATA(pnd)->abort_fd, &value);
+  }
+}
+
 static int
 pn532_spi_wait_for_data(nfc_device *pnd, int timeout)
 {
   static const uint8_t pn532_spi_ready = 0x01;
-  static const int pn532_spi_poll_interval = 10; //ms
+  // Without IRQ line, poll the status often at first as most responses come
+  // within a few ms, then back off up to the max interval
+  static const long pn532_spi_poll_min_interval = 50;   // us
+  static const long pn532_spi_poll_max_interval = 1000; // us
 
+  struct timespec start, now;
+  long poll_interval = pn532_spi_poll_min_interval;
+  int remaining = 0;
 
-  int timer = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
 
   int ret;
   while ((ret = pn532_spi_read_spi_status(pnd)) != pn532_spi_ready) {
@@ -355,17 +422,33 @@ pn532_spi_wait_for_data(nfc_device *pnd, int timeout)
     }
 
     if (DRIVER_DATA(pnd)->abort_flag) {
-      DRIVER_DATA(pnd)->abort_flag = false;
+      pn532_spi_clear_abort(pnd);
       return NFC_EOPABORTED;
     }
 
     if (timeout > 0) {
-      timer += pn532_spi_poll_interval;
-      if (timer > timeout) {
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      const long elapsed = (now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+      if (elapsed >= timeout) {
         return NFC_ETIMEOUT;
       }
+      remaining = timeout - elapsed;
+    }
 
-      msleep(pn532_spi_poll_interval);
+    if (DRIVER_DATA(pnd)->irq != INVALID_GPIO_IRQ) {
+      // The status is checked again after an edge, or once more on timeout
+      ret = gpio_irq_wait(DRIVER_DATA(pnd)->irq, DRIVER_DATA(pnd)->abort_fd, remaining);
+      if (NFC_EOPABORTED == ret) {
+        pn532_spi_clear_abort(pnd);
+        return ret;
+      }
+      if ((ret < 0) && (NFC_ETIMEOUT != ret)) {
+        return ret;
+      }
+    } else {
+      struct timespec xsleep = { .tv_sec = 0, .tv_nsec = poll_interval * 1000 };
+      nanosleep(&xsleep, NULL);
+      poll_interval = MIN(poll_interval * 2, pn532_spi_poll_max_interval);
     }
   }
 
@@ -560,6 +643,7 @@ pn532_spi_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int
     goto error;
   }
   // The PN53x command is done and we successfully received the reply
+  nfc_stats_frame_received(pnd, len);
   return len;
 error:
   return pnd->last_error;
@@ -593,20 +677,23 @@ pn532_spi_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int
       break;
   };
 
-  uint8_t  abtFrame[PN532_BUFFER_LEN + 1] = { pn532_spi_cmd_datawrite, 0x00, 0x00, 0xff };       // SPI data transfer starts with DATAWRITE (0x01) byte,  Every packet must start with "00 00 ff"
+  uint8_t *abtFrame;
   size_t szFrame = 0;
 
-  if ((res = pn53x_build_frame(abtFrame + 1, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_in_place(pbtData, szData, &abtFrame, &szFrame)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
+  // SPI data transfer starts with DATAWRITE (0x01) byte, there is room for it before the frame
+  *(--abtFrame) = pn532_spi_cmd_datawrite;
 
-  res = spi_send(DRIVER_DATA(pnd)->port, abtFrame, szFrame, true);
+  res = spi_send(DRIVER_DATA(pnd)->port, abtFrame, szFrame + 1, true);
   if (res != 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to transmit data. (TX)");
     pnd->last_error = res;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, szData);
 
   res = pn532_spi_wait_for_data(pnd, timeout);
   if (res != NFC_SUCCESS) {
@@ -654,6 +741,8 @@ pn532_spi_abort_command(nfc_device *pnd)
 {
   if (pnd) {
     DRIVER_DATA(pnd)->abort_flag = true;
+    if (DRIVER_DATA(pnd)->abort_fd >= 0)
+      eventfd_write(DRIVER_DATA(pnd)->abort_fd, 1);
   }
 
   return NFC_SUCCESS;
@@ -668,6 +757,7 @@ const struct nfc_driver pn532_spi_driver = {
   .name                             = PN532_SPI_DRIVER_NAME,
   .scan_type                        = INTRUSIVE,
   .scan                             = pn532_spi_scan,
+  .scan_bus                         = "spi",
   .open                             = pn532_spi_open,
   .close                            = pn532_spi_close,
   .strerror                         = pn53x_strerror,
@@ -675,10 +765,13 @@ const struct nfc_driver pn532_spi_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = pn532_initiator_init_secure_element,
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -695,6 +788,7 @@ const struct nfc_driver pn532_spi_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = pn532_spi_abort_command,
   .idle           = pn53x_idle,
@@ -50,10 +50,15 @@
 
 #define PN532_UART_DEFAULT_SPEED 115200
 #define PN532_UART_DRIVER_NAME "pn532_uart"
+// Time given to the PN532 to send its last frame again after a NACK, in ms
+#define PN532_UART_RESYNC_TIMEOUT 50
 
 #define LOG_CATEGORY "libnfc.driver.pn532_uart"
 #define LOG_GROUP    NFC_LOG_GROUP_DRIVER
 
+// Baud rates tried, fastest first, when "auto" is given as connstring speed
+static const uint32_t pn532_uart_auto_speeds[] = { 921600, 460800, 230400 };
+
 // Internal data structs
 const struct pn53x_io pn532_uart_io;
 struct pn532_uart_data {
@@ -180,6 +185,7 @@ pn532_uart_scan(const nfc_context *context, nfc_connstring connstrings[], const
 struct pn532_uart_descriptor {
   char *port;
   uint32_t speed;
+  bool auto_speed;
 };
 
 static void
@@ -200,12 +206,66 @@ pn532_uart_close(nfc_device *pnd)
   nfc_device_free(pnd);
 }
 
+/*
+ * Switch both the PN532 and the serial port to the fastest baud rate they
+ * share. If a baud rate doesn't work, the PN532 is put back to the previous
+ * one and the next one is tried; it only fails if the PN532 can't be reached
+ * anymore.
+ */
+static int
+pn532_uart_upgrade_speed(nfc_device *pnd)
+{
+  serial_port sp = DRIVER_DATA(pnd)->port;
+  const uint32_t current_speed = uart_get_speed(sp);
+
+  for (size_t n = 0; n < sizeof(pn532_uart_auto_speeds) / sizeof(pn532_uart_auto_speeds[0]); n++) {
+    const uint32_t speed = pn532_uart_auto_speeds[n];
+    if (speed <= current_speed)
+      break;
+    // Make sure the serial port can handle this speed before telling the PN532 about it
+    if (uart_set_speed(sp, speed) < 0)
+      continue;
+    uart_set_speed(sp, current_speed);
+
+    if (pn53x_SetSerialBaudRate(pnd, speed) < 0)
+      continue;
+    // PN532 switches to the new baud rate once it received this ACK frame
+    pn532_uart_ack(pnd);
+    uart_set_speed(sp, speed);
+    nfc_usleep(1000);
+
+    if (pn53x_check_communication(pnd) == 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "Serial port speed upgraded to %" PRIu32 " baud.", speed);
+      return NFC_SUCCESS;
+    }
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Communication failed at %" PRIu32 " baud, falling back to %" PRIu32 " baud.", speed, current_speed);
+    // The PN532 runs at the new speed, so it has to be told about the
+    // previous one at the new speed. If it doesn't answer, it likely never
+    // left the previous speed.
+    if (pn53x_SetSerialBaudRate(pnd, current_speed) == 0)
+      pn532_uart_ack(pnd);
+    uart_set_speed(sp, current_speed);
+    nfc_usleep(1000);
+    uart_flush_input(sp, true);
+    if (pn53x_check_communication(pnd) < 0)
+      return NFC_EIO;
+  }
+  return NFC_SUCCESS;
+}
+
 static nfc_device *
 pn532_uart_open(const nfc_context *context, const nfc_connstring connstring)
 {
   struct pn532_uart_descriptor ndd;
   char *speed_s;
   int connstring_decode_level = connstring_decode(connstring, PN532_UART_DRIVER_NAME, NULL, &ndd.port, &speed_s);
+  ndd.auto_speed = false;
+  if ((connstring_decode_level == 3) && (0 == strcmp(speed_s, "auto"))) {
+    // Start at default speed, then negotiate the fastest one once the chip is found
+    ndd.auto_speed = true;
+    free(speed_s);
+    connstring_decode_level = 2;
+  }
   if (connstring_decode_level == 3) {
     ndd.speed = 0;
     if (sscanf(speed_s, "%10"PRIu32, &ndd.speed) != 1) {
@@ -295,6 +355,12 @@ pn532_uart_open(const nfc_context *context, const nfc_connstring connstring)
     return NULL;
   }
 
+  if (ndd.auto_speed && (pn532_uart_upgrade_speed(pnd) < 0)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Communication lost while changing baud rate");
+    pn532_uart_close(pnd);
+    return NULL;
+  }
+
   pn53x_init(pnd);
   return pnd;
 }
@@ -309,7 +375,6 @@ pn532_uart_wakeup(nfc_device *pnd)
   return res;
 }
 
-#define PN532_BUFFER_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD)
 static int
 pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
 {
@@ -340,10 +405,10 @@ pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, in
       break;
   };
 
-  uint8_t  abtFrame[PN532_BUFFER_LEN] = { 0x00, 0x00, 0xff };       // Every packet must start with "00 00 ff"
+  uint8_t *abtFrame;
   size_t szFrame = 0;
 
-  if ((res = pn53x_build_frame(abtFrame, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_in_place(pbtData, szData, &abtFrame, &szFrame)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
@@ -354,6 +419,7 @@ pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, in
     pnd->last_error = res;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, szData);
 
   uint8_t abtRxBuf[PN53x_ACK_FRAME__LEN];
   res = uart_receive(DRIVER_DATA(pnd)->port, abtRxBuf, sizeof(abtRxBuf), 0, timeout);
@@ -371,6 +437,40 @@ pn532_uart_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, in
   return NFC_SUCCESS;
 }
 
+/*
+ * Get back in sync after a garbled frame: drop the bytes still in flight and,
+ * if the chip is awake, abort whatever it may still be running with an ACK
+ * frame and drop its late output as well.  Then a NACK frame asks the chip to
+ * send its last frame again: a frame start confirms that the link is back in
+ * sync.  A sleeping chip sends nothing.
+ */
+static int
+pn532_uart_resync(nfc_device *pnd)
+{
+  serial_port sp = DRIVER_DATA(pnd)->port;
+  uint8_t abtRxBuf[3];
+
+  uart_flush_input(sp, true);
+  if (NORMAL != CHIP_DATA(pnd)->power_mode)
+    return NFC_SUCCESS;
+  pn532_uart_ack(pnd);
+  uart_flush_input(sp, true);
+
+  if (uart_send(sp, pn53x_nack_frame, sizeof(pn53x_nack_frame), 0) < 0)
+    return NFC_EIO;
+  pnd->stats.nacks++;
+  const uint8_t pn53x_preamble[3] = { 0x00, 0x00, 0xff };
+  const bool bSync = (uart_receive(sp, abtRxBuf, sizeof(abtRxBuf), NULL, PN532_UART_RESYNC_TIMEOUT) == 0) &&
+                     (0 == memcmp(abtRxBuf, pn53x_preamble, sizeof(pn53x_preamble)));
+  // Drop the rest of the frame, or whatever came instead
+  uart_flush_input(sp, true);
+  if (!bSync) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to resync with the PN532");
+    return NFC_EIO;
+  }
+  return NFC_SUCCESS;
+}
+
 static int
 pn532_uart_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
 {
@@ -492,9 +592,14 @@ pn532_uart_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, in
     goto error;
   }
   // The PN53x command is done and we successfully received the reply
+  nfc_stats_frame_received(pnd, len);
   return len;
 error:
-  uart_flush_input(DRIVER_DATA(pnd)->port, true);
+  // Only a framing or checksum error leaves the link out of sync: after a
+  // timeout or an abort the chip has nothing in flight to drop.  The receive
+  // error is the one reported, a failed resync is only logged
+  if (NFC_EIO == pnd->last_error)
+    pn532_uart_resync(pnd);
   return pnd->last_error;
 }
 
@@ -526,15 +631,27 @@ pn532_uart_abort_command(nfc_device *pnd)
   return NFC_SUCCESS;
 }
 
+#ifndef WIN32
+static int
+pn532_uart_get_pollfd(nfc_device *pnd)
+{
+  return uart_get_fd(DRIVER_DATA(pnd)->port);
+}
+#endif
+
 const struct pn53x_io pn532_uart_io = {
   .send       = pn532_uart_send,
   .receive    = pn532_uart_receive,
+#ifndef WIN32
+  .get_pollfd = pn532_uart_get_pollfd,
+#endif
 };
 
 const struct nfc_driver pn532_uart_driver = {
   .name                             = PN532_UART_DRIVER_NAME,
   .scan_type                        = INTRUSIVE,
   .scan                             = pn532_uart_scan,
+  .scan_bus                         = "uart",
   .open                             = pn532_uart_open,
   .close                            = pn532_uart_close,
   .strerror                         = pn53x_strerror,
@@ -542,10 +659,13 @@ const struct nfc_driver pn532_uart_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = pn532_initiator_init_secure_element,
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -562,6 +682,7 @@ const struct nfc_driver pn532_uart_driver = {
   .get_supported_modulation     = pn53x_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = pn532_uart_abort_command,
   .idle           = pn53x_idle,
@@ -0,0 +1,415 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file pn53x_replay.c
+ * @brief Replay of a PN53x frame capture
+ *
+ * Devices opened while LIBNFC_CAPTURE is set record the frames exchanged with
+ * their PN53x chip (see nfc-capture.h). This driver serves the recorded
+ * replies back: each command sent must be the recorded one, its reply is
+ * returned after the recorded chip time, or at once in fast mode. Running the
+ * captured application against it reproduces the session without hardware,
+ * and in fast mode measures the library overhead without wire time.
+ *
+ * Connstring is "pn53x_replay:<capture file>[:fast]".
+ *
+ * The open sequence of the captured driver differs from this one: while
+ * opening, commands are answered by the recorded reply of the same command,
+ * or else of the same command code, taken from the capture open sequence.
+ * Strict replay starts right after it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "pn53x_replay.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "drivers.h"
+#include "nfc-internal.h"
+#include "nfc-capture.h"
+#include "chips/pn53x.h"
+#include "chips/pn53x-internal.h"
+
+#define PN53X_REPLAY_DRIVER_NAME "pn53x_replay"
+
+#define LOG_CATEGORY "libnfc.driver.pn53x_replay"
+#define LOG_GROUP    NFC_LOG_GROUP_DRIVER
+
+#ifndef _WIN32
+#  include <time.h>
+#else
+#  include <winbase.h>
+#endif
+
+// No reply pending
+#define PN53X_REPLAY_NONE SIZE_MAX
+// End of waits spent polling the clock, as sleeps overshoot by the timer slack, in ns
+#define PN53X_REPLAY_SPIN 100000
+
+const struct pn53x_io pn53x_replay_io;
+
+struct pn53x_replay_data {
+  struct nfc_capture_trace trace;
+  /** Replies are served at once, instead of after the recorded chip time */
+  bool bFast;
+  /** Device is being opened, commands are looked up in the capture open sequence */
+  bool bOpening;
+  /** Index of the end of the capture open sequence */
+  size_t szOpened;
+  /** Index of the next record to replay */
+  size_t szNext;
+  /** Index of the reply to the last command, or PN53X_REPLAY_NONE */
+  size_t szReply;
+  /** Recorded time between the last command and its reply, in ns */
+  uint64_t ui64Delay;
+  /** Time the last command was sent, in ns */
+  uint64_t ui64SentAt;
+  nfc_mutex mutex;
+  nfc_cond cond;
+  bool bAbort;
+};
+
+#define DRIVER_DATA(pnd) ((struct pn53x_replay_data*)(pnd->driver_data))
+
+static void
+pn53x_replay_nsleep(const uint64_t ui64Delay)
+{
+#ifndef _WIN32
+  struct timespec ts;
+  ts.tv_sec = ui64Delay / 1000000000;
+  ts.tv_nsec = ui64Delay % 1000000000;
+  nanosleep(&ts, NULL);
+#else
+  Sleep((DWORD)((ui64Delay + 999999) / 1000000));
+#endif
+}
+
+// Wait for the recorded time of the last reply, return NFC_EOPABORTED when aborted meanwhile
+static int
+pn53x_replay_wait(struct pn53x_replay_data *replay)
+{
+  int res = NFC_SUCCESS;
+  const uint64_t ui64Until = replay->ui64SentAt + replay->ui64Delay;
+
+  nfc_mutex_lock(&replay->mutex);
+  for (;;) {
+    if (replay->bAbort) {
+      replay->bAbort = false;
+      res = NFC_EOPABORTED;
+      break;
+    }
+    const uint64_t ui64Now = nfc_capture_now();
+    if (replay->bFast || (ui64Now >= ui64Until))
+      break;
+    const uint64_t ui64Wait = ui64Until - ui64Now;
+    if (ui64Wait >= 1000000) {
+      nfc_cond_wait(&replay->cond, &replay->mutex, (ui64Wait / 1000000 > INT_MAX) ? INT_MAX : (int)(ui64Wait / 1000000));
+    } else {
+      nfc_mutex_unlock(&replay->mutex);
+      if (ui64Wait > PN53X_REPLAY_SPIN)
+        pn53x_replay_nsleep(ui64Wait - PN53X_REPLAY_SPIN);
+      nfc_mutex_lock(&replay->mutex);
+    }
+  }
+  nfc_mutex_unlock(&replay->mutex);
+  return res;
+}
+
+// Find the recorded command answering pbtData in the capture open sequence
+static size_t
+pn53x_replay_lookup(const struct pn53x_replay_data *replay, const uint8_t *pbtData, const size_t szData)
+{
+  size_t szSameCode = PN53X_REPLAY_NONE;
+  for (size_t i = 0; i < replay->szOpened; i++) {
+    const struct nfc_capture_record *prec = &replay->trace.records[i];
+    if ((prec->type != NFC_CAPTURE_TX) || !prec->len || (prec->data[0] != pbtData[0]))
+      continue;
+    if ((prec->len == szData) && (0 == memcmp(prec->data, pbtData, szData)))
+      return i;
+    if (szSameCode == PN53X_REPLAY_NONE)
+      szSameCode = i;
+  }
+  return szSameCode;
+}
+
+// Index of the next frame record from szIndex on, skipping the other ones
+static size_t
+pn53x_replay_next_frame(const struct pn53x_replay_data *replay, size_t szIndex)
+{
+  while ((szIndex < replay->trace.count) &&
+         (replay->trace.records[szIndex].type != NFC_CAPTURE_TX) &&
+         (replay->trace.records[szIndex].type != NFC_CAPTURE_RX) &&
+         (replay->trace.records[szIndex].type != NFC_CAPTURE_TX_ERROR) &&
+         (replay->trace.records[szIndex].type != NFC_CAPTURE_RX_ERROR))
+    szIndex++;
+  return szIndex;
+}
+
+static int
+pn53x_replay_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  struct pn53x_replay_data *replay = DRIVER_DATA(pnd);
+  const struct nfc_capture_record *precs = replay->trace.records;
+  size_t szCommand;
+  (void) timeout;
+
+  replay->ui64SentAt = nfc_capture_now();
+  replay->szReply = PN53X_REPLAY_NONE;
+  nfc_stats_frame_sent(pnd, szData);
+  nfc_mutex_lock(&replay->mutex);
+  replay->bAbort = false;
+  nfc_mutex_unlock(&replay->mutex);
+
+  if (replay->bOpening) {
+    if ((szCommand = pn53x_replay_lookup(replay, pbtData, szData)) == PN53X_REPLAY_NONE) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Command 0x%02x not found in the capture open sequence", pbtData[0]);
+      pnd->last_error = NFC_EIO;
+      return pnd->last_error;
+    }
+  } else {
+    szCommand = pn53x_replay_next_frame(replay, replay->szNext);
+    if (szCommand == replay->trace.count) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "End of capture reached");
+      pnd->last_error = NFC_EIO;
+      return pnd->last_error;
+    }
+    if ((precs[szCommand].type != NFC_CAPTURE_TX) || (precs[szCommand].len != szData) ||
+        memcmp(precs[szCommand].data, pbtData, szData)) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Command 0x%02x diverges from the capture at record %" PRIuPTR, pbtData[0], szCommand);
+      pnd->last_error = NFC_EIO;
+      return pnd->last_error;
+    }
+    replay->szNext = szCommand + 1;
+  }
+
+  const size_t szReply = pn53x_replay_next_frame(replay, szCommand + 1);
+  if (szReply == replay->trace.count)
+    return NFC_SUCCESS;
+  replay->ui64Delay = precs[szReply].time - precs[szCommand].time;
+  if (precs[szReply].type == NFC_CAPTURE_TX_ERROR) {
+    if (!replay->bOpening)
+      replay->szNext = szReply + 1;
+    if ((pnd->last_error = pn53x_replay_wait(replay)) < 0)
+      return pnd->last_error;
+    pnd->last_error = nfc_capture_record_error(&precs[szReply]);
+    return pnd->last_error;
+  }
+  if ((precs[szReply].type == NFC_CAPTURE_RX) || (precs[szReply].type == NFC_CAPTURE_RX_ERROR))
+    replay->szReply = szReply;
+  return NFC_SUCCESS;
+}
+
+static int
+pn53x_replay_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  struct pn53x_replay_data *replay = DRIVER_DATA(pnd);
+  (void) timeout;
+
+  if (replay->szReply == PN53X_REPLAY_NONE) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "No reply in the capture");
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  const struct nfc_capture_record *prec = &replay->trace.records[replay->szReply];
+  if (!replay->bOpening)
+    replay->szNext = replay->szReply + 1;
+  replay->szReply = PN53X_REPLAY_NONE;
+
+  if ((pnd->last_error = pn53x_replay_wait(replay)) < 0)
+    return pnd->last_error;
+  if (prec->type == NFC_CAPTURE_RX_ERROR) {
+    pnd->last_error = nfc_capture_record_error(prec);
+    return pnd->last_error;
+  }
+  if (prec->len > szDataLen) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", szDataLen, prec->len);
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  memcpy(pbtData, prec->data, prec->len);
+  nfc_stats_frame_received(pnd, prec->len);
+  return (int) prec->len;
+}
+
+static int
+pn53x_replay_abort_command(nfc_device *pnd)
+{
+  if (pnd) {
+    struct pn53x_replay_data *replay = DRIVER_DATA(pnd);
+    nfc_mutex_lock(&replay->mutex);
+    replay->bAbort = true;
+    nfc_cond_broadcast(&replay->cond);
+    nfc_mutex_unlock(&replay->mutex);
+  }
+  return NFC_SUCCESS;
+}
+
+static void
+pn53x_replay_data_free(struct pn53x_replay_data *replay)
+{
+  nfc_cond_destroy(&replay->cond);
+  nfc_mutex_destroy(&replay->mutex);
+  nfc_capture_trace_free(&replay->trace);
+}
+
+static void
+pn53x_replay_close(nfc_device *pnd)
+{
+  pn53x_idle(pnd);
+  pn53x_replay_data_free(DRIVER_DATA(pnd));
+  pn53x_data_free(pnd);
+  nfc_device_free(pnd);
+}
+
+static nfc_device *
+pn53x_replay_open(const nfc_context *context, const nfc_connstring connstring)
+{
+  const size_t szPrefix = strlen(PN53X_REPLAY_DRIVER_NAME ":");
+  if (strncmp(connstring, PN53X_REPLAY_DRIVER_NAME ":", szPrefix) || !connstring[szPrefix]) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "No capture file given");
+    return NULL;
+  }
+  // The file name is everything in between, so that it may hold colons
+  nfc_connstring path;
+  strcpy(path, connstring + szPrefix);
+  const size_t szPath = strlen(path);
+  bool bFast = false;
+  if ((szPath > 5) && (0 == strcmp(path + szPath - 5, ":fast"))) {
+    path[szPath - 5] = '\0';
+    bFast = true;
+  }
+
+  struct pn53x_replay_data *replay = calloc(1, sizeof(struct pn53x_replay_data));
+  if (!replay) {
+    perror("malloc");
+    return NULL;
+  }
+  if (nfc_capture_trace_load(&replay->trace, path) < 0) {
+    free(replay);
+    return NULL;
+  }
+  replay->bFast = bFast;
+  replay->szReply = PN53X_REPLAY_NONE;
+  for (replay->szOpened = 0; replay->szOpened < replay->trace.count; replay->szOpened++) {
+    if (replay->trace.records[replay->szOpened].type == NFC_CAPTURE_OPENED)
+      break;
+  }
+  replay->szNext = replay->szOpened;
+  nfc_mutex_init(&replay->mutex);
+  nfc_cond_init(&replay->cond);
+
+  nfc_device *pnd = nfc_device_new(context, connstring);
+  if (!pnd) {
+    perror("malloc");
+    pn53x_replay_data_free(replay);
+    free(replay);
+    return NULL;
+  }
+  if (replay->trace.count && (replay->trace.records[0].type == NFC_CAPTURE_CONNSTRING)) {
+    snprintf(pnd->name, sizeof(pnd->name), "%s:%.*s", PN53X_REPLAY_DRIVER_NAME,
+             (int) MIN(replay->trace.records[0].len, DEVICE_NAME_LENGTH), (const char *) replay->trace.records[0].data);
+  } else {
+    snprintf(pnd->name, sizeof(pnd->name), "%s", PN53X_REPLAY_DRIVER_NAME);
+  }
+  pnd->driver_data = replay;
+
+  // Alloc and init chip's data
+  if (pn53x_data_new(pnd, &pn53x_replay_io) == NULL) {
+    perror("malloc");
+    pn53x_replay_data_free(replay);
+    nfc_device_free(pnd);
+    return NULL;
+  }
+  CHIP_DATA(pnd)->power_mode = NORMAL;
+  pnd->driver = &pn53x_replay_driver;
+
+  // Chip type comes from the recorded GetFirmwareVersion reply
+  replay->bOpening = true;
+  const int res = pn53x_init(pnd);
+  replay->bOpening = false;
+  if (res < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to replay the open sequence");
+    pn53x_replay_data_free(replay);
+    pn53x_data_free(pnd);
+    nfc_device_free(pnd);
+    return NULL;
+  }
+  return pnd;
+}
+
+const struct pn53x_io pn53x_replay_io = {
+  .send       = pn53x_replay_send,
+  .receive    = pn53x_replay_receive,
+};
+
+const struct nfc_driver pn53x_replay_driver = {
+  .name                             = PN53X_REPLAY_DRIVER_NAME,
+  .scan_type                        = NOT_AVAILABLE,
+  .open                             = pn53x_replay_open,
+  .close                            = pn53x_replay_close,
+  .strerror                         = pn53x_strerror,
+
+  .initiator_init                   = pn53x_initiator_init,
+  .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
+  .initiator_poll_target            = pn53x_initiator_poll_target,
+  .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
+  .initiator_deselect_target        = pn53x_initiator_deselect_target,
+  .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
+  .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
+  .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
+  .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
+  .initiator_target_is_present      = pn53x_initiator_target_is_present,
+
+  .target_init           = pn53x_target_init,
+  .target_send_bytes     = pn53x_target_send_bytes,
+  .target_receive_bytes  = pn53x_target_receive_bytes,
+  .target_send_bits      = pn53x_target_send_bits,
+  .target_receive_bits   = pn53x_target_receive_bits,
+
+  .device_set_property_bool     = pn53x_set_property_bool,
+  .device_set_property_int      = pn53x_set_property_int,
+  .get_supported_modulation     = pn53x_get_supported_modulation,
+  .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
+  .device_get_information_about = pn53x_get_information_about,
+
+  .abort_command  = pn53x_replay_abort_command,
+  .idle           = pn53x_idle,
+  .powerdown      = pn53x_PowerDown,
+};
@@ -0,0 +1,1624 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file pn53x_sim.c
+ * @brief Simulated PN532/PN533 with virtual cards
+ *
+ * The chip is modeled in process, down to its frames: each command is framed
+ * as for a real chip, acknowledged, run against virtual cards and answered
+ * with a normal or an extended frame, once the configured latency elapsed.
+ * No hardware is needed, which makes the upper layers testable and their
+ * overhead measurable.
+ *
+ * Connstring is "pn53x_sim[:chip[:options]]", where chip is pn532 or pn533
+ * (default) and options a comma separated list of:
+ * - card types, put in the field in this order: mifare-classic,
+ *   mifare-ultralight, iso14443-4, felica or dep (default: a mifare-classic)
+ * - latency=<us>: time taken by every command
+ * - rf-latency=<us>: time added to commands exchanging with cards
+ * - leave=<ms>: cards leave the field this long after the device is opened
+ * - back=<ms>: cards which left come back to the field this long later
+ *   (default: never)
+ * - no-halt: ISO14443-A cards are idle once deselected, instead of halted, and
+ *   answer the next listing again
+ *
+ * Under Linux, nfc_device_get_pollfd() returns a timerfd which gets readable
+ * once the answer of the pending command is ready.
+ *
+ * MIFARE Classic cards use the transport key FFFFFFFFFFFF, ISO14443-4 and
+ * DEP cards echo what they receive (ISO14443-4 ones followed by 90 00).
+ * Being only a model, cards do not collide and MIFARE Classic Crypto1 is not
+ * emulated in raw mode.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include "pn53x_sim.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "drivers.h"
+#include "nfc-internal.h"
+#include "chips/pn53x.h"
+#include "chips/pn53x-internal.h"
+
+#define PN53X_SIM_DRIVER_NAME "pn53x_sim"
+
+#define LOG_CATEGORY "libnfc.driver.pn53x_sim"
+#define LOG_GROUP    NFC_LOG_GROUP_DRIVER
+
+#ifndef _WIN32
+#  include <time.h>
+#  include <unistd.h>
+#else
+#  include <winbase.h>
+#endif
+#ifdef __linux__
+#  include <sys/timerfd.h>
+#endif
+
+// Cards which can be put in the field
+#define PN53X_SIM_MAX_CARDS 8
+// Targets listed at once by InListPassiveTarget
+#define PN53X_SIM_MAX_TARGETS 2
+// Largest frame exchanged with a card, chained ones included
+#define PN53X_SIM_CARD_BUFFER_LEN 1024
+// Largest answer after the command code
+#define PN53X_SIM_ANSWER_MAX_LEN (PN53x_EXTENDED_FRAME__DATA_MAX_LEN - 2)
+// Largest InDataExchange answer sent at once after its status byte, longer ones are chained
+#define PN53X_SIM_CHUNK_LEN (PN53X_SIM_ANSWER_MAX_LEN - 1)
+#define PN53X_SIM_FIFO_LEN 64
+
+typedef enum {
+  PN53X_SIM_MIFARE_CLASSIC,
+  PN53X_SIM_MIFARE_ULTRALIGHT,
+  PN53X_SIM_ISO14443_4,
+  PN53X_SIM_FELICA,
+  PN53X_SIM_DEP,
+} pn53x_sim_card_type;
+
+static const char *pn53x_sim_card_names[] = {
+  "mifare-classic",
+  "mifare-ultralight",
+  "iso14443-4",
+  "felica",
+  "dep",
+};
+
+typedef enum {
+  PN53X_SIM_IDLE,
+  // Answered REQA or WUPA, being selected in raw mode
+  PN53X_SIM_READY,
+  PN53X_SIM_ACTIVE,
+  PN53X_SIM_HALT,
+} pn53x_sim_card_state;
+
+struct pn53x_sim_card {
+  pn53x_sim_card_type type;
+  pn53x_sim_card_state state;
+  // Logical target number while active
+  uint8_t btTg;
+  // Cascade level being selected while ready
+  uint8_t btLevel;
+  // UID, FeliCa IDm or NFCID3
+  uint8_t abtId[10];
+  size_t szIdLen;
+  uint8_t abtAtqa[2];
+  uint8_t btSak;
+  uint8_t abtPmm[8];
+  // MIFARE Classic authenticated sector, -1 if none
+  int iAuthSector;
+  // ISO14443-4 activated, i.e. ATS sent
+  bool bIsoDep;
+  uint8_t abtMemory[1024];
+};
+
+struct pn53x_sim_data {
+  pn53x_type type;
+  struct pn53x_sim_card cards[PN53X_SIM_MAX_CARDS];
+  size_t szCards;
+  // Latencies in µs
+  uint32_t uiLatency;
+  uint32_t uiRfLatency;
+  // Time the cards leave the field and stay away, in ms after ui64Opened
+  uint32_t uiLeave;
+  uint32_t uiBack;
+  uint64_t ui64Opened;
+  bool bAway;
+  // Deselected ISO14443-A cards are left idle
+  bool bNoHalt;
+  uint8_t *abtRegisters;
+  uint8_t btParameters;
+  bool bField;
+  uint8_t abtFifo[PN53X_SIM_FIFO_LEN];
+  size_t szFifo;
+  size_t szFifoPos;
+  // InDataExchange frame chained by the host
+  uint8_t abtChained[PN53X_SIM_CARD_BUFFER_LEN];
+  size_t szChained;
+  // InDataExchange answer chained to the host
+  uint8_t abtPending[PN53X_SIM_CARD_BUFFER_LEN];
+  size_t szPending;
+  size_t szPendingPos;
+  // Chip output: ACK frame then answer frame
+  uint8_t abtOutput[PN53x_ACK_FRAME__LEN + PN53x_EXTENDED_FRAME__DATA_MAX_LEN + PN53x_EXTENDED_FRAME__OVERHEAD];
+  size_t szOutput;
+  size_t szOutputPos;
+  uint64_t ui64ReadyAt;
+#ifdef __linux__
+  // Readable once the answer is ready
+  int iReadyFd;
+#endif
+  nfc_mutex mutex;
+  nfc_cond cond;
+  bool bAbort;
+};
+
+#define DRIVER_DATA(pnd) ((struct pn53x_sim_data*)(pnd->driver_data))
+
+const struct pn53x_io pn53x_sim_io;
+
+static void
+pn53x_sim_usleep(const uint64_t ui64Delay)
+{
+#ifndef _WIN32
+  struct timespec ts;
+  ts.tv_sec = ui64Delay / 1000000;
+  ts.tv_nsec = (ui64Delay % 1000000) * 1000;
+  nanosleep(&ts, NULL);
+#else
+  Sleep((DWORD)((ui64Delay + 999) / 1000));
+#endif
+}
+
+static uint8_t
+pn53x_sim_odd_parity(uint8_t bt)
+{
+  bt ^= bt >> 4;
+  bt ^= bt >> 2;
+  bt ^= bt >> 1;
+  return !(bt & 0x01);
+}
+
+static void
+pn53x_sim_card_init(struct pn53x_sim_card *pc, const pn53x_sim_card_type type, const uint8_t btIndex)
+{
+  memset(pc, 0x00, sizeof(*pc));
+  pc->type = type;
+  pc->state = PN53X_SIM_IDLE;
+  pc->iAuthSector = -1;
+
+  switch (type) {
+    case PN53X_SIM_MIFARE_CLASSIC: {
+      const uint8_t abtUid[] = { 0x4d, 0x46, 0x43, btIndex };
+      memcpy(pc->abtId, abtUid, sizeof(abtUid));
+      pc->szIdLen = sizeof(abtUid);
+      pc->abtAtqa[1] = 0x04;
+      pc->btSak = 0x08;
+      // Manufacturer block: UID, BCC, SAK and ATQA
+      memcpy(pc->abtMemory, abtUid, sizeof(abtUid));
+      pc->abtMemory[4] = abtUid[0] ^ abtUid[1] ^ abtUid[2] ^ abtUid[3];
+      pc->abtMemory[5] = pc->btSak;
+      pc->abtMemory[6] = pc->abtAtqa[1];
+      pc->abtMemory[7] = pc->abtAtqa[0];
+      // Sector trailers: transport keys and access conditions
+      const uint8_t abtTrailer[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x07, 0x80, 0x69, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+      for (size_t n = 0; n < 16; n++)
+        memcpy(pc->abtMemory + (n * 4 + 3) * 16, abtTrailer, sizeof(abtTrailer));
+    }
+    break;
+    case PN53X_SIM_MIFARE_ULTRALIGHT: {
+      const uint8_t abtUid[] = { 0x04, 0x55, 0x4c, 0x00, 0x00, 0x00, btIndex };
+      memcpy(pc->abtId, abtUid, sizeof(abtUid));
+      pc->szIdLen = sizeof(abtUid);
+      pc->abtAtqa[1] = 0x44;
+      pc->btSak = 0x00;
+      // Pages 0 to 2: UID and its check bytes, internal byte, lock bytes
+      memcpy(pc->abtMemory, abtUid, 3);
+      pc->abtMemory[3] = 0x88 ^ abtUid[0] ^ abtUid[1] ^ abtUid[2];
+      memcpy(pc->abtMemory + 4, abtUid + 3, 4);
+      pc->abtMemory[8] = abtUid[3] ^ abtUid[4] ^ abtUid[5] ^ abtUid[6];
+      pc->abtMemory[9] = 0x48;
+    }
+    break;
+    case PN53X_SIM_ISO14443_4: {
+      const uint8_t abtUid[] = { 0x04, 0x49, 0x53, 0x4f, 0x00, 0x00, btIndex };
+      memcpy(pc->abtId, abtUid, sizeof(abtUid));
+      pc->szIdLen = sizeof(abtUid);
+      pc->abtAtqa[0] = 0x03;
+      pc->abtAtqa[1] = 0x44;
+      pc->btSak = 0x20;
+    }
+    break;
+    case PN53X_SIM_FELICA: {
+      const uint8_t abtIdm[] = { 0x01, 0x2e, 0x46, 0x43, 0x00, 0x00, 0x00, btIndex };
+      const uint8_t abtPmm[] = { 0x03, 0x01, 0x4b, 0x02, 0x4f, 0x49, 0x93, 0xff };
+      memcpy(pc->abtId, abtIdm, sizeof(abtIdm));
+      pc->szIdLen = sizeof(abtIdm);
+      memcpy(pc->abtPmm, abtPmm, sizeof(abtPmm));
+    }
+    break;
+    case PN53X_SIM_DEP: {
+      // Random UID, as NFC-DEP targets have
+      const uint8_t abtUid[] = { 0x08, 0x44, 0x45, btIndex };
+      memcpy(pc->abtId, abtUid, sizeof(abtUid));
+      pc->szIdLen = sizeof(abtUid);
+      pc->abtAtqa[1] = 0x04;
+      pc->btSak = 0x40;
+    }
+    break;
+  }
+}
+
+// ATS sent by ISO14443-4 cards: FSCI 256 bytes, TA, TB, TC and an historical byte
+static const uint8_t pn53x_sim_ats[] = { 0x06, 0x78, 0x77, 0x81, 0x02, 0x80 };
+// FeliCa system code
+static const uint8_t pn53x_sim_system_code[] = { 0x88, 0xb4 };
+
+static bool
+pn53x_sim_card_is_iso14443a(const struct pn53x_sim_card *pc)
+{
+  return pc->type != PN53X_SIM_FELICA;
+}
+
+static void
+pn53x_sim_card_reset(struct pn53x_sim_card *pc, const pn53x_sim_card_state state)
+{
+  pc->state = state;
+  pc->btTg = 0;
+  pc->iAuthSector = -1;
+  pc->bIsoDep = false;
+}
+
+static struct pn53x_sim_card *
+pn53x_sim_target(struct pn53x_sim_data *sim, const uint8_t btTg)
+{
+  for (size_t n = 0; n < sim->szCards; n++) {
+    if ((sim->cards[n].state == PN53X_SIM_ACTIVE) && (sim->cards[n].btTg == btTg))
+      return &sim->cards[n];
+  }
+  return NULL;
+}
+
+// Previous targets are forgotten by the chip when looking for new ones
+static void
+pn53x_sim_release_targets(struct pn53x_sim_data *sim)
+{
+  for (size_t n = 0; n < sim->szCards; n++) {
+    if ((sim->cards[n].state == PN53X_SIM_ACTIVE) || (sim->cards[n].state == PN53X_SIM_READY))
+      pn53x_sim_card_reset(&sim->cards[n], PN53X_SIM_IDLE);
+  }
+}
+
+static bool
+pn53x_sim_felica_system_code_match(const uint8_t *pbtSystemCode)
+{
+  // 0xff is a wildcard
+  return ((pbtSystemCode[0] == 0xff) || (pbtSystemCode[0] == pn53x_sim_system_code[0])) &&
+         ((pbtSystemCode[1] == 0xff) || (pbtSystemCode[1] == pn53x_sim_system_code[1]));
+}
+
+/*
+ * MIFARE Classic 1K, with InDataExchange the chip runs Crypto1: commands are
+ * seen in clear.
+ */
+static int
+pn53x_sim_mifare_classic(struct pn53x_sim_card *pc, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if ((szTx < 2) || (pbtTx[1] >= 64))
+    return -ETIMEOUT;
+  const uint8_t btBlock = pbtTx[1];
+  const int iSector = btBlock / 4;
+
+  switch (pbtTx[0]) {
+    case 0x60: // Authenticate with key A
+    case 0x61: { // Authenticate with key B
+      if (szTx < 12)
+        return -ETIMEOUT;
+      const uint8_t *pbtTrailer = pc->abtMemory + (iSector * 4 + 3) * 16;
+      const uint8_t *pbtKey = pbtTrailer + ((pbtTx[0] == 0x60) ? 0 : 10);
+      if (memcmp(pbtKey, pbtTx + 2, 6) || memcmp(pc->abtId, pbtTx + 8, 4)) {
+        // Card goes to HALT on authentication failure
+        pn53x_sim_card_reset(pc, PN53X_SIM_HALT);
+        return -EMFAUTH;
+      }
+      pc->iAuthSector = iSector;
+      return 0;
+    }
+    case 0x30: // Read
+      if (pc->iAuthSector != iSector)
+        return -ETIMEOUT;
+      memcpy(pbtRx, pc->abtMemory + btBlock * 16, 16);
+      // Key A of sector trailers is never read back
+      if ((btBlock % 4) == 3)
+        memset(pbtRx, 0x00, 6);
+      return 16;
+    case 0xa0: // Write
+      // Manufacturer block is read-only
+      if ((szTx < 18) || (pc->iAuthSector != iSector) || (btBlock == 0))
+        return -ETIMEOUT;
+      memcpy(pc->abtMemory + btBlock * 16, pbtTx + 2, 16);
+      return 0;
+  }
+  return -ETIMEOUT;
+}
+
+// MIFARE Ultralight, 16 pages of 4 bytes
+static int
+pn53x_sim_mifare_ultralight(struct pn53x_sim_card *pc, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if ((szTx < 2) || (pbtTx[1] >= 16))
+    return -ETIMEOUT;
+  const uint8_t btPage = pbtTx[1];
+
+  switch (pbtTx[0]) {
+    case 0x30: // Read four pages, rolling over to page 0
+      for (size_t n = 0; n < 16; n++)
+        pbtRx[n] = pc->abtMemory[(btPage * 4 + n) % 64];
+      return 16;
+    case 0xa2: // Write
+    case 0xa0: // Compatibility write, only the first four bytes are written
+      if ((szTx < ((pbtTx[0] == 0xa2) ? 6 : 18)) || (btPage < 3))
+        return -ETIMEOUT;
+      for (size_t n = 0; n < 4; n++) {
+        // One Time Programmable bits can only be set
+        if (btPage == 3)
+          pc->abtMemory[btPage * 4 + n] |= pbtTx[2 + n];
+        else
+          pc->abtMemory[btPage * 4 + n] = pbtTx[2 + n];
+      }
+      return 0;
+  }
+  return -ETIMEOUT;
+}
+
+// ISO14443-4 card, once activated APDUs are echoed followed by 90 00
+static int
+pn53x_sim_iso14443_4(struct pn53x_sim_card *pc, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if (!pc->bIsoDep) {
+    // RATS
+    if ((szTx < 2) || (pbtTx[0] != 0xe0))
+      return -ETIMEOUT;
+    pc->bIsoDep = true;
+    memcpy(pbtRx, pn53x_sim_ats, sizeof(pn53x_sim_ats));
+    return sizeof(pn53x_sim_ats);
+  }
+  if (szTx + 2 > PN53X_SIM_CARD_BUFFER_LEN)
+    return -EINBUFOVF;
+  memcpy(pbtRx, pbtTx, szTx);
+  pbtRx[szTx] = 0x90;
+  pbtRx[szTx + 1] = 0x00;
+  return szTx + 2;
+}
+
+// FeliCa card with a single service of 16 blocks, frames start with their length
+static int
+pn53x_sim_felica(struct pn53x_sim_card *pc, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if ((szTx < 2) || (pbtTx[0] != szTx))
+    return -ETIMEOUT;
+
+  if (pbtTx[1] == 0x00) {
+    // Polling
+    if ((szTx < 6) || !pn53x_sim_felica_system_code_match(pbtTx + 2))
+      return -ETIMEOUT;
+    size_t szRx = 2;
+    pbtRx[1] = 0x01;
+    memcpy(pbtRx + szRx, pc->abtId, 8);
+    szRx += 8;
+    memcpy(pbtRx + szRx, pc->abtPmm, 8);
+    szRx += 8;
+    if (pbtTx[4] == 0x01) {
+      memcpy(pbtRx + szRx, pn53x_sim_system_code, sizeof(pn53x_sim_system_code));
+      szRx += sizeof(pn53x_sim_system_code);
+    }
+    pbtRx[0] = szRx;
+    return szRx;
+  }
+
+  // Other commands are addressed to an IDm
+  if ((szTx < 10) || memcmp(pbtTx + 2, pc->abtId, 8))
+    return -ETIMEOUT;
+  memcpy(pbtRx + 2, pc->abtId, 8);
+  pbtRx[1] = pbtTx[1] + 1;
+
+  switch (pbtTx[1]) {
+    case 0x04: // Request Response: mode 0
+      pbtRx[10] = 0x00;
+      pbtRx[0] = 11;
+      return 11;
+    case 0x06: // Read Without Encryption
+    case 0x08: { // Write Without Encryption
+      if (szTx < 11)
+        return -ETIMEOUT;
+      size_t szPos = 11 + 2 * pbtTx[10];
+      if (szPos >= szTx)
+        return -ETIMEOUT;
+      const uint8_t btBlocks = pbtTx[szPos++];
+      uint8_t abtBlocks[15];
+      bool bValid = (btBlocks > 0) && (btBlocks <= sizeof(abtBlocks));
+      for (size_t n = 0; bValid && (n < btBlocks); n++) {
+        // Block list element: two bytes long if its first bit is set, three otherwise
+        const size_t szElement = (pbtTx[szPos] & 0x80) ? 2 : 3;
+        if (szPos + szElement > szTx)
+          return -ETIMEOUT;
+        const unsigned int uiBlock = (szElement == 2) ? pbtTx[szPos + 1] : (pbtTx[szPos + 1] | (pbtTx[szPos + 2] << 8));
+        bValid = uiBlock < 16;
+        abtBlocks[n] = uiBlock;
+        szPos += szElement;
+      }
+      if (bValid && (pbtTx[1] == 0x08) && (szPos + btBlocks * 16 > szTx))
+        return -ETIMEOUT;
+      // Status flags
+      pbtRx[10] = bValid ? 0x00 : 0x01;
+      pbtRx[11] = bValid ? 0x00 : 0xa8;
+      size_t szRx = 12;
+      if (bValid && (pbtTx[1] == 0x06)) {
+        pbtRx[szRx++] = btBlocks;
+        for (size_t n = 0; n < btBlocks; n++) {
+          memcpy(pbtRx + szRx, pc->abtMemory + abtBlocks[n] * 16, 16);
+          szRx += 16;
+        }
+      } else if (bValid) {
+        for (size_t n = 0; n < btBlocks; n++)
+          memcpy(pc->abtMemory + abtBlocks[n] * 16, pbtTx + szPos + n * 16, 16);
+      }
+      pbtRx[0] = szRx;
+      return szRx;
+    }
+  }
+  return -ETIMEOUT;
+}
+
+/*
+ * Exchange a frame with a card as InDataExchange does, i.e. CRC, ISO14443-4
+ * blocks and MIFARE Classic Crypto1 handled by the chip. Returns the answer
+ * length or a negative PN53x status.
+ */
+static int
+pn53x_sim_card_exchange(struct pn53x_sim_card *pc, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx)
+{
+  if (!szTx)
+    return -ETIMEOUT;
+  switch (pc->type) {
+    case PN53X_SIM_MIFARE_CLASSIC:
+      return pn53x_sim_mifare_classic(pc, pbtTx, szTx, pbtRx);
+    case PN53X_SIM_MIFARE_ULTRALIGHT:
+      return pn53x_sim_mifare_ultralight(pc, pbtTx, szTx, pbtRx);
+    case PN53X_SIM_ISO14443_4:
+      return pn53x_sim_iso14443_4(pc, pbtTx, szTx, pbtRx);
+    case PN53X_SIM_FELICA:
+      return pn53x_sim_felica(pc, pbtTx, szTx, pbtRx);
+    case PN53X_SIM_DEP:
+      memcpy(pbtRx, pbtTx, szTx);
+      return szTx;
+  }
+  return -ETIMEOUT;
+}
+
+// UID bytes of a cascade level, followed by their BCC
+static void
+pn53x_sim_cascade_level(const struct pn53x_sim_card *pc, const uint8_t btLevel, uint8_t *pbtRx)
+{
+  uint8_t abtCascaded[12];
+  size_t szCascaded;
+  iso14443_cascade_uid(pc->abtId, pc->szIdLen, abtCascaded, &szCascaded);
+  memcpy(pbtRx, abtCascaded + (btLevel - 1) * 4, 4);
+  pbtRx[4] = pbtRx[0] ^ pbtRx[1] ^ pbtRx[2] ^ pbtRx[3];
+}
+
+/*
+ * Exchange a raw ISO14443-A frame, as InCommunicateThru does, without parity
+ * nor CRC. Returns the answer length in bits or a negative PN53x status;
+ * *pbCrc tells whether the answer should be followed by a CRC.
+ */
+static int
+pn53x_sim_raw_exchange(struct pn53x_sim_data *sim, const uint8_t *pbtTx, const size_t szTxBits, uint8_t *pbtRx, bool *pbCrc)
+{
+  const size_t szTx = szTxBits / 8;
+  struct pn53x_sim_card *pc = NULL;
+  *pbCrc = false;
+
+  if ((szTxBits == 7) && ((pbtTx[0] == 0x26) || (pbtTx[0] == 0x52))) {
+    // REQA wakes up IDLE cards, WUPA HALT ones as well
+    for (size_t n = 0; n < sim->szCards; n++) {
+      struct pn53x_sim_card *pcn = &sim->cards[n];
+      if (pn53x_sim_card_is_iso14443a(pcn) && ((pcn->state == PN53X_SIM_IDLE) || ((pcn->state == PN53X_SIM_HALT) && (pbtTx[0] == 0x52)))) {
+        pn53x_sim_card_reset(pcn, PN53X_SIM_READY);
+        pcn->btLevel = 1;
+        if (!pc)
+          pc = pcn;
+      }
+    }
+    if (!pc)
+      return -ETIMEOUT;
+    // ATQA, LSB first
+    pbtRx[0] = pc->abtAtqa[1];
+    pbtRx[1] = pc->abtAtqa[0];
+    return 16;
+  }
+  if (szTxBits % 8)
+    return -ETIMEOUT;
+
+  if ((szTx >= 2) && ((pbtTx[0] == 0x93) || (pbtTx[0] == 0x95) || (pbtTx[0] == 0x97))) {
+    // Anticollision or select, the first ready card wins
+    const uint8_t btLevel = ((pbtTx[0] - 0x93) / 2) + 1;
+    for (size_t n = 0; (n < sim->szCards) && !pc; n++) {
+      if ((sim->cards[n].state == PN53X_SIM_READY) && (sim->cards[n].btLevel == btLevel))
+        pc = &sim->cards[n];
+    }
+    if (!pc)
+      return -ETIMEOUT;
+    uint8_t abtLevel[5];
+    pn53x_sim_cascade_level(pc, btLevel, abtLevel);
+    if ((szTx == 2) && (pbtTx[1] == 0x20)) {
+      memcpy(pbtRx, abtLevel, sizeof(abtLevel));
+      return 40;
+    }
+    if ((szTx != 7) || (pbtTx[1] != 0x70) || memcmp(pbtTx + 2, abtLevel, sizeof(abtLevel)))
+      return -ETIMEOUT;
+    if (abtLevel[0] == 0x88) {
+      // Cascade tag: UID not complete
+      pc->btLevel++;
+      pbtRx[0] = 0x04;
+    } else {
+      for (size_t n = 0; n < sim->szCards; n++) {
+        if (sim->cards[n].state == PN53X_SIM_READY)
+          pn53x_sim_card_reset(&sim->cards[n], PN53X_SIM_IDLE);
+      }
+      pc->state = PN53X_SIM_ACTIVE;
+      pc->btTg = 1;
+      pbtRx[0] = pc->btSak;
+    }
+    *pbCrc = true;
+    return 8;
+  }
+
+  for (size_t n = 0; (n < sim->szCards) && !pc; n++) {
+    if (sim->cards[n].state == PN53X_SIM_ACTIVE)
+      pc = &sim->cards[n];
+  }
+  if (!pc)
+    return -ETIMEOUT;
+
+  if (pc->type == PN53X_SIM_FELICA) {
+    // CRC of FeliCa frames is always handled by the chip
+    const int res = pn53x_sim_card_exchange(pc, pbtTx, szTx, pbtRx);
+    return (res < 0) ? res : res * 8;
+  }
+  if ((szTx == 2) && (pbtTx[0] == 0x50) && (pbtTx[1] == 0x00)) {
+    // HLTA, never answered
+    pn53x_sim_card_reset(pc, PN53X_SIM_HALT);
+    return -ETIMEOUT;
+  }
+  *pbCrc = true;
+  if ((pc->type == PN53X_SIM_ISO14443_4) && pc->bIsoDep) {
+    const uint8_t btPcb = pbtTx[0];
+    if ((btPcb & 0xe2) == 0x02) {
+      // I-block, echoed after its PCB and optional CID and NAD
+      const size_t szHeader = 1 + ((btPcb & 0x08) ? 1 : 0) + ((btPcb & 0x04) ? 1 : 0);
+      if (szTx < szHeader)
+        return -ETIMEOUT;
+      memcpy(pbtRx, pbtTx, szHeader);
+      // Chaining is not acknowledged, the frame is answered as a whole
+      pbtRx[0] &= ~0x10;
+      const int res = pn53x_sim_iso14443_4(pc, pbtTx + szHeader, szTx - szHeader, pbtRx + szHeader);
+      return (res < 0) ? res : (int)(szHeader + res) * 8;
+    }
+    if ((btPcb & 0xf6) == 0xb2) {
+      // R(NAK) is answered with R(ACK)
+      pbtRx[0] = 0xa2 | (btPcb & 0x01);
+      return 8;
+    }
+    if ((btPcb & 0xf7) == 0xc2) {
+      // S(DESELECT)
+      memcpy(pbtRx, pbtTx, szTx);
+      pn53x_sim_card_reset(pc, PN53X_SIM_HALT);
+      return szTx * 8;
+    }
+    return -ETIMEOUT;
+  }
+  if ((pc->type == PN53X_SIM_MIFARE_CLASSIC) && ((pbtTx[0] == 0x60) || (pbtTx[0] == 0x61))) {
+    // Crypto1 is not emulated
+    return -ETIMEOUT;
+  }
+  const int res = pn53x_sim_card_exchange(pc, pbtTx, szTx, pbtRx);
+  if (res < 0)
+    return res;
+  if (res == 0) {
+    // 4-bit ACK
+    *pbCrc = false;
+    pbtRx[0] = 0x0a;
+    return 4;
+  }
+  return res * 8;
+}
+
+/*
+ * Raw exchange as configured by CIU registers: CRC is added and checked by
+ * the chip if enabled in TxMode and RxMode, and answer last bits are set in
+ * Control.
+ */
+static int
+pn53x_sim_transceive_bits(struct pn53x_sim_data *sim, const uint8_t *pbtTx, size_t szTxBits, uint8_t *pbtRx)
+{
+  uint8_t *abtRegisters = sim->abtRegisters;
+  // Strip the CRC computed by the host
+  if (!(abtRegisters[PN53X_REG_CIU_TxMode] & SYMBOL_TX_CRC_ENABLE) && !(szTxBits % 8) &&
+      (szTxBits >= 24) && iso14443a_crc_check(pbtTx, szTxBits / 8))
+    szTxBits -= 16;
+
+  bool bCrc;
+  int res = pn53x_sim_raw_exchange(sim, pbtTx, szTxBits, pbtRx, &bCrc);
+  if (res < 0)
+    return res;
+  if (bCrc && !(abtRegisters[PN53X_REG_CIU_RxMode] & SYMBOL_RX_CRC_ENABLE)) {
+    iso14443a_crc_append(pbtRx, res / 8);
+    res += 16;
+  }
+  abtRegisters[PN53X_REG_CIU_Control] = (abtRegisters[PN53X_REG_CIU_Control] & ~SYMBOL_RX_LAST_BITS) | (res % 8);
+  return res;
+}
+
+// Transceive command written to CIU registers, from and to the FIFO
+static void
+pn53x_sim_fifo_transceive(struct pn53x_sim_data *sim)
+{
+  const uint8_t btTxBits = sim->abtRegisters[PN53X_REG_CIU_BitFraming] & SYMBOL_TX_LAST_BITS;
+  if (!sim->szFifo)
+    return;
+  uint8_t abtTx[PN53X_SIM_FIFO_LEN];
+  uint8_t abtRx[PN53X_SIM_CARD_BUFFER_LEN];
+  const size_t szTx = sim->szFifo;
+  memcpy(abtTx, sim->abtFifo, szTx);
+  const int res = pn53x_sim_transceive_bits(sim, abtTx, btTxBits ? ((szTx - 1) * 8 + btTxBits) : szTx * 8, abtRx);
+  sim->szFifo = (res > 0) ? MIN((size_t)(res + 7) / 8, sizeof(sim->abtFifo)) : 0;
+  sim->szFifoPos = 0;
+  memcpy(sim->abtFifo, abtRx, sim->szFifo);
+}
+
+static uint8_t
+pn53x_sim_read_register(struct pn53x_sim_data *sim, const uint16_t ui16Address)
+{
+  switch (ui16Address) {
+    case PN53X_REG_CIU_FIFOData:
+      return (sim->szFifoPos < sim->szFifo) ? sim->abtFifo[sim->szFifoPos++] : 0x00;
+    case PN53X_REG_CIU_FIFOLevel:
+      return sim->szFifo - sim->szFifoPos;
+  }
+  return sim->abtRegisters[ui16Address];
+}
+
+static void
+pn53x_sim_write_register(struct pn53x_sim_data *sim, const uint16_t ui16Address, const uint8_t ui8Value)
+{
+  switch (ui16Address) {
+    case PN53X_REG_CIU_FIFOData:
+      if (sim->szFifoPos)
+        sim->szFifo = sim->szFifoPos = 0;
+      if (sim->szFifo < sizeof(sim->abtFifo))
+        sim->abtFifo[sim->szFifo++] = ui8Value;
+      return;
+    case PN53X_REG_CIU_FIFOLevel:
+      if (ui8Value & SYMBOL_FLUSH_BUFFER)
+        sim->szFifo = sim->szFifoPos = 0;
+      return;
+    case PN53X_REG_CIU_BitFraming:
+      sim->abtRegisters[ui16Address] = ui8Value & ~SYMBOL_START_SEND;
+      if ((ui8Value & SYMBOL_START_SEND) && ((sim->abtRegisters[PN53X_REG_CIU_Command] & SYMBOL_COMMAND) == SYMBOL_COMMAND_TRANSCEIVE))
+        pn53x_sim_fifo_transceive(sim);
+      return;
+  }
+  sim->abtRegisters[ui16Address] = ui8Value;
+}
+
+// InListPassiveTarget target data, from Tg
+static size_t
+pn53x_sim_target_data(const struct pn53x_sim_data *sim, struct pn53x_sim_card *pc, const uint8_t btTg, const uint8_t btRequestCode, uint8_t *pbtData)
+{
+  size_t sz = 0;
+  pbtData[sz++] = btTg;
+  if (pn53x_sim_card_is_iso14443a(pc)) {
+    memcpy(pbtData + sz, pc->abtAtqa, 2);
+    sz += 2;
+    pbtData[sz++] = pc->btSak;
+    pbtData[sz++] = pc->szIdLen;
+    memcpy(pbtData + sz, pc->abtId, pc->szIdLen);
+    sz += pc->szIdLen;
+    if ((pc->btSak & 0x20) && (sim->btParameters & PARAM_AUTO_RATS)) {
+      memcpy(pbtData + sz, pn53x_sim_ats, sizeof(pn53x_sim_ats));
+      sz += sizeof(pn53x_sim_ats);
+      pc->bIsoDep = true;
+    }
+  } else {
+    // POL_RES, starting with its length
+    const size_t szPolRes = (btRequestCode == 0x01) ? 20 : 18;
+    pbtData[sz++] = szPolRes;
+    pbtData[sz++] = 0x01;
+    memcpy(pbtData + sz, pc->abtId, 8);
+    sz += 8;
+    memcpy(pbtData + sz, pc->abtPmm, 8);
+    sz += 8;
+    if (btRequestCode == 0x01) {
+      memcpy(pbtData + sz, pn53x_sim_system_code, sizeof(pn53x_sim_system_code));
+      sz += sizeof(pn53x_sim_system_code);
+    }
+  }
+  pc->state = PN53X_SIM_ACTIVE;
+  pc->btTg = btTg;
+  return sz;
+}
+
+static int
+pn53x_sim_InListPassiveTarget(struct pn53x_sim_data *sim, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtOut)
+{
+  if ((szParams < 2) || (pbtParams[0] == 0) || (pbtParams[0] > PN53X_SIM_MAX_TARGETS))
+    return -1;
+  const uint8_t btMaxTg = pbtParams[0];
+  const uint8_t btBrTy = pbtParams[1];
+  const uint8_t *pbtInitiatorData = pbtParams + 2;
+  const size_t szInitiatorData = szParams - 2;
+
+  sim->bField = true;
+  pn53x_sim_release_targets(sim);
+
+  uint8_t btNbTg = 0;
+  size_t szOut = 1;
+  for (size_t n = 0; (n < sim->szCards) && (btNbTg < btMaxTg); n++) {
+    struct pn53x_sim_card *pc = &sim->cards[n];
+    uint8_t btRequestCode = 0x00;
+    if (pc->state != PN53X_SIM_IDLE)
+      continue;
+    if (btBrTy == 0x00) {
+      if (!pn53x_sim_card_is_iso14443a(pc))
+        continue;
+      if (szInitiatorData) {
+        // Only the card with this (cascaded) UID
+        uint8_t abtCascaded[12];
+        size_t szCascaded;
+        iso14443_cascade_uid(pc->abtId, pc->szIdLen, abtCascaded, &szCascaded);
+        if ((szCascaded != szInitiatorData) || memcmp(abtCascaded, pbtInitiatorData, szCascaded))
+          continue;
+      }
+    } else if ((btBrTy == 0x01) || (btBrTy == 0x02)) {
+      if (pc->type != PN53X_SIM_FELICA)
+        continue;
+      // Polling payload: 00, system code, request code, time slot number
+      if (szInitiatorData >= 5) {
+        if (!pn53x_sim_felica_system_code_match(pbtInitiatorData + 1))
+          continue;
+        btRequestCode = pbtInitiatorData[3];
+      }
+    } else {
+      continue;
+    }
+    szOut += pn53x_sim_target_data(sim, pc, ++btNbTg, btRequestCode, pbtOut + szOut);
+  }
+  pbtOut[0] = btNbTg;
+  return szOut;
+}
+
+// Next chunk of a chained InDataExchange answer
+static int
+pn53x_sim_next_chunk(struct pn53x_sim_data *sim, uint8_t *pbtOut)
+{
+  const size_t szLeft = sim->szPending - sim->szPendingPos;
+  const size_t szChunk = MIN(szLeft, PN53X_SIM_CHUNK_LEN);
+  pbtOut[0] = (szLeft > szChunk) ? 0x40 : 0x00;
+  memcpy(pbtOut + 1, sim->abtPending + sim->szPendingPos, szChunk);
+  sim->szPendingPos += szChunk;
+  if (sim->szPendingPos == sim->szPending)
+    sim->szPending = sim->szPendingPos = 0;
+  return 1 + szChunk;
+}
+
+static int
+pn53x_sim_InDataExchange(struct pn53x_sim_data *sim, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtOut)
+{
+  if (szParams < 1)
+    return -1;
+  struct pn53x_sim_card *pc = pn53x_sim_target(sim, pbtParams[0] & 0x3f);
+  if (!pc) {
+    sim->szChained = sim->szPending = sim->szPendingPos = 0;
+    pbtOut[0] = ECMD;
+    return 1;
+  }
+  if ((szParams == 1) && sim->szPending)
+    return pn53x_sim_next_chunk(sim, pbtOut);
+  sim->szPending = sim->szPendingPos = 0;
+
+  // More Information bit: the host chains its frame
+  if (sim->szChained + szParams - 1 > sizeof(sim->abtChained)) {
+    sim->szChained = 0;
+    pbtOut[0] = EINBUFOVF;
+    return 1;
+  }
+  memcpy(sim->abtChained + sim->szChained, pbtParams + 1, szParams - 1);
+  sim->szChained += szParams - 1;
+  if (pbtParams[0] & 0x40) {
+    pbtOut[0] = 0x00;
+    return 1;
+  }
+  const int res = pn53x_sim_card_exchange(pc, sim->abtChained, sim->szChained, sim->abtPending);
+  sim->szChained = 0;
+  if (res < 0) {
+    pbtOut[0] = -res;
+    return 1;
+  }
+  sim->szPending = res;
+  return pn53x_sim_next_chunk(sim, pbtOut);
+}
+
+static int
+pn53x_sim_InCommunicateThru(struct pn53x_sim_data *sim, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtOut)
+{
+  const uint8_t btTxBits = sim->abtRegisters[PN53X_REG_CIU_BitFraming] & SYMBOL_TX_LAST_BITS;
+  const bool bParity = !(sim->abtRegisters[PN53X_REG_CIU_ManualRCV] & SYMBOL_PARITY_DISABLE);
+  uint8_t abtTx[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+  uint8_t abtRx[PN53X_SIM_CARD_BUFFER_LEN];
+  uint8_t abtRxPar[PN53X_SIM_CARD_BUFFER_LEN];
+  int res;
+
+  if (!szParams) {
+    pbtOut[0] = ETIMEOUT;
+    return 1;
+  }
+  size_t szTxBits = btTxBits ? ((szParams - 1) * 8 + btTxBits) : szParams * 8;
+  if (bParity) {
+    memcpy(abtTx, pbtParams, szParams);
+  } else {
+    // Host sent its own parity bits
+    if ((res = pn53x_unwrap_frame(pbtParams, szTxBits, abtTx, NULL)) < 0)
+      return -1;
+    szTxBits = res;
+  }
+  if ((res = pn53x_sim_transceive_bits(sim, abtTx, szTxBits, abtRx)) < 0) {
+    pbtOut[0] = -res;
+    return 1;
+  }
+  size_t szRxBits = res;
+  if (!bParity) {
+    for (size_t n = 0; n < (szRxBits + 7) / 8; n++)
+      abtRxPar[n] = pn53x_sim_odd_parity(abtRx[n]);
+    if (((szRxBits + szRxBits / 8 + 7) / 8) > PN53X_SIM_CHUNK_LEN) {
+      pbtOut[0] = EBUFOVF;
+      return 1;
+    }
+    szRxBits = pn53x_wrap_frame(abtRx, szRxBits, abtRxPar, pbtOut + 1);
+    sim->abtRegisters[PN53X_REG_CIU_Control] = (sim->abtRegisters[PN53X_REG_CIU_Control] & ~SYMBOL_RX_LAST_BITS) | (szRxBits % 8);
+  } else {
+    if ((szRxBits + 7) / 8 > PN53X_SIM_CHUNK_LEN) {
+      pbtOut[0] = EBUFOVF;
+      return 1;
+    }
+    memcpy(pbtOut + 1, abtRx, (szRxBits + 7) / 8);
+  }
+  pbtOut[0] = 0x00;
+  return 1 + (szRxBits + 7) / 8;
+}
+
+// Release targets: ISO14443-A ones are halted unless no-halt is set, FeliCa ones have no such state
+static int
+pn53x_sim_InRelease(struct pn53x_sim_data *sim, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtOut)
+{
+  if (szParams < 1)
+    return -1;
+  for (size_t n = 0; n < sim->szCards; n++) {
+    struct pn53x_sim_card *pc = &sim->cards[n];
+    if ((pc->state == PN53X_SIM_ACTIVE) && ((pbtParams[0] == 0) || (pbtParams[0] == pc->btTg)))
+      pn53x_sim_card_reset(pc, (pn53x_sim_card_is_iso14443a(pc) && !sim->bNoHalt) ? PN53X_SIM_HALT : PN53X_SIM_IDLE);
+  }
+  sim->szChained = sim->szPending = sim->szPendingPos = 0;
+  pbtOut[0] = 0x00;
+  return 1;
+}
+
+static int
+pn53x_sim_InJumpForDEP(struct pn53x_sim_data *sim, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtOut)
+{
+  // Active/passive mode, baud rate and optional fields do not change the model
+  (void) pbtParams;
+  if (szParams < 3)
+    return -1;
+  sim->bField = true;
+  pn53x_sim_release_targets(sim);
+  for (size_t n = 0; n < sim->szCards; n++) {
+    struct pn53x_sim_card *pc = &sim->cards[n];
+    if ((pc->type != PN53X_SIM_DEP) || (pc->state != PN53X_SIM_IDLE))
+      continue;
+    pc->state = PN53X_SIM_ACTIVE;
+    pc->btTg = 1;
+    // Status, Tg, then ATR_RES: NFCID3t, DIDt, BSt, BRt, TO and PPt (LRt 254 bytes, no Gt)
+    size_t szOut = 0;
+    pbtOut[szOut++] = 0x00;
+    pbtOut[szOut++] = pc->btTg;
+    const uint8_t abtNfcid3[] = { 0x01, 0xfe, 0x44, 0x45, 0x50, 0x00, 0x00, 0x00, 0x00, pc->abtId[3] };
+    memcpy(pbtOut + szOut, abtNfcid3, sizeof(abtNfcid3));
+    szOut += sizeof(abtNfcid3);
+    pbtOut[szOut++] = 0x00;
+    pbtOut[szOut++] = 0x00;
+    pbtOut[szOut++] = 0x00;
+    pbtOut[szOut++] = 0x0e;
+    pbtOut[szOut++] = 0x30;
+    return szOut;
+  }
+  pbtOut[0] = ETIMEOUT;
+  return 1;
+}
+
+static int
+pn53x_sim_InAutoPoll(struct pn53x_sim_data *sim, const uint8_t *pbtParams, const size_t szParams, uint8_t *pbtOut)
+{
+  if (szParams < 3)
+    return -1;
+  sim->bField = true;
+  pn53x_sim_release_targets(sim);
+  for (size_t i = 2; i < szParams; i++) {
+    const uint8_t btType = pbtParams[i];
+    for (size_t n = 0; n < sim->szCards; n++) {
+      struct pn53x_sim_card *pc = &sim->cards[n];
+      if (pc->state != PN53X_SIM_IDLE)
+        continue;
+      bool bMatch;
+      switch (btType) {
+        case PTT_GENERIC_PASSIVE_106:
+          bMatch = pn53x_sim_card_is_iso14443a(pc);
+          break;
+        case PTT_MIFARE:
+          bMatch = (pc->type == PN53X_SIM_MIFARE_CLASSIC) || (pc->type == PN53X_SIM_MIFARE_ULTRALIGHT);
+          break;
+        case PTT_ISO14443_4A_106:
+          bMatch = pc->type == PN53X_SIM_ISO14443_4;
+          break;
+        case PTT_FELICA_212:
+        case PTT_FELICA_424:
+          bMatch = pc->type == PN53X_SIM_FELICA;
+          break;
+        default:
+          bMatch = false;
+      }
+      if (!bMatch)
+        continue;
+      pbtOut[0] = 1;
+      pbtOut[1] = btType;
+      pbtOut[2] = pn53x_sim_target_data(sim, pc, 1, 0x00, pbtOut + 3);
+      return 3 + pbtOut[2];
+    }
+  }
+  pbtOut[0] = 0;
+  return 1;
+}
+
+static int
+pn53x_sim_GetGeneralStatus(struct pn53x_sim_data *sim, uint8_t *pbtOut)
+{
+  size_t szOut = 3;
+  pbtOut[0] = 0x00;
+  pbtOut[1] = sim->bField ? 0x01 : 0x00;
+  pbtOut[2] = 0;
+  for (size_t n = 0; n < sim->szCards; n++) {
+    const struct pn53x_sim_card *pc = &sim->cards[n];
+    if (pc->state != PN53X_SIM_ACTIVE)
+      continue;
+    pbtOut[2]++;
+    pbtOut[szOut++] = pc->btTg;
+    // BrRx, BrTx and modulation type
+    const uint8_t btBr = pn53x_sim_card_is_iso14443a(pc) ? 0x00 : 0x01;
+    pbtOut[szOut++] = btBr;
+    pbtOut[szOut++] = btBr;
+    pbtOut[szOut++] = pn53x_sim_card_is_iso14443a(pc) ? 0x00 : 0x10;
+  }
+  if (sim->type == PN532) {
+    // SAM status
+    pbtOut[szOut++] = 0x00;
+  }
+  return szOut;
+}
+
+/*
+ * Run a command, starting with its code. Its answer, after the answer code,
+ * is written to pbtOut and its length returned, or -1 when the chip answers
+ * with a syntax error frame.
+ */
+static int
+pn53x_sim_command(struct pn53x_sim_data *sim, const uint8_t *pbtCmd, const size_t szCmd, uint8_t *pbtOut, bool *pbRf)
+{
+  const uint8_t *pbtParams = pbtCmd + 1;
+  const size_t szParams = szCmd - 1;
+  *pbRf = false;
+
+  switch (pbtCmd[0]) {
+    case Diagnose:
+      if (szParams < 1)
+        return -1;
+      switch (pbtParams[0]) {
+        case 0x00: // Communication line test
+          if (szParams > PN53X_SIM_ANSWER_MAX_LEN)
+            return -1;
+          memcpy(pbtOut, pbtParams, szParams);
+          return szParams;
+        case 0x06: // Card presence
+          *pbRf = true;
+          pbtOut[0] = pn53x_sim_target(sim, 1) ? 0x00 : ETIMEOUT;
+          return 1;
+      }
+      pbtOut[0] = 0x00;
+      return 1;
+    case GetFirmwareVersion: {
+      const uint8_t abtPn532[] = { 0x32, 0x01, 0x06, 0x07 };
+      const uint8_t abtPn533[] = { 0x33, 0x02, 0x08, 0x07 };
+      memcpy(pbtOut, (sim->type == PN532) ? abtPn532 : abtPn533, 4);
+      return 4;
+    }
+    case GetGeneralStatus:
+      return pn53x_sim_GetGeneralStatus(sim, pbtOut);
+    case ReadRegister: {
+      if ((szParams < 2) || (szParams % 2) || (szParams / 2 > PN53X_SIM_CHUNK_LEN))
+        return -1;
+      size_t szOut = 0;
+      if (sim->type == PN533) {
+        // PN533 prepends its answer by a status byte
+        pbtOut[szOut++] = 0x00;
+      }
+      for (size_t n = 0; n < szParams; n += 2)
+        pbtOut[szOut++] = pn53x_sim_read_register(sim, (pbtParams[n] << 8) | pbtParams[n + 1]);
+      return szOut;
+    }
+    case WriteRegister:
+      if ((szParams < 3) || (szParams % 3))
+        return -1;
+      for (size_t n = 0; n < szParams; n += 3)
+        pn53x_sim_write_register(sim, (pbtParams[n] << 8) | pbtParams[n + 1], pbtParams[n + 2]);
+      if (sim->type == PN533) {
+        pbtOut[0] = 0x00;
+        return 1;
+      }
+      return 0;
+    case ReadGPIO:
+      pbtOut[0] = 0xff;
+      pbtOut[1] = 0xff;
+      pbtOut[2] = 0x00;
+      return 3;
+    case WriteGPIO:
+      return 0;
+    case SetParameters:
+      if (szParams < 1)
+        return -1;
+      sim->btParameters = pbtParams[0];
+      return 0;
+    case SetSerialBaudRate:
+    case SAMConfiguration:
+      return (sim->type == PN532) ? 0 : -1;
+    case PowerDown:
+      pbtOut[0] = 0x00;
+      return 1;
+    case RFConfiguration:
+      if (szParams < 2)
+        return -1;
+      if (pbtParams[0] == 0x01) {
+        sim->bField = pbtParams[1] & 0x01;
+        // Field off: all cards are reset
+        for (size_t n = 0; !sim->bField && (n < sim->szCards); n++)
+          pn53x_sim_card_reset(&sim->cards[n], PN53X_SIM_IDLE);
+      }
+      return 0;
+    case InListPassiveTarget:
+      *pbRf = true;
+      return pn53x_sim_InListPassiveTarget(sim, pbtParams, szParams, pbtOut);
+    case InDataExchange:
+      *pbRf = true;
+      return pn53x_sim_InDataExchange(sim, pbtParams, szParams, pbtOut);
+    case InCommunicateThru:
+      *pbRf = true;
+      return pn53x_sim_InCommunicateThru(sim, pbtParams, szParams, pbtOut);
+    case InDeselect:
+    case InRelease:
+      *pbRf = true;
+      return pn53x_sim_InRelease(sim, pbtParams, szParams, pbtOut);
+    case InSelect:
+    case InPSL:
+      if (szParams < 1)
+        return -1;
+      *pbRf = true;
+      pbtOut[0] = pn53x_sim_target(sim, pbtParams[0]) ? 0x00 : ECMD;
+      return 1;
+    case InJumpForDEP:
+    case InJumpForPSL:
+      *pbRf = true;
+      return pn53x_sim_InJumpForDEP(sim, pbtParams, szParams, pbtOut);
+    case InAutoPoll:
+      if (sim->type != PN532)
+        return -1;
+      *pbRf = true;
+      return pn53x_sim_InAutoPoll(sim, pbtParams, szParams, pbtOut);
+  }
+  // Target mode and other commands are not simulated
+  return -1;
+}
+
+// Tell whether the cards are away from the field; cards leaving it lose their power
+static bool
+pn53x_sim_cards_away(struct pn53x_sim_data *sim)
+{
+  if (!sim->uiLeave)
+    return false;
+  const uint64_t ui64Elapsed = (nfc_stats_now() - sim->ui64Opened) / 1000;
+  const bool bAway = (ui64Elapsed >= sim->uiLeave) && (!sim->uiBack || (ui64Elapsed < (uint64_t) sim->uiLeave + sim->uiBack));
+  if (bAway && !sim->bAway) {
+    for (size_t n = 0; n < sim->szCards; n++)
+      pn53x_sim_card_reset(&sim->cards[n], PN53X_SIM_IDLE);
+  }
+  sim->bAway = bAway;
+  return bAway;
+}
+
+/*
+ * Chip side of the host link: a valid frame is acknowledged and run, its
+ * answer frame is ready once the latency elapsed. Invalid frames are ignored.
+ */
+static void
+pn53x_sim_process_frame(struct pn53x_sim_data *sim, const uint8_t *pbtFrame, const size_t szFrame)
+{
+  const uint8_t pn53x_preamble[3] = { 0x00, 0x00, 0xff };
+  size_t szLen, szPos;
+
+  sim->szOutput = sim->szOutputPos = 0;
+  if ((szFrame < 9) || memcmp(pbtFrame, pn53x_preamble, 3))
+    return;
+  if ((pbtFrame[3] == 0xff) && (pbtFrame[4] == 0xff)) {
+    // Extended frame
+    if ((szFrame < 12) || ((pbtFrame[5] + pbtFrame[6] + pbtFrame[7]) & 0xff))
+      return;
+    szLen = (pbtFrame[5] << 8) | pbtFrame[6];
+    szPos = 8;
+  } else {
+    if ((pbtFrame[3] + pbtFrame[4]) & 0xff)
+      return;
+    szLen = pbtFrame[3];
+    szPos = 5;
+  }
+  if ((szLen < 2) || (szPos + szLen + 2 > szFrame) || (pbtFrame[szPos] != 0xd4))
+    return;
+  uint8_t btDCS = 0;
+  for (size_t n = szPos; n <= szPos + szLen; n++)
+    btDCS += pbtFrame[n];
+  if (btDCS || (pbtFrame[szPos + szLen + 1] != 0x00))
+    return;
+
+  memcpy(sim->abtOutput, pn53x_ack_frame, PN53x_ACK_FRAME__LEN);
+  sim->szOutput = PN53x_ACK_FRAME__LEN;
+
+  uint8_t abtAnswer[1 + PN53X_SIM_ANSWER_MAX_LEN];
+  bool bRf;
+  // Cards away are hidden from the command
+  const size_t szCards = sim->szCards;
+  if (pn53x_sim_cards_away(sim))
+    sim->szCards = 0;
+  const int res = pn53x_sim_command(sim, pbtFrame + szPos + 1, szLen - 1, abtAnswer + 1, &bRf);
+  sim->szCards = szCards;
+  sim->ui64ReadyAt = nfc_stats_now() + sim->uiLatency + (bRf ? sim->uiRfLatency : 0);
+
+  uint8_t *pbt = sim->abtOutput + sim->szOutput;
+  if (res < 0) {
+    // Syntax error frame
+    const uint8_t abtErrorFrame[] = { 0x00, 0x00, 0xff, 0x01, 0xff, 0x7f, 0x81, 0x00 };
+    memcpy(pbt, abtErrorFrame, sizeof(abtErrorFrame));
+    sim->szOutput += sizeof(abtErrorFrame);
+    return;
+  }
+  abtAnswer[0] = pbtFrame[szPos + 1] + 1;
+  const size_t szAnswer = res + 1;
+  *pbt++ = 0x00;
+  *pbt++ = 0x00;
+  *pbt++ = 0xff;
+  if (szAnswer <= PN53x_NORMAL_FRAME__DATA_MAX_LEN) {
+    *pbt++ = szAnswer + 1;
+    *pbt++ = 256 - (szAnswer + 1);
+  } else {
+    *pbt++ = 0xff;
+    *pbt++ = 0xff;
+    *pbt++ = (szAnswer + 1) >> 8;
+    *pbt++ = (szAnswer + 1) & 0xff;
+    *pbt++ = 256 - ((((szAnswer + 1) >> 8) + ((szAnswer + 1) & 0xff)) & 0xff);
+  }
+  btDCS = 256 - 0xd5;
+  *pbt++ = 0xd5;
+  for (size_t n = 0; n < szAnswer; n++) {
+    *pbt++ = abtAnswer[n];
+    btDCS -= abtAnswer[n];
+  }
+  *pbt++ = btDCS;
+  *pbt++ = 0x00;
+  sim->szOutput = pbt - sim->abtOutput;
+}
+
+#ifdef __linux__
+// Arm the ready timerfd at ui64At (nfc_stats_now() time, i.e. CLOCK_MONOTONIC), or disarm it with UINT64_MAX
+static void
+pn53x_sim_set_ready_timer(struct pn53x_sim_data *sim, const uint64_t ui64At)
+{
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  if (ui64At != UINT64_MAX) {
+    its.it_value.tv_sec = ui64At / 1000000;
+    its.it_value.tv_nsec = (ui64At % 1000000) * 1000;
+  }
+  if (timerfd_settime(sim->iReadyFd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to set the ready timer");
+}
+#endif
+
+static int
+pn53x_sim_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  struct pn53x_sim_data *sim = DRIVER_DATA(pnd);
+  uint8_t *abtFrame;
+  size_t szFrame = 0;
+  int res;
+  (void) timeout;
+
+  if ((res = pn53x_build_frame_in_place(pbtData, szData, &abtFrame, &szFrame)) < 0) {
+    pnd->last_error = res;
+    return pnd->last_error;
+  }
+  nfc_stats_frame_sent(pnd, szData);
+
+  nfc_mutex_lock(&sim->mutex);
+  sim->bAbort = false;
+  nfc_mutex_unlock(&sim->mutex);
+  pn53x_sim_process_frame(sim, abtFrame, szFrame);
+
+  if (sim->szOutput < PN53x_ACK_FRAME__LEN) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", "Unable to read ACK");
+    pnd->last_error = NFC_ETIMEOUT;
+    return pnd->last_error;
+  }
+  sim->szOutputPos = PN53x_ACK_FRAME__LEN;
+  if (pn53x_check_ack_frame(pnd, sim->abtOutput, PN53x_ACK_FRAME__LEN) < 0)
+    return pnd->last_error;
+#ifdef __linux__
+  if (sim->szOutput > sim->szOutputPos)
+    pn53x_sim_set_ready_timer(sim, sim->ui64ReadyAt);
+#endif
+  return NFC_SUCCESS;
+}
+
+// Wait for the answer to be ready, or the timeout (ms, 0 for none) or an abort
+static int
+pn53x_sim_wait(struct pn53x_sim_data *sim, const int timeout)
+{
+  const uint64_t ui64Deadline = (timeout > 0) ? nfc_stats_now() + (uint64_t) timeout * 1000 : UINT64_MAX;
+  const bool bPending = sim->szOutput > sim->szOutputPos;
+  const uint64_t ui64Until = bPending ? MIN(sim->ui64ReadyAt, ui64Deadline) : ui64Deadline;
+  int res;
+
+  nfc_mutex_lock(&sim->mutex);
+  for (;;) {
+    if (sim->bAbort) {
+      sim->bAbort = false;
+      res = NFC_EOPABORTED;
+      break;
+    }
+    const uint64_t ui64Now = nfc_stats_now();
+    if (ui64Now >= ui64Until) {
+      res = (bPending && (sim->ui64ReadyAt <= ui64Deadline)) ? NFC_SUCCESS : NFC_ETIMEOUT;
+      break;
+    }
+    const uint64_t ui64Wait = ui64Until - ui64Now;
+    if (ui64Wait >= 1000) {
+      // Without deadline, wait for an abort only
+      nfc_cond_wait(&sim->cond, &sim->mutex, (ui64Wait / 1000 > INT_MAX) ? 0 : (int)(ui64Wait / 1000));
+    } else {
+      nfc_mutex_unlock(&sim->mutex);
+      pn53x_sim_usleep(ui64Wait);
+      nfc_mutex_lock(&sim->mutex);
+    }
+  }
+  nfc_mutex_unlock(&sim->mutex);
+  return res;
+}
+
+static int
+pn53x_sim_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, int timeout)
+{
+  struct pn53x_sim_data *sim = DRIVER_DATA(pnd);
+  size_t len;
+
+  pnd->last_error = pn53x_sim_wait(sim, timeout);
+#ifdef __linux__
+  pn53x_sim_set_ready_timer(sim, UINT64_MAX);
+#endif
+  if (pnd->last_error < 0) {
+    // Late answer is dropped
+    sim->szOutput = sim->szOutputPos = 0;
+    return pnd->last_error;
+  }
+  const uint8_t *pbtFrame = sim->abtOutput + sim->szOutputPos;
+  const size_t szFrame = sim->szOutput - sim->szOutputPos;
+  sim->szOutput = sim->szOutputPos = 0;
+
+  const uint8_t pn53x_preamble[3] = { 0x00, 0x00, 0xff };
+  if ((szFrame < 5) || memcmp(pbtFrame, pn53x_preamble, 3)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Frame preamble+start code mismatch");
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  if ((0x01 == pbtFrame[3]) && (0xff == pbtFrame[4])) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Application level error detected");
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  if ((0xff == pbtFrame[3]) && (0xff == pbtFrame[4])) {
+    // Extended frame, LEN include TFI + (CC+1)
+    len = (pbtFrame[5] << 8) + pbtFrame[6] - 2;
+    pbtFrame += 8;
+  } else {
+    // Normal frame, LEN include TFI + (CC+1)
+    len = pbtFrame[3] - 2;
+    pbtFrame += 5;
+  }
+  if (len > szDataLen) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", szDataLen, len);
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  if ((pbtFrame[0] != 0xd5) || (pbtFrame[1] != CHIP_DATA(pnd)->last_command + 1)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Command Code verification failed");
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  memcpy(pbtData, pbtFrame + 2, len);
+
+  // The PN53x command is done and we successfully received the reply
+  nfc_stats_frame_received(pnd, len);
+  return len;
+}
+
+static int
+pn53x_sim_abort_command(nfc_device *pnd)
+{
+  if (pnd) {
+    struct pn53x_sim_data *sim = DRIVER_DATA(pnd);
+    nfc_mutex_lock(&sim->mutex);
+    sim->bAbort = true;
+    nfc_cond_broadcast(&sim->cond);
+    nfc_mutex_unlock(&sim->mutex);
+  }
+  return NFC_SUCCESS;
+}
+
+#ifdef __linux__
+static int
+pn53x_sim_get_pollfd(nfc_device *pnd)
+{
+  return DRIVER_DATA(pnd)->iReadyFd;
+}
+#endif
+
+static void
+pn53x_sim_data_free(struct pn53x_sim_data *sim)
+{
+#ifdef __linux__
+  if (sim->iReadyFd >= 0)
+    close(sim->iReadyFd);
+#endif
+  nfc_cond_destroy(&sim->cond);
+  nfc_mutex_destroy(&sim->mutex);
+  free(sim->abtRegisters);
+}
+
+static void
+pn53x_sim_close(nfc_device *pnd)
+{
+  pn53x_idle(pnd);
+  pn53x_sim_data_free(DRIVER_DATA(pnd));
+  pn53x_data_free(pnd);
+  nfc_device_free(pnd);
+}
+
+// Parse options, a comma separated list of card types, latencies, card moves and flags
+static bool
+pn53x_sim_parse_options(struct pn53x_sim_data *sim, char *options)
+{
+  for (char *option = options, *next; option; option = next) {
+    if ((next = strchr(option, ',')))
+      *(next++) = '\0';
+    if (sscanf(option, "latency=%10" SCNu32, &sim->uiLatency) == 1)
+      continue;
+    if (sscanf(option, "rf-latency=%10" SCNu32, &sim->uiRfLatency) == 1)
+      continue;
+    if (sscanf(option, "leave=%10" SCNu32, &sim->uiLeave) == 1)
+      continue;
+    if (sscanf(option, "back=%10" SCNu32, &sim->uiBack) == 1)
+      continue;
+    if (0 == strcmp(option, "no-halt")) {
+      sim->bNoHalt = true;
+      continue;
+    }
+    size_t n;
+    for (n = 0; n < sizeof(pn53x_sim_card_names) / sizeof(pn53x_sim_card_names[0]); n++) {
+      if (0 == strcmp(option, pn53x_sim_card_names[n]))
+        break;
+    }
+    if (n == sizeof(pn53x_sim_card_names) / sizeof(pn53x_sim_card_names[0])) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown option: %s", option);
+      return false;
+    }
+    if (sim->szCards == PN53X_SIM_MAX_CARDS) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "No more than %d cards can be simulated", PN53X_SIM_MAX_CARDS);
+      return false;
+    }
+    pn53x_sim_card_init(&sim->cards[sim->szCards], (pn53x_sim_card_type) n, sim->szCards);
+    sim->szCards++;
+  }
+  return true;
+}
+
+static nfc_device *
+pn53x_sim_open(const nfc_context *context, const nfc_connstring connstring)
+{
+  char *chip = NULL;
+  char *options = NULL;
+  const int connstring_decode_level = connstring_decode(connstring, PN53X_SIM_DRIVER_NAME, NULL, &chip, &options);
+  if (connstring_decode_level < 1)
+    return NULL;
+
+  struct pn53x_sim_data *sim = calloc(1, sizeof(struct pn53x_sim_data));
+  if (!sim) {
+    perror("malloc");
+    free(chip);
+    free(options);
+    return NULL;
+  }
+  sim->type = PN533;
+  if (chip && (0 == strcmp(chip, "pn532"))) {
+    sim->type = PN532;
+  } else if (chip && strcmp(chip, "pn533")) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unknown chip: %s", chip);
+    free(chip);
+    free(options);
+    free(sim);
+    return NULL;
+  }
+  free(chip);
+  const bool bOptions = !options || pn53x_sim_parse_options(sim, options);
+  free(options);
+  if (!bOptions) {
+    free(sim);
+    return NULL;
+  }
+  if (!sim->szCards) {
+    pn53x_sim_card_init(&sim->cards[0], PN53X_SIM_MIFARE_CLASSIC, 0);
+    sim->szCards = 1;
+  }
+  if (!(sim->abtRegisters = calloc(1, 0x10000))) {
+    perror("malloc");
+    free(sim);
+    return NULL;
+  }
+  // CRC handled by the chip, as after a reset
+  sim->abtRegisters[PN53X_REG_CIU_TxMode] = SYMBOL_TX_CRC_ENABLE;
+  sim->abtRegisters[PN53X_REG_CIU_RxMode] = SYMBOL_RX_CRC_ENABLE;
+  nfc_mutex_init(&sim->mutex);
+  nfc_cond_init(&sim->cond);
+  sim->ui64Opened = nfc_stats_now();
+#ifdef __linux__
+  if ((sim->iReadyFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+    perror("timerfd_create");
+    pn53x_sim_data_free(sim);
+    free(sim);
+    return NULL;
+  }
+#endif
+
+  nfc_device *pnd = nfc_device_new(context, connstring);
+  if (!pnd) {
+    perror("malloc");
+    pn53x_sim_data_free(sim);
+    free(sim);
+    return NULL;
+  }
+  snprintf(pnd->name, sizeof(pnd->name), "%s:%s", PN53X_SIM_DRIVER_NAME, (sim->type == PN532) ? "pn532" : "pn533");
+  pnd->driver_data = sim;
+
+  // Alloc and init chip's data
+  if (pn53x_data_new(pnd, &pn53x_sim_io) == NULL) {
+    perror("malloc");
+    pn53x_sim_data_free(sim);
+    nfc_device_free(pnd);
+    return NULL;
+  }
+  CHIP_DATA(pnd)->type = sim->type;
+  CHIP_DATA(pnd)->power_mode = NORMAL;
+  pnd->driver = &pn53x_sim_driver;
+
+  // Check communication using "Diagnose" command, with "Communication test" (0x00)
+  if (pn53x_check_communication(pnd) < 0) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "pn53x_check_communication error");
+    pn53x_sim_close(pnd);
+    return NULL;
+  }
+
+  pn53x_init(pnd);
+  return pnd;
+}
+
+const struct pn53x_io pn53x_sim_io = {
+  .send       = pn53x_sim_send,
+  .receive    = pn53x_sim_receive,
+#ifdef __linux__
+  .get_pollfd = pn53x_sim_get_pollfd,
+#endif
+};
+
+const struct nfc_driver pn53x_sim_driver = {
+  .name                             = PN53X_SIM_DRIVER_NAME,
+  .scan_type                        = NOT_AVAILABLE,
+  .open                             = pn53x_sim_open,
+  .close                            = pn53x_sim_close,
+  .strerror                         = pn53x_strerror,
+
+  .initiator_init                   = pn53x_initiator_init,
+  .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
+  .initiator_poll_target            = pn53x_initiator_poll_target,
+  .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
+  .initiator_deselect_target        = pn53x_initiator_deselect_target,
+  .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
+  .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
+  .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
+  .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
+  .initiator_target_is_present      = pn53x_initiator_target_is_present,
+
+  .target_init           = pn53x_target_init,
+  .target_send_bytes     = pn53x_target_send_bytes,
+  .target_receive_bytes  = pn53x_target_receive_bytes,
+  .target_send_bits      = pn53x_target_send_bits,
+  .target_receive_bits   = pn53x_target_receive_bits,
+
+  .device_set_property_bool     = pn53x_set_property_bool,
+  .device_set_property_int      = pn53x_set_property_int,
+  .get_supported_modulation     = pn53x_get_supported_modulation,
+  .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
+  .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
+
+  .abort_command  = pn53x_sim_abort_command,
+  .idle           = pn53x_idle,
+  .powerdown      = pn53x_PowerDown,
+};
@@ -58,8 +58,6 @@ Thanks to d18c7db and Okko for example code
 #define LOG_CATEGORY "libnfc.driver.pn53x_usb"
 #define LOG_GROUP    NFC_LOG_GROUP_DRIVER
 
-#define USB_INFINITE_TIMEOUT   0
-
 #define DRIVER_DATA(pnd) ((struct pn53x_usb_data*)(pnd->driver_data))
 
 const nfc_modulation_type no_target_support[] = {0};
@@ -77,12 +75,11 @@ typedef enum {
 
 // Internal data struct
 struct pn53x_usb_data {
-  usb_dev_handle *pudh;
+  usbbus_handle *pudh;
   pn53x_usb_model model;
   uint32_t uiEndPointIn;
   uint32_t uiEndPointOut;
   uint32_t uiMaxPacketSize;
-  volatile bool abort_flag;
   bool possibly_corrupted_usbdesc;
 };
 
@@ -90,17 +87,17 @@ struct pn53x_usb_data {
 const struct pn53x_io pn53x_usb_io;
 
 // Prototypes
-bool pn53x_usb_get_usb_device_name(struct usb_device *dev, usb_dev_handle *udev, char *buffer, size_t len);
+bool pn53x_usb_get_usb_device_name(const struct usbbus_device *dev, usbbus_handle *udev, char *buffer, size_t len);
 int pn53x_usb_init(nfc_device *pnd);
 
 static int
 pn53x_usb_bulk_read(struct pn53x_usb_data *data, uint8_t abtRx[], const size_t szRx, const int timeout)
 {
-  int res = usb_bulk_read(data->pudh, data->uiEndPointIn, (char *) abtRx, szRx, timeout);
+  int res = usbbus_bulk_read(data->pudh, data->uiEndPointIn, abtRx, szRx, timeout);
   if (res > 0) {
     LOG_HEX(NFC_LOG_GROUP_COM, "RX", abtRx, res);
   } else if (res < 0) {
-    if (res != -USB_TIMEDOUT)
+    if ((res != -USB_TIMEDOUT) && (res != -USB_CANCELED))
       log_put(NFC_LOG_GROUP_COM, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to read from USB (%s)", _usb_strerror(res));
   }
   return res;
@@ -110,11 +107,11 @@ static int
 pn53x_usb_bulk_write(struct pn53x_usb_data *data, uint8_t abtTx[], const size_t szTx, const int timeout)
 {
   LOG_HEX(NFC_LOG_GROUP_COM, "TX", abtTx, szTx);
-  int res = usb_bulk_write(data->pudh, data->uiEndPointOut, (char *) abtTx, szTx, timeout);
+  int res = usbbus_bulk_write(data->pudh, data->uiEndPointOut, abtTx, szTx, timeout);
   if (res > 0) {
     // HACK This little hack is a well know problem of USB, see http://www.libusb.org/ticket/6 for more details
     if ((res % data->uiMaxPacketSize) == 0) {
-      usb_bulk_write(data->pudh, data->uiEndPointOut, "\0", 0, timeout);
+      usbbus_bulk_write(data->pudh, data->uiEndPointOut, (const uint8_t *) "\0", 0, timeout);
     }
   } else {
     log_put(NFC_LOG_GROUP_COM, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to write to USB (%s)", _usb_strerror(res));
@@ -239,11 +236,11 @@ pn53x_usb_get_device_model(uint16_t vendor_id, uint16_t product_id)
 }
 
 static bool
-pn53x_usb_get_end_points_default(struct usb_device *dev, struct pn53x_usb_data *data)
+pn53x_usb_get_end_points_default(const struct usbbus_device *dev, struct pn53x_usb_data *data)
 {
   for (size_t n = 0; n < sizeof(pn53x_usb_supported_devices) / sizeof(struct pn53x_usb_supported_device); n++) {
-    if ((dev->descriptor.idVendor == pn53x_usb_supported_devices[n].vendor_id) &&
-        (dev->descriptor.idProduct == pn53x_usb_supported_devices[n].product_id)) {
+    if ((dev->idVendor == pn53x_usb_supported_devices[n].vendor_id) &&
+        (dev->idProduct == pn53x_usb_supported_devices[n].product_id)) {
       if (pn53x_usb_supported_devices[n].uiMaxPacketSize != 0) {
         data->uiEndPointIn = pn53x_usb_supported_devices[n].uiEndPointIn;
         data->uiEndPointOut = pn53x_usb_supported_devices[n].uiEndPointOut;
@@ -261,30 +258,32 @@ int  pn53x_usb_ack(nfc_device *pnd);
 
 // Find transfer endpoints for bulk transfers
 static void
-pn53x_usb_get_end_points(struct usb_device *dev, struct pn53x_usb_data *data)
+pn53x_usb_get_end_points(const struct usbbus_device *dev, struct pn53x_usb_data *data)
 {
   uint32_t uiIndex;
   uint32_t uiEndPoint;
-  struct usb_interface_descriptor *puid = dev->config->interface->altsetting;
+
+  if (!dev->has_config)
+    return;
 
   // 3 Endpoints maximum: Interrupt In, Bulk In, Bulk Out
-  for (uiIndex = 0; uiIndex < puid->bNumEndpoints; uiIndex++) {
+  for (uiIndex = 0; uiIndex < dev->bNumEndpoints; uiIndex++) {
     // Only accept bulk transfer endpoints (ignore interrupt endpoints)
-    if (puid->endpoint[uiIndex].bmAttributes != USB_ENDPOINT_TYPE_BULK)
+    if (dev->endpoint[uiIndex].bmAttributes != USB_ENDPOINT_TYPE_BULK)
       continue;
 
     // Copy the endpoint to a local var, makes it more readable code
-    uiEndPoint = puid->endpoint[uiIndex].bEndpointAddress;
+    uiEndPoint = dev->endpoint[uiIndex].bEndpointAddress;
 
     // Test if we dealing with a bulk IN endpoint
     if ((uiEndPoint & USB_ENDPOINT_DIR_MASK) == USB_ENDPOINT_IN) {
       data->uiEndPointIn = uiEndPoint;
-      data->uiMaxPacketSize = puid->endpoint[uiIndex].wMaxPacketSize;
+      data->uiMaxPacketSize = dev->endpoint[uiIndex].wMaxPacketSize;
     }
     // Test if we dealing with a bulk OUT endpoint
     if ((uiEndPoint & USB_ENDPOINT_DIR_MASK) == USB_ENDPOINT_OUT) {
       data->uiEndPointOut = uiEndPoint;
-      data->uiMaxPacketSize = puid->endpoint[uiIndex].wMaxPacketSize;
+      data->uiMaxPacketSize = dev->endpoint[uiIndex].wMaxPacketSize;
     }
   }
 }
@@ -297,61 +296,61 @@ pn53x_usb_scan(const nfc_context *context, nfc_connstring connstrings[], const s
   usb_prepare();
 
   size_t device_found = 0;
-  uint32_t uiBusIndex = 0;
-  struct usb_bus *bus;
-  for (bus = usb_get_busses(); bus; bus = bus->next) {
-    struct usb_device *dev;
-
-    for (dev = bus->devices; dev; dev = dev->next, uiBusIndex++) {
-      for (size_t n = 0; n < sizeof(pn53x_usb_supported_devices) / sizeof(struct pn53x_usb_supported_device); n++) {
-        if ((pn53x_usb_supported_devices[n].vendor_id == dev->descriptor.idVendor) &&
-            (pn53x_usb_supported_devices[n].product_id == dev->descriptor.idProduct)) {
-          // Make sure there are 2 endpoints available
-          // libusb-win32 may return a NULL dev->config,
-          // or the descriptors may be corrupted, hence
-          // let us assume we will use hardcoded defaults
-          // from pn53x_usb_supported_devices if available.
-          // otherwise get data from the descriptors.
-          if (pn53x_usb_supported_devices[n].uiMaxPacketSize == 0) {
-            if (dev->config->interface == NULL || dev->config->interface->altsetting == NULL) {
-              // Nope, we maybe want the next one, let's try to find another
-              continue;
-            }
-            if (dev->config->interface->altsetting->bNumEndpoints < 2) {
-              // Nope, we maybe want the next one, let's try to find another
-              continue;
-            }
-          }
-
-          usb_dev_handle *udev = usb_open(dev);
-          if (udev == NULL)
-            continue;
+  struct usbbus_device *devices;
+  size_t devices_count = usbbus_get_devices(&devices);
+  for (size_t i = 0; i < devices_count; i++) {
+    const struct usbbus_device *dev = &devices[i];
 
-          // Set configuration
-          int res = usb_set_configuration(udev, 1);
-          if (res < 0) {
-            log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set USB configuration (%s)", _usb_strerror(res));
-            usb_close(udev);
-            // we failed to use the device
+    for (size_t n = 0; n < sizeof(pn53x_usb_supported_devices) / sizeof(struct pn53x_usb_supported_device); n++) {
+      if ((pn53x_usb_supported_devices[n].vendor_id == dev->idVendor) &&
+          (pn53x_usb_supported_devices[n].product_id == dev->idProduct)) {
+        // Make sure there are 2 endpoints available
+        // libusb-win32 may return a NULL dev->config,
+        // or the descriptors may be corrupted, hence
+        // let us assume we will use hardcoded defaults
+        // from pn53x_usb_supported_devices if available.
+        // otherwise get data from the descriptors.
+        if (pn53x_usb_supported_devices[n].uiMaxPacketSize == 0) {
+          if (!dev->has_config) {
+            // Nope, we maybe want the next one, let's try to find another
             continue;
           }
-
-          // pn53x_usb_get_usb_device_name (dev, udev, pnddDevices[device_found].acDevice, sizeof (pnddDevices[device_found].acDevice));
-          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "device found: Bus %s Device %s", bus->dirname, dev->filename);
-          usb_close(udev);
-          if (snprintf(connstrings[device_found], sizeof(nfc_connstring), "%s:%s:%s", PN53X_USB_DRIVER_NAME, bus->dirname, dev->filename) >= (int)sizeof(nfc_connstring)) {
-            // truncation occurred, skipping that one
+          if (dev->bNumEndpoints < 2) {
+            // Nope, we maybe want the next one, let's try to find another
             continue;
           }
-          device_found++;
-          // Test if we reach the maximum "wanted" devices
-          if (device_found == connstrings_len) {
-            return device_found;
-          }
+        }
+
+        usbbus_handle *udev = usbbus_open(dev);
+        if (udev == NULL)
+          continue;
+
+        // Set configuration
+        int res = usbbus_set_configuration(udev, 1);
+        if (res < 0) {
+          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set USB configuration (%s)", _usb_strerror(res));
+          usbbus_close(udev);
+          // we failed to use the device
+          continue;
+        }
+
+        // pn53x_usb_get_usb_device_name (dev, udev, pnddDevices[device_found].acDevice, sizeof (pnddDevices[device_found].acDevice));
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "device found: Bus %s Device %s", dev->dirname, dev->filename);
+        usbbus_close(udev);
+        if (snprintf(connstrings[device_found], sizeof(nfc_connstring), "%s:%s:%s", PN53X_USB_DRIVER_NAME, dev->dirname, dev->filename) >= (int)sizeof(nfc_connstring)) {
+          // truncation occurred, skipping that one
+          continue;
+        }
+        device_found++;
+        // Test if we reach the maximum "wanted" devices
+        if (device_found == connstrings_len) {
+          usbbus_free_devices(devices);
+          return device_found;
         }
       }
     }
   }
+  usbbus_free_devices(devices);
 
   return device_found;
 }
@@ -362,23 +361,23 @@ struct pn53x_usb_descriptor {
 };
 
 bool
-pn53x_usb_get_usb_device_name(struct usb_device *dev, usb_dev_handle *udev, char *buffer, size_t len)
+pn53x_usb_get_usb_device_name(const struct usbbus_device *dev, usbbus_handle *udev, char *buffer, size_t len)
 {
   *buffer = '\0';
 
-  if (dev->descriptor.iManufacturer || dev->descriptor.iProduct) {
+  if (dev->iManufacturer || dev->iProduct) {
     if (udev) {
-      usb_get_string_simple(udev, dev->descriptor.iManufacturer, buffer, len);
+      usbbus_get_string_simple(udev, dev->iManufacturer, buffer, len);
       if (strlen(buffer) > 0)
         strcpy(buffer + strlen(buffer), " / ");
-      usb_get_string_simple(udev, dev->descriptor.iProduct, buffer + strlen(buffer), len - strlen(buffer));
+      usbbus_get_string_simple(udev, dev->iProduct, buffer + strlen(buffer), len - strlen(buffer));
     }
   }
 
   if (!*buffer) {
     for (size_t n = 0; n < sizeof(pn53x_usb_supported_devices) / sizeof(struct pn53x_usb_supported_device); n++) {
-      if ((pn53x_usb_supported_devices[n].vendor_id == dev->descriptor.idVendor) &&
-          (pn53x_usb_supported_devices[n].product_id == dev->descriptor.idProduct)) {
+      if ((pn53x_usb_supported_devices[n].vendor_id == dev->idVendor) &&
+          (pn53x_usb_supported_devices[n].product_id == dev->idProduct)) {
         strncpy(buffer, pn53x_usb_supported_devices[n].name, len);
         buffer[len - 1] = '\0';
         return true;
@@ -406,121 +405,122 @@ pn53x_usb_open(const nfc_context *context, const nfc_connstring connstring)
     .uiEndPointOut = 0,
     .possibly_corrupted_usbdesc = false,
   };
-  struct usb_bus *bus;
-  struct usb_device *dev;
+  struct usbbus_device *devices;
 
   usb_prepare();
 
-  for (bus = usb_get_busses(); bus; bus = bus->next) {
+  size_t devices_count = usbbus_get_devices(&devices);
+  for (size_t i = 0; i < devices_count; i++) {
+    const struct usbbus_device *dev = &devices[i];
+
     if (connstring_decode_level > 1)  {
       // A specific bus have been specified
-      if (0 != strcmp(bus->dirname, desc.dirname))
+      if (0 != strcmp(dev->dirname, desc.dirname))
         continue;
     }
-    for (dev = bus->devices; dev; dev = dev->next) {
-      if (connstring_decode_level > 2)  {
-        // A specific dev have been specified
-        if (0 != strcmp(dev->filename, desc.filename))
-          continue;
-      }
-      // Open the USB device
-      if ((data.pudh = usb_open(dev)) == NULL)
+    if (connstring_decode_level > 2)  {
+      // A specific dev have been specified
+      if (0 != strcmp(dev->filename, desc.filename))
         continue;
+    }
+    // Open the USB device
+    if ((data.pudh = usbbus_open(dev)) == NULL)
+      continue;
 
-      //To retrieve real USB endpoints configuration:
-      //pn53x_usb_get_end_points(dev, &data);
-      //printf("DEBUG ENDPOINTS    In:0x%x  Out:0x%x  Size:0x%x\n", data.uiEndPointIn, data.uiEndPointOut, data.uiMaxPacketSize);
+    //To retrieve real USB endpoints configuration:
+    //pn53x_usb_get_end_points(dev, &data);
+    //printf("DEBUG ENDPOINTS    In:0x%x  Out:0x%x  Size:0x%x\n", data.uiEndPointIn, data.uiEndPointOut, data.uiMaxPacketSize);
 
-      // Retrieve end points, using hardcoded defaults if available
-      // or using the descriptors otherwise.
-      if (pn53x_usb_get_end_points_default(dev, &data) == false) {
-        pn53x_usb_get_end_points(dev, &data);
-      }
-      // Set configuration
-      int res = usb_set_configuration(data.pudh, 1);
-      if (res < 0) {
-        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set USB configuration (%s)", _usb_strerror(res));
-        if (EPERM == -res) {
-          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "Warning: Please double check USB permissions for device %04x:%04x", dev->descriptor.idVendor, dev->descriptor.idProduct);
-        }
-        usb_close(data.pudh);
-        // we failed to use the specified device
-        goto free_mem;
+    // Retrieve end points, using hardcoded defaults if available
+    // or using the descriptors otherwise.
+    if (pn53x_usb_get_end_points_default(dev, &data) == false) {
+      pn53x_usb_get_end_points(dev, &data);
+    }
+    // Set configuration
+    int res = usbbus_set_configuration(data.pudh, 1);
+    if (res < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to set USB configuration (%s)", _usb_strerror(res));
+      if (EPERM == -res) {
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "Warning: Please double check USB permissions for device %04x:%04x", dev->idVendor, dev->idProduct);
       }
+      usbbus_close(data.pudh);
+      // we failed to use the specified device
+      goto free_devices;
+    }
 
-      res = usb_claim_interface(data.pudh, 0);
-      if (res < 0) {
-        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to claim USB interface (%s)", _usb_strerror(res));
-        usb_close(data.pudh);
-        // we failed to use the specified device
-        goto free_mem;
-      }
-      data.model = pn53x_usb_get_device_model(dev->descriptor.idVendor, dev->descriptor.idProduct);
-      // Allocate memory for the device info and specification, fill it and return the info
-      pnd = nfc_device_new(context, connstring);
-      if (!pnd) {
-        perror("malloc");
-        goto error;
-      }
-      pn53x_usb_get_usb_device_name(dev, data.pudh, pnd->name, sizeof(pnd->name));
+    res = usbbus_claim_interface(data.pudh, 0);
+    if (res < 0) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to claim USB interface (%s)", _usb_strerror(res));
+      usbbus_close(data.pudh);
+      // we failed to use the specified device
+      goto free_devices;
+    }
+    data.model = pn53x_usb_get_device_model(dev->idVendor, dev->idProduct);
+    // Allocate memory for the device info and specification, fill it and return the info
+    pnd = nfc_device_new(context, connstring);
+    if (!pnd) {
+      perror("malloc");
+      goto error;
+    }
+    pn53x_usb_get_usb_device_name(dev, data.pudh, pnd->name, sizeof(pnd->name));
 
-      pnd->driver_data = malloc(sizeof(struct pn53x_usb_data));
-      if (!pnd->driver_data) {
-        perror("malloc");
-        goto error;
-      }
-      *DRIVER_DATA(pnd) = data;
+    pnd->driver_data = malloc(sizeof(struct pn53x_usb_data));
+    if (!pnd->driver_data) {
+      perror("malloc");
+      goto error;
+    }
+    *DRIVER_DATA(pnd) = data;
 
-      // Alloc and init chip's data
-      if (pn53x_data_new(pnd, &pn53x_usb_io) == NULL) {
-        perror("malloc");
-        goto error;
-      }
+    // Alloc and init chip's data
+    if (pn53x_data_new(pnd, &pn53x_usb_io) == NULL) {
+      perror("malloc");
+      goto error;
+    }
 
-      switch (DRIVER_DATA(pnd)->model) {
-        // empirical tuning
-        case ASK_LOGO:
-          CHIP_DATA(pnd)->timer_correction = 50;
-          CHIP_DATA(pnd)->progressive_field = true;
-          break;
-        case SCM_SCL3711:
-        case SCM_SCL3712:
-        case NXP_PN533:
-          CHIP_DATA(pnd)->timer_correction = 46;
-          break;
-        case NXP_PN531:
-          CHIP_DATA(pnd)->timer_correction = 50;
-          break;
-        case SONY_PN531:
-          CHIP_DATA(pnd)->timer_correction = 54;
-          break;
-        case SONY_RCS360:
-        case UNKNOWN:
-          CHIP_DATA(pnd)->timer_correction = 0;   // TODO: allow user to know if timed functions are available
-          break;
-      }
-      pnd->driver = &pn53x_usb_driver;
+    switch (DRIVER_DATA(pnd)->model) {
+      // empirical tuning
+      case ASK_LOGO:
+        CHIP_DATA(pnd)->timer_correction = 50;
+        CHIP_DATA(pnd)->progressive_field = true;
+        break;
+      case SCM_SCL3711:
+      case SCM_SCL3712:
+      case NXP_PN533:
+        CHIP_DATA(pnd)->timer_correction = 46;
+        break;
+      case NXP_PN531:
+        CHIP_DATA(pnd)->timer_correction = 50;
+        break;
+      case SONY_PN531:
+        CHIP_DATA(pnd)->timer_correction = 54;
+        break;
+      case SONY_RCS360:
+      case UNKNOWN:
+        CHIP_DATA(pnd)->timer_correction = 0;   // TODO: allow user to know if timed functions are available
+        break;
+    }
+    pnd->driver = &pn53x_usb_driver;
 
-      // HACK1: Send first an ACK as Abort command, to reset chip before talking to it:
-      pn53x_usb_ack(pnd);
+    // HACK1: Send first an ACK as Abort command, to reset chip before talking to it:
+    pn53x_usb_ack(pnd);
 
-      // HACK2: Then send a GetFirmware command to resync USB toggle bit between host & device
-      // in case host used set_configuration and expects the device to have reset its toggle bit, which PN53x doesn't do
-      if (pn53x_usb_init(pnd) < 0) {
-        usb_close(data.pudh);
-        goto error;
-      }
-      DRIVER_DATA(pnd)->abort_flag = false;
-      goto free_mem;
+    // HACK2: Then send a GetFirmware command to resync USB toggle bit between host & device
+    // in case host used set_configuration and expects the device to have reset its toggle bit, which PN53x doesn't do
+    if (pn53x_usb_init(pnd) < 0) {
+      usbbus_close(data.pudh);
+      goto error;
     }
+    goto free_devices;
   }
   // We ran out of devices before the index required
-  goto free_mem;
+  goto free_devices;
 
 error:
   // Free allocated structure on error.
   nfc_device_free(pnd);
   pnd = NULL;
+free_devices:
+  usbbus_free_devices(devices);
 free_mem:
   free(desc.dirname);
   free(desc.filename);
@@ -544,11 +544,11 @@ pn53x_usb_close(nfc_device *pnd)
   pn53x_idle(pnd);
 
   int res;
-  if ((res = usb_release_interface(DRIVER_DATA(pnd)->pudh, 0)) < 0) {
+  if ((res = usbbus_release_interface(DRIVER_DATA(pnd)->pudh, 0)) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to release USB interface (%s)", _usb_strerror(res));
   }
 
-  if ((res = usb_close(DRIVER_DATA(pnd)->pudh)) < 0) {
+  if ((res = usbbus_close(DRIVER_DATA(pnd)->pudh)) < 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to close USB connection (%s)", _usb_strerror(res));
   }
   pn53x_data_free(pnd);
@@ -560,20 +560,24 @@ pn53x_usb_close(nfc_device *pnd)
 static int
 pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, const int timeout)
 {
-  uint8_t  abtFrame[PN53X_USB_BUFFER_LEN] = { 0x00, 0x00, 0xff };  // Every packet must start with "00 00 ff"
+  uint8_t *abtFrame;
   size_t szFrame = 0;
   int res = 0;
 
-  if ((res = pn53x_build_frame(abtFrame, &szFrame, pbtData, szData)) < 0) {
+  if ((res = pn53x_build_frame_in_place(pbtData, szData, &abtFrame, &szFrame)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
 
   DRIVER_DATA(pnd)->possibly_corrupted_usbdesc |= szData > 17;
+  // Have the IN transfer queued before the command goes out, so that the ACK
+  // frame is caught as soon as the PN53x sends it
+  usbbus_bulk_read_submit(DRIVER_DATA(pnd)->pudh, DRIVER_DATA(pnd)->uiEndPointIn, PN53X_USB_BUFFER_LEN);
   if ((res = pn53x_usb_bulk_write(DRIVER_DATA(pnd), abtFrame, szFrame, timeout)) < 0) {
     pnd->last_error = res;
     return pnd->last_error;
   }
+  nfc_stats_frame_sent(pnd, szData);
 
   uint8_t abtRxBuf[PN53X_USB_BUFFER_LEN];
   if ((res = pn53x_usb_bulk_read(DRIVER_DATA(pnd), abtRxBuf, sizeof(abtRxBuf), timeout)) < 0) {
@@ -583,6 +587,8 @@ pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, con
     return pnd->last_error;
   }
 
+  // Likewise queue the read of the response, pn53x_usb_receive() will pick it up
+  usbbus_bulk_read_submit(DRIVER_DATA(pnd)->pudh, DRIVER_DATA(pnd)->uiEndPointIn, PN53X_USB_BUFFER_LEN);
   if (pn53x_check_ack_frame(pnd, abtRxBuf, res) == 0) {
     // The PN53x is running the sent command
   } else {
@@ -599,51 +605,32 @@ pn53x_usb_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, con
       pn53x_usb_ack(pnd);
       return pnd->last_error;
     }
+    pnd->stats.nacks++;
   }
   return NFC_SUCCESS;
 }
 
-#define USB_TIMEOUT_PER_PASS 200
 static int
-pn53x_usb_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, const int timeout)
+pn53x_usb_receive_frame(nfc_device *pnd, struct pn53x_frame *frame, const int timeout)
 {
   size_t len;
   off_t offset = 0;
 
-  uint8_t  abtRxBuf[PN53X_USB_BUFFER_LEN];
+  uint8_t *abtRxBuf = frame->buffer;
   int res;
 
-  /*
-   * If no timeout is specified but the command is blocking, force a 200ms (USB_TIMEOUT_PER_PASS)
-   * timeout to allow breaking the loop if the user wants to stop it.
-   */
-  int usb_timeout;
-  int remaining_time = timeout;
-read:
-  if (timeout == USB_INFINITE_TIMEOUT) {
-    usb_timeout = USB_TIMEOUT_PER_PASS;
-  } else {
-    // A user-provided timeout is set, we have to cut it in multiple chunk to be able to keep an nfc_abort_command() mechanism
-    remaining_time -= USB_TIMEOUT_PER_PASS;
-    if (remaining_time <= 0) {
-      pnd->last_error = NFC_ETIMEOUT;
-      return pnd->last_error;
-    } else {
-      usb_timeout = MIN(remaining_time, USB_TIMEOUT_PER_PASS);
-    }
-  }
+  // The USB bus layer keeps blocking reads interruptible by nfc_abort_command()
+  res = pn53x_usb_bulk_read(DRIVER_DATA(pnd), abtRxBuf, PN53X_USB_BUFFER_LEN, timeout);
 
-  res = pn53x_usb_bulk_read(DRIVER_DATA(pnd), abtRxBuf, sizeof(abtRxBuf), usb_timeout);
+  if (res == -USB_CANCELED) {
+    pn53x_usb_ack(pnd);
+    pnd->last_error = NFC_EOPABORTED;
+    return pnd->last_error;
+  }
 
   if (res == -USB_TIMEDOUT) {
-    if (DRIVER_DATA(pnd)->abort_flag) {
-      DRIVER_DATA(pnd)->abort_flag = false;
-      pn53x_usb_ack(pnd);
-      pnd->last_error = NFC_EOPABORTED;
-      return pnd->last_error;
-    } else {
-      goto read;
-    }
+    pnd->last_error = NFC_ETIMEOUT;
+    return pnd->last_error;
   }
 
   if (res < 0) {
@@ -693,8 +680,8 @@ read:
     offset += 2;
   }
 
-  if (len > szDataLen) {
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", szDataLen, len);
+  if ((offset + 2 + len + 2) > (size_t)res) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: frame truncated. (received: %d, len: %" PRIuPTR ")", res, len);
     pnd->last_error = NFC_EIO;
     return pnd->last_error;
   }
@@ -714,13 +701,15 @@ read:
   }
   offset += 1;
 
-  memcpy(pbtData, abtRxBuf + offset, len);
+  // The payload is left where it was received
+  frame->data = abtRxBuf + offset;
+  frame->len = len;
   offset += len;
 
   uint8_t btDCS = (256 - 0xD5);
   btDCS -= CHIP_DATA(pnd)->last_command + 1;
   for (size_t szPos = 0; szPos < len; szPos++) {
-    btDCS -= pbtData[szPos];
+    btDCS -= frame->data[szPos];
   }
 
   if (btDCS != abtRxBuf[offset]) {
@@ -738,9 +727,28 @@ read:
   // The PN53x command is done and we successfully received the reply
   pnd->last_error = 0;
   DRIVER_DATA(pnd)->possibly_corrupted_usbdesc |= len > 16;
+  nfc_stats_frame_received(pnd, len);
   return len;
 }
 
+static int
+pn53x_usb_receive(nfc_device *pnd, uint8_t *pbtData, const size_t szDataLen, const int timeout)
+{
+  struct pn53x_frame frame;
+  int res;
+
+  if ((res = pn53x_usb_receive_frame(pnd, &frame, timeout)) < 0) {
+    return res;
+  }
+  if (frame.len > szDataLen) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to receive data: buffer too small. (szDataLen: %" PRIuPTR ", len: %" PRIuPTR ")", szDataLen, frame.len);
+    pnd->last_error = NFC_EIO;
+    return pnd->last_error;
+  }
+  memcpy(pbtData, frame.data, frame.len);
+  return res;
+}
+
 int
 pn53x_usb_ack(nfc_device *pnd)
 {
@@ -851,7 +859,7 @@ pn53x_usb_set_property_bool(nfc_device *pnd, const nfc_property property, const
 static int
 pn53x_usb_abort_command(nfc_device *pnd)
 {
-  DRIVER_DATA(pnd)->abort_flag = true;
+  usbbus_bulk_read_abort(DRIVER_DATA(pnd)->pudh);
   return NFC_SUCCESS;
 }
 
@@ -865,15 +873,29 @@ pn53x_usb_get_supported_modulation(nfc_device *pnd, const nfc_mode mode, const n
   return NFC_SUCCESS;
 }
 
+static int
+pn53x_usb_get_pollfd(nfc_device *pnd)
+{
+  const int res = usbbus_get_pollfd(DRIVER_DATA(pnd)->pudh);
+  if (res < 0) {
+    pnd->last_error = (res == -ENOSYS) ? NFC_EDEVNOTSUPP : NFC_EIO;
+    return pnd->last_error;
+  }
+  return res;
+}
+
 const struct pn53x_io pn53x_usb_io = {
-  .send       = pn53x_usb_send,
-  .receive    = pn53x_usb_receive,
+  .send          = pn53x_usb_send,
+  .receive       = pn53x_usb_receive,
+  .receive_frame = pn53x_usb_receive_frame,
+  .get_pollfd    = pn53x_usb_get_pollfd,
 };
 
 const struct nfc_driver pn53x_usb_driver = {
   .name                             = PN53X_USB_DRIVER_NAME,
   .scan_type                        = NOT_INTRUSIVE,
   .scan                             = pn53x_usb_scan,
+  .scan_bus                         = "usb",
   .open                             = pn53x_usb_open,
   .close                            = pn53x_usb_close,
   .strerror                         = pn53x_strerror,
@@ -881,10 +903,13 @@ const struct nfc_driver pn53x_usb_driver = {
   .initiator_init                   = pn53x_initiator_init,
   .initiator_init_secure_element    = NULL, // No secure-element support
   .initiator_select_passive_target  = pn53x_initiator_select_passive_target,
+  .initiator_select_passive_targets = pn53x_initiator_select_passive_targets,
   .initiator_poll_target            = pn53x_initiator_poll_target,
   .initiator_select_dep_target      = pn53x_initiator_select_dep_target,
   .initiator_deselect_target        = pn53x_initiator_deselect_target,
   .initiator_transceive_bytes       = pn53x_initiator_transceive_bytes,
+  .initiator_transceive_bytes_async    = pn53x_initiator_transceive_bytes_async,
+  .initiator_transceive_bytes_complete = pn53x_initiator_transceive_bytes_complete,
   .initiator_transceive_bits        = pn53x_initiator_transceive_bits,
   .initiator_transceive_bytes_timed = pn53x_initiator_transceive_bytes_timed,
   .initiator_transceive_bits_timed  = pn53x_initiator_transceive_bits_timed,
@@ -901,6 +926,7 @@ const struct nfc_driver pn53x_usb_driver = {
   .get_supported_modulation     = pn53x_usb_get_supported_modulation,
   .get_supported_baud_rate      = pn53x_get_supported_baud_rate,
   .device_get_information_about = pn53x_get_information_about,
+  .device_get_pollfd            = pn53x_get_pollfd,
 
   .abort_command  = pn53x_usb_abort_command,
   .idle           = pn53x_idle,
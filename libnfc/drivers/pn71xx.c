@@ -554,6 +554,7 @@ const struct nfc_driver pn71xx_driver = {
   .name                             = PN71XX_DRIVER_NAME,
   .scan_type                        = NOT_INTRUSIVE,
   .scan                             = pn71xx_scan,
+  .scan_bus                         = "nci",
   .open                             = pn71xx_open,
   .close                            = pn71xx_close,
   .strerror                         = NULL,
@@ -54,55 +54,874 @@ log_priority_to_str(const int priority)
 
 #include "log-internal.h"
 
-void
-log_init(const nfc_context *context)
-{
-#ifdef ENVVARS
-  char str[32];
-  sprintf(str, "%"PRIu32, context->log_level);
-  setenv("LIBNFC_LOG_LEVEL", str, 1);
+#if defined(__GNUC__) && !defined(_WIN32)
+#  include <pthread.h>
+#  include <sched.h>
+#  define LOG_ASYNC
+#endif
+
+volatile uint32_t log_cached_level =
+#ifdef DEBUG
+  3;
+#else
+  1;
+#endif
+LOG_THREAD_LOCAL uint32_t log_silenced = 0;
+
+// Longest message handed to a callback sink or formatted from a ring record
+#define LOG_MESSAGE_LEN 1280
+
+/*
+ * Where messages go: a callback, else a file, else stderr through
+ * log_put_internal() (which also feeds the debugger output on Windows)
+ */
+static struct {
+  FILE *file;
+  nfc_log_callback callback;
+  void *user_data;
+  const nfc_context *owner;
+} log_sink;
+
+#ifdef LOG_ASYNC
+static pthread_mutex_t log_sink_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define log_sink_lock() pthread_mutex_lock(&log_sink_mutex)
+#  define log_sink_unlock() pthread_mutex_unlock(&log_sink_mutex)
 #else
-  (void)context;
+#  define log_sink_lock() ((void) 0)
+#  define log_sink_unlock() ((void) 0)
 #endif
+
+// Write a formatted message to the sink, with log_sink_lock() held
+static void
+log_sink_write(const uint64_t ui64Timestamp, const uint8_t priority, const char *category, const char *message)
+{
+  if (log_sink.callback) {
+    log_sink.callback(ui64Timestamp, priority, category, message, log_sink.user_data);
+  } else if (log_sink.file) {
+    fprintf(log_sink.file, "%s\t%s\t%s\n", log_priority_to_str(priority), category, message);
+  } else {
+    log_put_internal("%s\t%s\t%s\n", log_priority_to_str(priority), category, message);
+  }
+}
+
+static size_t
+log_hex_format(char *pcBuf, const size_t szBufLen, const char *pcTag, const uint8_t *pbtData, const size_t szBytes)
+{
+  static const char acHex[] = "0123456789abcdef";
+  size_t szBuf = strlen(pcTag);
+
+  if (szBuf > szBufLen - 3)
+    szBuf = szBufLen - 3;
+  memcpy(pcBuf, pcTag, szBuf);
+  pcBuf[szBuf++] = ':';
+  pcBuf[szBuf++] = ' ';
+  for (size_t szPos = 0; (szPos < szBytes) && (szBuf + 3 < szBufLen); szPos++) {
+    pcBuf[szBuf++] = acHex[pbtData[szPos] >> 4];
+    pcBuf[szBuf++] = acHex[pbtData[szPos] & 0x0f];
+    pcBuf[szBuf++] = ' ';
+  }
+  pcBuf[szBuf] = '\0';
+  return szBuf;
+}
+
+#ifdef LOG_ASYNC
+
+/*
+ * Asynchronous logging
+ *
+ * Log calls push binary records into a bounded ring, the log thread formats
+ * them and writes them to the sink.  Producers never format: a record keeps
+ * the format string (which is a literal, so its address is as good as an
+ * identifier) and the raw arguments, or the raw bytes of a hex dump.  When
+ * the ring is full the record is dropped and counted.  The log thread waits
+ * on a condition variable once the ring is empty; only the producer
+ * publishing a record then takes the mutex to wake it up.
+ *
+ * The ring is Dmitry Vyukov's bounded queue: each slot has a sequence number
+ * telling whether it is free for the producer claiming position n (sequence
+ * is n) or holds the record of position n for the consumer (sequence is n+1).
+ */
+
+#define LOG_RECORD_LEN 512
+#define LOG_RING_DEFAULT_RECORDS 1024
+#define LOG_RING_MIN_RECORDS 16
+
+typedef enum {
+  LOG_RECORD_ARGS,
+  LOG_RECORD_HEX,
+  LOG_RECORD_TEXT,
+} log_record_kind;
+
+// Serialized argument types
+#define LOG_ARG_SIGNED   'i'
+#define LOG_ARG_UNSIGNED 'u'
+#define LOG_ARG_DOUBLE   'f'
+#define LOG_ARG_POINTER  'p'
+#define LOG_ARG_STRING   's'
+
+struct log_record_header {
+  uint64_t sequence;
+  uint64_t timestamp;
+  const char *category;
+  // Format string of LOG_RECORD_ARGS records
+  const char *format;
+  // Original payload length of LOG_RECORD_HEX records
+  uint32_t total;
+  uint16_t len;
+  uint8_t group;
+  uint8_t priority;
+  uint8_t kind;
+};
+
+#define LOG_RECORD_DATA_LEN (LOG_RECORD_LEN - sizeof(struct log_record_header))
+
+struct log_record {
+  struct log_record_header h;
+  uint8_t data[LOG_RECORD_DATA_LEN];
+};
+
+static struct {
+  struct log_record *records;
+  uint64_t mask;
+  // Next position to claim by producers
+  uint64_t tail;
+  // Next position to read by the log thread
+  uint64_t head;
+  uint64_t dropped;
+  // Producers between log_ring_claim() and log_ring_publish()
+  uint32_t writers;
+  bool enabled;
+  bool running;
+  // Set by the log thread before it waits for records, under wakeup_mutex
+  bool idle;
+  pthread_mutex_t wakeup_mutex;
+  pthread_cond_t wakeup;
+  pthread_t thread;
+  const nfc_context *owner;
+} log_ring = {
+  .wakeup_mutex = PTHREAD_MUTEX_INITIALIZER,
+  .wakeup = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Claim the next record of the ring
+ * @return 0 when a record was claimed, 1 when the ring is full, -1 when logging is synchronous
+ */
+static int
+log_ring_claim(struct log_record **ppRecord, uint64_t *pui64Pos)
+{
+  __atomic_add_fetch(&log_ring.writers, 1, __ATOMIC_SEQ_CST);
+  if (!__atomic_load_n(&log_ring.enabled, __ATOMIC_SEQ_CST)) {
+    __atomic_sub_fetch(&log_ring.writers, 1, __ATOMIC_SEQ_CST);
+    return -1;
+  }
+
+  uint64_t ui64Pos = __atomic_load_n(&log_ring.tail, __ATOMIC_RELAXED);
+  for (;;) {
+    struct log_record *pRecord = &log_ring.records[ui64Pos & log_ring.mask];
+    const int64_t i64Diff = (int64_t)(__atomic_load_n(&pRecord->h.sequence, __ATOMIC_ACQUIRE) - ui64Pos);
+    if (i64Diff == 0) {
+      if (__atomic_compare_exchange_n(&log_ring.tail, &ui64Pos, ui64Pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        *ppRecord = pRecord;
+        *pui64Pos = ui64Pos;
+        return 0;
+      }
+    } else if (i64Diff < 0) {
+      __atomic_add_fetch(&log_ring.dropped, 1, __ATOMIC_RELAXED);
+      __atomic_sub_fetch(&log_ring.writers, 1, __ATOMIC_SEQ_CST);
+      return 1;
+    } else {
+      ui64Pos = __atomic_load_n(&log_ring.tail, __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// Wake the log thread up if it waits for records
+static void
+log_ring_wakeup(void)
+{
+  pthread_mutex_lock(&log_ring.wakeup_mutex);
+  pthread_cond_signal(&log_ring.wakeup);
+  pthread_mutex_unlock(&log_ring.wakeup_mutex);
+}
+
+static void
+log_ring_publish(struct log_record *pRecord, const uint64_t ui64Pos)
+{
+  __atomic_store_n(&pRecord->h.sequence, ui64Pos + 1, __ATOMIC_RELEASE);
+  // Pairs with the fence of log_ring_wait(): either the log thread sees this
+  // record before it waits, or this producer sees it idle and wakes it up
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&log_ring.idle, __ATOMIC_RELAXED))
+    log_ring_wakeup();
+  __atomic_sub_fetch(&log_ring.writers, 1, __ATOMIC_SEQ_CST);
+}
+
+// printf(3) conversion specification
+struct log_spec {
+  const char *start;
+  const char *modifier;
+  const char *end;
+  char conversion;
+  // Length modifier: 'H' for hh, 'h', 'l', 'q' for ll, 'j', 'z', 't', 'L' or 0
+  char size;
+  bool width_arg;
+  bool precision_arg;
+};
+
+// Parse the conversion specification starting at pcFormat, right after '%'
+static const char *
+log_parse_spec(const char *pcFormat, struct log_spec *pSpec)
+{
+  pSpec->start = pcFormat - 1;
+  pSpec->width_arg = false;
+  pSpec->precision_arg = false;
+  pSpec->size = 0;
+  while (*pcFormat && strchr("-+ #0'", *pcFormat))
+    pcFormat++;
+  if (*pcFormat == '*') {
+    pSpec->width_arg = true;
+    pcFormat++;
+  }
+  while ((*pcFormat >= '0') && (*pcFormat <= '9'))
+    pcFormat++;
+  if (*pcFormat == '.') {
+    pcFormat++;
+    if (*pcFormat == '*') {
+      pSpec->precision_arg = true;
+      pcFormat++;
+    }
+    while ((*pcFormat >= '0') && (*pcFormat <= '9'))
+      pcFormat++;
+  }
+  pSpec->modifier = pcFormat;
+  switch (*pcFormat) {
+    case 'h':
+    case 'l':
+      pSpec->size = *pcFormat++;
+      if (*pcFormat == pSpec->size) {
+        pSpec->size = (pSpec->size == 'h') ? 'H' : 'q';
+        pcFormat++;
+      }
+      break;
+    case 'j':
+    case 'z':
+    case 't':
+    case 'L':
+      pSpec->size = *pcFormat++;
+      break;
+  }
+  pSpec->conversion = *pcFormat;
+  if (*pcFormat)
+    pcFormat++;
+  pSpec->end = pcFormat;
+  return pcFormat;
+}
+
+static bool
+log_record_put(struct log_record *pRecord, const uint8_t btType, const void *pValue, const size_t szValue)
+{
+  if (pRecord->h.len + 1 + szValue > LOG_RECORD_DATA_LEN)
+    return false;
+  pRecord->data[pRecord->h.len++] = btType;
+  memcpy(pRecord->data + pRecord->h.len, pValue, szValue);
+  pRecord->h.len += szValue;
+  return true;
+}
+
+static bool
+log_record_put_signed(struct log_record *pRecord, const int64_t i64Value)
+{
+  return log_record_put(pRecord, LOG_ARG_SIGNED, &i64Value, sizeof(i64Value));
+}
+
+/*
+ * Store the arguments of format in pRecord
+ * @return false if the format has an unsupported conversion or the arguments do not fit
+ */
+static bool
+log_record_put_args(struct log_record *pRecord, const char *pcFormat, va_list va)
+{
+  struct log_spec spec;
+
+  pRecord->h.len = 0;
+  while ((pcFormat = strchr(pcFormat, '%'))) {
+    pcFormat = log_parse_spec(pcFormat + 1, &spec);
+    if (spec.width_arg && !log_record_put_signed(pRecord, va_arg(va, int)))
+      return false;
+    if (spec.precision_arg && !log_record_put_signed(pRecord, va_arg(va, int)))
+      return false;
+    bool bStored = true;
+    switch (spec.conversion) {
+      case '%':
+        break;
+      case 'd':
+      case 'i':
+      case 'c': {
+        int64_t i64Value;
+        switch (spec.size) {
+          case 'l':
+            i64Value = va_arg(va, long);
+            break;
+          case 'q':
+            i64Value = va_arg(va, long long);
+            break;
+          case 'j':
+            i64Value = va_arg(va, intmax_t);
+            break;
+          case 'z':
+            i64Value = (int64_t) va_arg(va, size_t);
+            break;
+          case 't':
+            i64Value = va_arg(va, ptrdiff_t);
+            break;
+          default:
+            i64Value = va_arg(va, int);
+            break;
+        }
+        if ((spec.conversion == 'c') && spec.size)
+          return false; // Wide character
+        bStored = log_record_put_signed(pRecord, i64Value);
+        break;
+      }
+      case 'o':
+      case 'u':
+      case 'x':
+      case 'X': {
+        uint64_t ui64Value;
+        switch (spec.size) {
+          case 'l':
+            ui64Value = va_arg(va, unsigned long);
+            break;
+          case 'q':
+            ui64Value = va_arg(va, unsigned long long);
+            break;
+          case 'j':
+            ui64Value = va_arg(va, uintmax_t);
+            break;
+          case 'z':
+            ui64Value = va_arg(va, size_t);
+            break;
+          case 't':
+            ui64Value = (uint64_t) va_arg(va, ptrdiff_t);
+            break;
+          case 'H':
+            ui64Value = (unsigned char) va_arg(va, unsigned int);
+            break;
+          case 'h':
+            ui64Value = (unsigned short) va_arg(va, unsigned int);
+            break;
+          default:
+            ui64Value = va_arg(va, unsigned int);
+            break;
+        }
+        bStored = log_record_put(pRecord, LOG_ARG_UNSIGNED, &ui64Value, sizeof(ui64Value));
+        break;
+      }
+      case 'e':
+      case 'E':
+      case 'f':
+      case 'F':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A': {
+        if (spec.size == 'L')
+          return false;
+        const double dValue = va_arg(va, double);
+        bStored = log_record_put(pRecord, LOG_ARG_DOUBLE, &dValue, sizeof(dValue));
+        break;
+      }
+      case 'p': {
+        const uint64_t ui64Value = (uintptr_t) va_arg(va, void *);
+        bStored = log_record_put(pRecord, LOG_ARG_POINTER, &ui64Value, sizeof(ui64Value));
+        break;
+      }
+      case 's': {
+        if (spec.size)
+          return false; // Wide string
+        const char *pcValue = va_arg(va, const char *);
+        if (!pcValue)
+          pcValue = "(null)";
+        size_t szValue = strlen(pcValue);
+        // Long strings are truncated to what is left in the record
+        if (pRecord->h.len + 1 + sizeof(uint16_t) + szValue > LOG_RECORD_DATA_LEN) {
+          if (pRecord->h.len + 1 + sizeof(uint16_t) >= LOG_RECORD_DATA_LEN)
+            return false;
+          szValue = LOG_RECORD_DATA_LEN - pRecord->h.len - 1 - sizeof(uint16_t);
+        }
+        const uint16_t ui16Len = szValue;
+        pRecord->data[pRecord->h.len++] = LOG_ARG_STRING;
+        memcpy(pRecord->data + pRecord->h.len, &ui16Len, sizeof(ui16Len));
+        pRecord->h.len += sizeof(ui16Len);
+        memcpy(pRecord->data + pRecord->h.len, pcValue, szValue);
+        pRecord->h.len += szValue;
+        break;
+      }
+      default:
+        // %n, %ls, %Lf, ... are not supported
+        return false;
+    }
+    if (!bStored)
+      return false;
+  }
+  return true;
+}
+
+// Read back a value stored by log_record_put()
+static const uint8_t *
+log_record_get(const uint8_t *pbtArg, void *pValue)
+{
+  memcpy(pValue, pbtArg + 1, sizeof(uint64_t));
+  return pbtArg + 1 + sizeof(uint64_t);
+}
+
+// Format a LOG_RECORD_ARGS record, reading its arguments back from the record
+static void
+log_record_format_args(const struct log_record *pRecord, char *pcBuf, const size_t szBufLen)
+{
+  const char *pcFormat = pRecord->h.format;
+  const uint8_t *pbtArg = pRecord->data;
+  size_t szBuf = 0;
+  struct log_spec spec;
+
+  pcBuf[0] = '\0';
+  while (*pcFormat && (szBuf + 1 < szBufLen)) {
+    const char *pcPercent = strchr(pcFormat, '%');
+    size_t szLiteral = pcPercent ? (size_t)(pcPercent - pcFormat) : strlen(pcFormat);
+    if (szLiteral > szBufLen - szBuf - 1)
+      szLiteral = szBufLen - szBuf - 1;
+    memcpy(pcBuf + szBuf, pcFormat, szLiteral);
+    szBuf += szLiteral;
+    pcBuf[szBuf] = '\0';
+    if (!pcPercent)
+      break;
+    pcFormat = log_parse_spec(pcPercent + 1, &spec);
+    if (spec.conversion == '%') {
+      pcBuf[szBuf++] = '%';
+      pcBuf[szBuf] = '\0';
+      continue;
+    }
+
+    int64_t i64Width = 0, i64Precision = 0;
+    if (spec.width_arg)
+      pbtArg = log_record_get(pbtArg, &i64Width);
+    if (spec.precision_arg)
+      pbtArg = log_record_get(pbtArg, &i64Precision);
+
+    // Rebuild the specification, without its length modifier
+    char acSpec[32];
+    const size_t szSpec = spec.modifier - spec.start;
+    if (szSpec + 4 > sizeof(acSpec))
+      break;
+    memcpy(acSpec, spec.start, szSpec);
+    acSpec[szSpec] = '\0';
+
+    const int iWidth = i64Width, iPrecision = i64Precision;
+    int res = 0;
+#define LOG_SNPRINTF(value) \
+    do { \
+      if (spec.width_arg && spec.precision_arg) \
+        res = snprintf(pcBuf + szBuf, szBufLen - szBuf, acSpec, iWidth, iPrecision, value); \
+      else if (spec.width_arg) \
+        res = snprintf(pcBuf + szBuf, szBufLen - szBuf, acSpec, iWidth, value); \
+      else if (spec.precision_arg) \
+        res = snprintf(pcBuf + szBuf, szBufLen - szBuf, acSpec, iPrecision, value); \
+      else \
+        res = snprintf(pcBuf + szBuf, szBufLen - szBuf, acSpec, value); \
+    } while (0)
+    switch (*pbtArg) {
+      case LOG_ARG_SIGNED: {
+        int64_t i64Value;
+        pbtArg = log_record_get(pbtArg, &i64Value);
+        if (spec.conversion == 'c') {
+          strcat(acSpec, "c");
+          LOG_SNPRINTF((int) i64Value);
+        } else {
+          strcat(acSpec, "lld");
+          LOG_SNPRINTF((long long) i64Value);
+        }
+        break;
+      }
+      case LOG_ARG_UNSIGNED: {
+        uint64_t ui64Value;
+        pbtArg = log_record_get(pbtArg, &ui64Value);
+        strcat(acSpec, "ll");
+        acSpec[szSpec + 2] = spec.conversion;
+        acSpec[szSpec + 3] = '\0';
+        LOG_SNPRINTF((unsigned long long) ui64Value);
+        break;
+      }
+      case LOG_ARG_DOUBLE: {
+        double dValue;
+        pbtArg = log_record_get(pbtArg, &dValue);
+        acSpec[szSpec] = spec.conversion;
+        acSpec[szSpec + 1] = '\0';
+        LOG_SNPRINTF(dValue);
+        break;
+      }
+      case LOG_ARG_POINTER: {
+        uint64_t ui64Value;
+        pbtArg = log_record_get(pbtArg, &ui64Value);
+        strcat(acSpec, "p");
+        LOG_SNPRINTF((void *)(uintptr_t) ui64Value);
+        break;
+      }
+      case LOG_ARG_STRING: {
+        uint16_t ui16Len;
+        char acValue[LOG_RECORD_DATA_LEN];
+        memcpy(&ui16Len, pbtArg + 1, sizeof(ui16Len));
+        memcpy(acValue, pbtArg + 1 + sizeof(ui16Len), ui16Len);
+        acValue[ui16Len] = '\0';
+        pbtArg += 1 + sizeof(ui16Len) + ui16Len;
+        strcat(acSpec, "s");
+        LOG_SNPRINTF(acValue);
+        break;
+      }
+    }
+#undef LOG_SNPRINTF
+    if (res < 0)
+      break;
+    szBuf += res;
+    if (szBuf >= szBufLen) {
+      szBuf = szBufLen - 1;
+      break;
+    }
+  }
+  pcBuf[szBuf] = '\0';
+}
+
+static void
+log_record_write(const struct log_record *pRecord)
+{
+  char acBuf[LOG_MESSAGE_LEN];
+
+  switch (pRecord->h.kind) {
+    case LOG_RECORD_ARGS:
+      log_record_format_args(pRecord, acBuf, sizeof(acBuf));
+      break;
+    case LOG_RECORD_HEX: {
+      // Tag is stored first, then as much of the payload as fits
+      const size_t szTag = strlen((const char *) pRecord->data) + 1;
+      size_t szBuf = log_hex_format(acBuf, sizeof(acBuf), (const char *) pRecord->data, pRecord->data + szTag, pRecord->h.len - szTag);
+      if (pRecord->h.total > pRecord->h.len - szTag)
+        snprintf(acBuf + szBuf, sizeof(acBuf) - szBuf, "(%" PRIu32 " more bytes)", (uint32_t)(pRecord->h.total - (pRecord->h.len - szTag)));
+      break;
+    }
+    case LOG_RECORD_TEXT:
+    default:
+      memcpy(acBuf, pRecord->data, pRecord->h.len);
+      acBuf[pRecord->h.len] = '\0';
+      break;
+  }
+  log_sink_write(pRecord->h.timestamp, pRecord->h.priority, pRecord->h.category, acBuf);
+}
+
+// Write out the records published so far, return how many there were
+static size_t
+log_ring_drain(void)
+{
+  size_t n = 0;
+
+  log_sink_lock();
+  for (;;) {
+    struct log_record *pRecord = &log_ring.records[log_ring.head & log_ring.mask];
+    if (__atomic_load_n(&pRecord->h.sequence, __ATOMIC_ACQUIRE) != log_ring.head + 1)
+      break;
+    log_record_write(pRecord);
+    // Hand the slot back to producers, for the position one lap ahead
+    __atomic_store_n(&pRecord->h.sequence, log_ring.head + log_ring.mask + 1, __ATOMIC_RELEASE);
+    log_ring.head++;
+    n++;
+  }
+  if (n && log_sink.file && !log_sink.callback)
+    fflush(log_sink.file);
+  log_sink_unlock();
+  return n;
+}
+
+// Wait until a record is published or the log thread is stopped
+static void
+log_ring_wait(void)
+{
+  pthread_mutex_lock(&log_ring.wakeup_mutex);
+  __atomic_store_n(&log_ring.idle, true, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  const struct log_record *pRecord = &log_ring.records[log_ring.head & log_ring.mask];
+  if ((__atomic_load_n(&pRecord->h.sequence, __ATOMIC_ACQUIRE) != log_ring.head + 1) &&
+      __atomic_load_n(&log_ring.running, __ATOMIC_ACQUIRE))
+    pthread_cond_wait(&log_ring.wakeup, &log_ring.wakeup_mutex);
+  __atomic_store_n(&log_ring.idle, false, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&log_ring.wakeup_mutex);
+}
+
+static void *
+log_ring_thread(void *arg)
+{
+  (void) arg;
+  for (;;) {
+    // Read before draining so that records published before the stop are written
+    const bool bRunning = __atomic_load_n(&log_ring.running, __ATOMIC_ACQUIRE);
+    if (!log_ring_drain()) {
+      if (!bRunning)
+        break;
+      log_ring_wait();
+    }
+  }
+  return NULL;
+}
+
+int
+log_start_async(const nfc_context *context, const size_t szRecords)
+{
+  if (log_ring.owner)
+    return NFC_EINVARG;
+
+  size_t szCount = LOG_RING_MIN_RECORDS;
+  while (szCount < (szRecords ? szRecords : LOG_RING_DEFAULT_RECORDS))
+    szCount <<= 1;
+  if (!(log_ring.records = malloc(szCount * sizeof(struct log_record))))
+    return NFC_ESOFT;
+  for (size_t n = 0; n < szCount; n++)
+    log_ring.records[n].h.sequence = n;
+  log_ring.mask = szCount - 1;
+  log_ring.head = 0;
+  log_ring.tail = 0;
+  log_ring.dropped = 0;
+  log_ring.running = true;
+  if (pthread_create(&log_ring.thread, NULL, log_ring_thread, NULL) != 0) {
+    free(log_ring.records);
+    log_ring.records = NULL;
+    return NFC_ESOFT;
+  }
+  log_ring.owner = context;
+  __atomic_store_n(&log_ring.enabled, true, __ATOMIC_SEQ_CST);
+  return NFC_SUCCESS;
+}
+
+int
+log_stop_async(const nfc_context *context)
+{
+  if (!log_ring.owner || (log_ring.owner != context))
+    return NFC_EINVARG;
+
+  // Let producers which already claimed a record publish it
+  __atomic_store_n(&log_ring.enabled, false, __ATOMIC_SEQ_CST);
+  while (__atomic_load_n(&log_ring.writers, __ATOMIC_SEQ_CST))
+    sched_yield();
+
+  // The log thread checks running under wakeup_mutex before it waits
+  pthread_mutex_lock(&log_ring.wakeup_mutex);
+  __atomic_store_n(&log_ring.running, false, __ATOMIC_RELEASE);
+  pthread_cond_signal(&log_ring.wakeup);
+  pthread_mutex_unlock(&log_ring.wakeup_mutex);
+  pthread_join(log_ring.thread, NULL);
+  free(log_ring.records);
+  log_ring.records = NULL;
+  log_ring.owner = NULL;
+  return NFC_SUCCESS;
+}
+
+uint64_t
+log_get_dropped(void)
+{
+  return __atomic_load_n(&log_ring.dropped, __ATOMIC_RELAXED);
+}
+
+#else
+
+int
+log_start_async(const nfc_context *context, const size_t szRecords)
+{
+  (void) context;
+  (void) szRecords;
+  return NFC_ENOTIMPL;
+}
+
+int
+log_stop_async(const nfc_context *context)
+{
+  (void) context;
+  return NFC_ENOTIMPL;
+}
+
+uint64_t
+log_get_dropped(void)
+{
+  return 0;
+}
+
+#endif // LOG_ASYNC
+
+int
+log_set_sink(const nfc_context *context, const char *path, nfc_log_callback callback, void *user_data)
+{
+  FILE *file = NULL;
+
+  if (path && !(file = fopen(path, "a")))
+    return NFC_EIO;
+
+  log_sink_lock();
+  if (log_sink.file)
+    fclose(log_sink.file);
+  log_sink.file = file;
+  log_sink.callback = callback;
+  log_sink.user_data = user_data;
+  log_sink.owner = (file || callback) ? context : NULL;
+  log_sink_unlock();
+  return NFC_SUCCESS;
+}
+
+// Contexts whose levels are merged into log_cached_level, under nfc_global_lock()
+static nfc_context *log_contexts;
+
+// Merge log levels: every field (main level, then each group) gets the most verbose priority
+static uint32_t
+log_level_merge(const uint32_t a, const uint32_t b)
+{
+  uint32_t res = 0;
+  for (int shift = 0; shift < 32; shift += 2)
+    res |= MAX((a >> shift) & 0x03, (b >> shift) & 0x03) << shift;
+  return res;
+}
+
+// Update the cache from the levels of all contexts, with nfc_global_lock() held
+static void
+log_update_level(void)
+{
+  uint32_t level = 0;
+  for (const nfc_context *context = log_contexts; context; context = context->log_next)
+    level = log_level_merge(level, context->log_level);
+  log_set_level(level);
 }
 
 void
-log_exit(void)
+log_init(nfc_context *context)
 {
+  nfc_global_lock();
+  context->log_next = log_contexts;
+  log_contexts = context;
+  log_update_level();
+  nfc_global_unlock();
 }
 
 void
-log_put(const uint8_t group, const char *category, const uint8_t priority, const char *format, ...)
+log_set_context_level(nfc_context *context, const uint32_t level)
 {
-  char *env_log_level = NULL;
-#ifdef ENVVARS
-  env_log_level = getenv("LIBNFC_LOG_LEVEL");
-#endif
-  uint32_t log_level;
-  if (NULL == env_log_level) {
-    // LIBNFC_LOG_LEVEL is not set
-#ifdef DEBUG
-    log_level = 3;
-#else
-    log_level = 1;
-#endif
-  } else {
-    log_level = atoi(env_log_level);
+  nfc_global_lock();
+  context->log_level = level;
+  log_update_level();
+  nfc_global_unlock();
+}
+
+void
+log_exit(nfc_context *context)
+{
+  nfc_global_lock();
+  for (nfc_context **ppContext = &log_contexts; *ppContext; ppContext = &(*ppContext)->log_next) {
+    if (*ppContext == context) {
+      *ppContext = context->log_next;
+      break;
+    }
   }
+  // Messages logged without any context keep the level of the last one
+  if (log_contexts)
+    log_update_level();
+  nfc_global_unlock();
 
-  //  printf("log_level = %"PRIu32" group = %"PRIu8" priority = %"PRIu8"\n", log_level, group, priority);
-  if (log_level) { // If log is not disabled by log_level=none
-    if (((log_level & 0x00000003) >= priority) ||   // Global log level
-        (((log_level >> (group * 2)) & 0x00000003) >= priority)) { // Group log level
+#ifdef LOG_ASYNC
+  if (log_ring.owner == context)
+    log_stop_async(context);
+#endif
+  if (log_sink.owner == context)
+    log_set_sink(context, NULL, NULL, NULL);
+}
 
-      va_list va;
+void
+log_put_message(const uint8_t group, const char *category, const uint8_t priority, const char *format, ...)
+{
+  va_list va;
+
+#ifdef LOG_ASYNC
+  struct log_record *pRecord;
+  uint64_t ui64Pos;
+  switch (log_ring_claim(&pRecord, &ui64Pos)) {
+    case 0:
+      pRecord->h.timestamp = nfc_stats_now();
+      pRecord->h.category = category;
+      pRecord->h.format = format;
+      pRecord->h.group = group;
+      pRecord->h.priority = priority;
+      pRecord->h.kind = LOG_RECORD_ARGS;
       va_start(va, format);
-      log_put_internal("%s\t%s\t", log_priority_to_str(priority), category);
-      log_vput_internal(format, va);
-      log_put_internal("\n");
+      if (!log_record_put_args(pRecord, format, va)) {
+        // Let the producer format what cannot be stored raw
+        va_end(va);
+        va_start(va, format);
+        const int res = vsnprintf((char *) pRecord->data, LOG_RECORD_DATA_LEN, format, va);
+        pRecord->h.kind = LOG_RECORD_TEXT;
+        pRecord->h.len = (res < 0) ? 0 : ((size_t) res >= LOG_RECORD_DATA_LEN) ? LOG_RECORD_DATA_LEN - 1 : (size_t) res;
+      }
       va_end(va);
+      log_ring_publish(pRecord, ui64Pos);
+      return;
+    case 1:
+      return;
+  }
+#endif
+  (void) group;
+  log_sink_lock();
+  va_start(va, format);
+  if (log_sink.callback) {
+    char acBuf[LOG_MESSAGE_LEN];
+    vsnprintf(acBuf, sizeof(acBuf), format, va);
+    log_sink.callback(nfc_stats_now(), priority, category, acBuf, log_sink.user_data);
+  } else if (log_sink.file) {
+    fprintf(log_sink.file, "%s\t%s\t", log_priority_to_str(priority), category);
+    vfprintf(log_sink.file, format, va);
+    fputc('\n', log_sink.file);
+    fflush(log_sink.file);
+  } else {
+    log_put_internal("%s\t%s\t", log_priority_to_str(priority), category);
+    log_vput_internal(format, va);
+    log_put_internal("\n");
+  }
+  va_end(va);
+  log_sink_unlock();
+}
+
+void
+log_hex(const uint8_t group, const char *category, const char *pcTag, const uint8_t *pbtData, const size_t szBytes)
+{
+#ifdef LOG_ASYNC
+  struct log_record *pRecord;
+  uint64_t ui64Pos;
+  switch (log_ring_claim(&pRecord, &ui64Pos)) {
+    case 0: {
+      size_t szTag = strlen(pcTag);
+      if (szTag > LOG_RECORD_DATA_LEN / 4)
+        szTag = LOG_RECORD_DATA_LEN / 4;
+      memcpy(pRecord->data, pcTag, szTag);
+      pRecord->data[szTag++] = '\0';
+      const size_t szPayload = (szBytes > LOG_RECORD_DATA_LEN - szTag) ? LOG_RECORD_DATA_LEN - szTag : szBytes;
+      memcpy(pRecord->data + szTag, pbtData, szPayload);
+      pRecord->h.timestamp = nfc_stats_now();
+      pRecord->h.category = category;
+      pRecord->h.group = group;
+      pRecord->h.priority = NFC_LOG_PRIORITY_DEBUG;
+      pRecord->h.kind = LOG_RECORD_HEX;
+      pRecord->h.len = szTag + szPayload;
+      pRecord->h.total = szBytes;
+      log_ring_publish(pRecord, ui64Pos);
+      return;
     }
+    case 1:
+      return;
   }
+#endif
+  char acBuf[1024];
+  log_hex_format(acBuf, sizeof(acBuf), pcTag, pbtData, szBytes);
+  log_put_message(group, category, NFC_LOG_PRIORITY_DEBUG, "%s", acBuf);
 }
 
 #endif // LOG
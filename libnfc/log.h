@@ -58,6 +58,14 @@
        LIBNFC_LOG_LEVEL=3585  // 1+512+3072
 */
 
+/*
+  Messages more verbose than NFC_LOG_PRIORITY_MAX are not compiled in at all,
+  whatever the log level is at run time (see --disable-debug-log).
+*/
+#ifndef NFC_LOG_PRIORITY_MAX
+#  define NFC_LOG_PRIORITY_MAX NFC_LOG_PRIORITY_DEBUG
+#endif
+
 //int log_priority_to_int(const char* priority);
 const char *log_priority_to_str(const int priority);
 
@@ -71,18 +79,86 @@ const char *log_priority_to_str(const int priority);
 #    define __has_attribute_format 1
 #  endif
 
-void log_init(const nfc_context *context);
-void log_exit(void);
-void log_put(const uint8_t group, const char *category, const uint8_t priority, const char *format, ...)
+/*
+ * Each context has its own log level, but messages are not tied to a context:
+ * a message is logged when the level of any context asks for it.  This cache
+ * merges the levels of all contexts, so log_enabled() reads a single word.
+ */
+extern volatile uint32_t log_cached_level;
+#  if defined(_MSC_VER)
+#    define LOG_THREAD_LOCAL __declspec(thread)
+#  else
+#    define LOG_THREAD_LOCAL __thread
+#  endif
+
+// Silence asked by the calling thread, which does not mute the others, see log_silence_begin()
+extern LOG_THREAD_LOCAL uint32_t log_silenced;
+#  define log_silence_begin() ((void) log_silenced++)
+#  define log_silence_end() ((void) log_silenced--)
+#  define log_is_silenced() (log_silenced != 0)
+
+#  if defined(__GNUC__)
+#    define log_get_level() __atomic_load_n(&log_cached_level, __ATOMIC_RELAXED)
+#    define log_set_level(level) __atomic_store_n(&log_cached_level, (uint32_t)(level), __ATOMIC_RELAXED)
+#  else
+#    define log_get_level() (log_cached_level)
+#    define log_set_level(level) ((void)(log_cached_level = (uint32_t)(level)))
+#  endif
+
+/**
+ * @brief Tell whether a message of \a priority in \a group would be logged
+ *
+ * Callers check it before doing any formatting work.
+ */
+static inline bool
+log_enabled(const uint8_t group, const uint8_t priority)
+{
+  if (priority > NFC_LOG_PRIORITY_MAX)
+    return false;
+  const uint32_t log_level = log_get_level();
+  return log_level && !log_is_silenced() && // If log is not disabled by log_level=none or silenced
+         (((log_level & 0x00000003) >= priority) ||   // Global log level
+          (((log_level >> (group * 2)) & 0x00000003) >= priority)); // Group log level
+}
+
+void log_init(nfc_context *context);
+void log_exit(nfc_context *context);
+void log_set_context_level(nfc_context *context, const uint32_t level);
+/*
+ * The sink and the ring of asynchronous logging are process-wide, not per
+ * context: log_put() has no context to pick a ring with.  The context which
+ * set the sink or started the ring owns it: it alone can stop the ring, and
+ * its log_exit() restores the stderr sink and synchronous logging.  Another
+ * context asking for a ring meanwhile gets NFC_EINVARG.
+ */
+int log_set_sink(const nfc_context *context, const char *path, nfc_log_callback callback, void *user_data);
+int log_start_async(const nfc_context *context, const size_t szRecords);
+int log_stop_async(const nfc_context *context);
+uint64_t log_get_dropped(void);
+void log_put_message(const uint8_t group, const char *category, const uint8_t priority, const char *format, ...)
 #  if __has_attribute_format
 __attribute__((format(printf, 4, 5)))
 #  endif
 ;
+#  define log_put(group, category, priority, ...) do { \
+    if (log_enabled(group, priority)) \
+      log_put_message(group, category, priority, __VA_ARGS__); \
+  } while (0)
 #else
 // No logging
 #define log_init(nfc_context) ((void) 0)
-#define log_exit() ((void) 0)
-#define log_put(group, category, priority, format, ...) do {} while (0)
+#define log_exit(nfc_context) ((void) 0)
+#define log_set_context_level(nfc_context, level) ((void) ((nfc_context)->log_level = (level)))
+#define log_set_sink(nfc_context, path, callback, user_data) (NFC_ENOTIMPL)
+#define log_start_async(nfc_context, szRecords) (NFC_ENOTIMPL)
+#define log_stop_async(nfc_context) (NFC_ENOTIMPL)
+#define log_get_dropped() ((uint64_t) 0)
+#define log_get_level() ((uint32_t) 0)
+#define log_set_level(level) ((void) (level))
+#define log_silence_begin() ((void) 0)
+#define log_silence_end() ((void) 0)
+#define log_enabled(group, priority) (false)
+#define log_put(group, category, priority, ...) do {} while (0)
 
 #endif // LOG
 
@@ -90,26 +166,21 @@ __attribute__((format(printf, 4, 5)))
  * @macro LOG_HEX
  * @brief Log a byte-array in hexadecimal format
  * Max values:  pcTag of 121 bytes + ": " + 300 bytes of data+ "\0" => acBuf of 1024 bytes
+ *
+ * Nothing is formatted unless debug messages of \a group are logged.
  */
 #  ifdef LOG
 #    define LOG_HEX(group, pcTag, pbtData, szBytes) do { \
-    size_t	 __szPos; \
-    char	 __acBuf[1024]; \
-    size_t	 __szBuf = 0; \
     if ((int)szBytes < 0) { \
       fprintf (stderr, "%s:%d: Attempt to print %d bytes!\n", __FILE__, __LINE__, (int)szBytes); \
       log_put (group, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s:%d: Attempt to print %d bytes!\n", __FILE__, __LINE__, (int)szBytes); \
       abort(); \
       break; \
     } \
-    snprintf (__acBuf + __szBuf, sizeof(__acBuf) - __szBuf, "%s: ", pcTag); \
-    __szBuf += strlen (pcTag) + 2; \
-    for (__szPos=0; (__szPos < (size_t)(szBytes)) && (__szBuf < sizeof(__acBuf)); __szPos++) { \
-      snprintf (__acBuf + __szBuf, sizeof(__acBuf) - __szBuf, "%02x ",((uint8_t *)(pbtData))[__szPos]); \
-      __szBuf += 3; \
-    } \
-    log_put (group, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%s", __acBuf); \
+    if (log_enabled(group, NFC_LOG_PRIORITY_DEBUG)) \
+      log_hex(group, LOG_CATEGORY, pcTag, (const uint8_t *)(pbtData), (size_t)(szBytes)); \
   } while (0);
+void log_hex(const uint8_t group, const char *category, const char *pcTag, const uint8_t *pbtData, const size_t szBytes);
 #  else
 #    define LOG_HEX(group, pcTag, pbtData, szBytes) do { \
     (void) group; \
@@ -34,6 +34,13 @@
 #endif // HAVE_CONFIG_H
 
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#endif
 
 #include "mirror-subr.h"
 
@@ -66,27 +73,67 @@ mirror(uint8_t bt)
   return ByteMirror[bt];
 }
 
-static void
-mirror_bytes(uint8_t *pbts, size_t szLen)
+/**
+ * @brief Mirror the bits of each byte of a buffer
+ * @param pbtDst destination buffer, may be the same as \a pbtSrc
+ * @param pbtSrc source buffer
+ * @param szLen amount of bytes
+ *
+ * Works 16 bytes at a time with a nibble shuffle (SSSE3) or the bit reversal
+ * instruction (AArch64 NEON) when built for them, 8 bytes at a time with
+ * 64-bit masks otherwise, and finishes with the lookup table.
+ */
+void
+mirror_buffer(uint8_t *pbtDst, const uint8_t *pbtSrc, size_t szLen)
 {
-  size_t  szByteNr;
-
-  for (szByteNr = 0; szByteNr < szLen; szByteNr++) {
-    *pbts = ByteMirror[*pbts];
-    pbts++;
+#if defined(__SSSE3__)
+  const __m128i xmmLow = _mm_setr_epi8(0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+                                       0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f);
+  const __m128i xmmHigh = _mm_slli_epi16(xmmLow, 4);
+  const __m128i xmmMask = _mm_set1_epi8(0x0f);
+  while (szLen >= 16) {
+    const __m128i xmm = _mm_loadu_si128((const __m128i *) pbtSrc);
+    const __m128i xmmRes = _mm_or_si128(_mm_shuffle_epi8(xmmHigh, _mm_and_si128(xmm, xmmMask)),
+                                        _mm_shuffle_epi8(xmmLow, _mm_and_si128(_mm_srli_epi16(xmm, 4), xmmMask)));
+    _mm_storeu_si128((__m128i *) pbtDst, xmmRes);
+    pbtSrc += 16;
+    pbtDst += 16;
+    szLen -= 16;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  while (szLen >= 16) {
+    vst1q_u8(pbtDst, vrbitq_u8(vld1q_u8(pbtSrc)));
+    pbtSrc += 16;
+    pbtDst += 16;
+    szLen -= 16;
+  }
+#endif
+  while (szLen >= 8) {
+    uint64_t ui64;
+    memcpy(&ui64, pbtSrc, 8);
+    ui64 = ((ui64 & 0xaaaaaaaaaaaaaaaaULL) >> 1) | ((ui64 & 0x5555555555555555ULL) << 1);
+    ui64 = ((ui64 & 0xccccccccccccccccULL) >> 2) | ((ui64 & 0x3333333333333333ULL) << 2);
+    ui64 = ((ui64 & 0xf0f0f0f0f0f0f0f0ULL) >> 4) | ((ui64 & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    memcpy(pbtDst, &ui64, 8);
+    pbtSrc += 8;
+    pbtDst += 8;
+    szLen -= 8;
+  }
+  while (szLen--) {
+    *pbtDst++ = ByteMirror[*pbtSrc++];
   }
 }
 
 uint32_t
 mirror32(uint32_t ui32Bits)
 {
-  mirror_bytes((uint8_t *) & ui32Bits, 4);
+  mirror_buffer((uint8_t *) & ui32Bits, (uint8_t *) & ui32Bits, 4);
   return ui32Bits;
 }
 
 uint64_t
 mirror64(uint64_t ui64Bits)
 {
-  mirror_bytes((uint8_t *) & ui64Bits, 8);
+  mirror_buffer((uint8_t *) & ui64Bits, (uint8_t *) & ui64Bits, 8);
   return ui64Bits;
 }
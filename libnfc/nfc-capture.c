@@ -0,0 +1,310 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-capture.c
+ * @brief Capture of the frames exchanged with a device, and their reading back
+ *
+ * A device captures from its creation, in memory: the devices probed then
+ * dropped while scanning are never written. Once nfc_open() has claimed the
+ * device, the capture is committed to its file and further records are
+ * written as they come, through stdio buffering so that capturing adds no
+ * system call per frame.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+#include "nfc-capture.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.capture"
+
+// Longest unsigned LEB128 encoding of a 64-bit value
+#define LEB128_MAX_LEN 10
+
+struct nfc_capture {
+  /** Capture file, NULL until the capture is committed */
+  FILE *file;
+  /** Records not written yet */
+  uint8_t *buffer;
+  size_t len;
+  size_t size;
+  /** Time of the previous record, in ns */
+  uint64_t last;
+  bool failed;
+};
+
+/**
+ * @brief Monotonic time in ns, see nfc_now_ns()
+ */
+uint64_t
+nfc_capture_now(void)
+{
+  return nfc_now_ns();
+}
+
+static size_t
+leb128_encode(uint8_t *pbt, uint64_t ui64Value)
+{
+  size_t sz = 0;
+  do {
+    pbt[sz] = ui64Value & 0x7f;
+    ui64Value >>= 7;
+    if (ui64Value)
+      pbt[sz] |= 0x80;
+    sz++;
+  } while (ui64Value);
+  return sz;
+}
+
+// Decode a value from pbt, szLen long, return its encoding length, 0 when truncated or too long
+static size_t
+leb128_decode(const uint8_t *pbt, const size_t szLen, uint64_t *pui64Value)
+{
+  *pui64Value = 0;
+  for (size_t sz = 0; (sz < szLen) && (sz < LEB128_MAX_LEN); sz++) {
+    *pui64Value |= (uint64_t)(pbt[sz] & 0x7f) << (7 * sz);
+    if (!(pbt[sz] & 0x80))
+      return sz + 1;
+  }
+  return 0;
+}
+
+static void
+nfc_capture_flush(struct nfc_capture *pcap)
+{
+  if (pcap->file && pcap->len) {
+    if (fwrite(pcap->buffer, 1, pcap->len, pcap->file) != pcap->len) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to write capture, capture stopped");
+      pcap->failed = true;
+    }
+    pcap->len = 0;
+  }
+}
+
+/**
+ * @brief Start a capture, kept in memory until nfc_capture_commit()
+ * @return Returns the capture, NULL when out of memory
+ */
+struct nfc_capture *
+nfc_capture_new(const char *connstring)
+{
+  struct nfc_capture *pcap = calloc(1, sizeof(struct nfc_capture));
+  if (!pcap)
+    return NULL;
+  nfc_capture_frame(pcap, NFC_CAPTURE_CONNSTRING, (const uint8_t *) connstring, strlen(connstring));
+  if (pcap->failed) {
+    nfc_capture_free(pcap);
+    return NULL;
+  }
+  return pcap;
+}
+
+/**
+ * @brief Write the capture to \a path, records captured so far then the next ones
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ */
+int
+nfc_capture_commit(struct nfc_capture *pcap, const char *path)
+{
+  if (pcap->failed)
+    return NFC_ESOFT;
+  if (!(pcap->file = fopen(path, "wb"))) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to create capture file %s", path);
+    return NFC_EIO;
+  }
+  if (fwrite(NFC_CAPTURE_MAGIC, 1, NFC_CAPTURE_MAGIC_LEN, pcap->file) != NFC_CAPTURE_MAGIC_LEN) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to write capture file %s", path);
+    fclose(pcap->file);
+    pcap->file = NULL;
+    return NFC_EIO;
+  }
+  nfc_capture_frame(pcap, NFC_CAPTURE_OPENED, NULL, 0);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Capturing to %s", path);
+  return pcap->failed ? NFC_EIO : NFC_SUCCESS;
+}
+
+/**
+ * @brief Close the capture file, or drop an uncommitted capture
+ */
+void
+nfc_capture_free(struct nfc_capture *pcap)
+{
+  if (pcap) {
+    if (pcap->file)
+      fclose(pcap->file);
+    free(pcap->buffer);
+    free(pcap);
+  }
+}
+
+/**
+ * @brief Record \a pbtData, timestamped now
+ *
+ * Callers hold the device lock, records are not serialized otherwise.
+ */
+void
+nfc_capture_frame(struct nfc_capture *pcap, const nfc_capture_type type, const uint8_t *pbtData, const size_t szData)
+{
+  if (pcap->failed)
+    return;
+  const uint64_t ui64Now = nfc_capture_now();
+  const size_t szRecord = 1 + 2 * LEB128_MAX_LEN + szData;
+  if (pcap->len + szRecord > pcap->size) {
+    const size_t szSize = (pcap->len + szRecord) * 2;
+    uint8_t *pbtBuffer = realloc(pcap->buffer, szSize);
+    if (!pbtBuffer) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Out of memory, capture stopped");
+      pcap->failed = true;
+      return;
+    }
+    pcap->buffer = pbtBuffer;
+    pcap->size = szSize;
+  }
+  uint8_t *pbt = pcap->buffer + pcap->len;
+  *(pbt++) = (uint8_t) type;
+  pbt += leb128_encode(pbt, pcap->last ? ui64Now - pcap->last : 0);
+  pbt += leb128_encode(pbt, szData);
+  if (szData)
+    memcpy(pbt, pbtData, szData);
+  pcap->len = pbt + szData - pcap->buffer;
+  pcap->last = ui64Now;
+  nfc_capture_flush(pcap);
+}
+
+/**
+ * @brief Record the libnfc error code \a error
+ */
+void
+nfc_capture_error(struct nfc_capture *pcap, const nfc_capture_type type, const int error)
+{
+  const uint32_t ui32Error = (uint32_t) error;
+  const uint8_t abtError[4] = { ui32Error & 0xff, (ui32Error >> 8) & 0xff, (ui32Error >> 16) & 0xff, ui32Error >> 24 };
+  nfc_capture_frame(pcap, type, abtError, sizeof(abtError));
+}
+
+/**
+ * @brief Load the capture file \a path and index its records
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ */
+int
+nfc_capture_trace_load(struct nfc_capture_trace *ptrace, const char *path)
+{
+  memset(ptrace, 0, sizeof(*ptrace));
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Unable to open capture file %s", path);
+    return NFC_EIO;
+  }
+  size_t szLen = 0;
+  size_t szSize = 0;
+  for (;;) {
+    if (szLen == szSize) {
+      szSize = szSize ? szSize * 2 : 65536;
+      uint8_t *pbtBuffer = realloc(ptrace->buffer, szSize);
+      if (!pbtBuffer) {
+        fclose(file);
+        nfc_capture_trace_free(ptrace);
+        return NFC_ESOFT;
+      }
+      ptrace->buffer = pbtBuffer;
+    }
+    const size_t szRead = fread(ptrace->buffer + szLen, 1, szSize - szLen, file);
+    if (!szRead)
+      break;
+    szLen += szRead;
+  }
+  const bool bError = ferror(file);
+  fclose(file);
+  if (bError || (szLen < NFC_CAPTURE_MAGIC_LEN) || memcmp(ptrace->buffer, NFC_CAPTURE_MAGIC, NFC_CAPTURE_MAGIC_LEN)) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s is not a capture file", path);
+    nfc_capture_trace_free(ptrace);
+    return NFC_EIO;
+  }
+
+  size_t szRecords = 0;
+  uint64_t ui64Time = 0;
+  for (size_t szPos = NFC_CAPTURE_MAGIC_LEN; szPos < szLen;) {
+    uint64_t ui64Delay, ui64Len;
+    size_t sz;
+    const uint8_t btType = ptrace->buffer[szPos++];
+    if (!(sz = leb128_decode(ptrace->buffer + szPos, szLen - szPos, &ui64Delay)))
+      break;
+    szPos += sz;
+    if (!(sz = leb128_decode(ptrace->buffer + szPos, szLen - szPos, &ui64Len)))
+      break;
+    szPos += sz;
+    if (ui64Len > szLen - szPos)
+      break;
+    if (ptrace->count == szRecords) {
+      szRecords = szRecords ? szRecords * 2 : 256;
+      struct nfc_capture_record *precs = realloc(ptrace->records, szRecords * sizeof(struct nfc_capture_record));
+      if (!precs) {
+        nfc_capture_trace_free(ptrace);
+        return NFC_ESOFT;
+      }
+      ptrace->records = precs;
+    }
+    ui64Time += ui64Delay;
+    struct nfc_capture_record *prec = &ptrace->records[ptrace->count++];
+    prec->type = (nfc_capture_type) btType;
+    prec->time = ui64Time;
+    prec->data = ptrace->buffer + szPos;
+    prec->len = (size_t) ui64Len;
+    szPos += prec->len;
+  }
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%" PRIuPTR " records loaded from %s", ptrace->count, path);
+  return NFC_SUCCESS;
+}
+
+void
+nfc_capture_trace_free(struct nfc_capture_trace *ptrace)
+{
+  free(ptrace->records);
+  free(ptrace->buffer);
+  memset(ptrace, 0, sizeof(*ptrace));
+}
+
+/**
+ * @brief Error code held by an error record
+ */
+int
+nfc_capture_record_error(const struct nfc_capture_record *prec)
+{
+  if (prec->len < 4)
+    return NFC_EIO;
+  return (int)(prec->data[0] | (prec->data[1] << 8) | (prec->data[2] << 16) | ((uint32_t) prec->data[3] << 24));
+}
@@ -0,0 +1,101 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-capture.h
+ * @brief Capture of the frames exchanged with a device, and their reading back
+ */
+
+#ifndef __NFC_CAPTURE_H__
+#define __NFC_CAPTURE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A capture file starts with NFC_CAPTURE_MAGIC then holds records made of:
+ * - type, 1 byte
+ * - time elapsed since the previous record in ns, unsigned LEB128
+ * - data length, unsigned LEB128
+ * - data
+ * Error records hold the libnfc error code, as a little-endian int32.
+ */
+#define NFC_CAPTURE_MAGIC     "LNFCCAP\x01"
+#define NFC_CAPTURE_MAGIC_LEN 8
+
+typedef enum {
+  /** Connection string of the captured device */
+  NFC_CAPTURE_CONNSTRING = 0,
+  /** Command sent to the chip */
+  NFC_CAPTURE_TX,
+  /** Reply received from the chip */
+  NFC_CAPTURE_RX,
+  /** Sending the previous command failed */
+  NFC_CAPTURE_TX_ERROR,
+  /** Receiving a reply failed */
+  NFC_CAPTURE_RX_ERROR,
+  /** Device open sequence is over */
+  NFC_CAPTURE_OPENED,
+} nfc_capture_type;
+
+struct nfc_capture;
+
+struct nfc_capture *nfc_capture_new(const char *connstring);
+int     nfc_capture_commit(struct nfc_capture *pcap, const char *path);
+void    nfc_capture_free(struct nfc_capture *pcap);
+void    nfc_capture_frame(struct nfc_capture *pcap, const nfc_capture_type type, const uint8_t *pbtData, const size_t szData);
+void    nfc_capture_error(struct nfc_capture *pcap, const nfc_capture_type type, const int error);
+
+uint64_t nfc_capture_now(void);
+
+/**
+ * @struct nfc_capture_record
+ * @brief Record read back from a capture file
+ */
+struct nfc_capture_record {
+  nfc_capture_type type;
+  /** Time since the first record, in ns */
+  uint64_t time;
+  const uint8_t *data;
+  size_t len;
+};
+
+/**
+ * @struct nfc_capture_trace
+ * @brief Capture file loaded in memory
+ */
+struct nfc_capture_trace {
+  uint8_t *buffer;
+  struct nfc_capture_record *records;
+  size_t count;
+};
+
+int     nfc_capture_trace_load(struct nfc_capture_trace *ptrace, const char *path);
+void    nfc_capture_trace_free(struct nfc_capture_trace *ptrace);
+int     nfc_capture_record_error(const struct nfc_capture_record *prec);
+
+#endif // __NFC_CAPTURE_H__
@@ -37,6 +37,7 @@
 #endif // HAVE_CONFIG_H
 
 #include "nfc-internal.h"
+#include "nfc-capture.h"
 
 nfc_device *
 nfc_device_new(const nfc_context *context, const nfc_connstring connstring)
@@ -63,6 +64,12 @@ nfc_device_new(const nfc_context *context, const nfc_connstring connstring)
   memcpy(res->connstring, connstring, sizeof(res->connstring));
   res->driver_data = NULL;
   res->chip_data   = NULL;
+  memset(&res->stats, 0, sizeof(res->stats));
+  res->stats_io_start = 0;
+  nfc_mutex_init(&res->lock);
+  res->watch = NULL;
+  // Devices are captured from their creation, see nfc_capture_commit()
+  res->capture = context->capture_path[0] ? nfc_capture_new(connstring) : NULL;
 
   return res;
 }
@@ -71,7 +78,31 @@ void
 nfc_device_free(nfc_device *dev)
 {
   if (dev) {
+    nfc_mutex_destroy(&dev->lock);
+    nfc_capture_free(dev->capture);
     free(dev->driver_data);
     free(dev);
   }
 }
+
+nfc_device *
+nfc_device_lock(nfc_device *pnd)
+{
+  if (pnd)
+    nfc_mutex_lock(&pnd->lock);
+  return pnd;
+}
+
+void
+nfc_device_unlock(nfc_device *pnd)
+{
+  if (pnd)
+    nfc_mutex_unlock(&pnd->lock);
+}
+
+// Cleanup handler of NFC_DEVICE_LOCK
+void
+nfc_device_unlock_scope(nfc_device *const *ppnd)
+{
+  nfc_device_unlock(*ppnd);
+}
@@ -0,0 +1,561 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-discovery.c
+ * @brief Parallel and cached device discovery
+ *
+ * Sources of nfc_list_devices() are grouped by the bus they probe: sources of
+ * a same bus (e.g. pn532_uart and arygon, which open the same serial ports)
+ * are run one after the other, groups run in parallel, each in its own thread.
+ * The caller waits for all groups, or until the context scan_timeout: groups
+ * still running then are left behind, and what they find is dropped. While a
+ * group left behind scans a bus, later calls do not scan it again and do not
+ * list its devices, and nfc_open() of a device on it waits for the scan.
+ *
+ * With a scan_cache_ttl, what each source found is kept in the context and
+ * reused while it is recent enough and the device nodes it names still exist.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#  include <unistd.h>
+#endif
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.discovery"
+
+// Distinct buses that can be locked, see nfc_discovery_bus_lock()
+#define NFC_DISCOVERY_MAX_BUSES 16
+
+struct nfc_discovery_entry {
+  const struct nfc_driver *driver;
+  // Probed user-defined device, empty for a driver scan
+  nfc_connstring connstring;
+  // When the source was run, in µs
+  uint64_t time;
+  // Room the source had: when full, more devices may be there
+  size_t capacity;
+  size_t count;
+  nfc_connstring *connstrings;
+};
+
+struct nfc_discovery_cache {
+  nfc_mutex mutex;
+  size_t count;
+  struct nfc_discovery_entry *entries;
+};
+
+struct nfc_discovery_result {
+  bool done;
+  bool cached;
+  // Bus still scanned by a group of an earlier call
+  bool busy;
+  size_t count;
+  nfc_connstring *connstrings;
+};
+
+// Shared by nfc_discover() and its group threads, released by the last of them
+struct nfc_discovery_scan {
+  nfc_mutex mutex;
+  nfc_cond cond;
+  unsigned int refs;
+  // Groups still running
+  unsigned int pending;
+  // Copy of the caller's context, which left behind groups may outlive
+  nfc_context context;
+  size_t connstrings_len;
+  size_t szSources;
+  struct nfc_discovery_source *sources;
+  struct nfc_discovery_result *results;
+};
+
+struct nfc_discovery_group {
+  struct nfc_discovery_scan *scan;
+  // First source of the group
+  size_t first;
+};
+
+// Buses being scanned, possibly by groups left behind by a previous call
+static struct nfc_discovery_bus {
+  const char *bus;
+  nfc_mutex mutex;
+  // A group is scanning it
+  bool scanning;
+} nfc_discovery_buses[NFC_DISCOVERY_MAX_BUSES];
+static size_t nfc_discovery_bus_count = 0;
+
+// Find a bus, added on first use, with nfc_global_lock() held
+static struct nfc_discovery_bus *
+nfc_discovery_bus_find(const char *bus)
+{
+  for (size_t i = 0; i < nfc_discovery_bus_count; i++) {
+    if (strcmp(nfc_discovery_buses[i].bus, bus) == 0)
+      return &nfc_discovery_buses[i];
+  }
+  if (nfc_discovery_bus_count == NFC_DISCOVERY_MAX_BUSES)
+    return NULL;
+  struct nfc_discovery_bus *pb = &nfc_discovery_buses[nfc_discovery_bus_count++];
+  pb->bus = bus;
+  pb->scanning = false;
+  nfc_mutex_init(&pb->mutex);
+  return pb;
+}
+
+/**
+ * @brief Get the lock taken by scans and opens on a bus
+ * @return Returns the lock, or NULL when \a bus is NULL or too many buses are known
+ */
+nfc_mutex *
+nfc_discovery_bus_lock(const char *bus)
+{
+  if (!bus)
+    return NULL;
+  nfc_global_lock();
+  struct nfc_discovery_bus *pb = nfc_discovery_bus_find(bus);
+  nfc_global_unlock();
+  return pb ? &pb->mutex : NULL;
+}
+
+// Mark a bus as scanned by a group, false when a group of an earlier call still scans it
+static bool
+nfc_discovery_bus_claim(const char *bus)
+{
+  bool res = true;
+
+  if (!bus)
+    return true;
+  nfc_global_lock();
+  struct nfc_discovery_bus *pb = nfc_discovery_bus_find(bus);
+  if (pb) {
+    res = !pb->scanning;
+    pb->scanning = true;
+  }
+  nfc_global_unlock();
+  return res;
+}
+
+static void
+nfc_discovery_bus_unclaim(const char *bus)
+{
+  if (!bus)
+    return;
+  nfc_global_lock();
+  struct nfc_discovery_bus *pb = nfc_discovery_bus_find(bus);
+  if (pb)
+    pb->scanning = false;
+  nfc_global_unlock();
+}
+
+static const char *
+nfc_discovery_source_bus(const struct nfc_discovery_source *pns)
+{
+  return pns->driver ? pns->driver->scan_bus : NULL;
+}
+
+// Sources without bus are groups of their own
+static bool
+nfc_discovery_same_group(const struct nfc_discovery_source *pns1, const struct nfc_discovery_source *pns2)
+{
+  const char *bus1 = nfc_discovery_source_bus(pns1);
+  const char *bus2 = nfc_discovery_source_bus(pns2);
+  return (pns1 == pns2) || (bus1 && bus2 && (strcmp(bus1, bus2) == 0));
+}
+
+// Tell whether the device node named by a connstring is still there, when it can be told cheaply
+static bool
+nfc_discovery_node_exists(const char *connstring)
+{
+#ifndef _WIN32
+  char acPath[NFC_BUFSIZE_CONNSTRING];
+  const char *pcNode = strstr(connstring, ":/dev/");
+  if (pcNode) {
+    // e.g. pn532_uart:/dev/ttyUSB0:115200
+    pcNode++;
+    const size_t szPath = strcspn(pcNode, ":");
+    memcpy(acPath, pcNode, szPath);
+    acPath[szPath] = '\0';
+    return access(acPath, F_OK) == 0;
+  }
+#  ifdef __linux__
+  // e.g. pn53x_usb:001:004, libusb bus and device numbers
+  unsigned int uiBus, uiDevice;
+  char c;
+  const char *pcParams = strchr(connstring, ':');
+  if (pcParams && (sscanf(pcParams, ":%3u:%3u%c", &uiBus, &uiDevice, &c) == 2) && (access("/dev/bus/usb", F_OK) == 0)) {
+    snprintf(acPath, sizeof(acPath), "/dev/bus/usb/%03u/%03u", uiBus, uiDevice);
+    return access(acPath, F_OK) == 0;
+  }
+#  endif
+#else
+  (void) connstring;
+#endif
+  return true;
+}
+
+static struct nfc_discovery_entry *
+nfc_discovery_cache_find(struct nfc_discovery_cache *cache, const struct nfc_discovery_source *pns)
+{
+  for (size_t i = 0; i < cache->count; i++) {
+    struct nfc_discovery_entry *pe = &cache->entries[i];
+    if ((pe->driver == pns->driver) && (strcmp(pe->connstring, pns->connstring) == 0))
+      return pe;
+  }
+  return NULL;
+}
+
+// Fill a result from the cache, return false when the source has to be run
+static bool
+nfc_discovery_cache_get(struct nfc_discovery_cache *cache, const int ttl, const struct nfc_discovery_source *pns, const size_t connstrings_len, struct nfc_discovery_result *pr)
+{
+  bool res = false;
+
+  nfc_mutex_lock(&cache->mutex);
+  const struct nfc_discovery_entry *pe = nfc_discovery_cache_find(cache, pns);
+  if (pe && (nfc_stats_now() - pe->time < (uint64_t) ttl * 1000) &&
+      ((pe->count < pe->capacity) || (pe->capacity >= connstrings_len))) {
+    res = true;
+    for (size_t i = 0; res && (i < pe->count); i++)
+      res = nfc_discovery_node_exists(pe->connstrings[i]);
+    if (res) {
+      pr->count = (pe->count < connstrings_len) ? pe->count : connstrings_len;
+      memcpy(pr->connstrings, pe->connstrings, pr->count * sizeof(nfc_connstring));
+    }
+  }
+  nfc_mutex_unlock(&cache->mutex);
+  return res;
+}
+
+static void
+nfc_discovery_cache_put(struct nfc_discovery_cache *cache, const struct nfc_discovery_source *pns, const size_t connstrings_len, const struct nfc_discovery_result *pr)
+{
+  nfc_connstring *pConnstrings = NULL;
+  if (pr->count && !(pConnstrings = malloc(pr->count * sizeof(nfc_connstring))))
+    return;
+  if (pr->count)
+    memcpy(pConnstrings, pr->connstrings, pr->count * sizeof(nfc_connstring));
+
+  nfc_mutex_lock(&cache->mutex);
+  struct nfc_discovery_entry *pe = nfc_discovery_cache_find(cache, pns);
+  if (!pe) {
+    struct nfc_discovery_entry *pEntries = realloc(cache->entries, (cache->count + 1) * sizeof(struct nfc_discovery_entry));
+    if (!pEntries) {
+      nfc_mutex_unlock(&cache->mutex);
+      free(pConnstrings);
+      return;
+    }
+    cache->entries = pEntries;
+    pe = &cache->entries[cache->count++];
+    pe->driver = pns->driver;
+    memcpy(pe->connstring, pns->connstring, sizeof(nfc_connstring));
+    pe->connstrings = NULL;
+  }
+  free(pe->connstrings);
+  pe->connstrings = pConnstrings;
+  pe->count = pr->count;
+  pe->capacity = connstrings_len;
+  pe->time = nfc_stats_now();
+  nfc_mutex_unlock(&cache->mutex);
+}
+
+struct nfc_discovery_cache *
+nfc_discovery_cache_new(void)
+{
+  struct nfc_discovery_cache *cache = calloc(1, sizeof(struct nfc_discovery_cache));
+  if (cache)
+    nfc_mutex_init(&cache->mutex);
+  return cache;
+}
+
+/**
+ * @brief Forget what was found so far, so that next nfc_list_devices() scans again
+ */
+void
+nfc_discovery_cache_invalidate(struct nfc_discovery_cache *cache)
+{
+  if (!cache)
+    return;
+  nfc_mutex_lock(&cache->mutex);
+  for (size_t i = 0; i < cache->count; i++)
+    free(cache->entries[i].connstrings);
+  free(cache->entries);
+  cache->entries = NULL;
+  cache->count = 0;
+  nfc_mutex_unlock(&cache->mutex);
+}
+
+void
+nfc_discovery_cache_free(struct nfc_discovery_cache *cache)
+{
+  if (!cache)
+    return;
+  nfc_discovery_cache_invalidate(cache);
+  nfc_mutex_destroy(&cache->mutex);
+  free(cache);
+}
+
+static size_t
+nfc_discovery_source_run(nfc_context *context, const struct nfc_discovery_source *pns, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  if (!pns->probe) {
+    const size_t res = pns->driver->scan(context, connstrings, connstrings_len);
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%ld device(s) found using %s driver", (unsigned long) res, pns->driver->name);
+    return res;
+  }
+
+  // Let's make sure the user-defined device exists, silently
+  log_silence_begin();
+  nfc_device *pnd = nfc_open(context, pns->connstring);
+  log_silence_end();
+  if (!pnd)
+    return 0;
+  nfc_close(pnd);
+  memcpy(connstrings[0], pns->connstring, sizeof(nfc_connstring));
+  return 1;
+}
+
+static void
+nfc_discovery_scan_free(struct nfc_discovery_scan *ps)
+{
+  if (ps->results) {
+    for (size_t i = 0; i < ps->szSources; i++)
+      free(ps->results[i].connstrings);
+  }
+  free(ps->results);
+  free(ps->sources);
+  free(ps);
+}
+
+static void
+nfc_discovery_scan_release(struct nfc_discovery_scan *ps)
+{
+  nfc_mutex_lock(&ps->mutex);
+  const bool bLast = (--ps->refs == 0);
+  nfc_mutex_unlock(&ps->mutex);
+  if (bLast) {
+    nfc_cond_destroy(&ps->cond);
+    nfc_mutex_destroy(&ps->mutex);
+    nfc_discovery_scan_free(ps);
+  }
+}
+
+static void *
+nfc_discovery_group_thread(void *arg)
+{
+  struct nfc_discovery_group *pg = arg;
+  struct nfc_discovery_scan *ps = pg->scan;
+  const struct nfc_discovery_source *pnsFirst = &ps->sources[pg->first];
+  const char *bus = nfc_discovery_source_bus(pnsFirst);
+
+  nfc_mutex *pBusLock = nfc_discovery_bus_lock(bus);
+  if (pBusLock)
+    nfc_mutex_lock(pBusLock);
+  for (size_t i = pg->first; i < ps->szSources; i++) {
+    struct nfc_discovery_result *pr = &ps->results[i];
+    // Results from the cache are done before the group starts
+    if (pr->done || !nfc_discovery_same_group(pnsFirst, &ps->sources[i]))
+      continue;
+    const size_t count = nfc_discovery_source_run(&ps->context, &ps->sources[i], pr->connstrings, ps->connstrings_len);
+    nfc_mutex_lock(&ps->mutex);
+    pr->count = count;
+    pr->done = true;
+    nfc_mutex_unlock(&ps->mutex);
+  }
+  if (pBusLock)
+    nfc_mutex_unlock(pBusLock);
+  nfc_discovery_bus_unclaim(bus);
+
+  nfc_mutex_lock(&ps->mutex);
+  ps->pending--;
+  nfc_cond_broadcast(&ps->cond);
+  nfc_mutex_unlock(&ps->mutex);
+  free(pg);
+  nfc_discovery_scan_release(ps);
+  return NULL;
+}
+
+static struct nfc_discovery_scan *
+nfc_discovery_scan_new(const nfc_context *context, const struct nfc_discovery_source *sources, const size_t szSources, const size_t connstrings_len)
+{
+  struct nfc_discovery_scan *ps = calloc(1, sizeof(struct nfc_discovery_scan));
+  if (!ps)
+    return NULL;
+  ps->szSources = szSources;
+  ps->connstrings_len = connstrings_len;
+  ps->sources = malloc(szSources * sizeof(struct nfc_discovery_source));
+  ps->results = calloc(szSources, sizeof(struct nfc_discovery_result));
+  if (!ps->sources || !ps->results) {
+    nfc_discovery_scan_free(ps);
+    return NULL;
+  }
+  memcpy(ps->sources, sources, szSources * sizeof(struct nfc_discovery_source));
+  for (size_t i = 0; i < szSources; i++) {
+    // User-defined devices taken as they are need no room
+    if ((!sources[i].connstring[0] || sources[i].probe) &&
+        !(ps->results[i].connstrings = malloc(connstrings_len * sizeof(nfc_connstring)))) {
+      nfc_discovery_scan_free(ps);
+      return NULL;
+    }
+  }
+  // Probed devices are not captured, and the cache is only used by the caller
+  memcpy(&ps->context, context, sizeof(nfc_context));
+  strcpy(ps->context.capture_path, "");
+  ps->context.discovery_cache = NULL;
+  nfc_mutex_init(&ps->mutex);
+  nfc_cond_init(&ps->cond);
+  ps->refs = 1;
+  return ps;
+}
+
+/**
+ * @brief Find devices from user-defined devices and driver scans
+ * @return Returns the number of devices found
+ *
+ * @param context The context to operate on
+ * @param sources where to look for devices, in the order they are listed
+ * @param szSources size of \a sources
+ * @param connstrings array of \a nfc_connstring
+ * @param connstrings_len size of the \a connstrings array
+ */
+size_t
+nfc_discover(nfc_context *context, const struct nfc_discovery_source *sources, const size_t szSources, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  size_t device_found = 0;
+  size_t i;
+
+  // Nothing is run when the leading user-defined devices taken as they are fill connstrings
+  for (i = 0; (i < szSources) && sources[i].connstring[0] && !sources[i].probe; i++) {
+    if (device_found < connstrings_len)
+      memcpy(connstrings[device_found++], sources[i].connstring, sizeof(nfc_connstring));
+  }
+  if ((i == szSources) || (device_found == connstrings_len))
+    return device_found;
+  device_found = 0;
+
+  struct nfc_discovery_scan *ps = nfc_discovery_scan_new(context, sources, szSources, connstrings_len);
+  if (!ps)
+    return 0;
+
+  for (i = 0; i < szSources; i++) {
+    struct nfc_discovery_result *pr = &ps->results[i];
+    if (sources[i].connstring[0] && !sources[i].probe) {
+      pr->done = true;
+    } else if ((context->scan_cache_ttl > 0) && nfc_discovery_cache_get(context->discovery_cache, context->scan_cache_ttl, &sources[i], connstrings_len, pr)) {
+      pr->done = pr->cached = true;
+    }
+  }
+
+  // Start a thread for each group with something to run, from its first source
+  for (i = 0; i < szSources; i++) {
+    size_t j;
+    for (j = 0; (j < i) && !nfc_discovery_same_group(&sources[j], &sources[i]); j++)
+      ;
+    if (j < i)
+      continue;
+    for (j = i; (j < szSources) && (!nfc_discovery_same_group(&sources[i], &sources[j]) || ps->results[j].done); j++)
+      ;
+    if (j == szSources)
+      continue;
+
+    // A bus still scanned by a group left behind is not scanned twice at once
+    const char *bus = nfc_discovery_source_bus(&sources[i]);
+    if (!nfc_discovery_bus_claim(bus)) {
+      for (j = i; j < szSources; j++) {
+        if (nfc_discovery_same_group(&sources[i], &sources[j]) && !ps->results[j].done)
+          ps->results[j].busy = true;
+      }
+      continue;
+    }
+    struct nfc_discovery_group *pg = malloc(sizeof(struct nfc_discovery_group));
+    if (!pg) {
+      nfc_discovery_bus_unclaim(bus);
+      continue;
+    }
+    pg->scan = ps;
+    pg->first = i;
+    nfc_mutex_lock(&ps->mutex);
+    ps->pending++;
+    ps->refs++;
+    nfc_mutex_unlock(&ps->mutex);
+    nfc_thread thread;
+    if (nfc_thread_create(&thread, nfc_discovery_group_thread, pg) < 0) {
+      // Run it here instead
+      nfc_discovery_group_thread(pg);
+    } else {
+      nfc_thread_detach(thread);
+    }
+  }
+
+  nfc_mutex_lock(&ps->mutex);
+  const uint64_t ui64Deadline = nfc_stats_now() + (uint64_t) context->scan_timeout * 1000;
+  while (ps->pending) {
+    int timeout = 0;
+    if (context->scan_timeout > 0) {
+      const uint64_t ui64Now = nfc_stats_now();
+      if (ui64Now >= ui64Deadline)
+        break;
+      timeout = (int)((ui64Deadline - ui64Now + 999) / 1000);
+    }
+    nfc_cond_wait(&ps->cond, &ps->mutex, timeout);
+  }
+
+  for (i = 0; (i < szSources) && (device_found < connstrings_len); i++) {
+    struct nfc_discovery_result *pr = &ps->results[i];
+    if (pr->busy) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "%s bus still scanned by an earlier call, its devices are not listed",
+              sources[i].probe ? sources[i].connstring : sources[i].driver->name);
+      continue;
+    }
+    if (!pr->done) {
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "%s still running after %d ms, its devices are not listed",
+              sources[i].probe ? sources[i].connstring : sources[i].driver->name, context->scan_timeout);
+      continue;
+    }
+    if (!pr->connstrings) {
+      memcpy(connstrings[device_found++], sources[i].connstring, sizeof(nfc_connstring));
+      continue;
+    }
+    if ((context->scan_cache_ttl > 0) && !pr->cached)
+      nfc_discovery_cache_put(context->discovery_cache, &sources[i], connstrings_len, pr);
+    const size_t count = (pr->count < connstrings_len - device_found) ? pr->count : connstrings_len - device_found;
+    memcpy(connstrings[device_found], pr->connstrings, count * sizeof(nfc_connstring));
+    device_found += count;
+  }
+  nfc_mutex_unlock(&ps->mutex);
+  nfc_discovery_scan_release(ps);
+
+  return device_found;
+}
@@ -30,20 +30,26 @@
 * @brief Provide some useful internal functions
 */
 
-#include <nfc/nfc.h>
-#include "nfc-internal.h"
-
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+
 #ifdef CONFFILES
 #include "conf.h"
 #endif
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
 
 #define LOG_GROUP    NFC_LOG_GROUP_GENERAL
 #define LOG_CATEGORY "libnfc.general"
@@ -95,6 +101,14 @@ nfc_context_new(void)
     res->user_defined_devices[i].optional = false;
   }
   res->user_defined_device_count = 0;
+  strcpy(res->capture_path, "");
+  res->capture_count = 0;
+  res->scan_timeout = 0;
+  res->scan_cache_ttl = 0;
+  if (!(res->discovery_cache = nfc_discovery_cache_new())) {
+    free(res);
+    return NULL;
+  }
 
 #ifdef ENVVARS
   // Load user defined device from environment variable at first
@@ -138,6 +152,23 @@ nfc_context_new(void)
   if (envvar) {
     res->log_level = atoi(envvar);
   }
+
+  // Frame capture
+  envvar = getenv("LIBNFC_CAPTURE");
+  if (envvar) {
+    strncpy(res->capture_path, envvar, sizeof(res->capture_path));
+    res->capture_path[sizeof(res->capture_path) - 1] = '\0';
+  }
+
+  // Device discovery
+  envvar = getenv("LIBNFC_SCAN_TIMEOUT");
+  if (envvar) {
+    res->scan_timeout = atoi(envvar);
+  }
+  envvar = getenv("LIBNFC_SCAN_CACHE_TTL");
+  if (envvar) {
+    res->scan_cache_ttl = atoi(envvar);
+  }
 #endif // ENVVARS
 
   // Initialize log before use it...
@@ -151,6 +182,8 @@ nfc_context_new(void)
 #endif
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "allow_autoscan is set to %s", (res->allow_autoscan) ? "true" : "false");
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "allow_intrusive_scan is set to %s", (res->allow_intrusive_scan) ? "true" : "false");
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "scan_timeout is set to %d ms", res->scan_timeout);
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "scan_cache_ttl is set to %d ms", res->scan_cache_ttl);
 
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%d device(s) defined by user", res->user_defined_device_count);
   for (uint32_t i = 0; i < res->user_defined_device_count; i++) {
@@ -162,7 +195,8 @@ nfc_context_new(void)
 void
 nfc_context_free(nfc_context *context)
 {
-  log_exit();
+  log_exit(context);
+  nfc_discovery_cache_free(context->discovery_cache);
   free(context);
 }
 
@@ -198,6 +232,82 @@ prepare_initiator_data(const nfc_modulation nm, uint8_t **ppbtInitiatorData, siz
   }
 }
 
+// Bytes telling a target apart from the other targets of its modulation, e.g. its UID
+static size_t
+nfc_target_id(const nfc_target *pnt, const uint8_t **ppbtId)
+{
+  const nfc_target_info *pnti = &pnt->nti;
+
+  switch (pnt->nm.nmt) {
+    case NMT_ISO14443A:
+      *ppbtId = pnti->nai.abtUid;
+      return MIN(pnti->nai.szUidLen, sizeof(pnti->nai.abtUid));
+    case NMT_ISO14443B:
+      *ppbtId = pnti->nbi.abtPupi;
+      return sizeof(pnti->nbi.abtPupi);
+    case NMT_ISO14443BI:
+      *ppbtId = pnti->nii.abtDIV;
+      return sizeof(pnti->nii.abtDIV);
+    case NMT_ISO14443B2SR:
+      *ppbtId = pnti->nsi.abtUID;
+      return sizeof(pnti->nsi.abtUID);
+    case NMT_ISO14443B2CT:
+      *ppbtId = pnti->nci.abtUID;
+      return sizeof(pnti->nci.abtUID);
+    case NMT_ISO14443BICLASS:
+      *ppbtId = pnti->nhi.abtUID;
+      return sizeof(pnti->nhi.abtUID);
+    case NMT_FELICA:
+      *ppbtId = pnti->nfi.abtId;
+      return sizeof(pnti->nfi.abtId);
+    case NMT_JEWEL:
+      *ppbtId = pnti->nji.btId;
+      return sizeof(pnti->nji.btId);
+    case NMT_BARCODE:
+      *ppbtId = pnti->nti.abtData;
+      return MIN(pnti->nti.szDataLen, sizeof(pnti->nti.abtData));
+    case NMT_DEP:
+      *ppbtId = pnti->ndi.abtNFCID3;
+      return sizeof(pnti->ndi.abtNFCID3);
+  }
+  *ppbtId = NULL;
+  return 0;
+}
+
+/**
+ * @brief Hash the identifier (UID, PUPI, NFCID...) of a target
+ *
+ * Targets listed again hash the same, whatever the other data (e.g. ATS) they returned.
+ */
+uint32_t
+nfc_target_hash(const nfc_target *pnt)
+{
+  const uint8_t *pbtId;
+  const size_t szId = nfc_target_id(pnt, &pbtId);
+  // 32-bit FNV-1a
+  uint32_t ui32Hash = 2166136261u;
+
+  ui32Hash = (ui32Hash ^ (uint8_t) pnt->nm.nmt) * 16777619u;
+  for (size_t n = 0; n < szId; n++)
+    ui32Hash = (ui32Hash ^ pbtId[n]) * 16777619u;
+  return ui32Hash;
+}
+
+/**
+ * @brief Tell whether two targets have the same modulation type and identifier
+ */
+bool
+nfc_target_same(const nfc_target *pnt1, const nfc_target *pnt2)
+{
+  const uint8_t *pbtId1, *pbtId2;
+
+  if (pnt1->nm.nmt != pnt2->nm.nmt)
+    return false;
+  const size_t szId1 = nfc_target_id(pnt1, &pbtId1);
+  const size_t szId2 = nfc_target_id(pnt2, &pbtId2);
+  return (szId1 == szId2) && ((szId1 == 0) || (memcmp(pbtId1, pbtId2, szId1) == 0));
+}
+
 int
 connstring_decode(const nfc_connstring connstring, const char *driver_name, const char *bus_name, char **pparam1, char **pparam2)
 {
@@ -260,3 +370,303 @@ connstring_decode(const nfc_connstring connstring, const char *driver_name, cons
   return res;
 }
 
+void
+nfc_mutex_init(nfc_mutex *pMutex)
+{
+#ifdef _WIN32
+  InitializeCriticalSection(pMutex);
+#else
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(pMutex, &attr);
+  pthread_mutexattr_destroy(&attr);
+#endif
+}
+
+void
+nfc_mutex_destroy(nfc_mutex *pMutex)
+{
+#ifdef _WIN32
+  DeleteCriticalSection(pMutex);
+#else
+  pthread_mutex_destroy(pMutex);
+#endif
+}
+
+void
+nfc_mutex_lock(nfc_mutex *pMutex)
+{
+#ifdef _WIN32
+  EnterCriticalSection(pMutex);
+#else
+  pthread_mutex_lock(pMutex);
+#endif
+}
+
+void
+nfc_mutex_unlock(nfc_mutex *pMutex)
+{
+#ifdef _WIN32
+  LeaveCriticalSection(pMutex);
+#else
+  pthread_mutex_unlock(pMutex);
+#endif
+}
+
+void
+nfc_cond_init(nfc_cond *pCond)
+{
+#ifdef _WIN32
+  InitializeConditionVariable(pCond);
+#else
+  pthread_cond_init(pCond, NULL);
+#endif
+}
+
+void
+nfc_cond_destroy(nfc_cond *pCond)
+{
+#ifdef _WIN32
+  (void) pCond;
+#else
+  pthread_cond_destroy(pCond);
+#endif
+}
+
+/**
+ * @brief Wait for \a pCond to be signaled, with \a pMutex locked once
+ * @return Returns 0 when signaled (or spuriously woken up), NFC_ETIMEOUT after \a timeout ms, 0 meaning no timeout
+ */
+int
+nfc_cond_wait(nfc_cond *pCond, nfc_mutex *pMutex, const int timeout)
+{
+#ifdef _WIN32
+  if (!SleepConditionVariableCS(pCond, pMutex, (timeout > 0) ? (DWORD) timeout : INFINITE))
+    return (GetLastError() == ERROR_TIMEOUT) ? NFC_ETIMEOUT : NFC_ESOFT;
+  return 0;
+#else
+  if (timeout <= 0)
+    return pthread_cond_wait(pCond, pMutex) ? NFC_ESOFT : 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += timeout / 1000;
+  ts.tv_nsec += (timeout % 1000) * 1000000L;
+  if (ts.tv_nsec >= 1000000000L) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000L;
+  }
+  const int res = pthread_cond_timedwait(pCond, pMutex, &ts);
+  if (res == ETIMEDOUT)
+    return NFC_ETIMEOUT;
+  return res ? NFC_ESOFT : 0;
+#endif
+}
+
+void
+nfc_cond_broadcast(nfc_cond *pCond)
+{
+#ifdef _WIN32
+  WakeAllConditionVariable(pCond);
+#else
+  pthread_cond_broadcast(pCond);
+#endif
+}
+
+#ifdef _WIN32
+struct nfc_thread_start {
+  void *(*routine)(void *);
+  void *arg;
+};
+
+static DWORD WINAPI
+nfc_thread_trampoline(LPVOID lpParam)
+{
+  struct nfc_thread_start start = *(struct nfc_thread_start *) lpParam;
+  free(lpParam);
+  start.routine(start.arg);
+  return 0;
+}
+#endif
+
+/**
+ * @brief Run \a routine(\a arg) in a new thread
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ */
+int
+nfc_thread_create(nfc_thread *pThread, void *(*routine)(void *), void *arg)
+{
+#ifdef _WIN32
+  struct nfc_thread_start *start = malloc(sizeof(struct nfc_thread_start));
+  if (!start)
+    return NFC_ESOFT;
+  start->routine = routine;
+  start->arg = arg;
+  if (!(*pThread = CreateThread(NULL, 0, nfc_thread_trampoline, start, 0, NULL))) {
+    free(start);
+    return NFC_ESOFT;
+  }
+  return 0;
+#else
+  return pthread_create(pThread, NULL, routine, arg) ? NFC_ESOFT : 0;
+#endif
+}
+
+void
+nfc_thread_join(nfc_thread thread)
+{
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(thread, NULL);
+#endif
+}
+
+void
+nfc_thread_detach(nfc_thread thread)
+{
+#ifdef _WIN32
+  CloseHandle(thread);
+#else
+  pthread_detach(thread);
+#endif
+}
+
+#ifdef _WIN32
+static SRWLOCK nfc_global_mutex = SRWLOCK_INIT;
+#else
+static pthread_mutex_t nfc_global_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void
+nfc_global_lock(void)
+{
+#ifdef _WIN32
+  AcquireSRWLockExclusive(&nfc_global_mutex);
+#else
+  pthread_mutex_lock(&nfc_global_mutex);
+#endif
+}
+
+void
+nfc_global_unlock(void)
+{
+#ifdef _WIN32
+  ReleaseSRWLockExclusive(&nfc_global_mutex);
+#else
+  pthread_mutex_unlock(&nfc_global_mutex);
+#endif
+}
+
+/**
+ * @brief Monotonic time, in nanoseconds
+ */
+uint64_t
+nfc_now_ns(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER liFrequency, liNow;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liNow);
+  return (uint64_t)(liNow.QuadPart / liFrequency.QuadPart) * 1000000000 +
+         (uint64_t)(liNow.QuadPart % liFrequency.QuadPart) * 1000000000 / liFrequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Monotonic time, in microseconds, to time device inputs/outputs
+ */
+uint64_t
+nfc_stats_now(void)
+{
+  return nfc_now_ns() / 1000;
+}
+
+/**
+ * @brief Sleep for \a ui64Delay microseconds (rounded up to milliseconds under Windows)
+ */
+void
+nfc_usleep(const uint64_t ui64Delay)
+{
+#ifdef _WIN32
+  Sleep((DWORD)((ui64Delay + 999) / 1000));
+#else
+  struct timespec ts;
+  ts.tv_sec = ui64Delay / 1000000;
+  ts.tv_nsec = (ui64Delay % 1000000) * 1000;
+  nanosleep(&ts, NULL);
+#endif
+}
+
+/**
+ * @brief Account the time elapsed since \a ui64Start into \a pls
+ */
+void
+nfc_stats_add_latency(nfc_latency_stats *pls, const uint64_t ui64Start)
+{
+  const uint64_t ui64Duration = nfc_stats_now() - ui64Start;
+  uint64_t ui64Bound = ui64Duration;
+  size_t szBucket = 0;
+
+  // Bucket i holds durations from 2^(i-1) to 2^i us
+  while (ui64Bound && (szBucket < NFC_STATS_HISTOGRAM_LEN - 1)) {
+    ui64Bound >>= 1;
+    szBucket++;
+  }
+  pls->histogram[szBucket]++;
+  pls->count++;
+  pls->total_us += ui64Duration;
+  if (ui64Duration > pls->max_us)
+    pls->max_us = ui64Duration;
+}
+
+/**
+ * @brief Get the statistics of a chip command
+ * @return the statistics entry of \a btCode, or NULL if all entries are used by other commands
+ */
+nfc_command_stats *
+nfc_stats_command(nfc_device *pnd, const uint8_t btCode)
+{
+  nfc_device_stats *pStats = &pnd->stats;
+  size_t n;
+
+  for (n = 0; n < pStats->command_count; n++) {
+    if (pStats->commands[n].code == btCode)
+      return &pStats->commands[n];
+  }
+  if (n == NFC_STATS_COMMANDS_LEN)
+    return NULL;
+  pStats->commands[n].code = btCode;
+  pStats->command_count++;
+  return &pStats->commands[n];
+}
+
+/**
+ * @brief Account a frame written to the device by its driver
+ *
+ * The time since the start of the output is accounted as send time, the
+ * acknowledgement wait (if any) is timed from now on.
+ */
+void
+nfc_stats_frame_sent(nfc_device *pnd, const size_t szFrame)
+{
+  pnd->stats.frames_sent++;
+  pnd->stats.bytes_sent += szFrame;
+  nfc_stats_add_latency(&pnd->stats.send, pnd->stats_io_start);
+  pnd->stats_io_start = nfc_stats_now();
+}
+
+/**
+ * @brief Account a frame received from the device by its driver
+ */
+void
+nfc_stats_frame_received(nfc_device *pnd, const size_t szFrame)
+{
+  pnd->stats.frames_received++;
+  pnd->stats.bytes_received += szFrame;
+}
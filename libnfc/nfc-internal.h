@@ -37,6 +37,11 @@
 #if !defined(_MSC_VER)
 #  include <sys/time.h>
 #endif
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
 
 #include "nfc/nfc.h"
 
@@ -127,6 +132,8 @@ struct nfc_driver {
   const char *name;
   const scan_type_enum scan_type;
   size_t (*scan)(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len);
+  /** Optional: bus probed by scan(), drivers sharing one are not scanned concurrently, see nfc_discover() */
+  const char *scan_bus;
   struct nfc_device *(*open)(const nfc_context *context, const nfc_connstring connstring);
   void (*close)(struct nfc_device *pnd);
   const char *(*strerror)(const struct nfc_device *pnd);
@@ -134,14 +141,20 @@ struct nfc_driver {
   int (*initiator_init)(struct nfc_device *pnd);
   int (*initiator_init_secure_element)(struct nfc_device *pnd);
   int (*initiator_select_passive_target)(struct nfc_device *pnd,  const nfc_modulation nm, const uint8_t *pbtInitData, const size_t szInitData, nfc_target *pnt);
+  /** Optional: select up to szTargets targets at once, returning how many were selected */
+  int (*initiator_select_passive_targets)(struct nfc_device *pnd,  const nfc_modulation nm, const uint8_t *pbtInitData, const size_t szInitData, nfc_target ant[], const size_t szTargets);
   int (*initiator_poll_target)(struct nfc_device *pnd, const nfc_modulation *pnmModulations, const size_t szModulations, const uint8_t uiPollNr, const uint8_t btPeriod, nfc_target *pnt);
   int (*initiator_select_dep_target)(struct nfc_device *pnd, const nfc_dep_mode ndm, const nfc_baud_rate nbr, const nfc_dep_info *pndiInitiator, nfc_target *pnt, const int timeout);
   int (*initiator_deselect_target)(struct nfc_device *pnd);
   int (*initiator_transceive_bytes)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, int timeout);
+  int (*initiator_transceive_bytes_async)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
+  int (*initiator_transceive_bytes_complete)(struct nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int timeout);
   int (*initiator_transceive_bits)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar);
   int (*initiator_transceive_bytes_timed)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx, const size_t szRx, uint32_t *cycles);
   int (*initiator_transceive_bits_timed)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar, uint8_t *pbtRx, uint8_t *pbtRxPar, uint32_t *cycles);
   int (*initiator_target_is_present)(struct nfc_device *pnd, const nfc_target *pnt);
+  /** Optional: wait up to timeout ms for a target to come (present false) or go (present true), returning 1 if it did, 0 otherwise */
+  int (*initiator_target_wait_presence)(struct nfc_device *pnd, const bool present, const int timeout);
 
   int (*target_init)(struct nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRx, int timeout);
   int (*target_send_bytes)(struct nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout);
@@ -154,6 +167,7 @@ struct nfc_driver {
   int (*get_supported_modulation)(struct nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type **const supported_mt);
   int (*get_supported_baud_rate)(struct nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br);
   int (*device_get_information_about)(struct nfc_device *pnd, char **buf);
+  int (*device_get_pollfd)(struct nfc_device *pnd);
 
   int (*abort_command)(struct nfc_device *pnd);
   int (*idle)(struct nfc_device *pnd);
@@ -182,11 +196,89 @@ struct nfc_context {
   uint32_t  log_level;
   struct nfc_user_defined_device user_defined_devices[MAX_USER_DEFINED_DEVICES];
   unsigned int user_defined_device_count;
+  /** File the frames of opened devices are captured to, empty for none */
+  char capture_path[NFC_BUFSIZE_CONNSTRING];
+  /** Count of the devices captured so far */
+  unsigned int capture_count;
+  /** Longest wait for drivers scanning in nfc_list_devices(), in ms, 0 to wait for all of them */
+  int scan_timeout;
+  /** How long nfc_list_devices() results are reused, in ms, 0 to scan every time */
+  int scan_cache_ttl;
+  /** Results of the previous scans */
+  struct nfc_discovery_cache *discovery_cache;
+  /** Next context whose log level is merged into the cached one, see log_init() */
+  struct nfc_context *log_next;
 };
 
 nfc_context *nfc_context_new(void);
 void nfc_context_free(nfc_context *context);
 
+/**
+ * @brief Where nfc_discover() looks for devices
+ */
+struct nfc_discovery_source {
+  /** Driver to scan with, or driver of the user-defined device */
+  const struct nfc_driver *driver;
+  /** User-defined device, empty to scan with \a driver */
+  nfc_connstring connstring;
+  /** Whether the user-defined device is opened to check it is there */
+  bool probe;
+};
+
+size_t nfc_discover(nfc_context *context, const struct nfc_discovery_source *sources, const size_t szSources, nfc_connstring connstrings[], const size_t connstrings_len);
+struct nfc_discovery_cache *nfc_discovery_cache_new(void);
+void nfc_discovery_cache_free(struct nfc_discovery_cache *cache);
+void nfc_discovery_cache_invalidate(struct nfc_discovery_cache *cache);
+
+/**
+ * Recursive mutex
+ */
+#ifdef _WIN32
+typedef CRITICAL_SECTION nfc_mutex;
+#else
+typedef pthread_mutex_t nfc_mutex;
+#endif
+
+void nfc_mutex_init(nfc_mutex *pMutex);
+void nfc_mutex_destroy(nfc_mutex *pMutex);
+void nfc_mutex_lock(nfc_mutex *pMutex);
+void nfc_mutex_unlock(nfc_mutex *pMutex);
+
+/**
+ * Condition variable, waited for with a locked \a nfc_mutex
+ */
+#ifdef _WIN32
+typedef CONDITION_VARIABLE nfc_cond;
+typedef HANDLE nfc_thread;
+#else
+typedef pthread_cond_t nfc_cond;
+typedef pthread_t nfc_thread;
+#endif
+
+void nfc_cond_init(nfc_cond *pCond);
+void nfc_cond_destroy(nfc_cond *pCond);
+int  nfc_cond_wait(nfc_cond *pCond, nfc_mutex *pMutex, const int timeout);
+void nfc_cond_broadcast(nfc_cond *pCond);
+
+int  nfc_thread_create(nfc_thread *pThread, void *(*routine)(void *), void *arg);
+void nfc_thread_join(nfc_thread thread);
+void nfc_thread_detach(nfc_thread thread);
+
+/*
+ * Lock of the process wide state: drivers list, shared bus and PC/SC
+ * contexts.  It is not recursive, so it must not be held across calls
+ * which may take it again.
+ */
+void nfc_global_lock(void);
+void nfc_global_unlock(void);
+
+/*
+ * Lock of a bus (see nfc_driver scan_bus), held while its drivers scan or
+ * open a device, so that a scan left behind by nfc_list_devices() does not
+ * run along an open on the same bus.
+ */
+nfc_mutex *nfc_discovery_bus_lock(const char *bus);
+
 /**
  * @struct nfc_device
  * @brief NFC device information
@@ -216,17 +308,61 @@ struct nfc_device {
   uint8_t  btSupportByte;
   /** Last reported error */
   int     last_error;
+  /** Input/output statistics */
+  nfc_device_stats stats;
+  /** Start of the input/output being timed, in us */
+  uint64_t stats_io_start;
+  /** Serializes the public API calls made on this device, see NFC_DEVICE_LOCK */
+  nfc_mutex lock;
+  /** Target watch started by nfc_device_watch_targets() */
+  struct nfc_target_watch *watch;
+  /** Frame capture, see nfc-capture.h */
+  struct nfc_capture *capture;
 };
 
 nfc_device *nfc_device_new(const nfc_context *context, const nfc_connstring connstring);
 void        nfc_device_free(nfc_device *dev);
 
+nfc_device *nfc_device_lock(nfc_device *pnd);
+void        nfc_device_unlock(nfc_device *pnd);
+void        nfc_device_unlock_scope(nfc_device *const *ppnd);
+
+/**
+ * @macro NFC_DEVICE_LOCK
+ * @brief Hold the lock of a device until the end of the enclosing block
+ *
+ * The lock is recursive, so public functions calling each other can all take it.
+ * The lock is released by a scope cleanup, so that every return path does it:
+ * compilers without cleanup support cannot build libnfc, as they could not
+ * build HAL() and its statement expression either.
+ */
+#ifndef __has_attribute
+#  define __has_attribute(x) 0
+#endif
+#if defined(__GNUC__) || __has_attribute(cleanup)
+#  define NFC_DEVICE_LOCK(pnd) \
+  nfc_device *const nfc_locked_device __attribute__((cleanup(nfc_device_unlock_scope))) = nfc_device_lock((nfc_device *)(pnd))
+#else
+#  error "NFC_DEVICE_LOCK needs __attribute__((cleanup)) to unlock devices on every return path"
+#endif
+
+uint64_t nfc_now_ns(void);
+uint64_t nfc_stats_now(void);
+void nfc_usleep(const uint64_t ui64Delay);
+void nfc_stats_add_latency(nfc_latency_stats *pls, const uint64_t ui64Start);
+nfc_command_stats *nfc_stats_command(nfc_device *pnd, const uint8_t btCode);
+void nfc_stats_frame_sent(nfc_device *pnd, const size_t szFrame);
+void nfc_stats_frame_received(nfc_device *pnd, const size_t szFrame);
+
 void string_as_boolean(const char *s, bool *value);
 
 void iso14443_cascade_uid(const uint8_t abtUID[], const size_t szUID, uint8_t *pbtCascadedUID, size_t *pszCascadedUID);
 
 void prepare_initiator_data(const nfc_modulation nm, uint8_t **ppbtInitiatorData, size_t *pszInitiatorData);
 
+uint32_t nfc_target_hash(const nfc_target *pnt);
+bool nfc_target_same(const nfc_target *pnt1, const nfc_target *pnt2);
+
 int connstring_decode(const nfc_connstring connstring, const char *driver_name, const char *bus_name, char **pparam1, char **pparam2);
 
 #endif // __NFC_INTERNAL_H__
@@ -0,0 +1,445 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-poll-group.c
+ * @brief Poll several devices concurrently
+ *
+ * A small pool of worker threads takes turns on the devices of a group: each
+ * turn lists the targets of one modulation on the device polled the longest
+ * time ago, then queues them as events for the application. A device which
+ * has its share of the event queue waiting to be read is skipped until the
+ * application catches up, so neither a slow reader nor a busy one can hold
+ * back the others.
+ *
+ * A target is reported once when it comes: targets whose hash was already
+ * listed by the previous turn of the same modulation on the same device are
+ * not queued again.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.poll"
+
+// Default event queue length
+#define NFC_POLL_GROUP_EVENTS 64
+// Most targets listed in a turn
+#define NFC_POLL_GROUP_TARGETS 8
+
+// Targets listed by the last turn of a modulation
+struct nfc_poll_seen {
+  uint32_t hashes[NFC_POLL_GROUP_TARGETS];
+  size_t count;
+};
+
+struct nfc_poll_member {
+  nfc_device *pnd;
+  /** Targets listed by the last turn of each modulation */
+  struct nfc_poll_seen *seen;
+  /** Next modulation to poll */
+  size_t modulation;
+  /** Events queued and not read yet */
+  size_t pending;
+  /** Turn it was last polled at */
+  uint64_t turn;
+  bool busy;
+  bool failed;
+};
+
+struct nfc_poll_group {
+  nfc_mutex mutex;
+  /** Signaled when a parked device may be polled again, or on stop */
+  nfc_cond work;
+  /** Signaled when events are queued, or on stop */
+  nfc_cond events;
+  nfc_modulation *modulations;
+  size_t szModulations;
+  struct nfc_poll_member *members;
+  size_t szMembers;
+  /** Members no longer polled because of an error */
+  size_t szFailed;
+  nfc_thread *workers;
+  size_t szWorkers;
+  /** Ring of events */
+  nfc_poll_event *queue;
+  size_t szQueue;
+  size_t szHead;
+  size_t szCount;
+  /** Events a device may have queued */
+  size_t szQuota;
+  uint64_t turn;
+  bool running;
+};
+
+// Next device to poll: the one which waited the longest, with room in the queue
+static struct nfc_poll_member *
+nfc_poll_group_pick(nfc_poll_group *group)
+{
+  struct nfc_poll_member *pm = NULL;
+  for (size_t i = 0; i < group->szMembers; i++) {
+    struct nfc_poll_member *candidate = &group->members[i];
+    if (candidate->busy || candidate->failed || (candidate->pending >= group->szQuota))
+      continue;
+    if (!pm || (candidate->turn < pm->turn))
+      pm = candidate;
+  }
+  return pm;
+}
+
+static void
+nfc_poll_group_push(nfc_poll_group *group, struct nfc_poll_member *pm, const size_t szModulation, const int error, const nfc_target *pnt)
+{
+  nfc_poll_event *pev = &group->queue[(group->szHead + group->szCount) % group->szQueue];
+  pev->device = pm->pnd;
+  pev->modulation = szModulation;
+  pev->error = error;
+  if (pnt)
+    pev->target = *pnt;
+  else
+    memset(&pev->target, 0, sizeof(pev->target));
+  group->szCount++;
+  pm->pending++;
+}
+
+static bool
+nfc_poll_group_seen(const struct nfc_poll_seen *ps, const uint32_t ui32Hash)
+{
+  for (size_t i = 0; i < ps->count; i++) {
+    if (ps->hashes[i] == ui32Hash)
+      return true;
+  }
+  return false;
+}
+
+static void *
+nfc_poll_group_worker(void *arg)
+{
+  nfc_poll_group *group = arg;
+  nfc_target ant[NFC_POLL_GROUP_TARGETS];
+
+  nfc_mutex_lock(&group->mutex);
+  while (group->running) {
+    struct nfc_poll_member *pm = nfc_poll_group_pick(group);
+    if (!pm) {
+      nfc_cond_wait(&group->work, &group->mutex, 0);
+      continue;
+    }
+    const size_t szModulation = pm->modulation;
+    size_t szTargets = group->szQuota - pm->pending;
+    if (szTargets > NFC_POLL_GROUP_TARGETS)
+      szTargets = NFC_POLL_GROUP_TARGETS;
+    pm->busy = true;
+    nfc_mutex_unlock(&group->mutex);
+
+    const int res = nfc_initiator_list_passive_targets(pm->pnd, group->modulations[szModulation], ant, szTargets);
+    if (res < 0)
+      log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "Stop polling %s: %s", nfc_device_get_name(pm->pnd), nfc_strerror(pm->pnd));
+
+    // Targets still there since the last turn were already reported
+    struct nfc_poll_seen *ps = &pm->seen[szModulation];
+    struct nfc_poll_seen seen = { .count = 0 };
+    bool abNew[NFC_POLL_GROUP_TARGETS];
+    for (int i = 0; i < res; i++) {
+      seen.hashes[i] = nfc_target_hash(&ant[i]);
+      abNew[i] = !nfc_poll_group_seen(ps, seen.hashes[i]);
+    }
+    if (res >= 0) {
+      seen.count = res;
+      *ps = seen;
+    }
+
+    nfc_mutex_lock(&group->mutex);
+    bool bQueued = false;
+    if (res < 0) {
+      // Keep the other devices going, this one will not be polled again
+      nfc_poll_group_push(group, pm, szModulation, res, NULL);
+      pm->failed = true;
+      group->szFailed++;
+      bQueued = true;
+    }
+    for (int i = 0; i < res; i++) {
+      if (abNew[i]) {
+        nfc_poll_group_push(group, pm, szModulation, NFC_SUCCESS, &ant[i]);
+        bQueued = true;
+      }
+    }
+    if (bQueued)
+      nfc_cond_broadcast(&group->events);
+    pm->modulation = (szModulation + 1) % group->szModulations;
+    pm->turn = ++group->turn;
+    pm->busy = false;
+  }
+  nfc_mutex_unlock(&group->mutex);
+  return NULL;
+}
+
+/** @ingroup initiator
+ * @brief Create a group of devices to poll concurrently
+ * @return Returns a new poll group, or \c NULL on error
+ *
+ * @param pnmModulations desired modulations, polled in turn on each device
+ * @param szModulations size of \a pnmModulations
+ * @param szEvents length of the event queue, 0 for a default one
+ *
+ * Devices are added with nfc_poll_group_add(), then polled from the threads
+ * started by nfc_poll_group_start() and targets are read with nfc_poll_group_next().
+ * A target is reported when a device finds it, not on each turn it stays in
+ * the field of that device.
+ */
+nfc_poll_group *
+nfc_poll_group_new(const nfc_modulation *pnmModulations, const size_t szModulations, const size_t szEvents)
+{
+  if (!pnmModulations || !szModulations)
+    return NULL;
+
+  nfc_poll_group *group = calloc(1, sizeof(nfc_poll_group));
+  if (!group)
+    return NULL;
+  group->szModulations = szModulations;
+  group->szQueue = szEvents ? szEvents : NFC_POLL_GROUP_EVENTS;
+  group->modulations = malloc(szModulations * sizeof(nfc_modulation));
+  group->queue = malloc(group->szQueue * sizeof(nfc_poll_event));
+  if (!group->modulations || !group->queue) {
+    free(group->modulations);
+    free(group->queue);
+    free(group);
+    return NULL;
+  }
+  memcpy(group->modulations, pnmModulations, szModulations * sizeof(nfc_modulation));
+  nfc_mutex_init(&group->mutex);
+  nfc_cond_init(&group->work);
+  nfc_cond_init(&group->events);
+  return group;
+}
+
+/** @ingroup initiator
+ * @brief Add a device to a poll group
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param group poll group, not started
+ * @param pnd \a nfc_device struct pointer, which is set up as initiator
+ *
+ * The device must stay opened until the group is freed. It may still be used
+ * by the application while the group polls it, calls being serialized.
+ */
+int
+nfc_poll_group_add(nfc_poll_group *group, nfc_device *pnd)
+{
+  int res;
+
+  if (!group || !pnd)
+    return NFC_EINVARG;
+  nfc_mutex_lock(&group->mutex);
+  if (group->running) {
+    nfc_mutex_unlock(&group->mutex);
+    return NFC_EINVARG;
+  }
+  nfc_mutex_unlock(&group->mutex);
+
+  if ((res = nfc_initiator_init(pnd)) < 0)
+    return res;
+
+  struct nfc_poll_seen *seen = calloc(group->szModulations, sizeof(struct nfc_poll_seen));
+  if (!seen)
+    return NFC_ESOFT;
+  struct nfc_poll_member *members = realloc(group->members, (group->szMembers + 1) * sizeof(struct nfc_poll_member));
+  if (!members) {
+    free(seen);
+    return NFC_ESOFT;
+  }
+  group->members = members;
+  memset(&members[group->szMembers], 0, sizeof(struct nfc_poll_member));
+  members[group->szMembers].pnd = pnd;
+  members[group->szMembers].seen = seen;
+  group->szMembers++;
+  return NFC_SUCCESS;
+}
+
+/** @ingroup initiator
+ * @brief Start polling the devices of a group
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param group poll group
+ * @param szWorkers amount of polling threads, 0 for one per device
+ *
+ * Devices are polled in turn, each turn trying one modulation on one device.
+ * Fewer threads than devices lower the load but a slow device then delays the others.
+ */
+int
+nfc_poll_group_start(nfc_poll_group *group, const size_t szWorkers)
+{
+  if (!group || !group->szMembers || group->running)
+    return NFC_EINVARG;
+
+  // Each device gets an equal share of the queue, which holds at least one event per device
+  if (group->szQueue < group->szMembers) {
+    nfc_poll_event *queue = malloc(group->szMembers * sizeof(nfc_poll_event));
+    if (!queue)
+      return NFC_ESOFT;
+    for (size_t i = 0; i < group->szCount; i++)
+      queue[i] = group->queue[(group->szHead + i) % group->szQueue];
+    free(group->queue);
+    group->queue = queue;
+    group->szQueue = group->szMembers;
+    group->szHead = 0;
+  }
+  group->szQuota = group->szQueue / group->szMembers;
+  for (size_t i = 0; i < group->szMembers; i++) {
+    group->members[i].failed = false;
+    memset(group->members[i].seen, 0, group->szModulations * sizeof(struct nfc_poll_seen));
+  }
+  group->szFailed = 0;
+
+  group->szWorkers = ((szWorkers == 0) || (szWorkers > group->szMembers)) ? group->szMembers : szWorkers;
+  if (!(group->workers = malloc(group->szWorkers * sizeof(nfc_thread))))
+    return NFC_ESOFT;
+  group->running = true;
+  for (size_t i = 0; i < group->szWorkers; i++) {
+    if (nfc_thread_create(&group->workers[i], nfc_poll_group_worker, group) < 0) {
+      group->szWorkers = i;
+      nfc_poll_group_stop(group);
+      return NFC_ESOFT;
+    }
+  }
+  return NFC_SUCCESS;
+}
+
+/** @ingroup initiator
+ * @brief Get the next event of a poll group
+ * @return Returns 0 when \a pevent was filled, NFC_ETIMEOUT when no event came in time, NFC_EOPABORTED when the group is stopped, or all its devices failed, and has no more events
+ *
+ * @param group poll group
+ * @param[out] pevent event, holding either a target or the error which stopped polling a device
+ * @param timeout in milliseconds, 0 to wait until an event comes, negative not to wait
+ */
+int
+nfc_poll_group_next(nfc_poll_group *group, nfc_poll_event *pevent, const int timeout)
+{
+  if (!group || !pevent)
+    return NFC_EINVARG;
+
+  const uint64_t ui64Deadline = nfc_stats_now() + (uint64_t)((timeout > 0) ? timeout : 0) * 1000;
+  int res = NFC_SUCCESS;
+
+  nfc_mutex_lock(&group->mutex);
+  while (!group->szCount) {
+    if (!group->running || (group->szFailed == group->szMembers)) {
+      res = NFC_EOPABORTED;
+      break;
+    }
+    if (timeout < 0) {
+      res = NFC_ETIMEOUT;
+      break;
+    }
+    int iWait = 0;
+    if (timeout > 0) {
+      const uint64_t ui64Now = nfc_stats_now();
+      if (ui64Now >= ui64Deadline) {
+        res = NFC_ETIMEOUT;
+        break;
+      }
+      iWait = (int)((ui64Deadline - ui64Now + 999) / 1000);
+    }
+    nfc_cond_wait(&group->events, &group->mutex, iWait);
+  }
+  if (group->szCount) {
+    *pevent = group->queue[group->szHead];
+    group->szHead = (group->szHead + 1) % group->szQueue;
+    group->szCount--;
+    for (size_t i = 0; i < group->szMembers; i++) {
+      struct nfc_poll_member *pm = &group->members[i];
+      if (pm->pnd == pevent->device) {
+        // A device parked on its quota can be polled again
+        if (pm->pending-- == group->szQuota)
+          nfc_cond_broadcast(&group->work);
+        break;
+      }
+    }
+    res = NFC_SUCCESS;
+  }
+  nfc_mutex_unlock(&group->mutex);
+  return res;
+}
+
+/** @ingroup initiator
+ * @brief Stop polling the devices of a group
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param group poll group
+ *
+ * Waits for the turns in progress to end. Events already queued can still be read.
+ */
+int
+nfc_poll_group_stop(nfc_poll_group *group)
+{
+  if (!group)
+    return NFC_EINVARG;
+
+  nfc_mutex_lock(&group->mutex);
+  group->running = false;
+  nfc_cond_broadcast(&group->work);
+  nfc_cond_broadcast(&group->events);
+  nfc_mutex_unlock(&group->mutex);
+
+  for (size_t i = 0; i < group->szWorkers; i++)
+    nfc_thread_join(group->workers[i]);
+  free(group->workers);
+  group->workers = NULL;
+  group->szWorkers = 0;
+  return NFC_SUCCESS;
+}
+
+/** @ingroup initiator
+ * @brief Stop and free a poll group
+ *
+ * @param group poll group, its devices are left opened
+ */
+void
+nfc_poll_group_free(nfc_poll_group *group)
+{
+  if (!group)
+    return;
+  nfc_poll_group_stop(group);
+  nfc_cond_destroy(&group->events);
+  nfc_cond_destroy(&group->work);
+  nfc_mutex_destroy(&group->mutex);
+  for (size_t i = 0; i < group->szMembers; i++)
+    free(group->members[i].seen);
+  free(group->members);
+  free(group->modulations);
+  free(group->queue);
+  free(group);
+}
@@ -0,0 +1,245 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+/**
+ * @file nfc-target-watch.c
+ * @brief Notify target arrivals and departures
+ *
+ * A thread per watched device alternates between two states. Without target,
+ * it lists one target of each modulation every period, with the RF field
+ * switched off in between. With a target, it checks every period that the
+ * target is still there, using the cheapest probe the chip has for its type
+ * (e.g. PN53x Diagnose card presence). Drivers able to wait for card state
+ * changes themselves, like PC/SC, are waited on instead and no RF polling is
+ * done by libnfc.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+
+#define LOG_GROUP    NFC_LOG_GROUP_GENERAL
+#define LOG_CATEGORY "libnfc.watch"
+
+// Default period between two presence checks, in ms
+#define NFC_TARGET_WATCH_PERIOD 200
+// Longest wait in a driver, so that unwatching is not delayed much more
+#define NFC_TARGET_WATCH_SLICE 250
+
+struct nfc_target_watch {
+  nfc_device *pnd;
+  nfc_modulation *modulations;
+  size_t szModulations;
+  int period;
+  nfc_target_callback callback;
+  void *user_data;
+  nfc_mutex mutex;
+  nfc_cond cond;
+  nfc_thread thread;
+  bool stop;
+};
+
+// Sleep for timeout ms, return false when the watch is stopped
+static bool
+nfc_target_watch_sleep(struct nfc_target_watch *pw, const int timeout)
+{
+  nfc_mutex_lock(&pw->mutex);
+  if (!pw->stop && timeout)
+    nfc_cond_wait(&pw->cond, &pw->mutex, timeout);
+  const bool bRunning = !pw->stop;
+  nfc_mutex_unlock(&pw->mutex);
+  return bRunning;
+}
+
+// Find a target of any of the watched modulations, left selected
+static bool
+nfc_target_watch_scan(struct nfc_target_watch *pw, nfc_target *pnt)
+{
+  for (size_t i = 0; i < pw->szModulations; i++) {
+    if (nfc_initiator_list_passive_targets(pw->pnd, pw->modulations[i], pnt, 1) == 1)
+      return true;
+  }
+  return false;
+}
+
+static bool
+nfc_target_watch_is_present(struct nfc_target_watch *pw, const nfc_target *pnt)
+{
+  int res = nfc_initiator_target_is_present(pw->pnd, NULL);
+  if (res != NFC_EDEVNOTSUPP)
+    return res == NFC_SUCCESS;
+
+  // No probe for this target type: select it again
+  nfc_target nt;
+  nfc_initiator_deselect_target(pw->pnd);
+  res = nfc_initiator_list_passive_targets(pw->pnd, pnt->nm, &nt, 1);
+  return (res == 1) && (memcmp(&nt.nti, &pnt->nti, sizeof(nt.nti)) == 0);
+}
+
+static void *
+nfc_target_watch_thread(void *arg)
+{
+  struct nfc_target_watch *pw = arg;
+  nfc_device *pnd = pw->pnd;
+  nfc_target nt;
+  bool bPresent = false;
+
+  if (pnd->driver->initiator_target_wait_presence) {
+    const int iSlice = (pw->period < NFC_TARGET_WATCH_SLICE) ? pw->period : NFC_TARGET_WATCH_SLICE;
+    // A card of none of the watched modulations is followed but not reported
+    bool bCard = false;
+    while (nfc_target_watch_sleep(pw, 0)) {
+      const int res = pnd->driver->initiator_target_wait_presence(pnd, bCard, iSlice);
+      if (res < 0) {
+        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Waiting for target change failed (%d)", res);
+        nfc_target_watch_sleep(pw, pw->period);
+      } else if (res > 0) {
+        bCard = !bCard;
+        if (bCard) {
+          if ((bPresent = nfc_target_watch_scan(pw, &nt)))
+            pw->callback(pnd, &nt, true, pw->user_data);
+        } else if (bPresent) {
+          bPresent = false;
+          pw->callback(pnd, &nt, false, pw->user_data);
+        }
+      }
+    }
+    return NULL;
+  }
+
+  while (nfc_target_watch_sleep(pw, 0)) {
+    if (!bPresent) {
+      nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, true);
+      if ((bPresent = nfc_target_watch_scan(pw, &nt))) {
+        pw->callback(pnd, &nt, true, pw->user_data);
+      } else {
+        // Save power until the next scan
+        nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, false);
+      }
+    } else if (!nfc_target_watch_is_present(pw, &nt)) {
+      bPresent = false;
+      pw->callback(pnd, &nt, false, pw->user_data);
+      // Look for a new target at once
+      continue;
+    }
+    nfc_target_watch_sleep(pw, pw->period);
+  }
+  return NULL;
+}
+
+/** @ingroup initiator
+ * @brief Watch targets coming to and leaving a device
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param pnmModulations desired modulations
+ * @param szModulations size of \a pnmModulations
+ * @param period time between two scans or presence checks in ms, 0 for a default one; longer periods lower the RF duty cycle but delay detection
+ * @param callback called on each target arrival and departure
+ * @param user_data passed to \a callback
+ *
+ * The device is set up as initiator and then watched from a dedicated thread,
+ * which calls \a callback. One target is followed at a time: it stays selected
+ * until it leaves, so \a callback and the application may communicate with it
+ * meanwhile. \a callback must not call nfc_device_unwatch_targets() nor nfc_close().
+ */
+int
+nfc_device_watch_targets(nfc_device *pnd, const nfc_modulation *pnmModulations, const size_t szModulations, const int period, nfc_target_callback callback, void *user_data)
+{
+  NFC_DEVICE_LOCK(pnd);
+  int res;
+
+  if (!pnmModulations || !szModulations || !callback || (period < 0))
+    return pnd->last_error = NFC_EINVARG;
+  if (pnd->watch)
+    return pnd->last_error = NFC_EINVARG;
+  if ((res = nfc_initiator_init(pnd)) < 0)
+    return res;
+
+  struct nfc_target_watch *pw = calloc(1, sizeof(struct nfc_target_watch));
+  if (!pw)
+    return pnd->last_error = NFC_ESOFT;
+  if (!(pw->modulations = malloc(szModulations * sizeof(nfc_modulation)))) {
+    free(pw);
+    return pnd->last_error = NFC_ESOFT;
+  }
+  memcpy(pw->modulations, pnmModulations, szModulations * sizeof(nfc_modulation));
+  pw->szModulations = szModulations;
+  pw->pnd = pnd;
+  pw->period = period ? period : NFC_TARGET_WATCH_PERIOD;
+  pw->callback = callback;
+  pw->user_data = user_data;
+  nfc_mutex_init(&pw->mutex);
+  nfc_cond_init(&pw->cond);
+  if ((res = nfc_thread_create(&pw->thread, nfc_target_watch_thread, pw)) < 0) {
+    nfc_cond_destroy(&pw->cond);
+    nfc_mutex_destroy(&pw->mutex);
+    free(pw->modulations);
+    free(pw);
+    return pnd->last_error = res;
+  }
+  pnd->watch = pw;
+  return NFC_SUCCESS;
+}
+
+/** @ingroup initiator
+ * @brief Stop watching the targets of a device
+ * @return Returns 0 on success, otherwise returns libnfc's error code (negative value)
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ *
+ * Waits for the watch thread to end, no callback is called afterwards.
+ */
+int
+nfc_device_unwatch_targets(nfc_device *pnd)
+{
+  nfc_device_lock(pnd);
+  struct nfc_target_watch *pw = pnd->watch;
+  pnd->watch = NULL;
+  // The watch thread needs the device to end its current step
+  nfc_device_unlock(pnd);
+  if (!pw)
+    return NFC_SUCCESS;
+
+  nfc_mutex_lock(&pw->mutex);
+  pw->stop = true;
+  nfc_cond_broadcast(&pw->cond);
+  nfc_mutex_unlock(&pw->mutex);
+  nfc_thread_join(pw->thread);
+
+  nfc_cond_destroy(&pw->cond);
+  nfc_mutex_destroy(&pw->mutex);
+  free(pw->modulations);
+  free(pw);
+  return NFC_SUCCESS;
+}
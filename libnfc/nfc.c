@@ -85,6 +85,7 @@
 #include <nfc/nfc.h>
 
 #include "nfc-internal.h"
+#include "nfc-capture.h"
 #include "target-subr.h"
 #include "drivers.h"
 
@@ -128,6 +129,14 @@
 #  include "drivers/pn71xx.h"
 #endif /* DRIVER_PN71XX_ENABLED */
 
+#if defined (DRIVER_PN53X_SIM_ENABLED)
+#  include "drivers/pn53x_sim.h"
+#endif /* DRIVER_PN53X_SIM_ENABLED */
+
+#if defined (DRIVER_PN53X_REPLAY_ENABLED)
+#  include "drivers/pn53x_replay.h"
+#endif /* DRIVER_PN53X_REPLAY_ENABLED */
+
 
 #define LOG_CATEGORY "libnfc.general"
 #define LOG_GROUP    NFC_LOG_GROUP_GENERAL
@@ -138,6 +147,35 @@ struct nfc_driver_list {
 };
 
 const struct nfc_driver_list *nfc_drivers = NULL;
+// Contexts sharing nfc_drivers, which is released with the last one
+static size_t nfc_context_count = 0;
+
+// Drivers are only added in front of the list, so it can be walked from its head without lock
+static const struct nfc_driver_list *
+nfc_drivers_head(void)
+{
+  nfc_global_lock();
+  const struct nfc_driver_list *pndl = nfc_drivers;
+  nfc_global_unlock();
+  return pndl;
+}
+
+#ifdef CONFFILES
+// Find the driver of a connstring, as nfc_open() does
+static const struct nfc_driver *
+nfc_driver_find(const nfc_connstring connstring)
+{
+  for (const struct nfc_driver_list *pndl = nfc_drivers_head(); pndl; pndl = pndl->next) {
+    const struct nfc_driver *ndr = pndl->driver;
+    if (0 == strncmp(ndr->name, connstring, strlen(ndr->name)))
+      return ndr;
+    // "usb" goes to any *_usb driver
+    if ((0 == strncmp("usb", connstring, strlen("usb"))) && (0 == strncmp("_usb", ndr->name + (strlen(ndr->name) - 4), 4)))
+      return ndr;
+  }
+  return NULL;
+}
+#endif // CONFFILES
 
 // descritions for debugging
 const char *nfc_property_name[] = {
@@ -158,39 +196,65 @@ const char *nfc_property_name[] = {
   "NP_FORCE_SPEED_106"
 };
 
+// Add a driver in front of the list, with nfc_global_lock() held
+static int
+nfc_drivers_add(const struct nfc_driver *ndr)
+{
+  if (!ndr) {
+    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "nfc_register_driver returning NFC_EINVARG");
+    return NFC_EINVARG;
+  }
+
+  struct nfc_driver_list *pndl = (struct nfc_driver_list *)malloc(sizeof(struct nfc_driver_list));
+  if (!pndl)
+    return NFC_ESOFT;
+
+  pndl->driver = ndr;
+  pndl->next = nfc_drivers;
+  nfc_drivers = pndl;
+
+  return NFC_SUCCESS;
+}
+
 static void
 nfc_drivers_init(void)
 {
 #if defined (DRIVER_PN53X_USB_ENABLED)
-  nfc_register_driver(&pn53x_usb_driver);
+  nfc_drivers_add(&pn53x_usb_driver);
 #endif /* DRIVER_PN53X_USB_ENABLED */
 #if defined (DRIVER_PCSC_ENABLED)
-  nfc_register_driver(&pcsc_driver);
+  nfc_drivers_add(&pcsc_driver);
 #endif /* DRIVER_ACR122_PCSC_ENABLED */
 #if defined (DRIVER_ACR122_PCSC_ENABLED)
-  nfc_register_driver(&acr122_pcsc_driver);
+  nfc_drivers_add(&acr122_pcsc_driver);
 #endif /* DRIVER_ACR122_PCSC_ENABLED */
 #if defined (DRIVER_ACR122_USB_ENABLED)
-  nfc_register_driver(&acr122_usb_driver);
+  nfc_drivers_add(&acr122_usb_driver);
 #endif /* DRIVER_ACR122_USB_ENABLED */
 #if defined (DRIVER_ACR122S_ENABLED)
-  nfc_register_driver(&acr122s_driver);
+  nfc_drivers_add(&acr122s_driver);
 #endif /* DRIVER_ACR122S_ENABLED */
 #if defined (DRIVER_PN532_UART_ENABLED)
-  nfc_register_driver(&pn532_uart_driver);
+  nfc_drivers_add(&pn532_uart_driver);
 #endif /* DRIVER_PN532_UART_ENABLED */
 #if defined (DRIVER_PN532_SPI_ENABLED)
-  nfc_register_driver(&pn532_spi_driver);
+  nfc_drivers_add(&pn532_spi_driver);
 #endif /* DRIVER_PN532_SPI_ENABLED */
 #if defined (DRIVER_PN532_I2C_ENABLED)
-  nfc_register_driver(&pn532_i2c_driver);
+  nfc_drivers_add(&pn532_i2c_driver);
 #endif /* DRIVER_PN532_I2C_ENABLED */
 #if defined (DRIVER_ARYGON_ENABLED)
-  nfc_register_driver(&arygon_driver);
+  nfc_drivers_add(&arygon_driver);
 #endif /* DRIVER_ARYGON_ENABLED */
 #if defined (DRIVER_PN71XX_ENABLED)
-  nfc_register_driver(&pn71xx_driver);
+  nfc_drivers_add(&pn71xx_driver);
 #endif /* DRIVER_PN71XX_ENABLED */
+#if defined (DRIVER_PN53X_SIM_ENABLED)
+  nfc_drivers_add(&pn53x_sim_driver);
+#endif /* DRIVER_PN53X_SIM_ENABLED */
+#if defined (DRIVER_PN53X_REPLAY_ENABLED)
+  nfc_drivers_add(&pn53x_replay_driver);
+#endif /* DRIVER_PN53X_REPLAY_ENABLED */
 }
 
 static int
@@ -206,26 +270,19 @@ nfc_device_validate_modulation(nfc_device *pnd, const nfc_mode mode, const nfc_m
 int
 nfc_register_driver(const struct nfc_driver *ndr)
 {
-  if (!ndr) {
-    log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "nfc_register_driver returning NFC_EINVARG");
-    return NFC_EINVARG;
-  }
-
-  struct nfc_driver_list *pndl = (struct nfc_driver_list *)malloc(sizeof(struct nfc_driver_list));
-  if (!pndl)
-    return NFC_ESOFT;
-
-  pndl->driver = ndr;
-  pndl->next = nfc_drivers;
-  nfc_drivers = pndl;
-
-  return NFC_SUCCESS;
+  nfc_global_lock();
+  const int res = nfc_drivers_add(ndr);
+  nfc_global_unlock();
+  return res;
 }
 
 /** @ingroup lib
  * @brief Initialize libnfc.
  * This function must be called before calling any other libnfc function
  * @param context Output location for nfc_context
+ *
+ * @note The log level read from the configuration and the environment is the
+ * one of this context, see nfc_set_log_level().
  */
 void
 nfc_init(nfc_context **context)
@@ -235,8 +292,11 @@ nfc_init(nfc_context **context)
     perror("malloc");
     return;
   }
+  nfc_global_lock();
   if (!nfc_drivers)
     nfc_drivers_init();
+  nfc_context_count++;
+  nfc_global_unlock();
 }
 
 /** @ingroup lib
@@ -247,15 +307,140 @@ nfc_init(nfc_context **context)
 void
 nfc_exit(nfc_context *context)
 {
-  while (nfc_drivers) {
+  nfc_global_lock();
+  if (nfc_context_count)
+    nfc_context_count--;
+  while (!nfc_context_count && nfc_drivers) {
     struct nfc_driver_list *pndl = (struct nfc_driver_list *) nfc_drivers;
     nfc_drivers = pndl->next;
     free(pndl);
   }
+  nfc_global_unlock();
 
   nfc_context_free(context);
 }
 
+/** @ingroup lib
+ * @brief Change the log level at run time
+ * @param context The context to operate on
+ * @param log_level Log level, as in the LIBNFC_LOG_LEVEL environment variable or \c log_level configuration option
+ *
+ * The level set by nfc_init() from the configuration and the environment is
+ * replaced; it applies right away to devices already opened.
+ *
+ * @note Messages are not tied to a context: with several contexts, a message
+ * is logged when the level of any of them asks for it.
+ */
+void
+nfc_set_log_level(nfc_context *context, const uint32_t log_level)
+{
+  log_set_context_level(context, log_level);
+}
+
+/** @ingroup lib
+ * @brief Get the log level of a context
+ * @return Returns the log level of \a context
+ * @param context The context to operate on
+ */
+uint32_t
+nfc_get_log_level(const nfc_context *context)
+{
+  return context->log_level;
+}
+
+/** @ingroup lib
+ * @brief Write log messages to stderr, which is the default
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ * @param context The context to operate on
+ *
+ * @note The log sink is process-wide: it receives the messages of all
+ * contexts, and nfc_exit() of the context which set it restores stderr.
+ */
+int
+nfc_log_set_stderr_sink(nfc_context *context)
+{
+  return log_set_sink(context, NULL, NULL, NULL);
+}
+
+/** @ingroup lib
+ * @brief Append log messages to a file
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ * @param context The context to operate on
+ * @param path Path of the file, opened in append mode and closed when replaced or by nfc_exit()
+ */
+int
+nfc_log_set_file_sink(nfc_context *context, const char *path)
+{
+  if (!path)
+    return NFC_EINVARG;
+  return log_set_sink(context, path, NULL, NULL);
+}
+
+/** @ingroup lib
+ * @brief Hand log messages to a callback
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ * @param context The context to operate on
+ * @param callback Function called for each message, see \a nfc_log_callback
+ * @param user_data Pointer given back to \a callback
+ */
+int
+nfc_log_set_callback_sink(nfc_context *context, nfc_log_callback callback, void *user_data)
+{
+  if (!callback)
+    return NFC_EINVARG;
+  return log_set_sink(context, NULL, callback, user_data);
+}
+
+/** @ingroup lib
+ * @brief Make logging asynchronous
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ * @param context The context to operate on
+ * @param records Capacity of the log ring in records (rounded up to a power of two), 0 for the default of 1024
+ *
+ * Log calls then only store binary records (timestamp, priority, format
+ * string and raw arguments, or raw bytes of frame dumps) in a lock-free ring,
+ * a background thread formats them and writes them to the sink. Logging no
+ * longer slows down device communications; when the ring is full, records are
+ * dropped and counted, see nfc_log_get_dropped().
+ *
+ * @note The log ring is process-wide, as messages are not tied to a context:
+ * only one context at a time can make logging asynchronous, for all contexts,
+ * others get NFC_EINVARG until it calls nfc_log_stop_async() or nfc_exit().
+ * @note Not available on Windows, where NFC_ENOTIMPL is returned.
+ */
+int
+nfc_log_start_async(nfc_context *context, const size_t records)
+{
+  return log_start_async(context, records);
+}
+
+/** @ingroup lib
+ * @brief Make logging synchronous again, once pending records are written
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ * @param context The context which called nfc_log_start_async()
+ *
+ * nfc_exit() does it as well.
+ */
+int
+nfc_log_stop_async(nfc_context *context)
+{
+  return log_stop_async(context);
+}
+
+/** @ingroup lib
+ * @brief Get the amount of log records dropped because the log ring was full
+ * @return Returns the amount of records dropped since the last nfc_log_start_async() call
+ * @param context The context to operate on
+ *
+ * The count is the one of the process-wide log ring, whichever context started it.
+ */
+uint64_t
+nfc_log_get_dropped(const nfc_context *context)
+{
+  (void) context;
+  return log_get_dropped();
+}
+
 /** @ingroup dev
  * @brief Open a NFC device
  * @param context The context to operate on.
@@ -272,6 +457,10 @@ nfc_exit(nfc_context *context)
  *
  * @note Depending on the desired operation mode, the device needs to be configured by using nfc_initiator_init() or nfc_target_init(),
  * optionally followed by manual tuning of the parameters if the default parameters are not suiting your goals.
+ *
+ * @note Each device may be used from several threads: calls taking a \a nfc_device are serialized by a per-device lock,
+ * so distinct devices run concurrently. Sequences of calls (e.g. select then transceive) are not atomic as a whole,
+ * and nfc_abort_command() does not take the lock so that it can interrupt a blocking call.
  */
 nfc_device *
 nfc_open(nfc_context *context, const nfc_connstring connstring)
@@ -289,7 +478,7 @@ nfc_open(nfc_context *context, const nfc_connstring connstring)
   }
 
   // Search through the device list for an available device
-  const struct nfc_driver_list *pndl = nfc_drivers;
+  const struct nfc_driver_list *pndl = nfc_drivers_head();
   while (pndl) {
     const struct nfc_driver *ndr = pndl->driver;
 
@@ -302,7 +491,13 @@ nfc_open(nfc_context *context, const nfc_connstring connstring)
       }
     }
 
+    // Scans of the same bus, possibly left behind by nfc_list_devices(), must not run meanwhile
+    nfc_mutex *pBusLock = nfc_discovery_bus_lock(ndr->scan_bus);
+    if (pBusLock)
+      nfc_mutex_lock(pBusLock);
     pnd = ndr->open(context, ncs);
+    if (pBusLock)
+      nfc_mutex_unlock(pBusLock);
     // Test if the opening was successful
     if (pnd == NULL) {
       if (0 == strncmp("usb", ncs, strlen("usb"))) {
@@ -311,6 +506,8 @@ nfc_open(nfc_context *context, const nfc_connstring connstring)
         continue;
       }
       log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "Unable to open \"%s\".", ncs);
+      // Listed devices may be gone as well
+      nfc_discovery_cache_invalidate(context->discovery_cache);
       return NULL;
     }
     for (uint32_t i = 0; i < context->user_defined_device_count; i++) {
@@ -320,12 +517,29 @@ nfc_open(nfc_context *context, const nfc_connstring connstring)
         break;
       }
     }
+    if (pnd->capture) {
+      // First device is captured to the given path, the next ones to path.1, path.2...
+      // Devices may be opened from several threads at once, each needs its own path
+      char path[sizeof(context->capture_path) + 16];
+      nfc_global_lock();
+      if (context->capture_count)
+        snprintf(path, sizeof(path), "%s.%u", context->capture_path, context->capture_count);
+      else
+        snprintf(path, sizeof(path), "%s", context->capture_path);
+      context->capture_count++;
+      nfc_global_unlock();
+      if (nfc_capture_commit(pnd->capture, path) < 0) {
+        nfc_capture_free(pnd->capture);
+        pnd->capture = NULL;
+      }
+    }
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "\"%s\" (%s) has been claimed.", pnd->name, pnd->connstring);
     return pnd;
   }
 
   // Too bad, no driver can decode connstring
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "No driver available to handle \"%s\".", ncs);
+  nfc_discovery_cache_invalidate(context->discovery_cache);
   return NULL;
 }
 
@@ -334,11 +548,16 @@ nfc_open(nfc_context *context, const nfc_connstring connstring)
  * @param pnd \a nfc_device struct pointer that represent currently used device
  *
  * Initiator's selected tag is closed and the device, including allocated \a nfc_device struct, is released.
+ * Calls made on \a pnd from other threads are waited for, but none may be issued after nfc_close() was called.
  */
 void
 nfc_close(nfc_device *pnd)
 {
   if (pnd) {
+    nfc_device_unwatch_targets(pnd);
+    // Let calls made from other threads complete
+    nfc_device_lock(pnd);
+    nfc_device_unlock(pnd);
     // Close, clean up and release the device
     pnd->driver->close(pnd);
   }
@@ -351,83 +570,51 @@ nfc_close(nfc_device *pnd)
  * @param connstrings array of \a nfc_connstring.
  * @param connstrings_len size of the \a connstrings array.
  *
+ * Drivers using distinct buses are scanned in parallel. The context scan_timeout
+ * (LIBNFC_SCAN_TIMEOUT, in ms) bounds the wait: devices of drivers still scanning
+ * then are not listed, nor by later calls until that scan ends. With a scan_cache_ttl (LIBNFC_SCAN_CACHE_TTL, in ms), what
+ * each driver found is reused for that long, unless its device nodes are gone or
+ * a device fails to open.
  */
 size_t
 nfc_list_devices(nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
 {
-  size_t device_found = 0;
+  size_t szDrivers = 0;
+  const struct nfc_driver_list *pndl;
+  for (pndl = nfc_drivers_head(); pndl; pndl = pndl->next)
+    szDrivers++;
+
+  struct nfc_discovery_source *sources = calloc(MAX_USER_DEFINED_DEVICES + szDrivers, sizeof(struct nfc_discovery_source));
+  if (!sources)
+    return 0;
+  size_t szSources = 0;
 
 #ifdef CONFFILES
   // Load manually configured devices (from config file and env variables)
   // TODO From env var...
   for (uint32_t i = 0; i < context->user_defined_device_count; i++) {
-    if (context->user_defined_devices[i].optional) {
-      // let's make sure the device exists
-      nfc_device *pnd = NULL;
-
-#ifdef ENVVARS
-      char *env_log_level = getenv("LIBNFC_LOG_LEVEL");
-      char *old_env_log_level = NULL;
-      // do it silently
-      if (env_log_level) {
-        if ((old_env_log_level = malloc(strlen(env_log_level) + 1)) == NULL) {
-          log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_ERROR, "%s", "Unable to malloc()");
-          return 0;
-        }
-        strcpy(old_env_log_level, env_log_level);
-      }
-      setenv("LIBNFC_LOG_LEVEL", "0", 1);
-#endif // ENVVARS
-
-      pnd = nfc_open(context, context->user_defined_devices[i].connstring);
-
-#ifdef ENVVARS
-      if (old_env_log_level) {
-        setenv("LIBNFC_LOG_LEVEL", old_env_log_level, 1);
-        free(old_env_log_level);
-      } else {
-        unsetenv("LIBNFC_LOG_LEVEL");
-      }
-#endif // ENVVARS
-
-      if (pnd) {
-        nfc_close(pnd);
-        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "User device %s found", context->user_defined_devices[i].name);
-        strcpy((char *)(connstrings + device_found), context->user_defined_devices[i].connstring);
-        device_found ++;
-        if (device_found == connstrings_len)
-          break;
-      }
-    } else {
-      // manual choice is not marked as optional so let's take it blindly
-      strcpy((char *)(connstrings + device_found), context->user_defined_devices[i].connstring);
-      device_found++;
-      if (device_found >= connstrings_len)
-        return device_found;
-    }
+    struct nfc_discovery_source *pns = &sources[szSources++];
+    strcpy(pns->connstring, context->user_defined_devices[i].connstring);
+    // Optional devices are opened to make sure they exist, the others are taken blindly
+    pns->probe = context->user_defined_devices[i].optional;
+    pns->driver = nfc_driver_find(pns->connstring);
   }
 #endif // CONFFILES
 
   // Device auto-detection
   if (context->allow_autoscan) {
-    const struct nfc_driver_list *pndl = nfc_drivers;
-    while (pndl) {
+    for (pndl = nfc_drivers_head(); pndl; pndl = pndl->next) {
       const struct nfc_driver *ndr = pndl->driver;
       if ((ndr->scan_type == NOT_INTRUSIVE) || ((context->allow_intrusive_scan) && (ndr->scan_type == INTRUSIVE))) {
-        size_t _device_found = ndr->scan(context, connstrings + (device_found), connstrings_len - (device_found));
-        log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%ld device(s) found using %s driver", (unsigned long) _device_found, ndr->name);
-        if (_device_found > 0) {
-          device_found += _device_found;
-          if (device_found == connstrings_len)
-            break;
-        }
+        sources[szSources++].driver = ndr;
       } // scan_type is INTRUSIVE but not allowed or NOT_AVAILABLE
-      pndl = pndl->next;
     }
   } else if (context->user_defined_device_count == 0) {
     log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_INFO, "Warning: %s", "user must specify device(s) manually when autoscan is disabled");
   }
 
+  const size_t device_found = nfc_discover(context, sources, szSources, connstrings, connstrings_len);
+  free(sources);
   return device_found;
 }
 
@@ -445,6 +632,7 @@ nfc_list_devices(nfc_context *context, nfc_connstring connstrings[], const size_
 int
 nfc_device_set_property_int(nfc_device *pnd, const nfc_property property, const int value)
 {
+  NFC_DEVICE_LOCK(pnd);
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "set_property_int %s %s", nfc_property_name[property], value ? "True" : "False");
   return HAL(device_set_property_int, pnd, property, value);
 }
@@ -465,6 +653,7 @@ nfc_device_set_property_int(nfc_device *pnd, const nfc_property property, const
 int
 nfc_device_set_property_bool(nfc_device *pnd, const nfc_property property, const bool bEnable)
 {
+  NFC_DEVICE_LOCK(pnd);
   log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "set_property_bool %s %s", nfc_property_name[property], bEnable ? "True" : "False");
   return HAL(device_set_property_bool, pnd, property, bEnable);
 }
@@ -492,6 +681,7 @@ nfc_device_set_property_bool(nfc_device *pnd, const nfc_property property, const
 int
 nfc_initiator_init(nfc_device *pnd)
 {
+  NFC_DEVICE_LOCK(pnd);
   int res = 0;
   // Drop the field for a while
   if ((res = nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, false)) < 0)
@@ -532,6 +722,7 @@ nfc_initiator_init(nfc_device *pnd)
 int
 nfc_initiator_init_secure_element(nfc_device *pnd)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_init_secure_element, pnd);
 }
 
@@ -564,6 +755,7 @@ nfc_initiator_select_passive_target(nfc_device *pnd,
                                     const uint8_t *pbtInitData, const size_t szInitData,
                                     nfc_target *pnt)
 {
+  NFC_DEVICE_LOCK(pnd);
   uint8_t *abtInit = NULL;
   uint8_t maxAbt = MAX(12, szInitData);
   size_t  szInit = 0;
@@ -604,13 +796,18 @@ nfc_initiator_select_passive_target(nfc_device *pnd,
  * communications. The chip needs to know with what kind of tag it is dealing
  * with, therefore the initial modulation and speed (106, 212 or 424 kbps)
  * should be supplied.
+ *
+ * The last target selected is left selected. Chips which select several
+ * targets with one command (e.g. PN53x) only talk to the first of them: when
+ * the last command selected several targets, they are all deselected before
+ * returning.
  */
 int
 nfc_initiator_list_passive_targets(nfc_device *pnd,
                                    const nfc_modulation nm,
                                    nfc_target ant[], const size_t szTargets)
 {
-  nfc_target nt;
+  NFC_DEVICE_LOCK(pnd);
   size_t  szTargetFound = 0;
   uint8_t *pbtInitData = NULL;
   size_t  szInitDataLen = 0;
@@ -618,32 +815,62 @@ nfc_initiator_list_passive_targets(nfc_device *pnd,
 
   pnd->last_error = 0;
 
+  if (szTargets == 0)
+    return 0;
+  // Targets are told apart by a hash of their identifier, confirmed on a match
+  uint32_t *pui32Hashes = malloc(szTargets * sizeof(uint32_t));
+  if (!pui32Hashes) {
+    pnd->last_error = NFC_ESOFT;
+    return pnd->last_error;
+  }
+
   // Let the reader only try once to find a tag
   bool bInfiniteSelect = pnd->bInfiniteSelect;
   if ((res = nfc_device_set_property_bool(pnd, NP_INFINITE_SELECT, false)) < 0) {
+    free(pui32Hashes);
     return res;
   }
 
   prepare_initiator_data(nm, &pbtInitData, &szInitDataLen);
 
-  while (nfc_initiator_select_passive_target(pnd, nm, pbtInitData, szInitDataLen, &nt) > 0) {
-    size_t i;
-    bool seen = false;
-    // Check if we've already seen this tag
-    for (i = 0; i < szTargetFound; i++) {
-      if (memcmp(&(ant[i]), &nt, sizeof(nfc_target)) == 0) {
-        seen = true;
-      }
+  // Some chips select several targets per command, saving a deselect and a select per target
+  const bool bBatch = (pnd->driver->initiator_select_passive_targets != NULL) &&
+                      (nfc_device_validate_modulation(pnd, N_INITIATOR, &nm) == NFC_SUCCESS);
+  const uint64_t ui64RfExchanges = pnd->stats.rf_exchanges;
+  bool seen = false;
+  // Targets selected by the last command
+  int iSelected = 0;
+  for (;;) {
+    nfc_target *pntNew = &(ant[szTargetFound]);
+    if (bBatch) {
+      res = pnd->driver->initiator_select_passive_targets(pnd, nm, pbtInitData, szInitDataLen, pntNew, szTargets - szTargetFound);
+    } else {
+      res = MIN(nfc_initiator_select_passive_target(pnd, nm, pbtInitData, szInitDataLen, pntNew), 1);
     }
-    if (seen) {
+    if (res <= 0) {
       break;
     }
-    memcpy(&(ant[szTargetFound]), &nt, sizeof(nfc_target));
-    szTargetFound++;
-    if (szTargets == szTargetFound) {
+    iSelected = res;
+    // Keep the targets not seen yet, seeing one again means all were listed
+    for (size_t n = 0; n < (size_t) res; n++) {
+      const uint32_t ui32Hash = nfc_target_hash(&(pntNew[n]));
+      bool bKnown = false;
+      for (size_t i = 0; (i < szTargetFound) && !bKnown; i++) {
+        bKnown = (pui32Hashes[i] == ui32Hash) && nfc_target_same(&(ant[i]), &(pntNew[n]));
+      }
+      if (bKnown) {
+        seen = true;
+        continue;
+      }
+      if (&(ant[szTargetFound]) != &(pntNew[n]))
+        memcpy(&(ant[szTargetFound]), &(pntNew[n]), sizeof(nfc_target));
+      pui32Hashes[szTargetFound++] = ui32Hash;
+    }
+    if (seen || (szTargets == szTargetFound)) {
       break;
     }
     nfc_initiator_deselect_target(pnd);
+    iSelected = 0;
     // deselect has no effect on FeliCa, Jewel and Thinfilm cards so we'll stop after one...
     // ISO/IEC 14443 B' cards are polled at 100% probability so it's not possible to detect correctly two cards at the same time
     if ((nm.nmt == NMT_FELICA) || (nm.nmt == NMT_JEWEL) || (nm.nmt == NMT_BARCODE) ||
@@ -651,6 +878,14 @@ nfc_initiator_list_passive_targets(nfc_device *pnd,
       break;
     }
   }
+  free(pui32Hashes);
+  // The chip's current target is the first one selected, not the last one listed
+  if (iSelected > 1) {
+    nfc_initiator_deselect_target(pnd);
+  }
+  log_put(LOG_GROUP, LOG_CATEGORY, NFC_LOG_PRIORITY_DEBUG, "%u target(s) listed in %u RF exchange(s)",
+          (unsigned int) szTargetFound, (unsigned int)(pnd->stats.rf_exchanges - ui64RfExchanges));
+  (void) ui64RfExchanges;
   if (bInfiniteSelect) {
     if ((res = nfc_device_set_property_bool(pnd, NP_INFINITE_SELECT, true)) < 0) {
       return res;
@@ -678,6 +913,7 @@ nfc_initiator_poll_target(nfc_device *pnd,
                           const uint8_t uiPollNr, const uint8_t uiPeriod,
                           nfc_target *pnt)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_poll_target, pnd, pnmModulations, szModulations, uiPollNr, uiPeriod, pnt);
 }
 
@@ -707,6 +943,7 @@ nfc_initiator_select_dep_target(nfc_device *pnd,
                                 const nfc_dep_mode ndm, const nfc_baud_rate nbr,
                                 const nfc_dep_info *pndiInitiator, nfc_target *pnt, const int timeout)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_select_dep_target, pnd, ndm, nbr, pndiInitiator, pnt, timeout);
 }
 
@@ -734,6 +971,7 @@ nfc_initiator_poll_dep_target(struct nfc_device *pnd,
                               nfc_target *pnt,
                               const int timeout)
 {
+  NFC_DEVICE_LOCK(pnd);
   const int period = 300;
   int remaining_time = timeout;
   int res;
@@ -778,6 +1016,7 @@ end:
 int
 nfc_initiator_deselect_target(nfc_device *pnd)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_deselect_target, pnd);
 }
 
@@ -813,9 +1052,61 @@ int
 nfc_initiator_transceive_bytes(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, uint8_t *pbtRx,
                                const size_t szRx, int timeout)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_transceive_bytes, pnd, pbtTx, szTx, pbtRx, szRx, timeout);
 }
 
+/** @ingroup initiator
+ * @brief Send data to target without waiting for its answer
+ * @return Returns 0 once the device accepted the frame, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represents currently used device
+ * @param pbtTx contains a byte array of the frame that needs to be transmitted.
+ * @param szTx contains the length in bytes.
+ * @param timeout timeout in milliseconds used while handing the frame to the device
+ *
+ * This function is the first half of nfc_initiator_transceive_bytes(): it returns
+ * as soon as the device acknowledged the command, while the RF exchange runs on the
+ * device. The answer must be collected with nfc_initiator_transceive_bytes_complete()
+ * before any other command is sent to this device.
+ *
+ * This allows a single thread to keep one frame in flight on each of several devices.
+ * Use nfc_device_get_pollfd() to know when the answer is available.
+ */
+int
+nfc_initiator_transceive_bytes_async(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
+{
+  NFC_DEVICE_LOCK(pnd);
+  if (!pnd->driver->initiator_transceive_bytes_async) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return HAL(initiator_transceive_bytes_async, pnd, pbtTx, szTx, timeout);
+}
+
+/** @ingroup initiator
+ * @brief Retrieve the answer of a frame sent by nfc_initiator_transceive_bytes_async()
+ * @return Returns received bytes count on success, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represents currently used device
+ * @param[out] pbtRx response from the target
+ * @param szRx size of \a pbtRx (Will return NFC_EOVFLOW if RX exceeds this size)
+ * @param timeout timeout in milliseconds
+ *
+ * If timeout equals to 0, the function blocks indefinitely (until an error is raised or function is completed)
+ * If timeout equals to -1, the default timeout will be used
+ */
+int
+nfc_initiator_transceive_bytes_complete(nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int timeout)
+{
+  NFC_DEVICE_LOCK(pnd);
+  if (!pnd->driver->initiator_transceive_bytes_complete) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return HAL(initiator_transceive_bytes_complete, pnd, pbtRx, szRx, timeout);
+}
+
 /** @ingroup initiator
  * @brief Transceive raw bit-frames to a target
  * @return Returns received bits count on success, otherwise returns libnfc's error code
@@ -858,6 +1149,7 @@ nfc_initiator_transceive_bits(nfc_device *pnd,
                               uint8_t *pbtRx, const size_t szRx,
                               uint8_t *pbtRxPar)
 {
+  NFC_DEVICE_LOCK(pnd);
   (void)szRx;
   return HAL(initiator_transceive_bits, pnd, pbtTx, szTxBits, pbtTxPar, pbtRx, pbtRxPar);
 }
@@ -894,6 +1186,7 @@ nfc_initiator_transceive_bytes_timed(nfc_device *pnd,
                                      uint8_t *pbtRx, const size_t szRx,
                                      uint32_t *cycles)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_transceive_bytes_timed, pnd, pbtTx, szTx, pbtRx, szRx, cycles);
 }
 
@@ -910,6 +1203,7 @@ nfc_initiator_transceive_bytes_timed(nfc_device *pnd,
 int
 nfc_initiator_target_is_present(nfc_device *pnd, const nfc_target *pnt)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(initiator_target_is_present, pnd, pnt);
 }
 
@@ -941,6 +1235,7 @@ nfc_initiator_transceive_bits_timed(nfc_device *pnd,
                                     uint8_t *pbtRxPar,
                                     uint32_t *cycles)
 {
+  NFC_DEVICE_LOCK(pnd);
   (void)szRx;
   return HAL(initiator_transceive_bits_timed, pnd, pbtTx, szTxBits, pbtTxPar, pbtRx, pbtRxPar, cycles);
 }
@@ -981,6 +1276,7 @@ nfc_initiator_transceive_bits_timed(nfc_device *pnd,
 int
 nfc_target_init(nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t szRx, int timeout)
 {
+  NFC_DEVICE_LOCK(pnd);
   int res = 0;
   // Disallow invalid frame
   if ((res = nfc_device_set_property_bool(pnd, NP_ACCEPT_INVALID_FRAMES, false)) < 0)
@@ -1022,6 +1318,7 @@ nfc_target_init(nfc_device *pnd, nfc_target *pnt, uint8_t *pbtRx, const size_t s
 int
 nfc_idle(nfc_device *pnd)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(idle, pnd);
 }
 
@@ -1060,6 +1357,7 @@ nfc_abort_command(nfc_device *pnd)
 int
 nfc_target_send_bytes(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx, int timeout)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(target_send_bytes, pnd, pbtTx, szTx, timeout);
 }
 
@@ -1080,6 +1378,7 @@ nfc_target_send_bytes(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTx,
 int
 nfc_target_receive_bytes(nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int timeout)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(target_receive_bytes, pnd, pbtRx, szRx, timeout);
 }
 
@@ -1097,6 +1396,7 @@ nfc_target_receive_bytes(nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, int
 int
 nfc_target_send_bits(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBits, const uint8_t *pbtTxPar)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(target_send_bits, pnd, pbtTx, szTxBits, pbtTxPar);
 }
 
@@ -1119,6 +1419,7 @@ nfc_target_send_bits(nfc_device *pnd, const uint8_t *pbtTx, const size_t szTxBit
 int
 nfc_target_receive_bits(nfc_device *pnd, uint8_t *pbtRx, const size_t szRx, uint8_t *pbtRxPar)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(target_receive_bits, pnd, pbtRx, szRx, pbtRxPar);
 }
 
@@ -1151,6 +1452,7 @@ static struct sErrorMessage {
 const char *
 nfc_strerror(const nfc_device *pnd)
 {
+  NFC_DEVICE_LOCK(pnd);
   const char *pcRes = "Unknown error";
   size_t  i;
   for (i = 0; i < (sizeof(sErrorMessages) / sizeof(struct sErrorMessage)); i++) {
@@ -1174,6 +1476,7 @@ nfc_strerror(const nfc_device *pnd)
 int
 nfc_strerror_r(const nfc_device *pnd, char *pcStrErrBuf, size_t szBufLen)
 {
+  NFC_DEVICE_LOCK(pnd);
   return (snprintf(pcStrErrBuf, szBufLen, "%s", nfc_strerror(pnd)) < 0) ? -1 : 0;
 }
 
@@ -1189,6 +1492,66 @@ nfc_perror(const nfc_device *pnd, const char *pcString)
   fprintf(stderr, "%s: %s\n", pcString, nfc_strerror(pnd));
 }
 
+/** @ingroup dev
+ * @brief Get a file descriptor to wait for device answers
+ * @return Returns a file descriptor on success, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ *
+ * The returned file descriptor becomes readable when the device starts sending the answer
+ * of a command submitted by nfc_initiator_transceive_bytes_async(), so it can be added to
+ * the caller's select(2)/poll(2)/epoll(7) set. The file descriptor remains owned by libnfc.
+ *
+ * @note Serial port based devices, and under Linux USB devices when libnfc uses libusb 1.0, provide
+ * such a file descriptor; others return NFC_EDEVNOTSUPP. For USB devices it is readable once the whole
+ * answer is received, and a libnfc thread handles USB events while such a device is opened.
+ */
+int
+nfc_device_get_pollfd(nfc_device *pnd)
+{
+  if (!pnd->driver->device_get_pollfd) {
+    pnd->last_error = NFC_EDEVNOTSUPP;
+    return pnd->last_error;
+  }
+  return HAL(device_get_pollfd, pnd);
+}
+
+/** @ingroup dev
+ * @brief Get the input/output statistics of a device
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ * @param[out] pstats \a nfc_device_stats struct pointer filled with a copy of the statistics
+ *
+ * Frames, bytes, retries, NACKs, errors, timeouts and aborts are counted from
+ * the device opening or the last nfc_device_reset_stats() call. Time spent in
+ * sending frames, waiting for their acknowledgement and receiving answers is
+ * kept in log2 histograms, as well as the latency of each chip command code.
+ */
+int
+nfc_device_get_stats(const nfc_device *pnd, nfc_device_stats *pstats)
+{
+  NFC_DEVICE_LOCK(pnd);
+  if (!pstats)
+    return NFC_EINVARG;
+  *pstats = pnd->stats;
+  return NFC_SUCCESS;
+}
+
+/** @ingroup dev
+ * @brief Reset the input/output statistics of a device
+ * @return Returns 0 on success, otherwise returns libnfc's error code
+ *
+ * @param pnd \a nfc_device struct pointer that represent currently used device
+ */
+int
+nfc_device_reset_stats(nfc_device *pnd)
+{
+  NFC_DEVICE_LOCK(pnd);
+  memset(&pnd->stats, 0, sizeof(pnd->stats));
+  return NFC_SUCCESS;
+}
+
 /** @ingroup error
  * @brief Returns last error occured on a nfc_device
  * @return Returns an integer that represents to libnfc's error code.
@@ -1198,6 +1561,7 @@ nfc_perror(const nfc_device *pnd, const char *pcString)
 int
 nfc_device_get_last_error(const nfc_device *pnd)
 {
+  NFC_DEVICE_LOCK(pnd);
   return pnd->last_error;
 }
 
@@ -1238,6 +1602,7 @@ nfc_device_get_connstring(nfc_device *pnd)
 int
 nfc_device_get_supported_modulation(nfc_device *pnd, const nfc_mode mode, const nfc_modulation_type **const supported_mt)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(get_supported_modulation, pnd, mode, supported_mt);
 }
 
@@ -1252,6 +1617,7 @@ nfc_device_get_supported_modulation(nfc_device *pnd, const nfc_mode mode, const
 int
 nfc_device_get_supported_baud_rate(nfc_device *pnd, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(get_supported_baud_rate, pnd, N_INITIATOR, nmt, supported_br);
 }
 
@@ -1266,6 +1632,7 @@ nfc_device_get_supported_baud_rate(nfc_device *pnd, const nfc_modulation_type nm
 int
 nfc_device_get_supported_baud_rate_target_mode(nfc_device *pnd, const nfc_modulation_type nmt, const nfc_baud_rate **const supported_br)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(get_supported_baud_rate, pnd, N_TARGET, nmt, supported_br);
 }
 
@@ -1351,6 +1718,7 @@ nfc_free(void *p)
 int
 nfc_device_get_information_about(nfc_device *pnd, char **buf)
 {
+  NFC_DEVICE_LOCK(pnd);
   return HAL(device_get_information_about, pnd, buf);
 }
 
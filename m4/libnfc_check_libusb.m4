@@ -12,8 +12,27 @@ AC_DEFUN([LIBNFC_CHECK_LIBUSB],
         [LIBUSB_WIN32_DIR=$withval],
         [LIBUSB_WIN32_DIR=""])
 
+    AC_ARG_ENABLE([libusb1],
+        [AS_HELP_STRING([--enable-libusb1], [use libusb-1.0 asynchronous transfers instead of libusb-0.1])],
+        [enable_libusb1=$enableval],
+        [enable_libusb1="no"])
+
+    # Search using libusb-1.0 module using pkg-config
+    if test x"$enable_libusb1" = "xyes"; then
+      if test x"$PKG_CONFIG" != "x"; then
+        PKG_CHECK_MODULES([libusb], [libusb-1.0], [HAVE_LIBUSB=1], [AC_MSG_ERROR([libusb-1.0 is mandatory with --enable-libusb1.])])
+        libusb_CFLAGS="$libusb_CFLAGS -DLIBUSB1_ENABLED"
+        if test x"$PKG_CONFIG_REQUIRES" != x""; then
+          PKG_CONFIG_REQUIRES="$PKG_CONFIG_REQUIRES,"
+        fi
+        PKG_CONFIG_REQUIRES="$PKG_CONFIG_REQUIRES libusb-1.0"
+      else
+        AC_MSG_ERROR([pkg-config is required to find libusb-1.0.])
+      fi
+    fi
+
     # --with-libusb-win32 directory have been set
-    if test "x$LIBUSB_WIN32_DIR" != "x"; then
+    if test x"$HAVE_LIBUSB" = "x0" && test "x$LIBUSB_WIN32_DIR" != "x"; then
       AC_MSG_NOTICE(["use libusb-win32 from $LIBUSB_WIN32_DIR"])
       libusb_CFLAGS="-I$LIBUSB_WIN32_DIR/include"
       libusb_LIBS="-L$LIBUSB_WIN32_DIR/lib/gcc -lusb"
@@ -4,7 +4,7 @@ AC_DEFUN([LIBNFC_ARG_WITH_DRIVERS],
 [
   AC_MSG_CHECKING(which drivers to build)
   AC_ARG_WITH(drivers,
-  AS_HELP_STRING([--with-drivers=DRIVERS], [Use a custom driver set, where DRIVERS is a coma-separated list of drivers to build support for. Available drivers are: 'acr122_pcsc', 'acr122_usb', 'acr122s', 'arygon', 'pcsc', 'pn532_i2c', 'pn532_spi', 'pn532_uart', 'pn53x_usb' and 'pn71xx'. Default drivers set is 'acr122_usb,acr122s,arygon,pn532_i2c,pn532_spi,pn532_uart,pn53x_usb'. The special driver set 'all' compile all available drivers.]),
+  AS_HELP_STRING([--with-drivers=DRIVERS], [Use a custom driver set, where DRIVERS is a coma-separated list of drivers to build support for. Available drivers are: 'acr122_pcsc', 'acr122_usb', 'acr122s', 'arygon', 'pcsc', 'pn532_i2c', 'pn532_spi', 'pn532_uart', 'pn53x_replay', 'pn53x_sim', 'pn53x_usb' and 'pn71xx'. Default drivers set is 'acr122_usb,acr122s,arygon,pn532_i2c,pn532_spi,pn532_uart,pn53x_usb'. The special driver set 'all' compile all available drivers.]),
 
   [       case "${withval}" in
           yes | no)
@@ -37,7 +37,7 @@ AC_DEFUN([LIBNFC_ARG_WITH_DRIVERS],
                   fi
                   ;;
     all)
-                  DRIVER_BUILD_LIST="acr122_pcsc acr122_usb acr122s arygon pn53x_usb pn532_uart pcsc"
+                  DRIVER_BUILD_LIST="acr122_pcsc acr122_usb acr122s arygon pn53x_usb pn532_uart pcsc pn53x_sim pn53x_replay"
 
                   if test x"$spi_available" = x"yes"
                   then
@@ -66,6 +66,8 @@ AC_DEFUN([LIBNFC_ARG_WITH_DRIVERS],
   driver_pn532_spi_enabled="no"
   driver_pn532_i2c_enabled="no"
   driver_pn71xx_enabled="no"
+  driver_pn53x_sim_enabled="no"
+  driver_pn53x_replay_enabled="no"
 
   for driver in ${DRIVER_BUILD_LIST}
   do
@@ -120,6 +122,14 @@ AC_DEFUN([LIBNFC_ARG_WITH_DRIVERS],
                   driver_pn71xx_enabled="yes"
                   DRIVERS_CFLAGS="$DRIVERS_CFLAGS -DDRIVER_PN71XX_ENABLED"
                   ;;
+    pn53x_sim)
+                  driver_pn53x_sim_enabled="yes"
+                  DRIVERS_CFLAGS="$DRIVERS_CFLAGS -DDRIVER_PN53X_SIM_ENABLED"
+                  ;;
+    pn53x_replay)
+                  driver_pn53x_replay_enabled="yes"
+                  DRIVERS_CFLAGS="$DRIVERS_CFLAGS -DDRIVER_PN53X_REPLAY_ENABLED"
+                  ;;
     *)
                   AC_MSG_ERROR([Unknow driver: $driver])
                   ;;
@@ -136,6 +146,8 @@ AC_DEFUN([LIBNFC_ARG_WITH_DRIVERS],
   AM_CONDITIONAL(DRIVER_PN532_SPI_ENABLED, [test x"$driver_pn532_spi_enabled" = xyes])
   AM_CONDITIONAL(DRIVER_PN532_I2C_ENABLED, [test x"$driver_pn532_i2c_enabled" = xyes])
   AM_CONDITIONAL(DRIVER_PN71XX_ENABLED, [test x"$driver_pn71xx_enabled" = xyes])
+  AM_CONDITIONAL(DRIVER_PN53X_SIM_ENABLED, [test x"$driver_pn53x_sim_enabled" = xyes])
+  AM_CONDITIONAL(DRIVER_PN53X_REPLAY_ENABLED, [test x"$driver_pn53x_replay_enabled" = xyes])
 ])
 
 AC_DEFUN([LIBNFC_DRIVERS_SUMMARY],[
@@ -151,4 +163,6 @@ echo "   pn532_uart....... $driver_pn532_uart_enabled"
 echo "   pn532_spi.......  $driver_pn532_spi_enabled"
 echo "   pn532_i2c........ $driver_pn532_i2c_enabled"
 echo "   pn71xx........... $driver_pn71xx_enabled"
+echo "   pn53x_replay..... $driver_pn53x_replay_enabled"
+echo "   pn53x_sim........ $driver_pn53x_sim_enabled"
 ])
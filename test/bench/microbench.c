@@ -0,0 +1,490 @@
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nfc/nfc.h>
+
+#include "nfc-internal.h"
+#include "chips/pn53x.h"
+#include "conf.h"
+#include "mirror-subr.h"
+#include "target-subr.h"
+
+/*
+ * CPU micro-benchmarks of the library hot functions, no device needed.
+ *
+ * Each benchmark is run for a warmup, then calibrated so that one repetition
+ * lasts about BENCH_REPETITION_NS, and the median of the repetitions is
+ * reported. With -t, results are checked against a thresholds file so that
+ * regressions make the run fail.
+ *
+ * Thresholds are not in ns, which depend on the machine, but in steps of a
+ * reference loop measured by the same run: a chain of dependent integer
+ * operations which no libnfc change moves.
+ */
+
+#define BENCH_WARMUP_NS       (50 * 1000 * 1000)
+#define BENCH_REPETITION_NS   (10 * 1000 * 1000)
+#define BENCH_REPETITIONS     15
+#define BENCH_REPETITIONS_MAX 101
+// Headroom of the thresholds printed with -g
+#define BENCH_HEADROOM        4
+// Steps of the reference loop run per call
+#define BENCH_REFERENCE_STEPS 1000
+
+struct bench {
+  const char *name;
+  // Bytes processed by one call, 0 when it does not make sense
+  size_t bytes;
+  void (*run)(void);
+};
+
+struct bench_result {
+  double ns;
+  double cycles;
+  double allocs;
+};
+
+// Keeps the results alive so that calls are not optimized out
+static volatile uintptr_t sink;
+
+static uint64_t
+bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define BENCH_HAS_CYCLES
+static uint64_t
+bench_cycles(void)
+{
+  uint32_t lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+#else
+static uint64_t
+bench_cycles(void)
+{
+  return 0;
+}
+#endif
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+// Linked with -Wl,--wrap so that allocations made by libnfc are counted
+static size_t szAllocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+void *
+__wrap_malloc(size_t size)
+{
+  szAllocations++;
+  return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+  szAllocations++;
+  return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_realloc(void *ptr, size_t size)
+{
+  szAllocations++;
+  return __real_realloc(ptr, size);
+}
+#endif
+
+// Inputs, set up once by bench_setup()
+static uint8_t abtData[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+static uint8_t abtFrame[PN53x_FRAME__BUFFER_LEN];
+static uint8_t abtPar[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+static uint8_t abtWrapped[PN53x_EXTENDED_FRAME__DATA_MAX_LEN];
+static size_t szWrappedBits;
+static nfc_target ntIso14443a;
+static nfc_connstring ncUart = "pn532_uart:/dev/ttyUSB0:115200";
+
+// Tg, ATQA, SAK, UID and ATS of an ISO14443-4 card, as given by InListPassiveTarget
+static const uint8_t abtIso14443aRaw[] = {
+  0x01, 0x00, 0x44, 0x20, 0x07, 0x04, 0x49, 0x53, 0x4f, 0x00, 0x00, 0x01,
+  0x06, 0x78, 0x77, 0x81, 0x02, 0x80
+};
+
+#ifdef CONFFILES
+static char acConfFile[] = "/tmp/microbench.conf.XXXXXX";
+static const char acConf[] =
+  "# Sample configuration\n"
+  "allow_autoscan = true\n"
+  "allow_intrusive_scan = false\n"
+  "log_level = 1\n"
+  "\n"
+  "device.name = \"PN532 board via UART\"\n"
+  "device.connstring = \"pn532_uart:/dev/ttyUSB0:115200\"\n"
+  "device.optional = true\n";
+#endif // CONFFILES
+
+static void
+bench_build_frame(size_t szData)
+{
+  size_t szFrame;
+  pn53x_build_frame(abtFrame, &szFrame, abtData, szData);
+  sink += szFrame;
+}
+
+static void
+bench_build_frame_64(void)
+{
+  bench_build_frame(64);
+}
+
+static void
+bench_build_frame_255(void)
+{
+  bench_build_frame(255);
+}
+
+static void
+bench_build_frame_in_place(void)
+{
+  uint8_t *pbtFrame;
+  size_t szFrame;
+  // Data is left at the headroom offset, as done by pn53x_transceive()
+  pn53x_build_frame_in_place(abtFrame + PN53x_FRAME__HEADROOM, 255, &pbtFrame, &szFrame);
+  sink += szFrame;
+}
+
+static void
+bench_wrap_frame(void)
+{
+  sink += pn53x_wrap_frame(abtData, 16 * 8, abtPar, abtFrame);
+}
+
+static void
+bench_unwrap_frame(void)
+{
+  sink += pn53x_unwrap_frame(abtWrapped, szWrappedBits, abtFrame, abtPar);
+}
+
+static void
+bench_iso14443a_crc(void)
+{
+  uint8_t abtCrc[2];
+  iso14443a_crc(abtData, 64, abtCrc);
+  sink += abtCrc[0];
+}
+
+static void
+bench_decode_target_data(void)
+{
+  nfc_target_info nti;
+  pn53x_decode_target_data(abtIso14443aRaw, sizeof(abtIso14443aRaw), PN533, NMT_ISO14443A, &nti);
+  sink += nti.nai.szUidLen;
+}
+
+static void
+bench_snprint_nfc_target(void)
+{
+  char acBuffer[4096];
+  snprint_nfc_target(acBuffer, sizeof(acBuffer), &ntIso14443a, true);
+  sink += (uint8_t) acBuffer[0];
+}
+
+static void
+bench_connstring_decode(void)
+{
+  char *pcPort, *pcSpeed;
+  sink += connstring_decode(ncUart, "pn532_uart", NULL, &pcPort, &pcSpeed);
+  free(pcPort);
+  free(pcSpeed);
+}
+
+#ifdef CONFFILES
+static void
+bench_conf_keyvalue(void *data, const char *key, const char *value)
+{
+  (void) data;
+  sink += (uint8_t)(key[0] ^ value[0]);
+}
+
+static void
+bench_conf_parse_file(void)
+{
+  conf_parse_file(acConfFile, bench_conf_keyvalue, NULL);
+}
+#endif // CONFFILES
+
+static void
+bench_mirror64(void)
+{
+  sink += mirror64(sink);
+}
+
+// Reference loop: each xorshift step needs the result of the previous one
+static void
+bench_reference(void)
+{
+  uint64_t x = sink | 1;
+  for (int n = 0; n < BENCH_REFERENCE_STEPS; n++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+  }
+  sink = x;
+}
+
+static const struct bench reference = { "reference", 0, bench_reference };
+
+static const struct bench benches[] = {
+  { "pn53x_build_frame/64", 64, bench_build_frame_64 },
+  { "pn53x_build_frame/255", 255, bench_build_frame_255 },
+  { "pn53x_build_frame_in_place/255", 255, bench_build_frame_in_place },
+  { "pn53x_wrap_frame/16", 16, bench_wrap_frame },
+  { "pn53x_unwrap_frame/16", 16, bench_unwrap_frame },
+  { "iso14443a_crc/64", 64, bench_iso14443a_crc },
+  { "pn53x_decode_target_data/iso14443a", sizeof(abtIso14443aRaw), bench_decode_target_data },
+  { "snprint_nfc_target/iso14443a", 0, bench_snprint_nfc_target },
+  { "connstring_decode", 0, bench_connstring_decode },
+#ifdef CONFFILES
+  { "conf_parse_file", sizeof(acConf) - 1, bench_conf_parse_file },
+#endif // CONFFILES
+  { "mirror64", 8, bench_mirror64 },
+};
+
+static int
+bench_setup(void)
+{
+  for (size_t n = 0; n < sizeof(abtData); n++) {
+    abtData[n] = (uint8_t)(n * 7 + 1);
+    abtPar[n] = (uint8_t)(n & 1);
+  }
+  memcpy(abtFrame + PN53x_FRAME__HEADROOM, abtData, 255);
+  szWrappedBits = pn53x_wrap_frame(abtData, 16 * 8, abtPar, abtWrapped);
+
+  ntIso14443a.nm.nmt = NMT_ISO14443A;
+  ntIso14443a.nm.nbr = NBR_106;
+  if (pn53x_decode_target_data(abtIso14443aRaw, sizeof(abtIso14443aRaw), PN533, NMT_ISO14443A, &ntIso14443a.nti) < 0) {
+    fprintf(stderr, "Unable to decode target data\n");
+    return -1;
+  }
+
+#ifdef CONFFILES
+  int fd = mkstemp(acConfFile);
+  if (fd < 0) {
+    perror("mkstemp");
+    return -1;
+  }
+  if (write(fd, acConf, sizeof(acConf) - 1) != (ssize_t)(sizeof(acConf) - 1)) {
+    perror("write");
+    close(fd);
+    return -1;
+  }
+  close(fd);
+#endif // CONFFILES
+  return 0;
+}
+
+static void
+bench_teardown(void)
+{
+#ifdef CONFFILES
+  unlink(acConfFile);
+#endif // CONFFILES
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+  const double da = *(const double *) a, db = *(const double *) b;
+  return (da > db) - (da < db);
+}
+
+static void
+bench_run(const struct bench *pb, const int iRepetitions, struct bench_result *pr)
+{
+  double adNs[BENCH_REPETITIONS_MAX];
+  double adCycles[BENCH_REPETITIONS_MAX];
+  uint64_t ui64Start = bench_now();
+
+  // Warm caches and branch predictors up, and find how many calls last one repetition
+  size_t szCalls = 1;
+  while (bench_now() - ui64Start < BENCH_WARMUP_NS) {
+    const uint64_t ui64Rep = bench_now();
+    for (size_t n = 0; n < szCalls; n++)
+      pb->run();
+    if (bench_now() - ui64Rep < BENCH_REPETITION_NS)
+      szCalls *= 2;
+  }
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+  const size_t szAllocationsStart = szAllocations;
+  pb->run();
+  pr->allocs = szAllocations - szAllocationsStart;
+#else
+  pr->allocs = 0;
+#endif
+
+  for (int r = 0; r < iRepetitions; r++) {
+    const uint64_t ui64Cycles = bench_cycles();
+    const uint64_t ui64Rep = bench_now();
+    for (size_t n = 0; n < szCalls; n++)
+      pb->run();
+    adNs[r] = (double)(bench_now() - ui64Rep) / szCalls;
+    adCycles[r] = (double)(bench_cycles() - ui64Cycles) / szCalls;
+  }
+  qsort(adNs, iRepetitions, sizeof(double), cmp_double);
+  qsort(adCycles, iRepetitions, sizeof(double), cmp_double);
+  pr->ns = adNs[iRepetitions / 2];
+  pr->cycles = adCycles[iRepetitions / 2];
+}
+
+// Check a result against the "name max_steps_per_op max_allocs_per_op" line of the thresholds file
+static bool
+bench_check(FILE *thresholds, const struct bench *pb, const struct bench_result *pr, const double dStepNs)
+{
+  char acLine[256];
+  rewind(thresholds);
+  while (fgets(acLine, sizeof(acLine), thresholds)) {
+    char acName[128];
+    double dMaxSteps, dMaxAllocs;
+    if ((acLine[0] == '#') || (sscanf(acLine, "%127s %lf %lf", acName, &dMaxSteps, &dMaxAllocs) != 3))
+      continue;
+    if (strcmp(acName, pb->name) != 0)
+      continue;
+    bool bOk = true;
+    if (pr->ns / dStepNs > dMaxSteps) {
+      printf("FAIL %s: %.1f reference steps/op, threshold is %.0f (%.1f ns/op, threshold is %.1f)\n",
+             pb->name, pr->ns / dStepNs, dMaxSteps, pr->ns, dMaxSteps * dStepNs);
+      bOk = false;
+    }
+#ifdef BENCH_COUNT_ALLOCATIONS
+    if (pr->allocs > dMaxAllocs) {
+      printf("FAIL %s: %.0f allocations/op, threshold is %.0f\n", pb->name, pr->allocs, dMaxAllocs);
+      bOk = false;
+    }
+#endif
+    return bOk;
+  }
+  return true;
+}
+
+static void
+print_usage(const char *progname)
+{
+  printf("usage: %s [-r repetitions] [-f filter] [-t thresholds] [-g] [-h]\n", progname);
+  printf("  -r repetitions  number of measured repetitions (default: %d)\n", BENCH_REPETITIONS);
+  printf("  -f filter       only run benchmarks whose name contains filter\n");
+  printf("  -t thresholds   fail when a result exceeds its threshold\n");
+  printf("  -g              print thresholds with %dx headroom from this run\n", BENCH_HEADROOM);
+  printf("  -h              print this help\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iRepetitions = BENCH_REPETITIONS;
+  const char *pcFilter = NULL;
+  const char *pcThresholds = NULL;
+  bool bGenerate = false;
+  int ch;
+
+  while ((ch = getopt(argc, argv, "r:f:t:gh")) != -1) {
+    switch (ch) {
+      case 'r':
+        iRepetitions = atoi(optarg);
+        if ((iRepetitions < 1) || (iRepetitions > BENCH_REPETITIONS_MAX)) {
+          fprintf(stderr, "Repetitions must be between 1 and %d\n", BENCH_REPETITIONS_MAX);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'f':
+        pcFilter = optarg;
+        break;
+      case 't':
+        pcThresholds = optarg;
+        break;
+      case 'g':
+        bGenerate = true;
+        break;
+      case 'h':
+        print_usage(argv[0]);
+        exit(EXIT_SUCCESS);
+      default:
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+
+  FILE *thresholds = NULL;
+  if (pcThresholds && !(thresholds = fopen(pcThresholds, "r"))) {
+    perror(pcThresholds);
+    exit(EXIT_FAILURE);
+  }
+  if (bench_setup() < 0) {
+    bench_teardown();
+    exit(EXIT_FAILURE);
+  }
+
+  // Unit of the thresholds
+  struct bench_result rReference;
+  bench_run(&reference, iRepetitions, &rReference);
+  const double dStepNs = rReference.ns / BENCH_REFERENCE_STEPS;
+
+  if (bGenerate) {
+    printf("# benchmark max_steps_per_op max_allocs_per_op\n");
+  } else {
+    printf("reference step: %.3f ns\n", dStepNs);
+    printf("%-36s %10s %10s %10s %12s %10s\n", "benchmark", "ns/op", "steps/op", "cycles/op", "cycles/byte", "allocs/op");
+  }
+
+  bool bOk = true;
+  for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    const struct bench *pb = &benches[i];
+    struct bench_result r;
+    if (pcFilter && !strstr(pb->name, pcFilter))
+      continue;
+    bench_run(pb, iRepetitions, &r);
+
+    if (bGenerate) {
+      // Round up to two significant digits
+      double dMaxSteps = r.ns / dStepNs * BENCH_HEADROOM, dScale = 1;
+      while (dMaxSteps >= 100) {
+        dMaxSteps /= 10;
+        dScale *= 10;
+      }
+      printf("%s %.0f %.0f\n", pb->name, (double)((uint64_t) dMaxSteps + 1) * dScale, r.allocs);
+      continue;
+    }
+
+    char acCyclesPerOp[16] = "-", acCyclesPerByte[16] = "-";
+#ifdef BENCH_HAS_CYCLES
+    snprintf(acCyclesPerOp, sizeof(acCyclesPerOp), "%.1f", r.cycles);
+    if (pb->bytes)
+      snprintf(acCyclesPerByte, sizeof(acCyclesPerByte), "%.2f", r.cycles / pb->bytes);
+#endif
+    printf("%-36s %10.1f %10.1f %10s %12s %10.0f\n", pb->name, r.ns, r.ns / dStepNs, acCyclesPerOp, acCyclesPerByte, r.allocs);
+    if (thresholds && !bench_check(thresholds, pb, &r, dStepNs))
+      bOk = false;
+  }
+
+  if (thresholds)
+    fclose(thresholds);
+  bench_teardown();
+  exit(bOk ? EXIT_SUCCESS : EXIT_FAILURE);
+}
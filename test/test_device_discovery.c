@@ -0,0 +1,234 @@
+// Built with -std=c99, setenv(), clock_gettime() and nanosleep() need POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+
+/*
+ * Exercise nfc_list_devices() with fake drivers whose scans are slow: drivers
+ * of distinct buses are scanned in parallel, scan_timeout bounds the wait and
+ * scan_cache_ttl saves scans.
+ */
+void test_device_discovery_parallel(void);
+void test_device_discovery_timeout(void);
+void test_device_discovery_left_behind(void);
+void test_device_discovery_cache(void);
+
+// Each fake scan sleeps for 200 ms then finds one device
+#define FAKE_SCAN_MS 200
+
+static int iScans;
+
+static void
+sleep_ms(const long ms)
+{
+  const struct timespec delay = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000 };
+  nanosleep(&delay, NULL);
+}
+
+static size_t
+fake_scan(const char *connstring, long ms, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  __atomic_add_fetch(&iScans, 1, __ATOMIC_RELAXED);
+  sleep_ms(ms);
+  if (!connstrings_len)
+    return 0;
+  strcpy(connstrings[0], connstring);
+  return 1;
+}
+
+static size_t
+fake_a_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  (void) context;
+  return fake_scan("fake_a:0", FAKE_SCAN_MS, connstrings, connstrings_len);
+}
+
+static size_t
+fake_b_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  (void) context;
+  return fake_scan("fake_b:0", FAKE_SCAN_MS, connstrings, connstrings_len);
+}
+
+static size_t
+fake_c_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  (void) context;
+  return fake_scan("fake_c:0", FAKE_SCAN_MS, connstrings, connstrings_len);
+}
+
+static size_t
+fake_stuck_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  (void) context;
+  return fake_scan("fake_stuck:0", 3000, connstrings, connstrings_len);
+}
+
+// Scans of fake_busy running, and their count
+static int iBusyScanning;
+static int iBusyScans;
+// Whether fake_busy was opened while it was scanning
+static bool bBusyOpenedWhileScanning;
+
+static size_t
+fake_busy_scan(const nfc_context *context, nfc_connstring connstrings[], const size_t connstrings_len)
+{
+  (void) context;
+  __atomic_add_fetch(&iBusyScanning, 1, __ATOMIC_SEQ_CST);
+  __atomic_add_fetch(&iBusyScans, 1, __ATOMIC_SEQ_CST);
+  const size_t res = fake_scan("fake_busy:0", 1000, connstrings, connstrings_len);
+  __atomic_sub_fetch(&iBusyScanning, 1, __ATOMIC_SEQ_CST);
+  return res;
+}
+
+static nfc_device *
+fake_busy_open(const nfc_context *context, const nfc_connstring connstring)
+{
+  (void) context;
+  (void) connstring;
+  bBusyOpenedWhileScanning = __atomic_load_n(&iBusyScanning, __ATOMIC_SEQ_CST) != 0;
+  return NULL;
+}
+
+// fake_a and fake_b use distinct buses, fake_c shares fake_a's one
+static const struct nfc_driver fake_a_driver = { .name = "fake_a", .scan_type = NOT_INTRUSIVE, .scan = fake_a_scan, .scan_bus = "fake1" };
+static const struct nfc_driver fake_b_driver = { .name = "fake_b", .scan_type = NOT_INTRUSIVE, .scan = fake_b_scan, .scan_bus = "fake2" };
+static const struct nfc_driver fake_c_driver = { .name = "fake_c", .scan_type = NOT_INTRUSIVE, .scan = fake_c_scan, .scan_bus = "fake1" };
+static const struct nfc_driver fake_stuck_driver = { .name = "fake_stuck", .scan_type = NOT_INTRUSIVE, .scan = fake_stuck_scan };
+static const struct nfc_driver fake_busy_driver = { .name = "fake_busy", .scan_type = NOT_INTRUSIVE, .scan = fake_busy_scan, .open = fake_busy_open, .scan_bus = "fake3" };
+
+static nfc_context *context;
+
+static void
+discovery_init(const char *timeout, const char *ttl)
+{
+  setenv("LIBNFC_SCAN_TIMEOUT", timeout, 1);
+  setenv("LIBNFC_SCAN_CACHE_TTL", ttl, 1);
+  nfc_init(&context);
+  unsetenv("LIBNFC_SCAN_TIMEOUT");
+  unsetenv("LIBNFC_SCAN_CACHE_TTL");
+  cut_assert_not_null(context, cut_message("nfc_init"));
+}
+
+// List devices, returning how long it took in ms and which fake devices were found
+static long
+discovery_list(char *acFound, size_t szFound)
+{
+  nfc_connstring connstrings[16];
+  struct timespec start, end;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  const size_t szDevices = nfc_list_devices(context, connstrings, 16);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  acFound[0] = '\0';
+  for (size_t i = 0; i < szDevices; i++) {
+    if (strncmp(connstrings[i], "fake_", 5) == 0) {
+      strncat(acFound, connstrings[i] + 5, szFound - strlen(acFound) - 1);
+      strncat(acFound, " ", szFound - strlen(acFound) - 1);
+    }
+  }
+  return (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+}
+
+void
+test_device_discovery_parallel(void)
+{
+  char acFound[64];
+
+  discovery_init("0", "0");
+  // Drivers are added in front of the list
+  nfc_register_driver(&fake_c_driver);
+  nfc_register_driver(&fake_b_driver);
+  nfc_register_driver(&fake_a_driver);
+
+  long elapsed = discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_string("a:0 b:0 c:0 ", acFound, cut_message("devices in driver order"));
+  // fake_a and fake_c are scanned one after the other, fake_b meanwhile
+  cut_assert_true(elapsed >= 2 * FAKE_SCAN_MS, cut_message("drivers of a bus scanned in turn, took %ld ms", elapsed));
+  cut_assert_true(elapsed < 3 * FAKE_SCAN_MS, cut_message("buses scanned in parallel, took %ld ms", elapsed));
+
+  nfc_exit(context);
+}
+
+void
+test_device_discovery_timeout(void)
+{
+  char acFound[64];
+
+  discovery_init("400", "0");
+  nfc_register_driver(&fake_stuck_driver);
+  nfc_register_driver(&fake_a_driver);
+
+  long elapsed = discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_string("a:0 ", acFound, cut_message("stuck driver not listed"));
+  cut_assert_true(elapsed < 1000, cut_message("deadline kept, took %ld ms", elapsed));
+
+  nfc_exit(context);
+}
+
+void
+test_device_discovery_left_behind(void)
+{
+  char acFound[64];
+
+  discovery_init("200", "0");
+  nfc_register_driver(&fake_busy_driver);
+  nfc_register_driver(&fake_a_driver);
+
+  long elapsed = discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_string("a:0 ", acFound, cut_message("busy driver not listed"));
+  cut_assert_true(elapsed < 1000, cut_message("deadline kept, took %ld ms", elapsed));
+
+  // The scan left behind still runs: its bus is not scanned again
+  elapsed = discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_string("a:0 ", acFound, cut_message("busy driver not listed again"));
+  cut_assert_true(elapsed < 1000, cut_message("no wait for the busy bus, took %ld ms", elapsed));
+  cut_assert_equal_int(1, __atomic_load_n(&iBusyScans, __ATOMIC_SEQ_CST), cut_message("busy bus scanned once"));
+
+  // Opening a device on that bus waits for the scan
+  const nfc_connstring connstring = "fake_busy:0";
+  cut_assert_null(nfc_open(context, connstring), cut_message("nfc_open"));
+  cut_assert_true(!bBusyOpenedWhileScanning, cut_message("opened while scanning"));
+
+  nfc_exit(context);
+}
+
+void
+test_device_discovery_cache(void)
+{
+  char acFound[64];
+
+  discovery_init("0", "500");
+  nfc_register_driver(&fake_a_driver);
+
+  iScans = 0;
+  discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_string("a:0 ", acFound, cut_message("first scan"));
+  cut_assert_equal_int(1, iScans, cut_message("scanned"));
+
+  long elapsed = discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_string("a:0 ", acFound, cut_message("cached scan"));
+  cut_assert_equal_int(1, iScans, cut_message("not scanned again"));
+  cut_assert_true(elapsed < FAKE_SCAN_MS, cut_message("cached, took %ld ms", elapsed));
+
+  // Opening a device which is gone drops the cache
+  const nfc_connstring connstring = "fake_gone:0";
+  cut_assert_null(nfc_open(context, connstring), cut_message("nfc_open"));
+  discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_int(2, iScans, cut_message("scanned after a failed open"));
+
+  // Results expire
+  sleep_ms(600);
+  discovery_list(acFound, sizeof(acFound));
+  cut_assert_equal_int(3, iScans, cut_message("scanned after the TTL"));
+
+  nfc_exit(context);
+}
@@ -0,0 +1,115 @@
+// Built without config.h (see Makefile.am), which usually asks for POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nfc/nfc.h>
+#include "buses/gpio.h"
+
+/*
+ * Exercise the IRQ line wait used by the pn532_spi driver without hardware:
+ * an eventfd or a timerfd stands for the GPIO line event fd.
+ */
+void test_gpio_irq_timeout(void);
+void test_gpio_irq_pending_edge(void);
+void test_gpio_irq_edge_latency(void);
+void test_gpio_irq_abort(void);
+
+static long
+elapsed_ms(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+void
+test_gpio_irq_timeout(void)
+{
+  struct timespec start;
+  gpio_irq irq = gpio_irq_open_fd(eventfd(0, 0));
+  cut_assert_true(irq != INVALID_GPIO_IRQ, cut_message("gpio_irq_open_fd"));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int res = gpio_irq_wait(irq, -1, 20);
+  cut_assert_equal_int(NFC_ETIMEOUT, res, cut_message("wait without edge"));
+  cut_assert_true(elapsed_ms(&start) >= 19, cut_message("timeout honored"));
+
+  gpio_irq_close(irq);
+}
+
+void
+test_gpio_irq_pending_edge(void)
+{
+  int fd = eventfd(0, 0);
+  gpio_irq irq = gpio_irq_open_fd(fd);
+  cut_assert_true(irq != INVALID_GPIO_IRQ, cut_message("gpio_irq_open_fd"));
+
+  // Edges happening before the wait are not lost
+  eventfd_write(fd, 1);
+  eventfd_write(fd, 1);
+  int res = gpio_irq_wait(irq, -1, 1000);
+  cut_assert_equal_int(NFC_SUCCESS, res, cut_message("wait with pending edge"));
+
+  // but are consumed by it
+  res = gpio_irq_wait(irq, -1, 10);
+  cut_assert_equal_int(NFC_ETIMEOUT, res, cut_message("wait after edge"));
+
+  gpio_irq_close(irq);
+}
+
+void
+test_gpio_irq_edge_latency(void)
+{
+  struct timespec start;
+  const struct itimerspec edge = { .it_value = { .tv_sec = 0, .tv_nsec = 2 * 1000 * 1000 } };
+  int fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  gpio_irq irq = gpio_irq_open_fd(fd);
+  cut_assert_true(irq != INVALID_GPIO_IRQ, cut_message("gpio_irq_open_fd"));
+
+  // The line falls 2 ms after the wait starts
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  timerfd_settime(fd, 0, &edge, NULL);
+  int res = gpio_irq_wait(irq, -1, 1000);
+  long elapsed = elapsed_ms(&start);
+  cut_assert_equal_int(NFC_SUCCESS, res, cut_message("wait for edge"));
+  cut_assert_true((elapsed >= 1) && (elapsed < 100), cut_message("woken up by the edge after %ld ms", elapsed));
+
+  gpio_irq_close(irq);
+}
+
+void
+test_gpio_irq_abort(void)
+{
+  int abort_fd = eventfd(0, EFD_NONBLOCK);
+  int other_abort_fd = eventfd(0, EFD_NONBLOCK);
+  eventfd_t value;
+  gpio_irq irq = gpio_irq_open_fd(eventfd(0, 0));
+  cut_assert_true(irq != INVALID_GPIO_IRQ, cut_message("gpio_irq_open_fd"));
+
+  int res = gpio_irq_wait(irq, abort_fd, 10);
+  cut_assert_equal_int(NFC_ETIMEOUT, res, cut_message("wait without abort"));
+
+  eventfd_write(abort_fd, 1);
+  res = gpio_irq_wait(irq, abort_fd, 1000);
+  cut_assert_equal_int(NFC_EOPABORTED, res, cut_message("wait with abort"));
+  eventfd_read(abort_fd, &value);
+
+  // An abort fd no longer given is not watched anymore
+  eventfd_write(abort_fd, 1);
+  res = gpio_irq_wait(irq, other_abort_fd, 10);
+  cut_assert_equal_int(NFC_ETIMEOUT, res, cut_message("wait with another abort fd"));
+
+  eventfd_write(other_abort_fd, 1);
+  res = gpio_irq_wait(irq, other_abort_fd, 1000);
+  cut_assert_equal_int(NFC_EOPABORTED, res, cut_message("wait with other abort"));
+
+  gpio_irq_close(irq);
+  close(abort_fd);
+  close(other_abort_fd);
+}
@@ -0,0 +1,144 @@
+#include <cutter.h>
+
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Check CRC_A and CRC_B against the examples of ISO/IEC 14443-3 Annex B, and
+ * frames whose CRC is well known (HLTA, REQB).
+ */
+void test_iso14443a_crc(void);
+void test_iso14443a_crc_check(void);
+void test_iso14443a_crc_batch(void);
+void test_iso14443b_crc(void);
+void test_iso14443b_crc_check(void);
+void test_iso14443b_crc_batch(void);
+
+struct crc_vector {
+  uint8_t abtData[8];
+  size_t szLen;
+  uint8_t abtCrc[2];
+};
+
+static const struct crc_vector crc_a_vectors[] = {
+  { { 0x00, 0x00 }, 2, { 0xa0, 0x1e } },
+  { { 0x12, 0x34 }, 2, { 0x26, 0xcf } },
+  // HLTA
+  { { 0x50, 0x00 }, 2, { 0x57, 0xcd } },
+  // Empty frame: initial value
+  { { 0x00 }, 0, { 0x63, 0x63 } },
+};
+
+static const struct crc_vector crc_b_vectors[] = {
+  { { 0x00, 0x00, 0x00 }, 3, { 0xcc, 0xc6 } },
+  { { 0x0f, 0xaa, 0xff }, 3, { 0xfc, 0xd1 } },
+  { { 0x0a, 0x12, 0x34, 0x56 }, 4, { 0x2c, 0xf6 } },
+  // REQB, AFI 0, one slot
+  { { 0x05, 0x00, 0x00 }, 3, { 0x71, 0xff } },
+};
+
+#define VECTOR_COUNT(v) (sizeof(v) / sizeof(v[0]))
+
+void
+test_iso14443a_crc(void)
+{
+  for (size_t n = 0; n < VECTOR_COUNT(crc_a_vectors); n++) {
+    uint8_t abtFrame[10];
+    uint8_t abtCrc[2];
+    memcpy(abtFrame, crc_a_vectors[n].abtData, crc_a_vectors[n].szLen);
+    iso14443a_crc(abtFrame, crc_a_vectors[n].szLen, abtCrc);
+    cut_assert_equal_memory(crc_a_vectors[n].abtCrc, 2, abtCrc, 2, cut_message("CRC_A of vector %d", (int) n));
+    iso14443a_crc_append(abtFrame, crc_a_vectors[n].szLen);
+    cut_assert_equal_memory(crc_a_vectors[n].abtCrc, 2, abtFrame + crc_a_vectors[n].szLen, 2, cut_message("CRC_A appended to vector %d", (int) n));
+  }
+}
+
+void
+test_iso14443a_crc_check(void)
+{
+  for (size_t n = 0; n < VECTOR_COUNT(crc_a_vectors); n++) {
+    uint8_t abtFrame[10];
+    const size_t szFrame = crc_a_vectors[n].szLen + 2;
+    memcpy(abtFrame, crc_a_vectors[n].abtData, crc_a_vectors[n].szLen);
+    memcpy(abtFrame + crc_a_vectors[n].szLen, crc_a_vectors[n].abtCrc, 2);
+    cut_assert_true(iso14443a_crc_check(abtFrame, szFrame), cut_message("valid CRC_A of vector %d", (int) n));
+
+    // Any flipped bit, in data or CRC, is detected
+    for (size_t bit = 0; bit < szFrame * 8; bit++) {
+      abtFrame[bit / 8] ^= 1 << (bit % 8);
+      cut_assert_true(!iso14443a_crc_check(abtFrame, szFrame), cut_message("bit %d flipped in vector %d", (int) bit, (int) n));
+      abtFrame[bit / 8] ^= 1 << (bit % 8);
+    }
+  }
+  // Too short to hold a CRC
+  const uint8_t abtShort[] = { 0x63 };
+  cut_assert_true(!iso14443a_crc_check(abtShort, sizeof(abtShort)), cut_message("one byte frame"));
+}
+
+void
+test_iso14443a_crc_batch(void)
+{
+  const uint8_t *apbtData[VECTOR_COUNT(crc_a_vectors)];
+  size_t aszLen[VECTOR_COUNT(crc_a_vectors)];
+  uint8_t abtCrc[2 * VECTOR_COUNT(crc_a_vectors)];
+
+  for (size_t n = 0; n < VECTOR_COUNT(crc_a_vectors); n++) {
+    apbtData[n] = crc_a_vectors[n].abtData;
+    aszLen[n] = crc_a_vectors[n].szLen;
+  }
+  iso14443a_crc_batch(apbtData, aszLen, VECTOR_COUNT(crc_a_vectors), abtCrc);
+  for (size_t n = 0; n < VECTOR_COUNT(crc_a_vectors); n++)
+    cut_assert_equal_memory(crc_a_vectors[n].abtCrc, 2, abtCrc + 2 * n, 2, cut_message("batched CRC_A of vector %d", (int) n));
+}
+
+void
+test_iso14443b_crc(void)
+{
+  for (size_t n = 0; n < VECTOR_COUNT(crc_b_vectors); n++) {
+    uint8_t abtFrame[10];
+    uint8_t abtCrc[2];
+    memcpy(abtFrame, crc_b_vectors[n].abtData, crc_b_vectors[n].szLen);
+    iso14443b_crc(abtFrame, crc_b_vectors[n].szLen, abtCrc);
+    cut_assert_equal_memory(crc_b_vectors[n].abtCrc, 2, abtCrc, 2, cut_message("CRC_B of vector %d", (int) n));
+    iso14443b_crc_append(abtFrame, crc_b_vectors[n].szLen);
+    cut_assert_equal_memory(crc_b_vectors[n].abtCrc, 2, abtFrame + crc_b_vectors[n].szLen, 2, cut_message("CRC_B appended to vector %d", (int) n));
+  }
+}
+
+void
+test_iso14443b_crc_check(void)
+{
+  for (size_t n = 0; n < VECTOR_COUNT(crc_b_vectors); n++) {
+    uint8_t abtFrame[10];
+    const size_t szFrame = crc_b_vectors[n].szLen + 2;
+    memcpy(abtFrame, crc_b_vectors[n].abtData, crc_b_vectors[n].szLen);
+    memcpy(abtFrame + crc_b_vectors[n].szLen, crc_b_vectors[n].abtCrc, 2);
+    cut_assert_true(iso14443b_crc_check(abtFrame, szFrame), cut_message("valid CRC_B of vector %d", (int) n));
+
+    // Any flipped bit, in data or CRC, is detected
+    for (size_t bit = 0; bit < szFrame * 8; bit++) {
+      abtFrame[bit / 8] ^= 1 << (bit % 8);
+      cut_assert_true(!iso14443b_crc_check(abtFrame, szFrame), cut_message("bit %d flipped in vector %d", (int) bit, (int) n));
+      abtFrame[bit / 8] ^= 1 << (bit % 8);
+    }
+  }
+  const uint8_t abtShort[] = { 0xff };
+  cut_assert_true(!iso14443b_crc_check(abtShort, sizeof(abtShort)), cut_message("one byte frame"));
+}
+
+void
+test_iso14443b_crc_batch(void)
+{
+  const uint8_t *apbtData[VECTOR_COUNT(crc_b_vectors)];
+  size_t aszLen[VECTOR_COUNT(crc_b_vectors)];
+  uint8_t abtCrc[2 * VECTOR_COUNT(crc_b_vectors)];
+
+  for (size_t n = 0; n < VECTOR_COUNT(crc_b_vectors); n++) {
+    apbtData[n] = crc_b_vectors[n].abtData;
+    aszLen[n] = crc_b_vectors[n].szLen;
+  }
+  iso14443b_crc_batch(apbtData, aszLen, VECTOR_COUNT(crc_b_vectors), abtCrc);
+  for (size_t n = 0; n < VECTOR_COUNT(crc_b_vectors); n++)
+    cut_assert_equal_memory(crc_b_vectors[n].abtCrc, 2, abtCrc + 2 * n, 2, cut_message("batched CRC_B of vector %d", (int) n));
+}
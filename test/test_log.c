@@ -0,0 +1,212 @@
+// Built with -std=c99, clock_gettime() and nanosleep() need POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+#include "log.h"
+
+/*
+ * Check the log facility.  Log helpers are internal to libnfc: this test is
+ * built against its own copy of log.c, driven with contexts of its own.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_log_level_per_context(void);
+void test_log_async_format(void);
+void test_log_async_dropped(void);
+void test_log_async_wakeup(void);
+
+#define LOG_TEST_MESSAGES 64
+#define LOG_TEST_MESSAGE_LEN 1280
+
+static nfc_context context;
+
+// Messages received by the callback sink
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  char messages[LOG_TEST_MESSAGES][LOG_TEST_MESSAGE_LEN];
+  int priorities[LOG_TEST_MESSAGES];
+  size_t count;
+  // The sink waits while it is set
+  bool blocked;
+  bool waiting;
+} sink = { .mutex = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static void
+sink_callback(const uint64_t timestamp_us, const int priority, const char *category, const char *message, void *user_data)
+{
+  (void) timestamp_us;
+  (void) category;
+  (void) user_data;
+  pthread_mutex_lock(&sink.mutex);
+  sink.waiting = true;
+  pthread_cond_broadcast(&sink.cond);
+  while (sink.blocked)
+    pthread_cond_wait(&sink.cond, &sink.mutex);
+  sink.waiting = false;
+  if (sink.count < LOG_TEST_MESSAGES) {
+    snprintf(sink.messages[sink.count], LOG_TEST_MESSAGE_LEN, "%s", message);
+    sink.priorities[sink.count] = priority;
+  }
+  sink.count++;
+  pthread_mutex_unlock(&sink.mutex);
+}
+
+void
+cut_setup(void)
+{
+  memset(&context, 0, sizeof(context));
+  context.log_level = NFC_LOG_PRIORITY_DEBUG;
+  log_init(&context);
+  sink.count = 0;
+  sink.blocked = false;
+  cut_assert_equal_int(0, log_set_sink(&context, NULL, sink_callback, NULL), cut_message("log_set_sink"));
+}
+
+void
+cut_teardown(void)
+{
+  pthread_mutex_lock(&sink.mutex);
+  sink.blocked = false;
+  pthread_cond_broadcast(&sink.cond);
+  pthread_mutex_unlock(&sink.mutex);
+  log_exit(&context);
+}
+
+void
+test_log_level_per_context(void)
+{
+  // Leave the context of cut_setup() out
+  log_exit(&context);
+  nfc_context a, b;
+  memset(&a, 0, sizeof(a));
+  memset(&b, 0, sizeof(b));
+
+  // Errors for a, communications debug for b
+  a.log_level = NFC_LOG_PRIORITY_ERROR;
+  b.log_level = NFC_LOG_PRIORITY_DEBUG << (NFC_LOG_GROUP_COM * 2);
+  log_init(&a);
+  log_init(&b);
+  cut_assert_true(log_enabled(NFC_LOG_GROUP_CHIP, NFC_LOG_PRIORITY_ERROR), cut_message("error asked for by a"));
+  cut_assert_true(!log_enabled(NFC_LOG_GROUP_CHIP, NFC_LOG_PRIORITY_INFO), cut_message("info asked for by none"));
+  cut_assert_true(log_enabled(NFC_LOG_GROUP_COM, NFC_LOG_PRIORITY_DEBUG), cut_message("debug asked for by b"));
+
+  // Changing a level leaves the other context alone
+  log_set_context_level(&a, NFC_LOG_PRIORITY_NONE);
+  cut_assert_equal_int(NFC_LOG_PRIORITY_DEBUG << (NFC_LOG_GROUP_COM * 2), b.log_level, cut_message("level of b"));
+  cut_assert_true(!log_enabled(NFC_LOG_GROUP_CHIP, NFC_LOG_PRIORITY_ERROR), cut_message("error asked for by none"));
+  cut_assert_true(log_enabled(NFC_LOG_GROUP_COM, NFC_LOG_PRIORITY_DEBUG), cut_message("debug still asked for by b"));
+
+  // So does the exit of a context
+  log_set_context_level(&a, NFC_LOG_PRIORITY_INFO);
+  log_exit(&b);
+  cut_assert_true(log_enabled(NFC_LOG_GROUP_CHIP, NFC_LOG_PRIORITY_INFO), cut_message("info asked for by a"));
+  cut_assert_true(!log_enabled(NFC_LOG_GROUP_COM, NFC_LOG_PRIORITY_DEBUG), cut_message("debug asked for by none"));
+  log_exit(&a);
+}
+
+static const uint8_t abtFrame[300] = { 0x00, 0xd4, 0x4a, 0x01, 0x00, 0xff };
+
+// Log one message for each kind of argument, and frame dumps
+static void
+log_test_messages(void)
+{
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_ERROR, "%s|%-8s|%.3s", "abc", "de", "fghij");
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_INFO, "%*d|%-*d|%.*d", 6, -42, 5, 7, 4, 3);
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "%lld %llu %lx", -1234567890123LL, 18446744073709551615ULL, 0xdeadbeefUL);
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "%p %p", (void *) &context, (void *) NULL);
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "%c%c%3c", 'x', 'y', 'z');
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "100%% done, %d%%", 50);
+  log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "%zu %hhu %hd %u %08.3f", (size_t) 42, (unsigned char) 200, (short) -3, 7u, 3.14159);
+  log_hex(NFC_LOG_GROUP_COM, "test", "TX", abtFrame, 0);
+  log_hex(NFC_LOG_GROUP_COM, "test", "TX", abtFrame, 6);
+  log_hex(NFC_LOG_GROUP_COM, "test", "RX", abtFrame, sizeof(abtFrame));
+}
+
+void
+test_log_async_format(void)
+{
+  static char acSync[LOG_TEST_MESSAGES][LOG_TEST_MESSAGE_LEN];
+  static int aiSync[LOG_TEST_MESSAGES];
+
+  log_test_messages();
+  const size_t szSync = sink.count;
+  cut_assert_equal_int(10, szSync, cut_message("synchronous messages"));
+  memcpy(acSync, sink.messages, sizeof(acSync));
+  memcpy(aiSync, sink.priorities, sizeof(aiSync));
+  sink.count = 0;
+
+  cut_assert_equal_int(0, log_start_async(&context, 0), cut_message("log_start_async"));
+  log_test_messages();
+  // Pending records are written when logging is made synchronous again
+  cut_assert_equal_int(0, log_stop_async(&context), cut_message("log_stop_async"));
+  cut_assert_equal_int(szSync, sink.count, cut_message("asynchronous messages"));
+  cut_assert_equal_int(0, log_get_dropped(), cut_message("dropped records"));
+  for (size_t n = 0; n < szSync; n++) {
+    cut_assert_equal_string(acSync[n], sink.messages[n], cut_message("message %d", (int) n));
+    cut_assert_equal_int(aiSync[n], sink.priorities[n], cut_message("priority of message %d", (int) n));
+  }
+}
+
+void
+test_log_async_dropped(void)
+{
+  const size_t szRecords = 16;
+  const size_t szMessages = 40;
+
+  cut_assert_equal_int(0, log_start_async(&context, szRecords), cut_message("log_start_async"));
+
+  // The log thread is held in the sink with the first record, whose slot is
+  // not handed back: the ring is full once szRecords records are queued
+  pthread_mutex_lock(&sink.mutex);
+  sink.blocked = true;
+  pthread_mutex_unlock(&sink.mutex);
+  for (size_t n = 0; n < szMessages; n++)
+    log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "message %d", (int) n);
+  pthread_mutex_lock(&sink.mutex);
+  while (!sink.waiting)
+    pthread_cond_wait(&sink.cond, &sink.mutex);
+  sink.blocked = false;
+  pthread_cond_broadcast(&sink.cond);
+  pthread_mutex_unlock(&sink.mutex);
+
+  cut_assert_equal_int(0, log_stop_async(&context), cut_message("log_stop_async"));
+  cut_assert_equal_int(szMessages - szRecords, log_get_dropped(), cut_message("dropped records"));
+  cut_assert_equal_int(szRecords, sink.count, cut_message("written records"));
+  cut_assert_equal_string("message 0", sink.messages[0], cut_message("first message"));
+  cut_assert_equal_string("message 15", sink.messages[szRecords - 1], cut_message("last message"));
+}
+
+void
+test_log_async_wakeup(void)
+{
+  cut_assert_equal_int(0, log_start_async(&context, 0), cut_message("log_start_async"));
+
+  for (int n = 0; n < 3; n++) {
+    // Let the log thread find the ring empty and wait, then wake it up
+    const struct timespec delay = { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+    nanosleep(&delay, NULL);
+    log_put_message(NFC_LOG_GROUP_GENERAL, "test", NFC_LOG_PRIORITY_DEBUG, "message %d", n);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 1;
+    pthread_mutex_lock(&sink.mutex);
+    while (sink.count < (size_t) n + 1) {
+      if (pthread_cond_timedwait(&sink.cond, &sink.mutex, &deadline) != 0)
+        break;
+    }
+    const size_t szCount = sink.count;
+    pthread_mutex_unlock(&sink.mutex);
+    cut_assert_equal_int(n + 1, szCount, cut_message("message %d written without a stop", n));
+  }
+  cut_assert_equal_int(0, log_stop_async(&context), cut_message("log_stop_async"));
+}
@@ -0,0 +1,99 @@
+#include <cutter.h>
+
+#include <string.h>
+
+#include "mirror-subr.h"
+
+/*
+ * Check mirror_buffer() against mirror(), one byte at a time, for every
+ * length up to two vectors and a bit more, and unaligned buffers.  This file
+ * is built against its own copy of mirror-subr.c, once as the library is and
+ * once with SSSE3, to run each vector path.
+ */
+void cut_setup(void);
+void test_mirror(void);
+void test_mirror_buffer(void);
+void test_mirror_buffer_in_place(void);
+
+#define MIRROR_MAX_LEN 33
+#define MIRROR_MAX_OFFSET 16
+#define MIRROR_GUARD 0xa5
+
+void
+cut_setup(void)
+{
+#if defined(__SSSE3__) && defined(__GNUC__)
+  if (!__builtin_cpu_supports("ssse3"))
+    cut_omit("SSSE3 is not supported by this CPU");
+#endif
+}
+
+static uint32_t random_state = 0x9e3779b9;
+
+static uint8_t
+random_byte(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return (uint8_t) random_state;
+}
+
+void
+test_mirror(void)
+{
+  for (int n = 0; n < 256; n++) {
+    uint8_t btExpected = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      if (n & (1 << bit))
+        btExpected |= 0x80 >> bit;
+    }
+    cut_assert_equal_int(btExpected, mirror(n), cut_message("mirror of 0x%02x", n));
+  }
+  cut_assert_equal_int(0x2c480c88, mirror32(0x34123011), cut_message("mirror32"));
+  cut_assert_true(mirror64(0x0123456789abcdefULL) == 0x80c4a2e691d5b3f7ULL, cut_message("mirror64"));
+}
+
+void
+test_mirror_buffer(void)
+{
+  uint8_t abtSrc[MIRROR_MAX_OFFSET + MIRROR_MAX_LEN];
+  uint8_t abtDst[MIRROR_MAX_OFFSET + MIRROR_MAX_LEN + 1];
+
+  for (size_t szLen = 0; szLen <= MIRROR_MAX_LEN; szLen++) {
+    for (size_t szSrcOffset = 0; szSrcOffset < MIRROR_MAX_OFFSET; szSrcOffset++) {
+      // Destination misaligned differently from the source
+      const size_t szDstOffset = (szSrcOffset * 7 + 3) % MIRROR_MAX_OFFSET;
+      for (size_t n = 0; n < sizeof(abtSrc); n++)
+        abtSrc[n] = random_byte();
+      memset(abtDst, MIRROR_GUARD, sizeof(abtDst));
+
+      mirror_buffer(abtDst + szDstOffset, abtSrc + szSrcOffset, szLen);
+      for (size_t n = 0; n < sizeof(abtDst); n++) {
+        const bool bInside = (n >= szDstOffset) && (n < szDstOffset + szLen);
+        const uint8_t btExpected = bInside ? mirror(abtSrc[szSrcOffset + n - szDstOffset]) : MIRROR_GUARD;
+        cut_assert_equal_int(btExpected, abtDst[n], cut_message("byte %d of %d bytes from offset %d to %d", (int) n, (int) szLen, (int) szSrcOffset, (int) szDstOffset));
+      }
+    }
+  }
+}
+
+void
+test_mirror_buffer_in_place(void)
+{
+  uint8_t abtBuffer[MIRROR_MAX_OFFSET + MIRROR_MAX_LEN];
+  uint8_t abtExpected[sizeof(abtBuffer)];
+
+  for (size_t szLen = 0; szLen <= MIRROR_MAX_LEN; szLen++) {
+    for (size_t szOffset = 0; szOffset < MIRROR_MAX_OFFSET; szOffset++) {
+      for (size_t n = 0; n < sizeof(abtBuffer); n++)
+        abtBuffer[n] = random_byte();
+      memcpy(abtExpected, abtBuffer, sizeof(abtBuffer));
+      for (size_t n = szOffset; n < szOffset + szLen; n++)
+        abtExpected[n] = mirror(abtExpected[n]);
+
+      mirror_buffer(abtBuffer + szOffset, abtBuffer + szOffset, szLen);
+      cut_assert_equal_memory(abtExpected, sizeof(abtExpected), abtBuffer, sizeof(abtBuffer), cut_message("%d bytes in place at offset %d", (int) szLen, (int) szOffset));
+    }
+  }
+}
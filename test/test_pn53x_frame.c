@@ -0,0 +1,116 @@
+#include <cutter.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+#include "chips/pn53x.h"
+
+/*
+ * Check pn53x_wrap_frame() and pn53x_unwrap_frame() against a bit by bit
+ * reference, for frames of 0 to 17 data bytes and every bit count in between:
+ * data bit i is sent at bit 9 * (i / 8) + i % 8 of the frame, and the parity
+ * of data byte j at bit 9 * j + 8.
+ */
+void test_pn53x_wrap_frame(void);
+void test_pn53x_unwrap_frame(void);
+
+#define FRAME_MAX_BYTES 17
+
+static uint32_t random_state = 0x2545f491;
+
+static uint8_t
+random_byte(void)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return (uint8_t) random_state;
+}
+
+static bool
+get_bit(const uint8_t *pbt, const size_t szBit)
+{
+  return (pbt[szBit / 8] >> (szBit % 8)) & 0x01;
+}
+
+static void
+set_bit(uint8_t *pbt, const size_t szBit, const bool bValue)
+{
+  if (bValue)
+    pbt[szBit / 8] |= 1 << (szBit % 8);
+  else
+    pbt[szBit / 8] &= ~(1 << (szBit % 8));
+}
+
+void
+test_pn53x_wrap_frame(void)
+{
+  // Nothing to frame
+  uint8_t abtEmpty[1] = { 0x00 };
+  cut_assert_equal_int(NFC_ECHIP, pn53x_wrap_frame(abtEmpty, 0, abtEmpty, abtEmpty), cut_message("empty frame"));
+
+  for (size_t szTxBits = 1; szTxBits <= FRAME_MAX_BYTES * 8; szTxBits++) {
+    uint8_t abtTx[FRAME_MAX_BYTES];
+    uint8_t abtTxPar[FRAME_MAX_BYTES];
+    uint8_t abtFrame[FRAME_MAX_BYTES * 9 / 8 + 1];
+    uint8_t abtExpected[sizeof(abtFrame)];
+
+    for (size_t n = 0; n < sizeof(abtTx); n++) {
+      abtTx[n] = random_byte();
+      abtTxPar[n] = random_byte() & 0x01;
+    }
+
+    // Short frames are sent as they are, without parity
+    const size_t szParities = (szTxBits < 9) ? 0 : szTxBits / 8;
+    const size_t szFrameBits = szTxBits + szParities;
+    memset(abtExpected, 0x00, sizeof(abtExpected));
+    for (size_t i = 0; i < szTxBits; i++)
+      set_bit(abtExpected, szParities ? 9 * (i / 8) + i % 8 : i, get_bit(abtTx, i));
+    for (size_t j = 0; j < szParities; j++)
+      set_bit(abtExpected, 9 * j + 8, abtTxPar[j]);
+
+    memset(abtFrame, 0x00, sizeof(abtFrame));
+    cut_assert_equal_int((int) szFrameBits, pn53x_wrap_frame(abtTx, szTxBits, abtTxPar, abtFrame), cut_message("frame bits for %d data bits", (int) szTxBits));
+    for (size_t f = 0; f < szFrameBits; f++)
+      cut_assert_equal_int(get_bit(abtExpected, f), get_bit(abtFrame, f), cut_message("frame bit %d of %d data bits", (int) f, (int) szTxBits));
+  }
+}
+
+void
+test_pn53x_unwrap_frame(void)
+{
+  uint8_t abtEmpty[1] = { 0x00 };
+  cut_assert_equal_int(NFC_ECHIP, pn53x_unwrap_frame(abtEmpty, 0, abtEmpty, abtEmpty), cut_message("empty frame"));
+
+  for (size_t szFrameBits = 1; szFrameBits <= FRAME_MAX_BYTES * 9; szFrameBits++) {
+    // Exactly the received bytes, so that reading past them is caught by memory checkers
+    const size_t szFrameBytes = (szFrameBits + 7) / 8;
+    uint8_t *pbtFrame = malloc(szFrameBytes);
+    cut_assert_not_null(pbtFrame, cut_message("malloc"));
+    uint8_t abtRx[FRAME_MAX_BYTES];
+    uint8_t abtRxPar[FRAME_MAX_BYTES];
+    uint8_t abtRxNoPar[FRAME_MAX_BYTES];
+
+    for (size_t n = 0; n < szFrameBytes; n++)
+      pbtFrame[n] = random_byte();
+
+    // Short frames hold no parity
+    const size_t szParities = (szFrameBits < 9) ? 0 : szFrameBits / 9;
+    const size_t szRxBits = szFrameBits - szParities;
+    memset(abtRx, 0x00, sizeof(abtRx));
+    memset(abtRxPar, 0x00, sizeof(abtRxPar));
+    memset(abtRxNoPar, 0x00, sizeof(abtRxNoPar));
+    cut_assert_equal_int((int) szRxBits, pn53x_unwrap_frame(pbtFrame, szFrameBits, abtRx, abtRxPar), cut_message("data bits for %d frame bits", (int) szFrameBits));
+    cut_assert_equal_int((int) szRxBits, pn53x_unwrap_frame(pbtFrame, szFrameBits, abtRxNoPar, NULL), cut_message("data bits for %d frame bits, without parity", (int) szFrameBits));
+
+    for (size_t i = 0; i < szRxBits; i++) {
+      const bool bExpected = get_bit(pbtFrame, szParities ? 9 * (i / 8) + i % 8 : i);
+      cut_assert_equal_int(bExpected, get_bit(abtRx, i), cut_message("data bit %d of %d frame bits", (int) i, (int) szFrameBits));
+      cut_assert_equal_int(bExpected, get_bit(abtRxNoPar, i), cut_message("data bit %d of %d frame bits, without parity", (int) i, (int) szFrameBits));
+    }
+    for (size_t j = 0; j < szParities; j++)
+      cut_assert_equal_int(get_bit(pbtFrame, 9 * j + 8), abtRxPar[j], cut_message("parity %d of %d frame bits", (int) j, (int) szFrameBits));
+    free(pbtFrame);
+  }
+}
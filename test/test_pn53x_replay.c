@@ -0,0 +1,133 @@
+// Built with -std=c99, setenv() and clock_gettime() need POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Capture a session with the pn53x_sim driver, then replay it with the
+ * pn53x_replay driver.
+ */
+void test_pn53x_replay_fast(void);
+void test_pn53x_replay_timing(void);
+void test_pn53x_replay_divergence(void);
+
+#define CAPTURE_FILE "test_pn53x_replay.cap"
+// Latency of the simulated card exchanges, in us, as in the connstring below
+#define RF_LATENCY   50000
+
+static const nfc_modulation nm_iso14443a = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+
+static nfc_context *context;
+static uint8_t abtApdu[260];
+
+static long
+elapsed_us(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+// Select the ISO14443-4 card and exchange a chained APDU, return the time it took in us
+static long
+session(nfc_device *device, const size_t szApdu, int *pres)
+{
+  nfc_target nt;
+  uint8_t abtRx[300];
+  struct timespec start;
+
+  cut_assert_equal_int(0, nfc_initiator_init(device), cut_message("nfc_initiator_init"));
+  cut_assert_equal_int(1, nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt), cut_message("select"));
+  cut_assert_equal_int(0x20, nt.nti.nai.btSak, cut_message("ISO14443-4 SAK"));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  *pres = nfc_initiator_transceive_bytes(device, abtApdu, szApdu, abtRx, sizeof(abtRx), 0);
+  const long elapsed = elapsed_us(&start);
+  if (*pres > 0)
+    cut_assert_equal_memory(abtApdu, szApdu, abtRx, szApdu, cut_message("APDU echoed"));
+  return elapsed;
+}
+
+static void
+capture(void)
+{
+  int res;
+
+  for (size_t i = 0; i < sizeof(abtApdu); i++)
+    abtApdu[i] = i;
+  setenv("LIBNFC_CAPTURE", CAPTURE_FILE, 1);
+  nfc_init(&context);
+  unsetenv("LIBNFC_CAPTURE");
+  cut_assert_not_null(context, cut_message("nfc_init"));
+  nfc_device *device = nfc_open(context, "pn53x_sim:pn533:iso14443-4,rf-latency=50000");
+  cut_assert_not_null(device, cut_message("nfc_open pn53x_sim"));
+  session(device, sizeof(abtApdu), &res);
+  cut_assert_equal_int((int) sizeof(abtApdu) + 2, res, cut_message("captured APDU"));
+  nfc_close(device);
+  nfc_exit(context);
+}
+
+static nfc_device *
+replay_open(const char *mode)
+{
+  nfc_connstring connstring;
+  snprintf(connstring, sizeof(connstring), "pn53x_replay:%s%s", CAPTURE_FILE, mode);
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+  nfc_device *device = nfc_open(context, connstring);
+  cut_assert_not_null(device, cut_message("nfc_open %s", connstring));
+  return device;
+}
+
+static void
+replay_close(nfc_device *device)
+{
+  nfc_close(device);
+  nfc_exit(context);
+  remove(CAPTURE_FILE);
+}
+
+void
+test_pn53x_replay_fast(void)
+{
+  int res;
+
+  capture();
+  nfc_device *device = replay_open(":fast");
+  const long elapsed = session(device, sizeof(abtApdu), &res);
+  cut_assert_equal_int((int) sizeof(abtApdu) + 2, res, cut_message("replayed APDU"));
+  cut_assert_true(elapsed < RF_LATENCY, cut_message("replayed without chip time, took %ld us", elapsed));
+  replay_close(device);
+}
+
+void
+test_pn53x_replay_timing(void)
+{
+  int res;
+
+  capture();
+  nfc_device *device = replay_open("");
+  const long elapsed = session(device, sizeof(abtApdu), &res);
+  cut_assert_equal_int((int) sizeof(abtApdu) + 2, res, cut_message("replayed APDU"));
+  cut_assert_true(elapsed >= RF_LATENCY, cut_message("replayed with chip time, took %ld us", elapsed));
+  replay_close(device);
+}
+
+void
+test_pn53x_replay_divergence(void)
+{
+  int res;
+
+  capture();
+  nfc_device *device = replay_open(":fast");
+  // Another APDU than the captured one
+  session(device, 5, &res);
+  cut_assert_equal_int(NFC_EIO, res, cut_message("diverging command"));
+  replay_close(device);
+}
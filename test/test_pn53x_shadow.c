@@ -0,0 +1,132 @@
+#include <cutter.h>
+
+#include <nfc/nfc.h>
+#include "nfc-internal.h"
+#include "chips/pn53x.h"
+
+/*
+ * Check the PN53x shadow register copy against the pn53x_sim driver:
+ * registers known from a previous access are not read from the chip again,
+ * until a command may have changed them.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_pn53x_shadow_write(void);
+void test_pn53x_shadow_failed_send(void);
+void test_pn53x_shadow_exchange(void);
+
+static nfc_context *context;
+static nfc_device *device;
+
+void
+cut_setup(void)
+{
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+  device = nfc_open(context, "pn53x_sim:pn533:mifare-ultralight");
+  cut_assert_not_null(device, cut_message("nfc_open"));
+  cut_assert_equal_int(0, nfc_initiator_init(device), cut_message("nfc_initiator_init"));
+}
+
+void
+cut_teardown(void)
+{
+  if (device)
+    nfc_close(device);
+  device = NULL;
+  if (context)
+    nfc_exit(context);
+  context = NULL;
+}
+
+// ReadRegister commands sent to the chip since the last statistics reset
+static uint64_t
+read_register_count(void)
+{
+  nfc_device_stats stats;
+  cut_assert_equal_int(0, nfc_device_get_stats(device, &stats), cut_message("nfc_device_get_stats"));
+  for (size_t n = 0; n < stats.command_count; n++) {
+    if (stats.commands[n].code == ReadRegister)
+      return stats.commands[n].latency.count;
+  }
+  return 0;
+}
+
+void
+test_pn53x_shadow_write(void)
+{
+  uint8_t value;
+
+  // A full write needs no read, and sends the registers waiting in the write-back cache
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_SFR_P3CFGB, 0xff, 0x00), >=, 0, cut_message("write register"));
+  cut_assert_equal_int(0, nfc_device_reset_stats(device), cut_message("nfc_device_reset_stats"));
+
+  // Read-modify-writes then use the shadow copy
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_SFR_P3CFGB, 0x0f, 0x05), >=, 0, cut_message("write low nibble"));
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_SFR_P3CFGB, 0xf0, 0xa0), >=, 0, cut_message("write high nibble"));
+  cut_assert_equal_int(0, pn53x_read_register(device, PN53X_SFR_P3CFGB, &value), cut_message("read register"));
+  cut_assert_equal_int(0xa5, value, cut_message("shadowed value"));
+  cut_assert_equal_int(0, read_register_count(), cut_message("register read from the chip"));
+}
+
+static int
+failing_send(nfc_device *pnd, const uint8_t *pbtData, const size_t szData, int timeout)
+{
+  (void) pnd;
+  (void) pbtData;
+  (void) szData;
+  (void) timeout;
+  return NFC_EIO;
+}
+
+void
+test_pn53x_shadow_failed_send(void)
+{
+  uint8_t value;
+
+  // A full write needs no read
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_SFR_P3CFGB, 0xff, 0x5a), >=, 0, cut_message("write register"));
+  cut_assert_equal_int(0, nfc_device_reset_stats(device), cut_message("nfc_device_reset_stats"));
+
+  // The chip may or may not have run a command whose sending failed
+  const struct pn53x_io *io = CHIP_DATA(device)->io;
+  struct pn53x_io failing_io = *io;
+  failing_io.send = failing_send;
+  CHIP_DATA(device)->io = &failing_io;
+  int res = pn53x_write_register(device, PN53X_SFR_P3CFGB, 0x0f, 0x00);
+  CHIP_DATA(device)->io = io;
+  cut_assert_equal_int(NFC_EIO, res, cut_message("write register with a failing send"));
+  cut_assert_equal_int(0, read_register_count(), cut_message("register read from the shadow copy before the write"));
+
+  // So the register is read again from the chip, which kept its value
+  cut_assert_equal_int(0, pn53x_read_register(device, PN53X_SFR_P3CFGB, &value), cut_message("read register"));
+  cut_assert_equal_int(1, read_register_count(), cut_message("register read from the chip"));
+  cut_assert_equal_int(0x5a, value, cut_message("chip value"));
+}
+
+void
+test_pn53x_shadow_exchange(void)
+{
+  nfc_target nt;
+  const nfc_modulation nm = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+  cut_assert_equal_int(1, nfc_initiator_select_passive_target(device, nm, NULL, 0, &nt), cut_message("select target"));
+
+  // Full writes need no read
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_REG_CIU_TxMode, 0xff, 0x80), >=, 0, cut_message("write TxMode"));
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_REG_CIU_RxMode, 0xff, 0x80), >=, 0, cut_message("write RxMode"));
+  cut_assert_operator_int(pn53x_write_register(device, PN53X_SFR_P3CFGB, 0xff, 0x5a), >=, 0, cut_message("write register"));
+
+  // The firmware sets the framing of the exchanged frames itself
+  const uint8_t abtRead[] = { 0x30, 0x00 };
+  uint8_t abtRx[16];
+  cut_assert_equal_int(16, nfc_initiator_transceive_bytes(device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), 0), cut_message("READ"));
+  cut_assert_equal_int(0, nfc_device_reset_stats(device), cut_message("nfc_device_reset_stats"));
+
+  uint8_t value;
+  cut_assert_equal_int(0, pn53x_read_register(device, PN53X_SFR_P3CFGB, &value), cut_message("read register"));
+  cut_assert_equal_int(0, read_register_count(), cut_message("register kept by the data exchange"));
+  cut_assert_equal_int(0, pn53x_read_register(device, PN53X_REG_CIU_TxMode, &value), cut_message("read TxMode"));
+  cut_assert_equal_int(1, read_register_count(), cut_message("TxMode read from the chip"));
+  cut_assert_equal_int(0, pn53x_read_register(device, PN53X_REG_CIU_RxMode, &value), cut_message("read RxMode"));
+  cut_assert_equal_int(2, read_register_count(), cut_message("RxMode read from the chip"));
+}
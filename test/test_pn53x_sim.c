@@ -0,0 +1,326 @@
+// Built with -std=c99, clock_gettime() and nanosleep() need POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Exercise the PN53x layer against the pn53x_sim driver: no hardware is
+ * needed, cards are virtual.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_pn53x_sim_list(void);
+void test_pn53x_sim_list_batches(void);
+void test_pn53x_sim_list_selected(void);
+void test_pn53x_sim_list_dedupe(void);
+void test_pn53x_sim_mifare(void);
+void test_pn53x_sim_iso_dep(void);
+void test_pn53x_sim_chained_stats(void);
+void test_pn53x_sim_raw(void);
+void test_pn53x_sim_latency(void);
+void test_pn53x_sim_abort(void);
+
+static const nfc_modulation nm_iso14443a = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+
+static nfc_context *context;
+static nfc_device *device;
+
+void
+cut_setup(void)
+{
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+}
+
+void
+cut_teardown(void)
+{
+  if (device)
+    nfc_close(device);
+  device = NULL;
+  if (context)
+    nfc_exit(context);
+  context = NULL;
+}
+
+// Open the device of a test, closed by cut_teardown()
+static void
+sim_open(const char *connstring)
+{
+  device = nfc_open(context, connstring);
+  cut_assert_not_null(device, cut_message("nfc_open %s", connstring));
+  cut_assert_equal_int(0, nfc_initiator_init(device), cut_message("nfc_initiator_init"));
+}
+
+static long
+elapsed_us(const struct timespec *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000 + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+void
+test_pn53x_sim_list(void)
+{
+  sim_open("pn53x_sim:pn533:mifare-classic,mifare-ultralight,iso14443-4,felica");
+  nfc_target nt[8];
+
+  int res = nfc_initiator_list_passive_targets(device, nm_iso14443a, nt, 8);
+  cut_assert_equal_int(3, res, cut_message("ISO14443A targets"));
+  cut_assert_equal_int(0x08, nt[0].nti.nai.btSak, cut_message("MIFARE Classic SAK"));
+  cut_assert_equal_int(4, nt[0].nti.nai.szUidLen, cut_message("MIFARE Classic UID length"));
+  cut_assert_equal_int(0x00, nt[1].nti.nai.btSak, cut_message("MIFARE Ultralight SAK"));
+  cut_assert_equal_int(7, nt[1].nti.nai.szUidLen, cut_message("MIFARE Ultralight UID length"));
+  cut_assert_equal_int(0x20, nt[2].nti.nai.btSak, cut_message("ISO14443-4 SAK"));
+  cut_assert_equal_int(5, nt[2].nti.nai.szAtsLen, cut_message("ISO14443-4 ATS length"));
+
+  const nfc_modulation nm_felica = { .nmt = NMT_FELICA, .nbr = NBR_212 };
+  res = nfc_initiator_list_passive_targets(device, nm_felica, nt, 8);
+  cut_assert_equal_int(1, res, cut_message("FeliCa targets"));
+  cut_assert_equal_int(0x01, nt[0].nti.nfi.abtId[0], cut_message("FeliCa IDm"));
+}
+
+// Times the command was sent to the chip
+static int
+sim_command_count(const uint8_t btCode)
+{
+  nfc_device_stats stats;
+  cut_assert_equal_int(0, nfc_device_get_stats(device, &stats), cut_message("nfc_device_get_stats"));
+  for (size_t n = 0; n < stats.command_count; n++) {
+    if (stats.commands[n].code == btCode)
+      return (int) stats.commands[n].latency.count;
+  }
+  return 0;
+}
+
+void
+test_pn53x_sim_list_batches(void)
+{
+  // The ISO14443-4 card comes first, so that its ATS is followed by another target
+  static const char *connstrings[] = {
+    "pn53x_sim:pn533:iso14443-4",
+    "pn53x_sim:pn533:iso14443-4,mifare-classic",
+    "pn53x_sim:pn533:iso14443-4,mifare-classic,mifare-ultralight",
+  };
+  const uint8_t abtSak[] = { 0x20, 0x08, 0x00 };
+  const size_t aszUidLen[] = { 7, 4, 7 };
+  // Two targets per InListPassiveTarget, then one listing none
+  const int aiInLists[] = { 2, 2, 3 };
+
+  for (int c = 0; c < 3; c++) {
+    sim_open(connstrings[c]);
+    nfc_target nt[8];
+    const int res = nfc_initiator_list_passive_targets(device, nm_iso14443a, nt, 8);
+    cut_assert_equal_int(c + 1, res, cut_message("targets of %s", connstrings[c]));
+    for (int n = 0; n < res; n++) {
+      cut_assert_equal_int(abtSak[n], nt[n].nti.nai.btSak, cut_message("SAK of target %d of %s", n, connstrings[c]));
+      cut_assert_equal_int(aszUidLen[n], nt[n].nti.nai.szUidLen, cut_message("UID length of target %d of %s", n, connstrings[c]));
+      // The last UID byte is the index of the card
+      cut_assert_equal_int(n, nt[n].nti.nai.abtUid[nt[n].nti.nai.szUidLen - 1], cut_message("UID of target %d of %s", n, connstrings[c]));
+    }
+    cut_assert_equal_int(5, nt[0].nti.nai.szAtsLen, cut_message("ATS length of %s", connstrings[c]));
+    cut_assert_equal_int(aiInLists[c], sim_command_count(0x4a), cut_message("InListPassiveTarget of %s", connstrings[c]));
+    nfc_close(device);
+    device = NULL;
+  }
+}
+
+void
+test_pn53x_sim_list_selected(void)
+{
+  sim_open("pn53x_sim:pn533:mifare-classic,mifare-ultralight,iso14443-4");
+  nfc_target nt[2];
+
+  // A single target is left selected
+  cut_assert_equal_int(1, nfc_initiator_list_passive_targets(device, nm_iso14443a, nt, 1), cut_message("one target"));
+  cut_assert_equal_int(0, nfc_initiator_target_is_present(device, &nt[0]), cut_message("target selected"));
+
+  // Two targets selected at once are not, as only the first one could be talked to
+  cut_assert_equal_int(2, nfc_initiator_list_passive_targets(device, nm_iso14443a, nt, 2), cut_message("two targets"));
+  cut_assert_equal_int(NFC_EINVARG, nfc_initiator_target_is_present(device, NULL), cut_message("no target selected"));
+}
+
+void
+test_pn53x_sim_list_dedupe(void)
+{
+  nfc_target nt[8];
+
+  // Deselected, the card answers again: listing stops once it is seen twice
+  sim_open("pn53x_sim:pn533:mifare-ultralight,no-halt");
+  cut_assert_equal_int(1, nfc_initiator_list_passive_targets(device, nm_iso14443a, nt, 8), cut_message("one card"));
+  cut_assert_equal_int(2, sim_command_count(0x4a), cut_message("InListPassiveTarget of one card"));
+  nfc_close(device);
+  device = NULL;
+
+  // The first two cards answer again and hide the third one
+  sim_open("pn53x_sim:pn533:mifare-classic,mifare-ultralight,iso14443-4,no-halt");
+  cut_assert_equal_int(2, nfc_initiator_list_passive_targets(device, nm_iso14443a, nt, 8), cut_message("three cards"));
+  cut_assert_equal_int(0x08, nt[0].nti.nai.btSak, cut_message("MIFARE Classic SAK"));
+  cut_assert_equal_int(0x00, nt[1].nti.nai.btSak, cut_message("MIFARE Ultralight SAK"));
+  cut_assert_equal_int(2, sim_command_count(0x4a), cut_message("InListPassiveTarget of three cards"));
+}
+
+void
+test_pn53x_sim_mifare(void)
+{
+  sim_open("pn53x_sim:pn532:mifare-classic,mifare-ultralight");
+  nfc_target nt;
+  uint8_t abtRx[32];
+
+  int res = nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt);
+  cut_assert_equal_int(1, res, cut_message("select MIFARE Classic"));
+
+  // Authenticate sector 1 with the transport key A, then write and read back block 4
+  uint8_t abtAuth[12] = { 0x60, 0x04, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+  memcpy(abtAuth + 8, nt.nti.nai.abtUid, 4);
+  res = nfc_initiator_transceive_bytes(device, abtAuth, sizeof(abtAuth), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int(0, res, cut_message("authenticate"));
+  uint8_t abtWrite[18] = { 0xa0, 0x04, 0x01, 0x02, 0x03, 0x04 };
+  res = nfc_initiator_transceive_bytes(device, abtWrite, sizeof(abtWrite), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int(0, res, cut_message("write"));
+  const uint8_t abtRead[] = { 0x30, 0x04 };
+  res = nfc_initiator_transceive_bytes(device, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int(16, res, cut_message("read"));
+  cut_assert_equal_memory(abtWrite + 2, 16, abtRx, 16, cut_message("read back"));
+
+  // Wrong key: the card halts
+  abtAuth[1] = 0x08;
+  abtAuth[2] = 0x00;
+  res = nfc_initiator_transceive_bytes(device, abtAuth, sizeof(abtAuth), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int(NFC_EMFCAUTHFAIL, res, cut_message("authenticate with a wrong key"));
+
+  // Next card is the MIFARE Ultralight, whose UID starts page 0
+  res = nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt);
+  cut_assert_equal_int(1, res, cut_message("select MIFARE Ultralight"));
+  const uint8_t abtReadPage0[] = { 0x30, 0x00 };
+  res = nfc_initiator_transceive_bytes(device, abtReadPage0, sizeof(abtReadPage0), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int(16, res, cut_message("read pages"));
+  cut_assert_equal_memory(nt.nti.nai.abtUid, 3, abtRx, 3, cut_message("UID in page 0"));
+}
+
+void
+test_pn53x_sim_iso_dep(void)
+{
+  sim_open("pn53x_sim:pn533:iso14443-4");
+  nfc_target nt;
+  uint8_t abtApdu[260];
+  uint8_t abtRx[300];
+
+  int res = nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt);
+  cut_assert_equal_int(1, res, cut_message("select ISO14443-4 card"));
+
+  // Answers longer than a normal frame come in an extended frame, longer than
+  // an extended frame are chained
+  const size_t aszApdu[] = { 5, 250, sizeof(abtApdu) };
+  for (size_t n = 0; n < sizeof(aszApdu) / sizeof(aszApdu[0]); n++) {
+    for (size_t i = 0; i < aszApdu[n]; i++)
+      abtApdu[i] = i;
+    res = nfc_initiator_transceive_bytes(device, abtApdu, aszApdu[n], abtRx, sizeof(abtRx), 0);
+    cut_assert_equal_int((int) aszApdu[n] + 2, res, cut_message("APDU of %d bytes", (int) aszApdu[n]));
+    cut_assert_equal_memory(abtApdu, aszApdu[n], abtRx, aszApdu[n], cut_message("APDU echoed"));
+    cut_assert_equal_int(0x90, abtRx[aszApdu[n]], cut_message("SW1"));
+  }
+}
+
+void
+test_pn53x_sim_chained_stats(void)
+{
+  sim_open("pn53x_sim:pn533:iso14443-4,latency=20000");
+  nfc_target nt;
+  nfc_device_stats stats;
+  uint8_t abtApdu[260];
+  uint8_t abtRx[300];
+
+  int res = nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt);
+  cut_assert_equal_int(1, res, cut_message("select ISO14443-4 card"));
+  cut_assert_equal_int(0, nfc_device_reset_stats(device), cut_message("nfc_device_reset_stats"));
+
+  // The answer is chained: every chunk is asked for with its own frame, whose
+  // send time does not include the wait for the previous chunk
+  memset(abtApdu, 0x5a, sizeof(abtApdu));
+  res = nfc_initiator_transceive_bytes(device, abtApdu, sizeof(abtApdu), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int((int) sizeof(abtApdu) + 2, res, cut_message("chained APDU"));
+  cut_assert_equal_int(0, nfc_device_get_stats(device, &stats), cut_message("nfc_device_get_stats"));
+  cut_assert_operator_int(stats.send.count, >=, 2, cut_message("frames sent"));
+  cut_assert_operator_int(stats.send.max_us, <, 20000, cut_message("longest send"));
+}
+
+void
+test_pn53x_sim_raw(void)
+{
+  sim_open("pn53x_sim:pn533:mifare-ultralight");
+  uint8_t abtRx[32];
+  uint8_t abtRxPar[32];
+
+  cut_assert_equal_int(0, nfc_device_set_property_bool(device, NP_HANDLE_CRC, false), cut_message("CRC off"));
+  cut_assert_equal_int(0, nfc_device_set_property_bool(device, NP_EASY_FRAMING, false), cut_message("easy framing off"));
+
+  // REQA, 7 bits: ATQA, 16 bits
+  const uint8_t abtReqa[] = { 0x26 };
+  int res = nfc_initiator_transceive_bits(device, abtReqa, 7, NULL, abtRx, sizeof(abtRx), NULL);
+  cut_assert_equal_int(16, res, cut_message("REQA"));
+  cut_assert_equal_int(0x44, abtRx[0], cut_message("ATQA"));
+
+  // Anticollision, cascade level 1: cascade tag and first UID bytes, with parity bits handled by the host
+  cut_assert_equal_int(0, nfc_device_set_property_bool(device, NP_HANDLE_PARITY, false), cut_message("parity off"));
+  const uint8_t abtAnticol[] = { 0x93, 0x20 };
+  const uint8_t abtAnticolPar[] = { 0x01, 0x00 };
+  res = nfc_initiator_transceive_bits(device, abtAnticol, 16, abtAnticolPar, abtRx, sizeof(abtRx), abtRxPar);
+  cut_assert_equal_int(40, res, cut_message("anticollision"));
+  cut_assert_equal_int(0x88, abtRx[0], cut_message("cascade tag"));
+  cut_assert_equal_int(abtRx[0] ^ abtRx[1] ^ abtRx[2] ^ abtRx[3], abtRx[4], cut_message("BCC"));
+  cut_assert_equal_int(0x01, abtRxPar[0], cut_message("odd parity of 0x88"));
+}
+
+static void *
+abort_later(void *arg)
+{
+  const struct timespec delay = { .tv_sec = 0, .tv_nsec = 20 * 1000 * 1000 };
+  nanosleep(&delay, NULL);
+  nfc_abort_command((nfc_device *) arg);
+  return NULL;
+}
+
+void
+test_pn53x_sim_latency(void)
+{
+  sim_open("pn53x_sim:pn533:iso14443-4,latency=500,rf-latency=2000");
+  nfc_target nt;
+  uint8_t abtRx[16];
+  struct timespec start;
+
+  int res = nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt);
+  cut_assert_equal_int(1, res, cut_message("select"));
+
+  const uint8_t abtApdu[] = { 0x00, 0xa4, 0x04, 0x00 };
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  res = nfc_initiator_transceive_bytes(device, abtApdu, sizeof(abtApdu), abtRx, sizeof(abtRx), 0);
+  long elapsed = elapsed_us(&start);
+  cut_assert_equal_int((int) sizeof(abtApdu) + 2, res, cut_message("APDU"));
+  cut_assert_true(elapsed >= 2500, cut_message("latencies added, took %ld us", elapsed));
+}
+
+void
+test_pn53x_sim_abort(void)
+{
+  nfc_target nt;
+  struct timespec start;
+
+  // A command running for 10 s is aborted
+  sim_open("pn53x_sim:pn533:iso14443-4,rf-latency=10000000");
+  pthread_t thread;
+  pthread_create(&thread, NULL, abort_later, device);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int res = nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt);
+  long elapsed = elapsed_us(&start);
+  pthread_join(thread, NULL);
+  cut_assert_equal_int(NFC_EOPABORTED, res, cut_message("aborted command"));
+  cut_assert_true(elapsed < 1000000, cut_message("aborted after %ld us", elapsed));
+}
@@ -0,0 +1,126 @@
+// Built with -std=c99, nanosleep() needs POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <time.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Poll two pn53x_sim devices from a poll group and check which events are
+ * queued: each device gets its share of the queue, and a card staying in the
+ * field is reported once.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_poll_group_quota(void);
+void test_poll_group_events(void);
+
+#define DEVICE_COUNT 2
+
+// A FeliCa card is listed on every turn it stays in the field, it has no halted state
+static const nfc_modulation nm_felica = { .nmt = NMT_FELICA, .nbr = NBR_212 };
+
+static nfc_context *context;
+static nfc_device *devices[DEVICE_COUNT];
+static nfc_poll_group *group;
+
+void
+cut_setup(void)
+{
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+}
+
+void
+cut_teardown(void)
+{
+  if (group)
+    nfc_poll_group_free(group);
+  group = NULL;
+  for (size_t i = 0; i < DEVICE_COUNT; i++) {
+    if (devices[i])
+      nfc_close(devices[i]);
+    devices[i] = NULL;
+  }
+  if (context)
+    nfc_exit(context);
+  context = NULL;
+}
+
+static void
+poll_group_open(const char *connstring, const size_t szEvents)
+{
+  group = nfc_poll_group_new(&nm_felica, 1, szEvents);
+  cut_assert_not_null(group, cut_message("nfc_poll_group_new"));
+  for (size_t i = 0; i < DEVICE_COUNT; i++) {
+    devices[i] = nfc_open(context, connstring);
+    cut_assert_not_null(devices[i], cut_message("nfc_open device %d", (int) i));
+    cut_assert_equal_int(0, nfc_poll_group_add(group, devices[i]), cut_message("nfc_poll_group_add device %d", (int) i));
+  }
+  cut_assert_equal_int(0, nfc_poll_group_start(group, DEVICE_COUNT), cut_message("nfc_poll_group_start"));
+}
+
+// Index of the device of an event
+static size_t
+event_device(const nfc_poll_event *pev)
+{
+  for (size_t i = 0; i < DEVICE_COUNT; i++) {
+    if (devices[i] == pev->device)
+      return i;
+  }
+  cut_fail("event from an unknown device");
+  return DEVICE_COUNT;
+}
+
+static void
+sleep_ms(const long ms)
+{
+  const struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+  nanosleep(&ts, NULL);
+}
+
+void
+test_poll_group_quota(void)
+{
+  nfc_poll_event ev;
+  size_t aszEvents[DEVICE_COUNT] = { 0 };
+
+  // Three cards per device, but room for two events: one for each device
+  poll_group_open("pn53x_sim:pn533:felica,felica,felica", DEVICE_COUNT);
+  sleep_ms(100);
+
+  for (size_t n = 0; n < DEVICE_COUNT; n++) {
+    cut_assert_equal_int(0, nfc_poll_group_next(group, &ev, -1), cut_message("event %d", (int) n));
+    cut_assert_equal_int(0, ev.error, cut_message("event %d error", (int) n));
+    aszEvents[event_device(&ev)]++;
+  }
+  for (size_t i = 0; i < DEVICE_COUNT; i++)
+    cut_assert_equal_int(1, (int) aszEvents[i], cut_message("events queued by device %d", (int) i));
+  cut_assert_equal_int(NFC_ETIMEOUT, nfc_poll_group_next(group, &ev, -1), cut_message("event over the queue bound"));
+}
+
+void
+test_poll_group_events(void)
+{
+  nfc_poll_event ev;
+  size_t aszEvents[DEVICE_COUNT] = { 0 };
+
+  // Many turns go by while the card stays on each device
+  poll_group_open("pn53x_sim:pn533:felica", 0);
+  sleep_ms(200);
+
+  int res;
+  size_t szEvents = 0;
+  while ((res = nfc_poll_group_next(group, &ev, -1)) == 0) {
+    cut_assert_equal_int(0, ev.error, cut_message("event %d error", (int) szEvents));
+    cut_assert_equal_int(0, (int) ev.modulation, cut_message("event %d modulation", (int) szEvents));
+    cut_assert_equal_int(NMT_FELICA, ev.target.nm.nmt, cut_message("event %d target", (int) szEvents));
+    aszEvents[event_device(&ev)]++;
+    szEvents++;
+  }
+  cut_assert_equal_int(NFC_ETIMEOUT, res, cut_message("no more events"));
+  for (size_t i = 0; i < DEVICE_COUNT; i++)
+    cut_assert_equal_int(1, (int) aszEvents[i], cut_message("events of device %d", (int) i));
+}
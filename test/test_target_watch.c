@@ -0,0 +1,93 @@
+// Built with -std=c99, nanosleep() needs POSIX
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Watch a pn53x_sim device whose card leaves the field and comes back, and
+ * check that each arrival and departure is reported once.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_target_watch_remove_reinsert(void);
+
+#define WATCH_EVENTS 8
+
+static const nfc_modulation nm_iso14443a = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+
+static nfc_context *context;
+static nfc_device *device;
+
+// Events reported by the watch thread
+static struct {
+  pthread_mutex_t mutex;
+  bool present[WATCH_EVENTS];
+  nfc_target targets[WATCH_EVENTS];
+  size_t count;
+} events = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+static void
+watch_callback(nfc_device *pnd, const nfc_target *pnt, const bool present, void *user_data)
+{
+  (void) pnd;
+  (void) user_data;
+  pthread_mutex_lock(&events.mutex);
+  if (events.count < WATCH_EVENTS) {
+    events.present[events.count] = present;
+    events.targets[events.count] = *pnt;
+  }
+  events.count++;
+  pthread_mutex_unlock(&events.mutex);
+}
+
+void
+cut_setup(void)
+{
+  events.count = 0;
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+}
+
+void
+cut_teardown(void)
+{
+  if (device) {
+    nfc_device_unwatch_targets(device);
+    nfc_close(device);
+  }
+  device = NULL;
+  if (context)
+    nfc_exit(context);
+  context = NULL;
+}
+
+void
+test_target_watch_remove_reinsert(void)
+{
+  // The card is in the field for 300 ms, away for 300 ms, then back
+  device = nfc_open(context, "pn53x_sim:pn533:mifare-ultralight,leave=300,back=300");
+  cut_assert_not_null(device, cut_message("nfc_open"));
+  cut_assert_equal_int(0, nfc_device_watch_targets(device, &nm_iso14443a, 1, 20, watch_callback, NULL), cut_message("nfc_device_watch_targets"));
+
+  const struct timespec delay = { .tv_sec = 0, .tv_nsec = 900 * 1000 * 1000 };
+  nanosleep(&delay, NULL);
+  cut_assert_equal_int(0, nfc_device_unwatch_targets(device), cut_message("nfc_device_unwatch_targets"));
+
+  pthread_mutex_lock(&events.mutex);
+  const size_t szCount = events.count;
+  pthread_mutex_unlock(&events.mutex);
+  cut_assert_equal_int(3, szCount, cut_message("events"));
+  cut_assert_true(events.present[0], cut_message("arrival"));
+  cut_assert_true(!events.present[1], cut_message("departure"));
+  cut_assert_true(events.present[2], cut_message("arrival again"));
+  for (size_t n = 1; n < szCount; n++) {
+    cut_assert_equal_memory(events.targets[0].nti.nai.abtUid, events.targets[0].nti.nai.szUidLen,
+                            events.targets[n].nti.nai.abtUid, events.targets[n].nti.nai.szUidLen, cut_message("UID of event %d", (int) n));
+  }
+}
@@ -0,0 +1,372 @@
+#define _XOPEN_SOURCE 600
+
+#include <cutter.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Drive several pn532_uart devices from several threads without hardware:
+ * each device is a pseudo-terminal answered by a minimal PN532 emulator
+ * thread, which echoes InDataExchange payloads back as the card response.
+ */
+void test_thread_storm_devices(void);
+void test_thread_storm_shared_device(void);
+void test_thread_storm_contexts(void);
+
+#define DEVICE_COUNT  4
+#define THREAD_COUNT  4
+#define ITERATIONS    50
+
+struct fake_pn532 {
+  int master;
+  int slave;
+  nfc_connstring connstring;
+  volatile bool stop;
+  pthread_t thread;
+  uint8_t regs[0x10000];
+};
+
+static void
+fake_pn532_write_frame(struct fake_pn532 *fake, const uint8_t *payload, size_t len)
+{
+  uint8_t frame[300];
+  size_t n = 0;
+  const size_t data_len = len + 1;
+  uint8_t dcs = 0xD5;
+
+  frame[n++] = 0x00;
+  frame[n++] = 0x00;
+  frame[n++] = 0xFF;
+  if (data_len <= 0xFF) {
+    frame[n++] = data_len;
+    frame[n++] = 0x100 - data_len;
+  } else {
+    frame[n++] = 0xFF;
+    frame[n++] = 0xFF;
+    frame[n++] = data_len >> 8;
+    frame[n++] = data_len & 0xFF;
+    frame[n++] = 0x100 - ((data_len >> 8) + (data_len & 0xFF));
+  }
+  frame[n++] = 0xD5;
+  for (size_t i = 0; i < len; i++) {
+    frame[n++] = payload[i];
+    dcs += payload[i];
+  }
+  frame[n++] = 0x100 - dcs;
+  frame[n++] = 0x00;
+  if (write(fake->master, frame, n) < 0)
+    return;
+}
+
+static void
+fake_pn532_handle(struct fake_pn532 *fake, const uint8_t *cmd, size_t len)
+{
+  static const uint8_t ack[] = { 0x00, 0x00, 0xFF, 0x00, 0xFF, 0x00 };
+  uint8_t reply[280];
+  size_t n = 0;
+
+  if (write(fake->master, ack, sizeof(ack)) < 0)
+    return;
+  reply[n++] = cmd[0] + 1;
+  switch (cmd[0]) {
+    case 0x00: // Diagnose: echo the communication line test
+      if ((len > 1) && (cmd[1] == 0x00)) {
+        memcpy(reply + n, cmd + 1, len - 1);
+        n += len - 1;
+      } else {
+        reply[n++] = 0x00;
+      }
+      break;
+    case 0x02: // GetFirmwareVersion: PN532 v1.6
+      reply[n++] = 0x32;
+      reply[n++] = 0x01;
+      reply[n++] = 0x06;
+      reply[n++] = 0x07;
+      break;
+    case 0x06: // ReadRegister
+      for (size_t i = 1; i + 1 < len; i += 2)
+        reply[n++] = fake->regs[(cmd[i] << 8) | cmd[i + 1]];
+      break;
+    case 0x08: // WriteRegister
+      for (size_t i = 1; i + 2 < len; i += 3)
+        fake->regs[(cmd[i] << 8) | cmd[i + 1]] = cmd[i + 2];
+      break;
+    case 0x4A: { // InListPassiveTarget: one ISO14443A target
+      static const uint8_t target[] = { 0x01, 0x01, 0x00, 0x04, 0x08, 0x04, 0xDE, 0xAD, 0xBE, 0xEF };
+      memcpy(reply + n, target, sizeof(target));
+      n += sizeof(target);
+    }
+    break;
+    case 0x40: // InDataExchange: the card echoes the payload
+      reply[n++] = 0x00;
+      memcpy(reply + n, cmd + 2, len - 2);
+      n += len - 2;
+      break;
+    case 0x16: // PowerDown
+    case 0x44: // InDeselect
+    case 0x52: // InRelease
+      reply[n++] = 0x00;
+      break;
+    default:
+      break;
+  }
+  fake_pn532_write_frame(fake, reply, n);
+}
+
+static void *
+fake_pn532_thread(void *arg)
+{
+  struct fake_pn532 *fake = arg;
+  uint8_t buf[1024];
+  size_t len = 0;
+
+  while (!fake->stop) {
+    struct pollfd pfd = { .fd = fake->master, .events = POLLIN };
+    if (poll(&pfd, 1, 10) <= 0)
+      continue;
+    ssize_t res = read(fake->master, buf + len, sizeof(buf) - len);
+    if (res <= 0) {
+      usleep(1000);
+      continue;
+    }
+    len += res;
+    for (;;) {
+      // Look for a frame start, skipping wake-up preambles
+      size_t i = 0;
+      while ((i + 1 < len) && !((buf[i] == 0x00) && (buf[i + 1] == 0xFF)))
+        i++;
+      if (i + 1 >= len) {
+        len = (len && (buf[len - 1] == 0x00)) ? 1 : 0;
+        buf[0] = 0x00;
+        break;
+      }
+      const uint8_t *frame = buf + i + 2;
+      const size_t avail = len - i - 2;
+      size_t data_len, offset;
+      if (avail < 2)
+        break;
+      if (((frame[0] == 0x00) && (frame[1] == 0xFF)) || ((frame[0] == 0xFF) && (frame[1] == 0x00))) {
+        // ACK or NACK from the host
+        data_len = 0;
+        offset = 0;
+      } else if ((frame[0] == 0xFF) && (frame[1] == 0xFF)) {
+        if (avail < 5)
+          break;
+        data_len = (frame[2] << 8) | frame[3];
+        offset = 5;
+      } else {
+        data_len = frame[0];
+        offset = 2;
+      }
+      const size_t frame_len = offset ? offset + data_len + 2 : 2;
+      if (avail < frame_len)
+        break;
+      if (offset && (data_len > 1) && (frame[offset] == 0xD4))
+        fake_pn532_handle(fake, frame + offset + 1, data_len - 1);
+      memmove(buf, frame + frame_len, avail - frame_len);
+      len = avail - frame_len;
+    }
+  }
+  return NULL;
+}
+
+static void
+fake_pn532_start(struct fake_pn532 *fake)
+{
+  struct termios tio;
+
+  memset(fake, 0, sizeof(*fake));
+  fake->master = posix_openpt(O_RDWR | O_NOCTTY);
+  cut_assert_true(fake->master >= 0, cut_message("posix_openpt"));
+  cut_assert_equal_int(0, grantpt(fake->master), cut_message("grantpt"));
+  cut_assert_equal_int(0, unlockpt(fake->master), cut_message("unlockpt"));
+  const char *name = ptsname(fake->master);
+  cut_assert_not_equal_pointer(NULL, name, cut_message("ptsname"));
+  snprintf(fake->connstring, sizeof(fake->connstring), "pn532_uart:%s", name);
+  // Keep the slave open so the line never hangs up between driver opens
+  fake->slave = open(name, O_RDWR | O_NOCTTY);
+  cut_assert_true(fake->slave >= 0, cut_message("open %s", name));
+  tcgetattr(fake->slave, &tio);
+  tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+  tio.c_oflag &= ~OPOST;
+  tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  tio.c_cflag &= ~(CSIZE | PARENB);
+  tio.c_cflag |= CS8;
+  tcsetattr(fake->slave, TCSANOW, &tio);
+  cut_assert_equal_int(0, pthread_create(&fake->thread, NULL, fake_pn532_thread, fake), cut_message("pthread_create"));
+}
+
+static void
+fake_pn532_stop(struct fake_pn532 *fake)
+{
+  fake->stop = true;
+  pthread_join(fake->thread, NULL);
+  close(fake->slave);
+  close(fake->master);
+}
+
+struct worker {
+  pthread_t thread;
+  nfc_context *context;
+  const char *connstring;
+  nfc_device *device;
+  uint8_t seed;
+  int errors;
+};
+
+static void
+transceive_loop(struct worker *w, nfc_device *pnd)
+{
+  uint8_t tx[64], rx[64];
+
+  for (int it = 0; it < ITERATIONS; it++) {
+    const size_t len = 1 + (it + w->seed) % sizeof(tx);
+    for (size_t i = 0; i < len; i++)
+      tx[i] = w->seed ^ (uint8_t)(i + it);
+    int res = nfc_initiator_transceive_bytes(pnd, tx, len, rx, sizeof(rx), 1000);
+    if ((res != (int) len) || memcmp(tx, rx, len))
+      w->errors++;
+  }
+}
+
+static void *
+device_worker(void *arg)
+{
+  struct worker *w = arg;
+  const nfc_modulation nm = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+  nfc_target nt;
+
+  nfc_device *pnd = nfc_open(w->context, w->connstring);
+  if (!pnd) {
+    w->errors++;
+    return NULL;
+  }
+  if ((nfc_initiator_init(pnd) < 0) ||
+      (nfc_initiator_select_passive_target(pnd, nm, NULL, 0, &nt) <= 0))
+    w->errors++;
+  else
+    transceive_loop(w, pnd);
+  nfc_close(pnd);
+  return NULL;
+}
+
+static void *
+shared_device_worker(void *arg)
+{
+  struct worker *w = arg;
+  transceive_loop(w, w->device);
+  return NULL;
+}
+
+void
+test_thread_storm_devices(void)
+{
+  struct fake_pn532 *fakes = calloc(DEVICE_COUNT, sizeof(struct fake_pn532));
+  struct worker workers[DEVICE_COUNT];
+  nfc_context *context;
+
+  cut_assert_not_equal_pointer(NULL, fakes, cut_message("calloc"));
+  nfc_init(&context);
+  cut_assert_not_equal_pointer(NULL, context, cut_message("nfc_init"));
+
+  // One device per thread, all opened and used at once in a shared context
+  for (int i = 0; i < DEVICE_COUNT; i++) {
+    fake_pn532_start(&fakes[i]);
+    workers[i] = (struct worker) {
+      .context = context, .connstring = fakes[i].connstring, .seed = 0x11 * (i + 1)
+    };
+  }
+  for (int i = 0; i < DEVICE_COUNT; i++)
+    pthread_create(&workers[i].thread, NULL, device_worker, &workers[i]);
+  for (int i = 0; i < DEVICE_COUNT; i++) {
+    pthread_join(workers[i].thread, NULL);
+    cut_assert_equal_int(0, workers[i].errors, cut_message("device %d", i));
+  }
+
+  nfc_exit(context);
+  for (int i = 0; i < DEVICE_COUNT; i++)
+    fake_pn532_stop(&fakes[i]);
+  free(fakes);
+}
+
+void
+test_thread_storm_shared_device(void)
+{
+  struct fake_pn532 *fake = malloc(sizeof(struct fake_pn532));
+  struct worker workers[THREAD_COUNT];
+  const nfc_modulation nm = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+  nfc_context *context;
+  nfc_target nt;
+
+  cut_assert_not_equal_pointer(NULL, fake, cut_message("malloc"));
+  fake_pn532_start(fake);
+  nfc_init(&context);
+  nfc_device *pnd = nfc_open(context, fake->connstring);
+  cut_assert_not_equal_pointer(NULL, pnd, cut_message("nfc_open"));
+  cut_assert_equal_int(0, nfc_initiator_init(pnd), cut_message("nfc_initiator_init"));
+  cut_assert_equal_int(1, nfc_initiator_select_passive_target(pnd, nm, NULL, 0, &nt), cut_message("select"));
+
+  // Exchanges from several threads must not interleave on the wire
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    workers[i] = (struct worker) { .device = pnd, .seed = 0x23 * (i + 1) };
+    pthread_create(&workers[i].thread, NULL, shared_device_worker, &workers[i]);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(workers[i].thread, NULL);
+    cut_assert_equal_int(0, workers[i].errors, cut_message("thread %d", i));
+  }
+
+  nfc_device_stats stats;
+  cut_assert_equal_int(0, nfc_device_get_stats(pnd, &stats), cut_message("nfc_device_get_stats"));
+  cut_assert_equal_int(0, (int) stats.errors, cut_message("device errors"));
+
+  nfc_close(pnd);
+  nfc_exit(context);
+  fake_pn532_stop(fake);
+  free(fake);
+}
+
+static void *
+context_worker(void *arg)
+{
+  struct worker *w = arg;
+  nfc_connstring connstrings[1];
+
+  for (int it = 0; it < ITERATIONS; it++) {
+    nfc_context *context;
+    nfc_init(&context);
+    if (!context) {
+      w->errors++;
+      continue;
+    }
+    nfc_list_devices(context, connstrings, 1);
+    nfc_exit(context);
+  }
+  return NULL;
+}
+
+void
+test_thread_storm_contexts(void)
+{
+  struct worker workers[THREAD_COUNT];
+
+  // Contexts are created and released concurrently while sharing the driver list
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    workers[i] = (struct worker) { .errors = 0 };
+    pthread_create(&workers[i].thread, NULL, context_worker, &workers[i]);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    pthread_join(workers[i].thread, NULL);
+    cut_assert_equal_int(0, workers[i].errors, cut_message("thread %d", i));
+  }
+}
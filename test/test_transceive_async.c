@@ -0,0 +1,96 @@
+#include <cutter.h>
+
+#include <poll.h>
+#include <string.h>
+
+#include <nfc/nfc.h>
+
+/*
+ * Exercise nfc_initiator_transceive_bytes_async() and _complete() against the
+ * pn53x_sim driver, whose answers are ready once its RF latency elapsed.
+ */
+void cut_setup(void);
+void cut_teardown(void);
+void test_transceive_async_pollfd(void);
+void test_transceive_async_pending(void);
+
+static const nfc_modulation nm_iso14443a = { .nmt = NMT_ISO14443A, .nbr = NBR_106 };
+
+static nfc_context *context;
+static nfc_device *device;
+
+void
+cut_setup(void)
+{
+  nfc_init(&context);
+  cut_assert_not_null(context, cut_message("nfc_init"));
+  device = nfc_open(context, "pn53x_sim:pn533:iso14443-4,rf-latency=20000");
+  cut_assert_not_null(device, cut_message("nfc_open"));
+  cut_assert_equal_int(0, nfc_initiator_init(device), cut_message("nfc_initiator_init"));
+  nfc_target nt;
+  cut_assert_equal_int(1, nfc_initiator_select_passive_target(device, nm_iso14443a, NULL, 0, &nt), cut_message("select"));
+}
+
+void
+cut_teardown(void)
+{
+  if (device)
+    nfc_close(device);
+  device = NULL;
+  if (context)
+    nfc_exit(context);
+  context = NULL;
+}
+
+void
+test_transceive_async_pollfd(void)
+{
+  const uint8_t abtApdu[] = { 0x00, 0xa4, 0x04, 0x00 };
+  uint8_t abtRx[16];
+
+  int fd = nfc_device_get_pollfd(device);
+  cut_assert_operator_int(fd, >=, 0, cut_message("pollfd"));
+
+  int res = nfc_initiator_transceive_bytes_async(device, abtApdu, sizeof(abtApdu), 0);
+  cut_assert_equal_int(0, res, cut_message("submit"));
+
+  // The answer takes 20 ms to come
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  cut_assert_equal_int(0, poll(&pfd, 1, 0), cut_message("pollfd readable before the answer"));
+  cut_assert_equal_int(1, poll(&pfd, 1, 1000), cut_message("pollfd not readable after the answer"));
+
+  res = nfc_initiator_transceive_bytes_complete(device, abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int((int) sizeof(abtApdu) + 2, res, cut_message("complete"));
+  cut_assert_equal_memory(abtApdu, sizeof(abtApdu), abtRx, sizeof(abtApdu), cut_message("APDU echoed"));
+  cut_assert_equal_int(0x90, abtRx[sizeof(abtApdu)], cut_message("SW1"));
+
+  // Once collected, the pollfd is no more readable
+  cut_assert_equal_int(0, poll(&pfd, 1, 0), cut_message("pollfd readable after completion"));
+}
+
+void
+test_transceive_async_pending(void)
+{
+  const uint8_t abtApdu1[] = { 0x00, 0xb0, 0x00, 0x01 };
+  const uint8_t abtApdu2[] = { 0x00, 0xb0, 0x00, 0x02 };
+  uint8_t abtRx[16];
+
+  // Nothing to complete yet
+  int res = nfc_initiator_transceive_bytes_complete(device, abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int(NFC_EINVARG, res, cut_message("complete without submit"));
+
+  res = nfc_initiator_transceive_bytes_async(device, abtApdu1, sizeof(abtApdu1), 0);
+  cut_assert_equal_int(0, res, cut_message("first submit"));
+  res = nfc_initiator_transceive_bytes_async(device, abtApdu2, sizeof(abtApdu2), 0);
+  cut_assert_equal_int(NFC_EINVARG, res, cut_message("second submit before completion"));
+
+  // The first frame is still in flight and gets its own answer
+  res = nfc_initiator_transceive_bytes_complete(device, abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int((int) sizeof(abtApdu1) + 2, res, cut_message("complete"));
+  cut_assert_equal_memory(abtApdu1, sizeof(abtApdu1), abtRx, sizeof(abtApdu1), cut_message("first APDU echoed"));
+
+  // The device is usable again
+  res = nfc_initiator_transceive_bytes(device, abtApdu2, sizeof(abtApdu2), abtRx, sizeof(abtRx), 0);
+  cut_assert_equal_int((int) sizeof(abtApdu2) + 2, res, cut_message("synchronous transceive"));
+  cut_assert_equal_memory(abtApdu2, sizeof(abtApdu2), abtRx, sizeof(abtApdu2), cut_message("second APDU echoed"));
+}
@@ -0,0 +1,435 @@
+/*-
+ * Free/Libre Near Field Communication (NFC) library
+ *
+ * Libnfc historical contributors:
+ * Copyright (C) 2009      Roel Verdult
+ * Copyright (C) 2009-2013 Romuald Conty
+ * Copyright (C) 2010-2012 Romain Tartière
+ * Copyright (C) 2010-2013 Philippe Teuwen
+ * Copyright (C) 2012-2013 Ludovic Rousseau
+ * See AUTHORS file for a more comprehensive list of contributors.
+ * Additional contributors of this file:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  1) Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *  2 )Redistributions in binary form must reproduce the above copyright
+ *  notice, this list of conditions and the following disclaimer in the
+ *  documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Note that this license only applies on the examples, NFC library itself is under LGPL
+ *
+ */
+
+/**
+ * @file nfc-bench.c
+ * @brief Measure the throughput and latency of standard NFC workloads
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif // HAVE_CONFIG_H
+
+#include <err.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+#include <nfc/nfc.h>
+
+#include "nfc-utils.h"
+#include "libnfc/chips/pn53x.h"
+
+#define DEFAULT_ITERATIONS 1000
+#define DEFAULT_WARMUP     10
+#define DEFAULT_PAYLOAD    16
+#define MAX_PAYLOAD        250
+
+static const nfc_modulation nmIso14443A = {
+  .nmt = NMT_ISO14443A,
+  .nbr = NBR_106,
+};
+
+static nfc_target nt;
+static uint8_t abtTx[MAX_PAYLOAD + 5];
+static size_t szTx;
+static uint8_t abtRx[MAX_PAYLOAD + 16];
+static size_t szPayload = DEFAULT_PAYLOAD;
+
+// Monotonic time, in ns
+static uint64_t
+bench_now(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER liFrequency, liNow;
+  QueryPerformanceFrequency(&liFrequency);
+  QueryPerformanceCounter(&liNow);
+  return (uint64_t)(liNow.QuadPart / liFrequency.QuadPart) * 1000000000 +
+         (uint64_t)(liNow.QuadPart % liFrequency.QuadPart) * 1000000000 / liFrequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Initiator with default settings, selecting once instead of forever
+static bool
+initiator_setup(nfc_device *pnd)
+{
+  if (nfc_initiator_init(pnd) < 0) {
+    nfc_perror(pnd, "nfc_initiator_init");
+    return false;
+  }
+  return (nfc_device_set_property_bool(pnd, NP_INFINITE_SELECT, false) >= 0) &&
+         (nfc_device_set_property_bool(pnd, NP_HANDLE_CRC, true) >= 0) &&
+         (nfc_device_set_property_bool(pnd, NP_HANDLE_PARITY, true) >= 0) &&
+         (nfc_device_set_property_bool(pnd, NP_EASY_FRAMING, true) >= 0);
+}
+
+static bool
+select_setup(nfc_device *pnd)
+{
+  return initiator_setup(pnd) && (nfc_initiator_select_passive_target(pnd, nmIso14443A, NULL, 0, &nt) == 1);
+}
+
+// Select the first ISO14443A target whose SAK matches, the other ones are halted
+static bool
+select_sak(nfc_device *pnd, const uint8_t btMask, const uint8_t btSak)
+{
+  if (!initiator_setup(pnd))
+    return false;
+  while (nfc_initiator_select_passive_target(pnd, nmIso14443A, NULL, 0, &nt) == 1) {
+    if ((nt.nti.nai.btSak & btMask) == btSak)
+      return true;
+    nfc_initiator_deselect_target(pnd);
+  }
+  return false;
+}
+
+// Deselected cards are halted until they leave the field, so the field is reset
+static void
+select_prepare(nfc_device *pnd)
+{
+  nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, false);
+  nfc_device_set_property_bool(pnd, NP_ACTIVATE_FIELD, true);
+}
+
+static bool
+select_run(nfc_device *pnd)
+{
+  return (nfc_initiator_select_passive_target(pnd, nmIso14443A, NULL, 0, &nt) == 1) &&
+         (nfc_initiator_deselect_target(pnd) >= 0);
+}
+
+static bool
+mifare_setup(nfc_device *pnd)
+{
+  // MIFARE Classic or Ultralight
+  if (!select_sak(pnd, 0x08, 0x08) && !select_sak(pnd, 0xff, 0x00))
+    return false;
+  if (nt.nti.nai.btSak & 0x08) {
+    // MIFARE Classic: authenticate sector 1 with the transport key A
+    const uint8_t abtAuth[12] = { 0x60, 0x04, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    memcpy(abtTx, abtAuth, 8);
+    memcpy(abtTx + 8, nt.nti.nai.abtUid + nt.nti.nai.szUidLen - 4, 4);
+    return nfc_initiator_transceive_bytes(pnd, abtTx, sizeof(abtAuth), abtRx, sizeof(abtRx), 0) >= 0;
+  }
+  return true;
+}
+
+static bool
+mifare_run(nfc_device *pnd)
+{
+  const uint8_t abtRead[2] = { 0x30, 0x04 };
+  return nfc_initiator_transceive_bytes(pnd, abtRead, sizeof(abtRead), abtRx, sizeof(abtRx), 0) == 16;
+}
+
+static bool
+iso_dep_setup(nfc_device *pnd)
+{
+  if (!select_sak(pnd, 0x20, 0x20))
+    return false;
+  // SELECT by name, with the payload as name
+  const uint8_t abtSelect[4] = { 0x00, 0xa4, 0x04, 0x00 };
+  memcpy(abtTx, abtSelect, sizeof(abtSelect));
+  abtTx[4] = (uint8_t) szPayload;
+  for (size_t i = 0; i < szPayload; i++)
+    abtTx[5 + i] = (uint8_t) i;
+  szTx = 5 + szPayload;
+  return true;
+}
+
+static bool
+iso_dep_run(nfc_device *pnd)
+{
+  return nfc_initiator_transceive_bytes(pnd, abtTx, szTx, abtRx, sizeof(abtRx), 0) >= 2;
+}
+
+static bool
+raw_setup(nfc_device *pnd)
+{
+  if (!initiator_setup(pnd) ||
+      (nfc_device_set_property_bool(pnd, NP_HANDLE_CRC, false) < 0) ||
+      (nfc_device_set_property_bool(pnd, NP_EASY_FRAMING, false) < 0))
+    return false;
+  // WUPA, 7 bits: the card is then ready for anticollision
+  const uint8_t abtWupa[1] = { 0x52 };
+  return nfc_initiator_transceive_bits(pnd, abtWupa, 7, NULL, abtRx, sizeof(abtRx), NULL) == 16;
+}
+
+static bool
+raw_run(nfc_device *pnd)
+{
+  // Anticollision, cascade level 1: a ready card stays ready
+  const uint8_t abtAnticol[2] = { 0x93, 0x20 };
+  return nfc_initiator_transceive_bits(pnd, abtAnticol, 16, NULL, abtRx, sizeof(abtRx), NULL) == 40;
+}
+
+static bool
+registers_run(nfc_device *pnd)
+{
+  // Eight CIU registers in one ReadRegister command
+  const uint8_t abtCmd[17] = { ReadRegister, 0x63, 0x01, 0x63, 0x02, 0x63, 0x03, 0x63, 0x04,
+                               0x63, 0x05, 0x63, 0x06, 0x63, 0x08, 0x63, 0x09
+                             };
+  return pn53x_transceive(pnd, abtCmd, sizeof(abtCmd), abtRx, sizeof(abtRx), -1) >= 8;
+}
+
+static bool
+registers_setup(nfc_device *pnd)
+{
+  char *strinfo = NULL;
+  if (!initiator_setup(pnd) || (nfc_device_get_information_about(pnd, &strinfo) < 0))
+    return false;
+  // Registers are only reachable on PN53x chips
+  const bool bPn53x = (0 == strncmp(strinfo, "chip: PN53", 10));
+  nfc_free(strinfo);
+  return bPn53x && registers_run(pnd);
+}
+
+static bool
+dep_setup(nfc_device *pnd)
+{
+  if (!initiator_setup(pnd) || (nfc_initiator_select_dep_target(pnd, NDM_PASSIVE, NBR_106, NULL, &nt, 1000) < 1))
+    return false;
+  for (size_t i = 0; i < szPayload; i++)
+    abtTx[i] = (uint8_t) i;
+  szTx = szPayload;
+  return true;
+}
+
+static bool
+dep_run(nfc_device *pnd)
+{
+  return nfc_initiator_transceive_bytes(pnd, abtTx, szTx, abtRx, sizeof(abtRx), 1000) > 0;
+}
+
+struct bench_workload {
+  const char *name;
+  const char *description;
+  /** Set the device up, false when the workload can not run on it */
+  bool (*setup)(nfc_device *pnd);
+  /** Untimed step before each operation, may be NULL */
+  void (*prepare)(nfc_device *pnd);
+  /** One operation, true on success */
+  bool (*run)(nfc_device *pnd);
+};
+
+static const struct bench_workload workloads[] = {
+  { "select",    "ISO14443A select and deselect",             select_setup,    select_prepare, select_run },
+  { "mifare",    "MIFARE 16-byte READ",                       mifare_setup,    NULL,           mifare_run },
+  { "iso-dep",   "ISO14443-4 APDU exchange",                  iso_dep_setup,   NULL,           iso_dep_run },
+  { "raw",       "Raw anticollision bit frames",              raw_setup,       NULL,           raw_run },
+  { "registers", "PN53x ReadRegister of 8 registers",         registers_setup, NULL,           registers_run },
+  { "dep",       "D.E.P. exchange with a passive target",     dep_setup,       NULL,           dep_run },
+};
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+static int
+compare_u64(const void *a, const void *b)
+{
+  const uint64_t ui64A = *(const uint64_t *) a;
+  const uint64_t ui64B = *(const uint64_t *) b;
+  return (ui64A > ui64B) - (ui64A < ui64B);
+}
+
+// Latency at the given per mille rank of sorted durations, in us
+static double
+percentile_us(const uint64_t *pui64Sorted, const size_t szCount, const size_t szPerMille)
+{
+  size_t szRank = (szCount * szPerMille + 999) / 1000;
+  return pui64Sorted[szRank ? szRank - 1 : 0] / 1000.0;
+}
+
+static void
+print_usage(const char *argv[])
+{
+  printf("Usage: %s [OPTIONS] [WORKLOAD...]\n", argv[0]);
+  printf("Options:\n");
+  printf("\t-h\tPrint this help message.\n");
+  printf("\t-d\tConnstring of the device to use, default is the first one found.\n");
+  printf("\t-n\tOperations per workload (default: %d).\n", DEFAULT_ITERATIONS);
+  printf("\t-w\tUntimed warmup operations per workload (default: %d).\n", DEFAULT_WARMUP);
+  printf("\t-s\tPayload size of iso-dep and dep exchanges, up to %d (default: %d).\n", MAX_PAYLOAD, DEFAULT_PAYLOAD);
+  printf("\t-m\tMachine-readable output, comma separated values.\n");
+  printf("Workloads (default: all, skipped when no suitable target is found):\n");
+  for (size_t i = 0; i < WORKLOAD_COUNT; i++)
+    printf("\t%s\t%s\n", workloads[i].name, workloads[i].description);
+}
+
+int
+main(int argc, const char *argv[])
+{
+  const char *connstring = NULL;
+  unsigned long ulIterations = DEFAULT_ITERATIONS;
+  unsigned long ulWarmup = DEFAULT_WARMUP;
+  bool bMachine = false;
+  bool abSelected[WORKLOAD_COUNT] = { false };
+  bool bAny = false;
+
+  // Get commandline options
+  for (int arg = 1; arg < argc; arg++) {
+    if (0 == strcmp(argv[arg], "-h")) {
+      print_usage(argv);
+      exit(EXIT_SUCCESS);
+    } else if ((0 == strcmp(argv[arg], "-d")) && (arg + 1 < argc)) {
+      connstring = argv[++arg];
+    } else if ((0 == strcmp(argv[arg], "-n")) && (arg + 1 < argc)) {
+      ulIterations = strtoul(argv[++arg], NULL, 10);
+    } else if ((0 == strcmp(argv[arg], "-w")) && (arg + 1 < argc)) {
+      ulWarmup = strtoul(argv[++arg], NULL, 10);
+    } else if ((0 == strcmp(argv[arg], "-s")) && (arg + 1 < argc)) {
+      szPayload = strtoul(argv[++arg], NULL, 10);
+    } else if (0 == strcmp(argv[arg], "-m")) {
+      bMachine = true;
+    } else {
+      size_t i;
+      for (i = 0; i < WORKLOAD_COUNT; i++) {
+        if (0 == strcmp(argv[arg], workloads[i].name))
+          break;
+      }
+      if (i == WORKLOAD_COUNT) {
+        ERR("%s is not supported option.", argv[arg]);
+        print_usage(argv);
+        exit(EXIT_FAILURE);
+      }
+      abSelected[i] = bAny = true;
+    }
+  }
+  if (!ulIterations || !szPayload || (szPayload > MAX_PAYLOAD)) {
+    ERR("%s", "Invalid operation count or payload size.");
+    print_usage(argv);
+    exit(EXIT_FAILURE);
+  }
+  uint64_t *pui64Durations = malloc(ulIterations * sizeof(uint64_t));
+  if (!pui64Durations) {
+    ERR("%s", "Unable to allocate durations (malloc)");
+    exit(EXIT_FAILURE);
+  }
+
+  nfc_context *context;
+  nfc_init(&context);
+  if (context == NULL) {
+    ERR("Unable to init libnfc (malloc)");
+    free(pui64Durations);
+    exit(EXIT_FAILURE);
+  }
+
+  nfc_device *pnd = nfc_open(context, connstring);
+  if (pnd == NULL) {
+    ERR("%s", "Unable to open NFC device.");
+    free(pui64Durations);
+    nfc_exit(context);
+    exit(EXIT_FAILURE);
+  }
+
+  if (bMachine) {
+    printf("workload,ops,errors,ops_per_s,p50_us,p99_us,p999_us,min_us,max_us\n");
+  } else {
+    printf("%s uses libnfc %s\n", argv[0], nfc_version());
+    printf("NFC device: %s opened\n", nfc_device_get_name(pnd));
+    printf("%lu operations per workload, after %lu warmup ones\n", ulIterations, ulWarmup);
+    printf("%-10s %8s %8s %12s %10s %10s %10s\n", "workload", "ops", "errors", "ops/s", "p50 (us)", "p99 (us)", "p999 (us)");
+  }
+
+  for (size_t w = 0; w < WORKLOAD_COUNT; w++) {
+    const struct bench_workload *pw = &workloads[w];
+    if (bAny && !abSelected[w])
+      continue;
+    if (!pw->setup(pnd)) {
+      if (bMachine)
+        WARN("%s skipped: no suitable target", pw->name);
+      else
+        printf("%-10s skipped: no suitable target\n", pw->name);
+      continue;
+    }
+
+    for (unsigned long i = 0; i < ulWarmup; i++) {
+      if (pw->prepare)
+        pw->prepare(pnd);
+      pw->run(pnd);
+    }
+    size_t szOps = 0;
+    unsigned long ulErrors = 0;
+    uint64_t ui64Total = 0;
+    for (unsigned long i = 0; i < ulIterations; i++) {
+      if (pw->prepare)
+        pw->prepare(pnd);
+      const uint64_t ui64Start = bench_now();
+      const bool bSuccess = pw->run(pnd);
+      const uint64_t ui64Duration = bench_now() - ui64Start;
+      if (!bSuccess) {
+        ulErrors++;
+        continue;
+      }
+      pui64Durations[szOps++] = ui64Duration;
+      ui64Total += ui64Duration;
+    }
+    nfc_initiator_deselect_target(pnd);
+
+    if (!szOps) {
+      if (bMachine)
+        printf("%s,0,%lu,,,,,,\n", pw->name, ulErrors);
+      else
+        printf("%-10s %8d %8lu\n", pw->name, 0, ulErrors);
+      continue;
+    }
+    // Throughput of the timed operations only
+    qsort(pui64Durations, szOps, sizeof(uint64_t), compare_u64);
+    const double dOpsPerSecond = ui64Total ? szOps * 1e9 / ui64Total : 0;
+    if (bMachine) {
+      printf("%s,%" PRIuPTR ",%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", pw->name, szOps, ulErrors, dOpsPerSecond,
+             percentile_us(pui64Durations, szOps, 500), percentile_us(pui64Durations, szOps, 990), percentile_us(pui64Durations, szOps, 999),
+             pui64Durations[0] / 1000.0, pui64Durations[szOps - 1] / 1000.0);
+    } else {
+      printf("%-10s %8" PRIuPTR " %8lu %12.1f %10.1f %10.1f %10.1f\n", pw->name, szOps, ulErrors, dOpsPerSecond,
+             percentile_us(pui64Durations, szOps, 500), percentile_us(pui64Durations, szOps, 990), percentile_us(pui64Durations, szOps, 999));
+    }
+  }
+
+  free(pui64Durations);
+  nfc_close(pnd);
+  nfc_exit(context);
+  exit(EXIT_SUCCESS);
+}